@@ -0,0 +1,258 @@
+#include <algorithm>
+#include <bit>
+#include <cstdlib>
+#include <new>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+// cached blocks are poisoned under AddressSanitizer, so a use after free is
+// still reported although the memory is never returned to malloc
+#if __has_include(<sanitizer/asan_interface.h>)
+#include <sanitizer/asan_interface.h>
+#else
+#define ASAN_POISON_MEMORY_REGION(addr, size) ((void)(addr), (void)(size))
+#define ASAN_UNPOISON_MEMORY_REGION(addr, size) ((void)(addr), (void)(size))
+#endif
+
+#include "allocator.h"
+
+namespace mt {
+
+    namespace {
+
+        size_t env_size(
+                const char* name,
+                const size_t fallback
+        ) {
+            if (const char* env { std::getenv(name) }) {
+                const long value { std::strtol(env, nullptr, 10) };
+                if (value >= 0) return static_cast<size_t>(value);
+            }
+            return fallback;
+        }
+
+        size_t cache_limit() {
+            static const size_t limit { env_size("MINITORCH_CACHE_MB", 1024) << 20 };
+            return limit;
+        }
+
+        bool huge_pages_enabled() {
+            static const bool enabled { env_size("MINITORCH_HUGE_PAGES", 1) != 0 };
+            return enabled;
+        }
+
+        size_t round_up(
+                const size_t value,
+                const size_t multiple
+        ) {
+            return (value + multiple - 1) / multiple * multiple;
+        }
+
+        // Four classes per power of two, so at most a quarter of a block is
+        // wasted, and whole huge pages for the large ones.
+        size_t size_class(
+                const size_t bytes
+        ) {
+            if (bytes <= BUFFER_ALIGNMENT) return BUFFER_ALIGNMENT;
+            if (bytes >= HUGE_PAGE_SIZE) return round_up(bytes, HUGE_PAGE_SIZE);
+            return round_up(bytes, std::bit_floor(bytes - 1) / 4);
+        }
+
+        std::align_val_t block_alignment(
+                const size_t block
+        ) {
+            return std::align_val_t{ block >= HUGE_PAGE_SIZE ? HUGE_PAGE_SIZE : BUFFER_ALIGNMENT };
+        }
+
+        void* system_allocate(
+                const size_t block
+        ) {
+            void* p { ::operator new(block, block_alignment(block)) };
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+            if (block >= HUGE_PAGE_SIZE && huge_pages_enabled()) madvise(p, block, MADV_HUGEPAGE);
+#endif
+            return p;
+        }
+
+        void system_free(
+                void* p,
+                const size_t block
+        ) {
+            ::operator delete(p, block_alignment(block));
+        }
+
+        class ThreadCache {
+        public:
+            ThreadCache():
+                m_free{},
+                m_stats{} {}
+
+            ThreadCache(const ThreadCache&) = delete;
+            ThreadCache& operator=(const ThreadCache&) = delete;
+
+            ~ThreadCache() {
+                release();
+            }
+
+            // Pops a cached block of the class into p, false when there is none.
+            bool take(
+                    const size_t block,
+                    void*& p
+            ) {
+                const auto it { m_free.find(block) };
+                if (it == m_free.end() || it->second.empty()) return false;
+                p = it->second.back();
+                it->second.pop_back();
+                m_stats.cached_bytes -= block;
+                ASAN_UNPOISON_MEMORY_REGION(p, block);
+                return true;
+            }
+
+            void give(
+                    void* p,
+                    const size_t block
+            ) {
+                if (m_stats.cached_bytes + block > cache_limit()) {
+                    system_free(p, block);
+                    return;
+                }
+                ASAN_POISON_MEMORY_REGION(p, block);
+                m_free[block].push_back(p);
+                m_stats.cached_bytes += block;
+            }
+
+            void release() {
+                for (auto& [block, list] : m_free) {
+                    for (void* p : list) {
+                        ASAN_UNPOISON_MEMORY_REGION(p, block);
+                        system_free(p, block);
+                    }
+                }
+                m_free.clear();
+                m_stats.cached_bytes = 0;
+            }
+
+            std::unordered_map<size_t, std::vector<void*>> m_free;
+            AllocatorStats m_stats;
+        };
+
+        // Buffers may outlive the cache of the thread that frees them (static
+        // tensors destroyed at exit): those go straight back to the system.
+        enum class CacheState { Unused, Alive, Destroyed };
+        thread_local CacheState t_cache_state { CacheState::Unused };
+
+        struct CacheHolder {
+            ThreadCache cache {};
+            CacheHolder() { t_cache_state = CacheState::Alive; }
+            ~CacheHolder() { t_cache_state = CacheState::Destroyed; }
+        };
+
+        ThreadCache* thread_cache() {
+            if (t_cache_state == CacheState::Destroyed) return nullptr;
+            thread_local CacheHolder holder {};
+            return &holder.cache;
+        }
+
+        void* allocate_block(
+                const size_t block,
+                bool& cached
+        ) {
+            void* p { nullptr };
+            ThreadCache* cache { thread_cache() };
+            cached = cache && cache->take(block, p);
+            return cached ? p : system_allocate(block);
+        }
+
+        void free_block(
+                void* p,
+                const size_t block
+        ) {
+            if (ThreadCache* cache { thread_cache() }) {
+                cache->give(p, block);
+            } else {
+                system_free(p, block);
+            }
+        }
+
+        thread_local BufferSource* t_buffer_source { nullptr };
+
+        struct BufferDeleter {
+            size_t block;
+
+            void operator()(float* p) const {
+                free_block(p, block);
+            }
+        };
+
+        // Serves the shared_ptr control blocks from the same cache, so a
+        // buffer handed out from the cache costs no malloc at all.
+        template <typename T>
+        struct ControlBlockAllocator {
+            using value_type = T;
+
+            ControlBlockAllocator() = default;
+
+            template <typename U>
+            ControlBlockAllocator(const ControlBlockAllocator<U>&) {}
+
+            T* allocate(
+                    const size_t n
+            ) {
+                bool cached { false };
+                return static_cast<T*>(allocate_block(size_class(n * sizeof(T)), cached));
+            }
+
+            void deallocate(
+                    T* p,
+                    const size_t n
+            ) {
+                free_block(p, size_class(n * sizeof(T)));
+            }
+
+            template <typename U>
+            bool operator==(const ControlBlockAllocator<U>&) const { return true; }
+        };
+    }
+
+    std::shared_ptr<float[]> allocate_buffer(
+            const size_t numel
+    ) {
+        if (BufferSource* source { t_buffer_source }) {
+            const BufferSourceGuard suspended(nullptr);
+            if (std::shared_ptr<float[]> buffer { source->allocate(numel) }) return buffer;
+        }
+        const size_t block { size_class(std::max<size_t>(numel, 1) * sizeof(float)) };
+        bool cached { false };
+        float* p { static_cast<float*>(allocate_block(block, cached)) };
+
+        if (ThreadCache* cache { thread_cache() }) {
+            cache->m_stats.allocations++;
+            if (cached) cache->m_stats.cache_hits++;
+        }
+        return std::shared_ptr<float[]>(p, BufferDeleter{ block }, ControlBlockAllocator<float>{});
+    }
+
+    BufferSourceGuard::BufferSourceGuard(
+            BufferSource* source
+    ):
+        m_prev_source{ t_buffer_source } {
+        t_buffer_source = source;
+    }
+
+    BufferSourceGuard::~BufferSourceGuard() {
+        t_buffer_source = m_prev_source;
+    }
+
+    AllocatorStats allocator_stats() {
+        const ThreadCache* cache { thread_cache() };
+        return cache ? cache->m_stats : AllocatorStats{};
+    }
+
+    void empty_cache() {
+        if (ThreadCache* cache { thread_cache() }) cache->release();
+    }
+}
@@ -0,0 +1,69 @@
+#ifndef ALLOCATOR_H
+#define ALLOCATOR_H
+
+#include <cstddef>
+#include <memory>
+
+namespace mt {
+
+    // Alignment of every tensor buffer: a cache line, and a full AVX-512 vector.
+    constexpr size_t BUFFER_ALIGNMENT { 64 };
+
+    // Blocks of at least this size are rounded to whole huge pages, aligned on
+    // them and advised as transparent huge pages.
+    constexpr size_t HUGE_PAGE_SIZE { size_t{ 2 } << 20 };
+
+    // Returns an uninitialized buffer of numel floats. Blocks are rounded up to
+    // size classes, and a freed block goes to a free list of the thread that
+    // drops the last reference, so the same shapes allocated and freed over
+    // and over (a training step) are served without touching malloc.
+    // The cache of each thread is capped by MINITORCH_CACHE_MB (default 1024,
+    // 0 disables caching), MINITORCH_HUGE_PAGES=0 turns off huge page advice.
+    std::shared_ptr<float[]> allocate_buffer(
+            const size_t numel
+    );
+
+    // Serves the buffers of allocate_buffer on the threads it is installed
+    // on, ahead of the cache, e.g. the slab of a static memory plan (see
+    // jit/memory_plan.h). It is not installed while it is called, so it can
+    // get buffers from the cache itself.
+    class BufferSource {
+    public:
+        virtual ~BufferSource() = default;
+
+        // A buffer for numel floats, or nullptr for the cache to serve it.
+        virtual std::shared_ptr<float[]> allocate(
+                const size_t numel
+        ) = 0;
+    };
+
+    // Installs source on the calling thread for its scope, restores the
+    // previous one (nullptr: none) on exit.
+    class BufferSourceGuard {
+    public:
+        explicit BufferSourceGuard(
+                BufferSource* source
+        );
+        ~BufferSourceGuard();
+
+        BufferSourceGuard(const BufferSourceGuard&) = delete;
+        BufferSourceGuard& operator=(const BufferSourceGuard&) = delete;
+
+    private:
+        BufferSource* const m_prev_source;
+    };
+
+    // Counters of the calling thread's cache.
+    struct AllocatorStats {
+        size_t allocations;  // buffers handed out by allocate_buffer
+        size_t cache_hits;   // blocks served from a free list
+        size_t cached_bytes; // bytes currently held in free lists
+    };
+
+    AllocatorStats allocator_stats();
+
+    // Returns every block cached by the calling thread to the system.
+    void empty_cache();
+}
+
+#endif
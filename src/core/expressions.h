@@ -0,0 +1,325 @@
+#ifndef EXPRESSIONS_H
+#define EXPRESSIONS_H
+
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+
+#include "tensors.h"
+#include "tensor_storages.h"
+#include "kernels/elementwise.h"
+
+// Lazy element-wise expressions. Combining lazy(...) operands with the
+// operators below records the computation in the type of the result, nothing
+// is computed until it is converted to a TensorStorage or a Tensor (or passed
+// to assign). The whole tree is then evaluated in a single s_apply_op pass:
+// operands are read once, the output is written once, and intermediates only
+// live in per-block stack buffers. Broadcasting follows the eager operators.
+//
+//     x.accumulate_grad((-lazy(a) / (lazy(b) * b) * grad).storage());
+//
+// Results are not tracked by autograd.
+namespace mt::expr {
+
+    // Elements per block, the intermediates of a block stay in L1.
+    constexpr size_t BLOCK { 256 };
+
+    // One block of a sub-expression: len values at data[i * step], step is 1,
+    // or 0 for a value that is the same across the block.
+    struct Span {
+        const float* data;
+        size_t step;
+    };
+
+    template <typename E>
+    struct Node;
+
+    template <typename E>
+    concept Expression = std::derived_from<E, Node<E>>;
+
+    // A tensor operand. Holds a copy of the storage, which shares the buffer,
+    // so an expression may outlive the tensors it was built from.
+    struct Leaf;
+
+    struct Scalar;
+
+    template <typename Op, Expression A>
+    struct Unary;
+
+    template <typename Op, Expression L, Expression R>
+    struct Binary;
+
+    // Evaluates a tree block by block, handed to s_apply_op in place of a
+    // scalar functor. ptrs[0] and steps[0] are the output, the leaves follow
+    // in left-to-right order.
+    template <Expression E>
+    struct Fused {
+        E root;
+
+        template <size_t N>
+        void run(
+                const std::array<float*, N>& ptrs,
+                const std::array<size_t, N>& steps,
+                const size_t len
+        ) const {
+            static_assert(N == E::leaves + 1, "one pointer per leaf and one for the output");
+            alignas(64) float buffer[BLOCK];
+            std::array<const float*, N - 1> block_ptrs;
+
+            for (size_t first { 0 }; first < len; first += BLOCK) {
+                const size_t n { std::min(BLOCK, len - first) };
+                for (size_t k { 0 }; k + 1 < N; ++k) block_ptrs[k] = ptrs[k + 1] + first * steps[k + 1];
+
+                float* out { ptrs[0] + first * steps[0] };
+                float* dst { steps[0] == 1 ? out : buffer };
+                const Span result { root.template eval<0>(block_ptrs, steps.data() + 1, n, dst) };
+
+                if (result.data != out || result.step != 1 || steps[0] != 1) {
+                    for (size_t i { 0 }; i < n; ++i) out[i * steps[0]] = result.data[i * result.step];
+                }
+            }
+        }
+    };
+
+    template <typename E>
+    struct Node {
+        TensorStorage storage() const {
+            return TensorStorage::s_eval(Fused<E>{ derived() }, derived().leaf_storages());
+        }
+
+        operator TensorStorage() const {
+            return storage();
+        }
+
+        operator Tensor() const {
+            mt::jit::record_untraceable("a lazy expression");
+            return Tensor(std::make_shared<TensorNode>(storage(), false));
+        }
+
+    private:
+        const E& derived() const {
+            return static_cast<const E&>(*this);
+        }
+    };
+
+    struct Leaf : Node<Leaf> {
+        static constexpr size_t leaves { 1 };
+
+        TensorStorage m_storage;
+
+        explicit Leaf(
+                const TensorStorage& storage
+        ):
+            m_storage{ storage } {}
+
+        std::tuple<const TensorStorage*> leaf_storages() const {
+            return { &m_storage };
+        }
+
+        // Dense and broadcast runs are read in place, other strides are
+        // gathered into dst.
+        template <size_t I, size_t M>
+        Span eval(
+                const std::array<const float*, M>& ptrs,
+                const size_t* steps,
+                const size_t len,
+                float* dst
+        ) const {
+            if (steps[I] <= 1) return { ptrs[I], steps[I] };
+            for (size_t i { 0 }; i < len; ++i) dst[i] = ptrs[I][i * steps[I]];
+            return { dst, 1 };
+        }
+    };
+
+    struct Scalar : Node<Scalar> {
+        static constexpr size_t leaves { 0 };
+
+        float m_value;
+
+        explicit Scalar(
+                const float value
+        ):
+            m_value{ value } {}
+
+        std::tuple<> leaf_storages() const {
+            return {};
+        }
+
+        template <size_t I, size_t M>
+        Span eval(
+                const std::array<const float*, M>&,
+                const size_t*,
+                const size_t,
+                float*
+        ) const {
+            return { &m_value, 0 };
+        }
+    };
+
+    template <typename Op, Expression A>
+    struct Unary : Node<Unary<Op, A>> {
+        static constexpr size_t leaves { A::leaves };
+
+        A m_arg;
+
+        explicit Unary(
+                const A& arg
+        ):
+            m_arg{ arg } {}
+
+        auto leaf_storages() const {
+            return m_arg.leaf_storages();
+        }
+
+        template <size_t I, size_t M>
+        Span eval(
+                const std::array<const float*, M>& ptrs,
+                const size_t* steps,
+                const size_t len,
+                float* dst
+        ) const {
+            alignas(64) float buffer[BLOCK];
+            const Span arg { m_arg.template eval<I>(ptrs, steps, len, buffer) };
+            if (arg.step == 0) {
+                dst[0] = Op{}(arg.data[0]);
+                return { dst, 0 };
+            }
+            (mt::kernels::elementwise_kernels().*Op::vec)(arg.data, dst, len);
+            return { dst, 1 };
+        }
+    };
+
+    template <typename Op, Expression L, Expression R>
+    struct Binary : Node<Binary<Op, L, R>> {
+        static constexpr size_t leaves { L::leaves + R::leaves };
+
+        L m_lhs;
+        R m_rhs;
+
+        Binary(
+                const L& lhs,
+                const R& rhs
+        ):
+            m_lhs{ lhs },
+            m_rhs{ rhs } {}
+
+        auto leaf_storages() const {
+            return std::tuple_cat(m_lhs.leaf_storages(), m_rhs.leaf_storages());
+        }
+
+        template <size_t I, size_t M>
+        Span eval(
+                const std::array<const float*, M>& ptrs,
+                const size_t* steps,
+                const size_t len,
+                float* dst
+        ) const {
+            alignas(64) float lhs_buffer[BLOCK];
+            alignas(64) float rhs_buffer[BLOCK];
+            const Span lhs { m_lhs.template eval<I>(ptrs, steps, len, lhs_buffer) };
+            const Span rhs { m_rhs.template eval<I + L::leaves>(ptrs, steps, len, rhs_buffer) };
+            if (lhs.step == 0 && rhs.step == 0) {
+                dst[0] = Op{}(lhs.data[0], rhs.data[0]);
+                return { dst, 0 };
+            }
+            (mt::kernels::elementwise_kernels().*Op::vec)(lhs.data, lhs.step, rhs.data, rhs.step, dst, len);
+            return { dst, 1 };
+        }
+    };
+
+    inline Leaf lazy(
+            const TensorStorage& storage
+    ) {
+        return Leaf(storage);
+    }
+
+    inline Leaf lazy(
+            const Tensor& tensor
+    ) {
+        return Leaf(tensor.m_node->m_storage);
+    }
+
+    // Operands that mix with expressions: tensors become leaves, floats
+    // become scalars.
+    template <typename T>
+    concept Operand = Expression<T> || std::same_as<T, Tensor> || std::same_as<T, TensorStorage> || std::convertible_to<T, float>;
+
+    template <Operand T>
+    auto as_expr(
+            const T& x
+    ) {
+        if constexpr (Expression<T>) {
+            return x;
+        } else if constexpr (std::same_as<T, Tensor> || std::same_as<T, TensorStorage>) {
+            return lazy(x);
+        } else {
+            return Scalar(static_cast<float>(x));
+        }
+    }
+
+    template <typename Op, Operand A, Operand B>
+    auto make_binary(
+            const A& a,
+            const B& b
+    ) {
+        using L = decltype(as_expr(a));
+        using R = decltype(as_expr(b));
+        return Binary<Op, L, R>(as_expr(a), as_expr(b));
+    }
+
+    // at least one side must already be an expression, plain tensor
+    // arithmetic stays eager
+    template <typename A, typename B>
+    concept MixedOperands = Operand<A> && Operand<B> && (Expression<A> || Expression<B>);
+
+    template <typename A, typename B> requires MixedOperands<A, B>
+    auto operator+(const A& a, const B& b) { return make_binary<mt::kernels::ops::Add>(a, b); }
+
+    template <typename A, typename B> requires MixedOperands<A, B>
+    auto operator-(const A& a, const B& b) { return make_binary<mt::kernels::ops::Sub>(a, b); }
+
+    template <typename A, typename B> requires MixedOperands<A, B>
+    auto operator*(const A& a, const B& b) { return make_binary<mt::kernels::ops::Mult>(a, b); }
+
+    template <typename A, typename B> requires MixedOperands<A, B>
+    auto operator/(const A& a, const B& b) { return make_binary<mt::kernels::ops::Div>(a, b); }
+
+    template <typename A, typename B> requires MixedOperands<A, B>
+    auto pow(const A& base, const B& exponent) { return make_binary<mt::kernels::ops::Pow>(base, exponent); }
+
+    template <typename A, typename B> requires MixedOperands<A, B>
+    auto maximum(const A& a, const B& b) { return make_binary<mt::kernels::ops::Maximum>(a, b); }
+
+    // comparisons give 1.0f where they hold and 0.0f elsewhere
+    template <typename A, typename B> requires MixedOperands<A, B>
+    auto gt(const A& a, const B& b) { return make_binary<mt::kernels::ops::Gt>(a, b); }
+
+    template <typename A, typename B> requires MixedOperands<A, B>
+    auto lte(const A& a, const B& b) { return make_binary<mt::kernels::ops::Lte>(a, b); }
+
+    template <Expression A>
+    auto operator-(const A& a) { return Unary<mt::kernels::ops::Minus, A>(a); }
+
+    template <Expression A>
+    auto log(const A& a) { return Unary<mt::kernels::ops::Log, A>(a); }
+
+    template <Expression A>
+    auto exp(const A& a) { return Unary<mt::kernels::ops::Exp, A>(a); }
+
+    // Evaluates e straight into the storage of dst, which e must broadcast
+    // to. e may read dst itself, element-wise reads come before the write.
+    template <Expression E>
+    void assign(
+            Tensor& dst,
+            const E& e
+    ) {
+        mt::jit::record_untraceable("mt::expr::assign");
+        TensorStorage::s_eval_inplace(dst.m_node->m_storage, Fused<E>{ e }, e.leaf_storages());
+    }
+}
+
+#endif
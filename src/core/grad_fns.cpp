@@ -2,14 +2,84 @@
 #include <format>
 #include <math.h>
 #include <memory>
+#include <algorithm>
+#include <span>
 
 #include "grad_fns.h"
 #include "formatting.h"
 #include "tensor_nodes.h"
 #include "tensors.h"
+#include "expressions.h"
+#include "grad_mode.h"
+
+namespace {
+    // Whether backward was asked to create a graph: it runs grad fns with
+    // grad mode set to create_graph. Grad fns that compute their gradients
+    // with fused expressions or storage kernels, which are not tracked, switch
+    // to tracked tensor ops then, so that higher-order derivatives work.
+    bool create_graph() {
+        return mt::is_grad_enabled();
+    }
+
+    // Wraps a gradient computed at the storage level, it is not tracked.
+    Tensor untracked(
+            TensorStorage&& storage
+    ) {
+        return Tensor(std::make_shared<TensorNode>(std::move(storage), false));
+    }
+
+    // The gradient of out, for the storage paths: they pass it on, or
+    // compute on it, without a Tensor per edge.
+    const TensorStorage& grad_of(
+            const Tensor& out
+    ) {
+        return out.m_node->m_grad->m_node->m_storage;
+    }
+
+    // dx = g·wᵀ, dw = xᵀ·g and dbias = sum of g over the batch, with g the
+    // gradient at the pre-activation. operands are x, w and the optional
+    // bias, the ones whose needs_grad flag is unset are skipped.
+    void linear_grads(
+            const std::span<Tensor> operands,
+            const std::span<const bool> needs_grad,
+            const mt::kernels::Activation activation,
+            const Tensor& out
+    ) {
+        Tensor& x { operands[0] };
+        Tensor& w { operands[1] };
+
+        if (create_graph()) {
+            Tensor g = out.grad();
+            if (activation == mt::kernels::Activation::ReLU) g = (out > 0.0f) * g;
+            if (needs_grad[0]) x.accumulate_grad(Tensor::matmul(g, w.transpose(0, 1)));
+            if (needs_grad[1]) w.accumulate_grad(Tensor::matmul(x.transpose(0, 1), g));
+            if (operands.size() == 3 && needs_grad[2]) operands[2].accumulate_grad(g.sum(0));
+            return;
+        }
+
+        const TensorStorage g { activation == mt::kernels::Activation::ReLU
+            ? TensorStorage(mt::expr::gt(mt::expr::lazy(out), 0.0f) * grad_of(out))
+            : grad_of(out) };
+        const TensorStorage& xs { x.m_node->m_storage };
+        const TensorStorage& ws { w.m_node->m_storage };
+
+        if (needs_grad[0]) x.accumulate_grad(TensorStorage::s_matmul(g, TensorStorage::s_transpose(ws, 0, 1)));
+        if (needs_grad[1]) w.accumulate_grad(TensorStorage::s_matmul(TensorStorage::s_transpose(xs, 0, 1), g));
+        if (operands.size() == 3 && needs_grad[2]) operands[2].accumulate_grad(TensorStorage::s_sum(g, 0));
+    }
+}
 
 GradFn::GradFn() {}
 
+std::vector<Tensor> GradFn::get_operands() const {
+    const std::span<const Tensor> ops { operands() };
+    return std::vector<Tensor>(ops.begin(), ops.end());
+}
+
+bool GradFn::reads_output() const {
+    return true;
+}
+
 std::ostream& operator<<(std::ostream& os, const GradFn& op) {
     return op.print(os);
 }
@@ -21,8 +91,17 @@ std::ostream& BackwardAdd::print(std::ostream& os) const {
 void BackwardAdd::compute_operands_grad(
         const Tensor& out
 ) {
-    m_operands[0].accumulate_grad(out.grad());
-    m_operands[1].accumulate_grad(out.grad());
+    if (create_graph()) {
+        if (m_needs_grad[0]) m_operands[0].accumulate_grad(out.grad());
+        if (m_needs_grad[1]) m_operands[1].accumulate_grad(out.grad());
+        return;
+    }
+    if (m_needs_grad[0]) m_operands[0].accumulate_grad(TensorStorage(grad_of(out)));
+    if (m_needs_grad[1]) m_operands[1].accumulate_grad(TensorStorage(grad_of(out)));
+}
+
+bool BackwardAdd::reads_output() const {
+    return false;
 }
 
 std::ostream& BackwardMinus::print(std::ostream& os) const {
@@ -32,7 +111,15 @@ std::ostream& BackwardMinus::print(std::ostream& os) const {
 void BackwardMinus::compute_operands_grad(
         const Tensor& out
 ) {
-    m_operands[0].accumulate_grad(-out.grad());
+    if (create_graph()) {
+        m_operands[0].accumulate_grad(-out.grad());
+        return;
+    }
+    m_operands[0].accumulate_grad(TensorStorage::s_minus(grad_of(out)));
+}
+
+bool BackwardMinus::reads_output() const {
+    return false;
 }
 
 std::ostream& BackwardSub::print(std::ostream& os) const {
@@ -42,8 +129,17 @@ std::ostream& BackwardSub::print(std::ostream& os) const {
 void BackwardSub::compute_operands_grad(
         const Tensor& out
 ) {
-    m_operands[0].accumulate_grad(out.grad());
-    m_operands[1].accumulate_grad(-out.grad());
+    if (create_graph()) {
+        if (m_needs_grad[0]) m_operands[0].accumulate_grad(out.grad());
+        if (m_needs_grad[1]) m_operands[1].accumulate_grad(-out.grad());
+        return;
+    }
+    if (m_needs_grad[0]) m_operands[0].accumulate_grad(TensorStorage(grad_of(out)));
+    if (m_needs_grad[1]) m_operands[1].accumulate_grad(TensorStorage::s_minus(grad_of(out)));
+}
+
+bool BackwardSub::reads_output() const {
+    return false;
 }
 
 std::ostream& BackwardMult::print(std::ostream& os) const {
@@ -55,8 +151,17 @@ void BackwardMult::compute_operands_grad(
 ) {
     Tensor& a = m_operands[0];
     Tensor& b = m_operands[1];
-    a.accumulate_grad(b * out.grad());
-    b.accumulate_grad(a * out.grad());
+    if (create_graph()) {
+        if (m_needs_grad[0]) a.accumulate_grad(b * out.grad());
+        if (m_needs_grad[1]) b.accumulate_grad(a * out.grad());
+        return;
+    }
+    if (m_needs_grad[0]) a.accumulate_grad(TensorStorage::s_mult(b.m_node->m_storage, grad_of(out)));
+    if (m_needs_grad[1]) b.accumulate_grad(TensorStorage::s_mult(a.m_node->m_storage, grad_of(out)));
+}
+
+bool BackwardMult::reads_output() const {
+    return false;
 }
 
 std::ostream& BackwardDiv::print(std::ostream& os) const {
@@ -68,8 +173,17 @@ void BackwardDiv::compute_operands_grad(
 ) {
     Tensor& a = m_operands[0];
     Tensor& b = m_operands[1];
-    a.accumulate_grad(out.grad() / b);
-    b.accumulate_grad(-a / (b * b) * out.grad());
+    if (create_graph()) {
+        if (m_needs_grad[0]) a.accumulate_grad(out.grad() / b);
+        if (m_needs_grad[1]) b.accumulate_grad(-a / (b * b) * out.grad());
+        return;
+    }
+    if (m_needs_grad[0]) a.accumulate_grad(TensorStorage::s_div(grad_of(out), b.m_node->m_storage));
+    if (m_needs_grad[1]) b.accumulate_grad((-mt::expr::lazy(a) / (mt::expr::lazy(b) * b) * grad_of(out)).storage());
+}
+
+bool BackwardDiv::reads_output() const {
+    return false;
 }
 
 std::ostream& BackwardPow::print(std::ostream& os) const {
@@ -79,15 +193,16 @@ std::ostream& BackwardPow::print(std::ostream& os) const {
 void BackwardPow::compute_operands_grad(
         const Tensor& out
 ) {
+    // d(b^e)/db = e * b^(e-1), d(b^e)/de = b^e * ln(b), b^e being the output
     Tensor& base = m_operands[0];
     Tensor& exp = m_operands[1];
-    Tensor ones(exp.shape());
-    ones.fill_inplace(1.0f);
-    
-    base.accumulate_grad((exp * base.pow(exp - ones)) * out.grad());
-    
-    Tensor log_base(base.log());
-    exp.accumulate_grad((base.pow(exp) * log_base) * out.grad());
+    if (create_graph()) {
+        if (m_needs_grad[0]) base.accumulate_grad(exp * base.pow(exp - 1.0f) * out.grad());
+        if (m_needs_grad[1]) exp.accumulate_grad(out * base.log() * out.grad());
+        return;
+    }
+    if (m_needs_grad[0]) base.accumulate_grad((mt::expr::lazy(exp) * mt::expr::pow(mt::expr::lazy(base), mt::expr::lazy(exp) - 1.0f) * grad_of(out)).storage());
+    if (m_needs_grad[1]) exp.accumulate_grad((mt::expr::lazy(out) * mt::expr::log(mt::expr::lazy(base)) * grad_of(out)).storage());
 }
 
 std::ostream& BackwardLog::print(std::ostream& os) const {
@@ -98,7 +213,30 @@ void BackwardLog::compute_operands_grad(
         const Tensor& out
 ) {
     Tensor& x = m_operands[0];
-    x.accumulate_grad(out.grad() / x);
+    if (create_graph()) {
+        x.accumulate_grad(out.grad() / x);
+        return;
+    }
+    x.accumulate_grad(TensorStorage::s_div(grad_of(out), x.m_node->m_storage));
+}
+
+bool BackwardLog::reads_output() const {
+    return false;
+}
+
+std::ostream& BackwardExp::print(std::ostream& os) const {
+    return os << "BackwardExp";
+}
+
+void BackwardExp::compute_operands_grad(
+        const Tensor& out
+) {
+    Tensor& x = m_operands[0];
+    if (create_graph()) {
+        x.accumulate_grad(out * out.grad());
+        return;
+    }
+    x.accumulate_grad(TensorStorage::s_mult(out.m_node->m_storage, grad_of(out)));
 }
 
 std::ostream& BackwardMaximum::print(std::ostream& os) const {
@@ -110,20 +248,252 @@ void BackwardMaximum::compute_operands_grad(
 ) {
     Tensor& a = m_operands[0];
     Tensor& b = m_operands[1];
-    Tensor a_mask = a > b;
-    Tensor b_mask = a <= b;
-    a.accumulate_grad(a_mask * out.grad());
-    b.accumulate_grad(b_mask * out.grad());
+    if (create_graph()) {
+        // the masks are constants
+        if (m_needs_grad[0]) a.accumulate_grad((a > b) * out.grad());
+        if (m_needs_grad[1]) b.accumulate_grad((a <= b) * out.grad());
+        return;
+    }
+    if (m_needs_grad[0]) a.accumulate_grad((mt::expr::gt(mt::expr::lazy(a), b) * grad_of(out)).storage());
+    if (m_needs_grad[1]) b.accumulate_grad((mt::expr::lte(mt::expr::lazy(a), b) * grad_of(out)).storage());
+}
+
+bool BackwardMaximum::reads_output() const {
+    return false;
+}
+
+std::ostream& BackwardMatmul::print(std::ostream& os) const {
+    return os << "BackwardMatmul";
+}
+
+void BackwardMatmul::compute_operands_grad(
+        const Tensor& out
+) {
+    // C = A·B  =>  dA = G·Bᵀ, dB = Aᵀ·G (transposes are strided views)
+    Tensor& a = m_operands[0];
+    Tensor& b = m_operands[1];
+    if (create_graph()) {
+        if (m_needs_grad[0]) a.accumulate_grad(Tensor::matmul(out.grad(), b.transpose(0, 1)));
+        if (m_needs_grad[1]) b.accumulate_grad(Tensor::matmul(a.transpose(0, 1), out.grad()));
+        return;
+    }
+    const TensorStorage& g { grad_of(out) };
+    if (m_needs_grad[0]) a.accumulate_grad(TensorStorage::s_matmul(g, TensorStorage::s_transpose(b.m_node->m_storage, 0, 1)));
+    if (m_needs_grad[1]) b.accumulate_grad(TensorStorage::s_matmul(TensorStorage::s_transpose(a.m_node->m_storage, 0, 1), g));
+}
+
+bool BackwardMatmul::reads_output() const {
+    return false;
+}
+
+BackwardLinear::BackwardLinear(
+        const Tensor x,
+        const Tensor w,
+        const Tensor bias,
+        const mt::kernels::Activation activation
+):
+    NBackwardOp(x, w, bias),
+    m_activation {activation} {}
+
+std::ostream& BackwardLinear::print(std::ostream& os) const {
+    return os << "BackwardLinear";
+}
+
+void BackwardLinear::compute_operands_grad(
+        const Tensor& out
+) {
+    linear_grads(m_operands, m_needs_grad, m_activation, out);
+}
+
+bool BackwardLinear::reads_output() const {
+    return m_activation == mt::kernels::Activation::ReLU;
+}
+
+BackwardLinearNoBias::BackwardLinearNoBias(
+        const Tensor x,
+        const Tensor w,
+        const mt::kernels::Activation activation
+):
+    NBackwardOp(x, w),
+    m_activation {activation} {}
+
+std::ostream& BackwardLinearNoBias::print(std::ostream& os) const {
+    return os << "BackwardLinearNoBias";
+}
+
+void BackwardLinearNoBias::compute_operands_grad(
+        const Tensor& out
+) {
+    linear_grads(m_operands, m_needs_grad, m_activation, out);
+}
+
+bool BackwardLinearNoBias::reads_output() const {
+    return m_activation == mt::kernels::Activation::ReLU;
+}
+
+BackwardScalarOp::BackwardScalarOp(
+        const Tensor operand,
+        const float scalar
+):
+    NBackwardOp(operand),
+    m_scalar {scalar} {}
+
+std::ostream& BackwardAddScalar::print(std::ostream& os) const {
+    return os << "BackwardAddScalar";
+}
+
+void BackwardAddScalar::compute_operands_grad(
+        const Tensor& out
+) {
+    if (create_graph()) {
+        m_operands[0].accumulate_grad(out.grad());
+        return;
+    }
+    m_operands[0].accumulate_grad(TensorStorage(grad_of(out)));
+}
+
+bool BackwardAddScalar::reads_output() const {
+    return false;
+}
+
+std::ostream& BackwardRsubScalar::print(std::ostream& os) const {
+    return os << "BackwardRsubScalar";
+}
+
+void BackwardRsubScalar::compute_operands_grad(
+        const Tensor& out
+) {
+    if (create_graph()) {
+        m_operands[0].accumulate_grad(-out.grad());
+        return;
+    }
+    m_operands[0].accumulate_grad(TensorStorage::s_minus(grad_of(out)));
+}
+
+bool BackwardRsubScalar::reads_output() const {
+    return false;
+}
+
+std::ostream& BackwardMultScalar::print(std::ostream& os) const {
+    return os << "BackwardMultScalar";
+}
+
+void BackwardMultScalar::compute_operands_grad(
+        const Tensor& out
+) {
+    if (create_graph()) {
+        m_operands[0].accumulate_grad(out.grad() * m_scalar);
+        return;
+    }
+    m_operands[0].accumulate_grad(TensorStorage::s_mult_scalar(grad_of(out), m_scalar));
+}
+
+bool BackwardMultScalar::reads_output() const {
+    return false;
+}
+
+std::ostream& BackwardDivScalar::print(std::ostream& os) const {
+    return os << "BackwardDivScalar";
+}
+
+void BackwardDivScalar::compute_operands_grad(
+        const Tensor& out
+) {
+    if (create_graph()) {
+        m_operands[0].accumulate_grad(out.grad() / m_scalar);
+        return;
+    }
+    m_operands[0].accumulate_grad(TensorStorage::s_div_scalar(grad_of(out), m_scalar));
+}
+
+bool BackwardDivScalar::reads_output() const {
+    return false;
+}
+
+std::ostream& BackwardRdivScalar::print(std::ostream& os) const {
+    return os << "BackwardRdivScalar";
+}
+
+void BackwardRdivScalar::compute_operands_grad(
+        const Tensor& out
+) {
+    // d(c/x)/dx = -c / x^2
+    Tensor& x = m_operands[0];
+    if (create_graph()) {
+        x.accumulate_grad(out.grad() * (-m_scalar) / (x * x));
+        return;
+    }
+    x.accumulate_grad((mt::expr::lazy(grad_of(out)) * (-m_scalar) / (mt::expr::lazy(x) * x)).storage());
+}
+
+bool BackwardRdivScalar::reads_output() const {
+    return false;
+}
+
+std::ostream& BackwardPowScalar::print(std::ostream& os) const {
+    return os << "BackwardPowScalar";
+}
+
+void BackwardPowScalar::compute_operands_grad(
+        const Tensor& out
+) {
+    // d(x^c)/dx = c * x^(c-1)
+    Tensor& x = m_operands[0];
+    if (create_graph()) {
+        x.accumulate_grad(x.pow(m_scalar - 1.0f) * m_scalar * out.grad());
+        return;
+    }
+    x.accumulate_grad((mt::expr::pow(mt::expr::lazy(x), m_scalar - 1.0f) * m_scalar * grad_of(out)).storage());
+}
+
+bool BackwardPowScalar::reads_output() const {
+    return false;
+}
+
+std::ostream& BackwardRpowScalar::print(std::ostream& os) const {
+    return os << "BackwardRpowScalar";
+}
+
+void BackwardRpowScalar::compute_operands_grad(
+        const Tensor& out
+) {
+    // d(c^x)/dx = c^x * ln(c), and c^x is the output itself
+    Tensor& x = m_operands[0];
+    if (create_graph()) {
+        x.accumulate_grad(out * std::log(m_scalar) * out.grad());
+        return;
+    }
+    x.accumulate_grad((mt::expr::lazy(out) * std::log(m_scalar) * grad_of(out)).storage());
+}
+
+std::ostream& BackwardMaximumScalar::print(std::ostream& os) const {
+    return os << "BackwardMaximumScalar";
+}
+
+void BackwardMaximumScalar::compute_operands_grad(
+        const Tensor& out
+) {
+    // same tie rule as BackwardMaximum: the gradient goes to c when x == c
+    Tensor& x = m_operands[0];
+    if (create_graph()) {
+        x.accumulate_grad((x > m_scalar) * out.grad());
+        return;
+    }
+    x.accumulate_grad((mt::expr::gt(mt::expr::lazy(x), m_scalar) * grad_of(out)).storage());
+}
+
+bool BackwardMaximumScalar::reads_output() const {
+    return false;
 }
 
 BackwardSum::BackwardSum(
         const Tensor reduced_tensor,
-        const size_t dim,
-        const size_t original_times
+        const std::vector<size_t>& dims,
+        const bool keepdim
 ):
     BackwardReduce(reduced_tensor),
-    m_dim {dim},
-    m_original_times {original_times} {}
+    m_dims {[dims]() { std::vector<size_t> d = dims; std::sort(d.begin(), d.end()); return d; }()},
+    m_keepdim {keepdim} {}
 
 std::ostream& BackwardSum::print(std::ostream& os) const {
     return os << "BackwardSum";
@@ -133,7 +503,27 @@ void BackwardSum::compute_operands_grad(
         const Tensor& out
 ) {
     Tensor& x = m_operands[0];
-    x.accumulate_grad(out.grad().unsqueeze(m_dim).expand(m_dim, m_original_times));
+    // restore the reduced singletons (ascending, so indices stay valid), then
+    // broadcast each of them back to its original size
+    if (create_graph()) {
+        Tensor grad = out.grad();
+        if (!m_keepdim) {
+            for (const size_t dim : m_dims) grad = grad.unsqueeze(dim);
+        }
+        for (const size_t dim : m_dims) grad = grad.expand(dim, x.shape()[dim]);
+        x.accumulate_grad(grad);
+        return;
+    }
+    TensorStorage grad { grad_of(out) };
+    if (!m_keepdim) {
+        for (const size_t dim : m_dims) grad = TensorStorage::s_unsqueeze(grad, dim);
+    }
+    for (const size_t dim : m_dims) grad = TensorStorage::s_expand(grad, dim, x.shape()[dim]);
+    x.accumulate_grad(std::move(grad));
+}
+
+bool BackwardSum::reads_output() const {
+    return false;
 }
 
 BackwardUnsqueeze::BackwardUnsqueeze(
@@ -151,7 +541,15 @@ void BackwardUnsqueeze::compute_operands_grad(
         const Tensor& out
 ) {
     Tensor& x = m_operands[0];
-    x.accumulate_grad(out.grad().squeeze(m_dim));
+    if (create_graph()) {
+        x.accumulate_grad(out.grad().squeeze(m_dim));
+        return;
+    }
+    x.accumulate_grad(TensorStorage::s_squeeze(grad_of(out), m_dim));
+}
+
+bool BackwardUnsqueeze::reads_output() const {
+    return false;
 }
 
 BackwardSqueeze::BackwardSqueeze(
@@ -169,7 +567,15 @@ void BackwardSqueeze::compute_operands_grad(
         const Tensor& out
 ) {
     Tensor& x = m_operands[0];
-    x.accumulate_grad(out.grad().unsqueeze(m_dim));
+    if (create_graph()) {
+        x.accumulate_grad(out.grad().unsqueeze(m_dim));
+        return;
+    }
+    x.accumulate_grad(TensorStorage::s_unsqueeze(grad_of(out), m_dim));
+}
+
+bool BackwardSqueeze::reads_output() const {
+    return false;
 }
 
 BackwardRepeat::BackwardRepeat(
@@ -187,7 +593,43 @@ void BackwardRepeat::compute_operands_grad(
         const Tensor& out
 ) {
     Tensor& x = m_operands[0];
-    x.accumulate_grad(out.grad().sum(m_dim).unsqueeze(m_dim));
+    if (create_graph()) {
+        x.accumulate_grad(out.grad().sum(m_dim, true));
+        return;
+    }
+    x.accumulate_grad(TensorStorage::s_sum(grad_of(out), m_dim, true));
+}
+
+bool BackwardRepeat::reads_output() const {
+    return false;
+}
+
+BackwardTranspose::BackwardTranspose(
+        const Tensor viewed_tensor,
+        const size_t dim0,
+        const size_t dim1
+):
+    BackwardView(viewed_tensor),
+    m_dim0 {dim0},
+    m_dim1 {dim1} {}
+
+std::ostream& BackwardTranspose::print(std::ostream& os) const {
+    return os << "BackwardTranspose";
+}
+
+void BackwardTranspose::compute_operands_grad(
+        const Tensor& out
+) {
+    Tensor& x = m_operands[0];
+    if (create_graph()) {
+        x.accumulate_grad(out.grad().transpose(m_dim0, m_dim1));
+        return;
+    }
+    x.accumulate_grad(TensorStorage::s_transpose(grad_of(out), m_dim0, m_dim1));
+}
+
+bool BackwardTranspose::reads_output() const {
+    return false;
 }
 
 BackwardClone::BackwardClone(
@@ -203,13 +645,29 @@ void BackwardClone::compute_operands_grad(
         const Tensor& out
 ) {
     Tensor& x = m_operands[0];
-    x.accumulate_grad(out.grad());
+    if (create_graph()) {
+        x.accumulate_grad(out.grad());
+        return;
+    }
+    x.accumulate_grad(TensorStorage(grad_of(out)));
+}
+
+bool BackwardClone::reads_output() const {
+    return false;
 }
 
 BackwardReLU::BackwardReLU(
-        const Tensor in_tensor
+        const Tensor in_tensor,
+        std::vector<uint64_t>&& mask
 ):
-    BackwardAct(in_tensor) {}
+    BackwardAct(in_tensor),
+    m_mask {std::move(mask)} {
+    m_operands[0].m_node->m_edge_refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+BackwardReLU::~BackwardReLU() {
+    m_operands[0].m_node->m_edge_refs.fetch_sub(1, std::memory_order_relaxed);
+}
 
 std::ostream& BackwardReLU::print(std::ostream& os) const {
     return os << "BackwardReLU";
@@ -219,11 +677,132 @@ void BackwardReLU::compute_operands_grad(
         const Tensor& out
 ) {
     Tensor& x = m_operands[0];
-    Tensor pos_mask(out.shape(), 0.0f);
-    for (size_t i {0}; i < out.m_node->m_storage.m_numel; ++i) {
-        if (out.m_node->m_storage.get_entry_ref(i) > 0.0f) {
-            pos_mask.m_node->m_storage.get_entry_ref(i) = 1.0f;
-        }
+    if (create_graph()) {
+        // the 0/1 factor is rebuilt from the mask, neither x nor out is read.
+        // A trace records it as out > 0, the same mask, so that a replay
+        // computes it from the batch it runs on rather than keeping this one
+        const Tensor factor { untracked(TensorStorage::s_relu_backward(TensorStorage(out.shape(), 1.0f), m_mask)) };
+        if (mt::jit::is_tracing()) Tensor::record_kernel(TensorStorage::s_gt_scalar, out, 0.0f, factor);
+        x.accumulate_grad(factor * out.grad());
+        return;
+    }
+    x.accumulate_grad(TensorStorage::s_relu_backward(grad_of(out), m_mask));
+}
+
+bool BackwardReLU::reads_output() const {
+    return false;
+}
+
+BackwardSoftmax::BackwardSoftmax(
+        const Tensor in_tensor,
+        const size_t dim
+):
+    BackwardAct(in_tensor),
+    m_dim {dim} {}
+
+std::ostream& BackwardSoftmax::print(std::ostream& os) const {
+    return os << "BackwardSoftmax";
+}
+
+void BackwardSoftmax::compute_operands_grad(
+        const Tensor& out
+) {
+    Tensor& x = m_operands[0];
+    if (create_graph()) {
+        // (g - sum(g * y)) * y, y being the output
+        const Tensor g { out.grad() };
+        x.accumulate_grad((g - (g * out).sum(m_dim, true)) * out);
+        return;
+    }
+    TensorStorage grad = TensorStorage::s_softmax_backward(
+        out.m_node->m_storage,
+        grad_of(out),
+        m_dim
+    );
+    x.accumulate_grad(std::move(grad));
+}
+
+BackwardLogSoftmax::BackwardLogSoftmax(
+        const Tensor in_tensor,
+        const size_t dim
+):
+    BackwardAct(in_tensor),
+    m_dim {dim} {}
+
+std::ostream& BackwardLogSoftmax::print(std::ostream& os) const {
+    return os << "BackwardLogSoftmax";
+}
+
+void BackwardLogSoftmax::compute_operands_grad(
+        const Tensor& out
+) {
+    Tensor& x = m_operands[0];
+    if (create_graph()) {
+        // g - softmax * sum(g), softmax = exp(y)
+        const Tensor g { out.grad() };
+        x.accumulate_grad(g - out.exp() * g.sum(m_dim, true));
+        return;
     }
-    x.accumulate_grad(pos_mask*out.grad());
+    TensorStorage grad = TensorStorage::s_log_softmax_backward(
+        out.m_node->m_storage,
+        grad_of(out),
+        m_dim
+    );
+    x.accumulate_grad(std::move(grad));
+}
+
+std::ostream& BackwardCrossEntropy::print(std::ostream& os) const {
+    return os << "BackwardCrossEntropy";
+}
+
+void BackwardCrossEntropy::compute_operands_grad(
+        const Tensor& out
+) {
+    Tensor& x = m_operands[0];
+    const Tensor& classes = m_operands[1];
+    if (!m_needs_grad[0]) return;
+    if (create_graph()) {
+        // (softmax(x) - onehot) * g over the class dimension
+        const size_t class_dim { x.shape().size() - 1 };
+        const Tensor g { out.grad() };
+        const Tensor onehot { classes.one_hot(x.shape()[class_dim]) };
+        x.accumulate_grad((x.softmax(class_dim) - onehot) * g.unsqueeze(g.shape().size()));
+        return;
+    }
+    TensorStorage grad = TensorStorage::s_cross_entropy_backward(
+        x.m_node->m_storage,
+        classes.m_node->m_storage,
+        grad_of(out)
+    );
+    x.accumulate_grad(std::move(grad));
+}
+
+bool BackwardCrossEntropy::reads_output() const {
+    return false;
+}
+
+std::ostream& BackwardBCEWithLogits::print(std::ostream& os) const {
+    return os << "BackwardBCEWithLogits";
+}
+
+void BackwardBCEWithLogits::compute_operands_grad(
+        const Tensor& out
+) {
+    // dl/dx = sigmoid(x) - y, dl/dy = -x
+    Tensor& x = m_operands[0];
+    Tensor& y = m_operands[1];
+    if (create_graph()) {
+        const Tensor grad { out.grad() };
+        if (m_needs_grad[0]) x.accumulate_grad((1.0f / ((-x).exp() + 1.0f) - y) * grad);
+        if (m_needs_grad[1]) y.accumulate_grad(-x * grad);
+        return;
+    }
+    const TensorStorage& grad { grad_of(out) };
+    const auto sigmoid { 1.0f / (mt::expr::exp(-mt::expr::lazy(x)) + 1.0f) };
+    if (m_needs_grad[0]) x.accumulate_grad(((sigmoid - y) * grad).storage());
+    if (m_needs_grad[1]) y.accumulate_grad((-mt::expr::lazy(x) * grad).storage());
+}
+
+bool BackwardBCEWithLogits::reads_output() const {
+    return false;
 }
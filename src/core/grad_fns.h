@@ -5,6 +5,8 @@
 #include <memory>
 #include <vector>
 #include <functional>
+#include <cstdint>
+#include <span>
 
 #include "tensor_nodes.h"
 #include "tensors.h"
@@ -24,7 +26,18 @@ public:
         const Tensor& out
     ) = 0;
 
-    virtual std::vector<Tensor> get_operands() const = 0;
+    // Non-owning view of the operands, for the engine to walk the graph
+    // without copying (and ref-counting) them.
+    virtual std::span<const Tensor> operands() const = 0;
+
+    std::vector<Tensor> get_operands() const;
+
+    // Whether compute_operands_grad reads the values of its output and not
+    // only its gradient. Such an output keeps its buffer even when only
+    // graph edges hold it (see TensorNode::m_edge_refs). True unless a grad
+    // fn opts out, which it may only do when no path of its backward, the
+    // create_graph one included, reads out.
+    virtual bool reads_output() const;
 };
 
 template <size_t N>
@@ -32,12 +45,17 @@ class NBackwardOp: public GradFn {
 public:
     static constexpr size_t s_N = N; // expose N as a static member
     std::array<Tensor, N> m_operands;
+    // Whether each operand required grad when the op was recorded. Grad fns
+    // skip the kernels of the operands that don't, e.g. the log term of pow
+    // for a constant exponent.
+    std::array<bool, N> m_needs_grad;
 
         // 1. Variadic Template Constructor
     template <typename... Tensors>
     explicit NBackwardOp(
             const Tensors... operands
-    ): m_operands{{operands...}} { // Optimization note: Move semantics (Tensors&&... and std::forward) could be used here for efficiency to avoid atomic ref-count increments on shared_ptr
+    ): m_operands{{operands...}},
+       m_needs_grad{} { // Optimization note: Move semantics (Tensors&&... and std::forward) could be used here for efficiency to avoid atomic ref-count increments on shared_ptr
         // 2. Compile-time Arity Check
         static_assert(sizeof...(Tensors) == N, 
             "Error: Number of arguments provided to constructor must match template parameter N.");
@@ -46,6 +64,10 @@ public:
         // This ensures every argument is actually a Tensor
         static_assert((std::is_convertible_v<Tensors, Tensor> && ...), 
             "Error: All arguments must be implicitly convertible to Tensor.");
+
+        for (size_t i {0}; i<N; i++) {
+            m_needs_grad[i] = m_operands[i].m_node->m_requires_grad;
+        }
     }
 
     void reset_all_grads() override {
@@ -55,13 +77,8 @@ public:
         }
     }
 
-    std::vector<Tensor> get_operands() const override {
-        std::vector<Tensor> ops;
-        ops.reserve(N);
-        for(const auto& op : m_operands) {
-            ops.push_back(op);
-        }
-        return ops;
+    std::span<const Tensor> operands() const override {
+        return m_operands;
     }
 };
 
@@ -74,6 +91,8 @@ public:
     void compute_operands_grad(
             const Tensor& out
     ) override;
+
+    bool reads_output() const override;
 };
 
 class BackwardMinus : public NBackwardOp<1> {
@@ -85,6 +104,8 @@ public:
     void compute_operands_grad(
             const Tensor& out
     ) override;
+
+    bool reads_output() const override;
 };
 
 class BackwardSub : public NBackwardOp<2> {
@@ -96,6 +117,8 @@ public:
     void compute_operands_grad(
             const Tensor& out
     ) override;
+
+    bool reads_output() const override;
 };
 
 class BackwardMult : public NBackwardOp<2> {
@@ -107,6 +130,8 @@ public:
     void compute_operands_grad(
             const Tensor& out
     ) override;
+
+    bool reads_output() const override;
 };
 
 class BackwardPow : public NBackwardOp<2> {
@@ -129,6 +154,8 @@ public:
     void compute_operands_grad(
             const Tensor& out
     ) override;
+
+    bool reads_output() const override;
 };
 
 class BackwardLog : public NBackwardOp<1> {
@@ -140,6 +167,19 @@ public:
     void compute_operands_grad(
             const Tensor& out
     ) override;
+
+    bool reads_output() const override;
+};
+
+class BackwardExp : public NBackwardOp<1> {
+public:
+    using NBackwardOp<s_N>::NBackwardOp;
+
+    std::ostream& print(std::ostream& os) const override;
+    
+    void compute_operands_grad(
+            const Tensor& out
+    ) override;
 };
 
 class BackwardMaximum : public NBackwardOp<2> {
@@ -151,6 +191,183 @@ public:
     void compute_operands_grad(
             const Tensor& out
     ) override;
+
+    bool reads_output() const override;
+};
+
+class BackwardMatmul : public NBackwardOp<2> {
+public:
+    using NBackwardOp<s_N>::NBackwardOp;
+
+    std::ostream& print(std::ostream& os) const override;
+    
+    void compute_operands_grad(
+            const Tensor& out
+    ) override;
+
+    bool reads_output() const override;
+};
+
+// activation(x·w + bias), see Tensor::linear. The output stands in for the
+// pre-activation: relu(z) > 0 exactly where z > 0.
+class BackwardLinear : public NBackwardOp<3> {
+public:
+    const mt::kernels::Activation m_activation;
+
+    BackwardLinear(
+            const Tensor x,
+            const Tensor w,
+            const Tensor bias,
+            const mt::kernels::Activation activation
+    );
+
+    std::ostream& print(std::ostream& os) const override;
+    
+    void compute_operands_grad(
+            const Tensor& out
+    ) override;
+
+    bool reads_output() const override;
+};
+
+class BackwardLinearNoBias : public NBackwardOp<2> {
+public:
+    const mt::kernels::Activation m_activation;
+
+    BackwardLinearNoBias(
+            const Tensor x,
+            const Tensor w,
+            const mt::kernels::Activation activation
+    );
+
+    std::ostream& print(std::ostream& os) const override;
+    
+    void compute_operands_grad(
+            const Tensor& out
+    ) override;
+
+    bool reads_output() const override;
+};
+
+// Grad fns of ops with a float operand, which is kept as a plain float.
+class BackwardScalarOp : public NBackwardOp<1> {
+public:
+    const float m_scalar;
+
+    BackwardScalarOp(
+            const Tensor operand,
+            const float scalar
+    );
+};
+
+// x + c and x - c
+class BackwardAddScalar : public BackwardScalarOp {
+public:
+    using BackwardScalarOp::BackwardScalarOp;
+
+    std::ostream& print(std::ostream& os) const override;
+    
+    void compute_operands_grad(
+            const Tensor& out
+    ) override;
+
+    bool reads_output() const override;
+};
+
+// c - x
+class BackwardRsubScalar : public BackwardScalarOp {
+public:
+    using BackwardScalarOp::BackwardScalarOp;
+
+    std::ostream& print(std::ostream& os) const override;
+    
+    void compute_operands_grad(
+            const Tensor& out
+    ) override;
+
+    bool reads_output() const override;
+};
+
+// x * c
+class BackwardMultScalar : public BackwardScalarOp {
+public:
+    using BackwardScalarOp::BackwardScalarOp;
+
+    std::ostream& print(std::ostream& os) const override;
+    
+    void compute_operands_grad(
+            const Tensor& out
+    ) override;
+
+    bool reads_output() const override;
+};
+
+// x / c
+class BackwardDivScalar : public BackwardScalarOp {
+public:
+    using BackwardScalarOp::BackwardScalarOp;
+
+    std::ostream& print(std::ostream& os) const override;
+    
+    void compute_operands_grad(
+            const Tensor& out
+    ) override;
+
+    bool reads_output() const override;
+};
+
+// c / x
+class BackwardRdivScalar : public BackwardScalarOp {
+public:
+    using BackwardScalarOp::BackwardScalarOp;
+
+    std::ostream& print(std::ostream& os) const override;
+    
+    void compute_operands_grad(
+            const Tensor& out
+    ) override;
+
+    bool reads_output() const override;
+};
+
+// x ^ c
+class BackwardPowScalar : public BackwardScalarOp {
+public:
+    using BackwardScalarOp::BackwardScalarOp;
+
+    std::ostream& print(std::ostream& os) const override;
+    
+    void compute_operands_grad(
+            const Tensor& out
+    ) override;
+
+    bool reads_output() const override;
+};
+
+// c ^ x
+class BackwardRpowScalar : public BackwardScalarOp {
+public:
+    using BackwardScalarOp::BackwardScalarOp;
+
+    std::ostream& print(std::ostream& os) const override;
+    
+    void compute_operands_grad(
+            const Tensor& out
+    ) override;
+};
+
+// max(x, c)
+class BackwardMaximumScalar : public BackwardScalarOp {
+public:
+    using BackwardScalarOp::BackwardScalarOp;
+
+    std::ostream& print(std::ostream& os) const override;
+    
+    void compute_operands_grad(
+            const Tensor& out
+    ) override;
+
+    bool reads_output() const override;
 };
 
 class BackwardReduce : public NBackwardOp<1> {
@@ -160,13 +377,13 @@ public:
 
 class BackwardSum : public BackwardReduce {
 public:
-    const size_t m_dim;
-    const size_t m_original_times;
+    const std::vector<size_t> m_dims;
+    const bool m_keepdim;
     
     BackwardSum(
             const Tensor reduced_tensor,
-            const size_t dim,
-            const size_t original_times
+            const std::vector<size_t>& dims,
+            const bool keepdim
     );
 
     std::ostream& print(std::ostream& os) const override;
@@ -174,6 +391,8 @@ public:
     void compute_operands_grad(
             const Tensor& out
     ) override;
+
+    bool reads_output() const override;
 };
 
 class BackwardView : public NBackwardOp<1> {
@@ -195,6 +414,8 @@ public:
     void compute_operands_grad(
             const Tensor& out
     ) override;
+
+    bool reads_output() const override;
 };
 
 class BackwardSqueeze : public BackwardView {
@@ -211,6 +432,8 @@ public:
     void compute_operands_grad(
             const Tensor& out
     ) override;
+
+    bool reads_output() const override;
 };
 
 class BackwardRepeat : public BackwardView {
@@ -227,6 +450,28 @@ public:
     void compute_operands_grad(
             const Tensor& out
     ) override;
+
+    bool reads_output() const override;
+};
+
+class BackwardTranspose : public BackwardView {
+public:
+    const size_t m_dim0;
+    const size_t m_dim1;
+    
+    BackwardTranspose(
+            const Tensor viewed_tensor,
+            const size_t dim0,
+            const size_t dim1
+    );
+
+    std::ostream& print(std::ostream& os) const override;
+    
+    void compute_operands_grad(
+            const Tensor& out
+    ) override;
+
+    bool reads_output() const override;
 };
 
 class BackwardClone : public BackwardView {
@@ -242,6 +487,8 @@ public:
     void compute_operands_grad(
             const Tensor& out
     ) override;
+
+    bool reads_output() const override;
 };
 
 class BackwardAct : public NBackwardOp<1> {
@@ -249,17 +496,91 @@ public:
     using NBackwardOp<s_N>::NBackwardOp;
 };
 
+// Reads only the packed x > 0 mask saved by the forward pass: the input is
+// held as a graph edge, whose buffer is not kept alive for this grad fn.
 class BackwardReLU : public BackwardAct {
-public:    
+public:
+    const std::vector<uint64_t> m_mask;
+
     BackwardReLU(
-            const Tensor in_tensor
+            const Tensor in_tensor,
+            std::vector<uint64_t>&& mask
     );
 
+    BackwardReLU(const BackwardReLU&) = delete;
+    BackwardReLU& operator=(const BackwardReLU&) = delete;
+
+    ~BackwardReLU() override;
+
     std::ostream& print(std::ostream& os) const override;
     
     void compute_operands_grad(
             const Tensor& out
     ) override;
+
+    bool reads_output() const override;
+};
+
+// Softmax along m_dim, differentiated through its output.
+class BackwardSoftmax : public BackwardAct {
+public:
+    const size_t m_dim;
+
+    BackwardSoftmax(
+            const Tensor in_tensor,
+            const size_t dim
+    );
+
+    std::ostream& print(std::ostream& os) const override;
+    
+    void compute_operands_grad(
+            const Tensor& out
+    ) override;
+};
+
+class BackwardLogSoftmax : public BackwardAct {
+public:
+    const size_t m_dim;
+
+    BackwardLogSoftmax(
+            const Tensor in_tensor,
+            const size_t dim
+    );
+
+    std::ostream& print(std::ostream& os) const override;
+    
+    void compute_operands_grad(
+            const Tensor& out
+    ) override;
+};
+
+// Cross-entropy of logits against class indices (see
+// TensorStorage::s_cross_entropy), the indices get no gradient.
+class BackwardCrossEntropy : public NBackwardOp<2> {
+public:
+    using NBackwardOp<s_N>::NBackwardOp;
+
+    std::ostream& print(std::ostream& os) const override;
+    
+    void compute_operands_grad(
+            const Tensor& out
+    ) override;
+
+    bool reads_output() const override;
+};
+
+// Element-wise binary cross-entropy of logits x against targets y.
+class BackwardBCEWithLogits : public NBackwardOp<2> {
+public:
+    using NBackwardOp<s_N>::NBackwardOp;
+
+    std::ostream& print(std::ostream& os) const override;
+    
+    void compute_operands_grad(
+            const Tensor& out
+    ) override;
+
+    bool reads_output() const override;
 };
 
 #endif
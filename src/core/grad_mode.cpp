@@ -0,0 +1,55 @@
+#include "grad_mode.h"
+
+namespace mt {
+
+    namespace {
+        thread_local bool t_grad_enabled { true };
+        thread_local bool t_inference_mode { false };
+    }
+
+    bool is_grad_enabled() {
+        return t_grad_enabled;
+    }
+
+    void set_grad_enabled(
+            const bool enabled
+    ) {
+        t_grad_enabled = enabled;
+    }
+
+    bool is_inference_mode() {
+        return t_inference_mode;
+    }
+
+    NoGradGuard::NoGradGuard():
+        m_prev_enabled{ t_grad_enabled } {
+        t_grad_enabled = false;
+    }
+
+    NoGradGuard::~NoGradGuard() {
+        t_grad_enabled = m_prev_enabled;
+    }
+
+    GradModeGuard::GradModeGuard(
+            const bool enabled
+    ):
+        m_prev_enabled{ t_grad_enabled } {
+        t_grad_enabled = enabled;
+    }
+
+    GradModeGuard::~GradModeGuard() {
+        t_grad_enabled = m_prev_enabled;
+    }
+
+    InferenceModeGuard::InferenceModeGuard():
+        m_prev_enabled{ t_grad_enabled },
+        m_prev_inference{ t_inference_mode } {
+        t_grad_enabled = false;
+        t_inference_mode = true;
+    }
+
+    InferenceModeGuard::~InferenceModeGuard() {
+        t_grad_enabled = m_prev_enabled;
+        t_inference_mode = m_prev_inference;
+    }
+}
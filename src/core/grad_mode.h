@@ -0,0 +1,73 @@
+#ifndef GRAD_MODE_H
+#define GRAD_MODE_H
+
+namespace mt {
+
+    // Whether ops record the autograd graph on the calling thread. When it is
+    // off, results are created with requires_grad=false and no GradFn is
+    // allocated, so operands are not captured either. Defaults to on.
+    bool is_grad_enabled();
+
+    void set_grad_enabled(
+            const bool enabled
+    );
+
+    // True inside an InferenceModeGuard on the calling thread.
+    bool is_inference_mode();
+
+    // Disables graph recording for its scope and restores the previous mode
+    // on exit. Leaves created in the scope still require grad.
+    //
+    //     {
+    //         mt::NoGradGuard no_grad;
+    //         Tensor y = model.forward(x); // y.m_node->m_grad_fn == nullptr
+    //     }
+    class NoGradGuard {
+    public:
+        NoGradGuard();
+        ~NoGradGuard();
+
+        NoGradGuard(const NoGradGuard&) = delete;
+        NoGradGuard& operator=(const NoGradGuard&) = delete;
+
+    private:
+        const bool m_prev_enabled;
+    };
+
+    // Sets grad mode for its scope and restores the previous mode on exit.
+    // Tensor::backward runs under GradModeGuard(create_graph).
+    class GradModeGuard {
+    public:
+        explicit GradModeGuard(
+                const bool enabled
+        );
+        ~GradModeGuard();
+
+        GradModeGuard(const GradModeGuard&) = delete;
+        GradModeGuard& operator=(const GradModeGuard&) = delete;
+
+    private:
+        const bool m_prev_enabled;
+    };
+
+    // No graph recording, and every TensorNode created in the scope, leaves
+    // included, has requires_grad=false: gradient buffers are never
+    // allocated for them and backward through them is rejected. Nor do they
+    // take a sequence number from the global counter, so threads running
+    // inference do not contend on it. For evaluation passes whose results
+    // never reach an optimizer.
+    class InferenceModeGuard {
+    public:
+        InferenceModeGuard();
+        ~InferenceModeGuard();
+
+        InferenceModeGuard(const InferenceModeGuard&) = delete;
+        InferenceModeGuard& operator=(const InferenceModeGuard&) = delete;
+
+    private:
+        const bool m_prev_enabled;
+        const bool m_prev_inference;
+    };
+}
+
+#endif
@@ -0,0 +1,171 @@
+#include <algorithm>
+#include <array>
+#include <format>
+#include <stdexcept>
+#include <utility>
+
+#include "capture.h"
+#include "../grad_mode.h"
+
+namespace mt::jit {
+
+    CapturedStep::CapturedStep(
+            StepFn step,
+            const std::vector<Tensor>& example_inputs
+    ):
+        m_step{ std::move(step) },
+        m_graph{},
+        m_pass_stats{},
+        m_grad_params{},
+        m_last_use{},
+        m_is_output{},
+        m_memory_plan{},
+        m_values{},
+        m_relu_mask{},
+        m_replays{ 0 },
+        m_eager_runs{ 0 } {
+        Trace trace(example_inputs);
+        Tensor loss = m_step(example_inputs);
+        if (!loss.m_node->m_requires_grad) {
+            throw std::invalid_argument(std::format("\nCannot capture a step whose loss does not require grad."));
+        }
+
+        // the capture's backward starts from no gradient and leaves the ones
+        // the leaves had untouched
+        std::vector<std::shared_ptr<TensorNode>> leaves { trace.graph().m_params };
+        for (const Tensor& input : example_inputs) leaves.push_back(input.m_node);
+        std::vector<std::shared_ptr<Tensor>> stashed;
+        for (const std::shared_ptr<TensorNode>& leaf : leaves) stashed.push_back(std::exchange(leaf->m_grad, nullptr));
+
+        loss.backward(false, true);
+
+        std::vector<Tensor> outputs { loss };
+        for (const std::shared_ptr<TensorNode>& param : trace.graph().m_params) {
+            if (!param->m_grad) continue;
+            m_grad_params.emplace_back(param);
+            outputs.push_back(*param->m_grad);
+        }
+        // reverse order, a leaf listed twice gets its first stash back
+        for (size_t i = leaves.size(); i-- > 0;) leaves[i]->m_grad = std::move(stashed[i]);
+        m_graph = trace.finish(outputs);
+        m_pass_stats = optimize(m_graph);
+
+        // a value is released by the last op reading it, or right away when
+        // nothing does
+        const std::vector<Op>& ops = m_graph.m_ops;
+        m_last_use.resize(ops.size());
+        for (size_t i = 0; i < ops.size(); ++i) {
+            m_last_use[i] = i;
+            for (const size_t input : ops[i].inputs) m_last_use[input] = i;
+        }
+        m_is_output.resize(ops.size());
+        for (const size_t output : m_graph.m_outputs) {
+            m_last_use[output] = ops.size();
+            m_is_output[output] = true;
+        }
+        m_values.resize(ops.size());
+    }
+
+    Tensor CapturedStep::run(
+            const std::vector<Tensor>& inputs
+    ) {
+        if (!matches(inputs)) {
+            Tensor loss = m_step(inputs);
+            loss.backward();
+            ++m_eager_runs;
+            return loss;
+        }
+
+        const std::vector<Op>& ops = m_graph.m_ops;
+        m_memory_plan.begin_step();
+        {
+            const mt::BufferSourceGuard source(&m_memory_plan);
+            for (size_t i = 0; i < ops.size(); ++i) {
+                m_memory_plan.begin_output(m_is_output[i]);
+                m_values[i].emplace(execute(ops[i], inputs));
+                for (const size_t input : ops[i].inputs) {
+                    if (m_last_use[input] == i) m_values[input].reset();
+                }
+                if (m_last_use[i] == i) m_values[i].reset();
+            }
+        }
+
+        // an output viewing an intermediate would be overwritten by the next
+        // step, one the passes reduced to a leaf would hand out its buffer
+        const std::vector<size_t>& outputs = m_graph.m_outputs;
+        for (const size_t output : outputs) {
+            const OpKind kind { ops[output].kind };
+            const bool leaf = kind == OpKind::Input || kind == OpKind::Param || kind == OpKind::Constant;
+            if (leaf || m_memory_plan.contains(*m_values[output])) m_values[output] = m_values[output]->clone();
+        }
+        m_memory_plan.end_step();
+
+        TensorStorage loss = *m_values[outputs[0]];
+        {
+            mt::NoGradGuard no_grad;
+            for (size_t k = 0; k < m_grad_params.size(); ++k) {
+                // moved out unless a later output is the same value, so that
+                // accumulate_grad can take the buffer over
+                std::optional<TensorStorage>& value = m_values[outputs[1 + k]];
+                const bool last = std::find(outputs.begin() + 2 + static_cast<std::ptrdiff_t>(k), outputs.end(), outputs[1 + k]) == outputs.end();
+                TensorStorage grad = last ? std::move(*value) : *value;
+                if (last) value.reset();
+                m_grad_params[k].accumulate_grad(std::move(grad));
+            }
+        }
+        for (std::optional<TensorStorage>& value : m_values) value.reset();
+
+        ++m_replays;
+        return Tensor(std::make_shared<TensorNode>(std::move(loss), false));
+    }
+
+    const Graph& CapturedStep::graph() const {
+        return m_graph;
+    }
+
+    const std::vector<Tensor>& CapturedStep::grad_params() const {
+        return m_grad_params;
+    }
+
+    const std::vector<PassStats>& CapturedStep::pass_stats() const {
+        return m_pass_stats;
+    }
+
+    const MemoryPlan& CapturedStep::memory_plan() const {
+        return m_memory_plan;
+    }
+
+    size_t CapturedStep::replays() const {
+        return m_replays;
+    }
+
+    size_t CapturedStep::eager_runs() const {
+        return m_eager_runs;
+    }
+
+    bool CapturedStep::matches(
+            const std::vector<Tensor>& inputs
+    ) const {
+        if (inputs.size() != m_graph.m_input_shapes.size()) return false;
+        for (size_t i = 0; i < inputs.size(); ++i) {
+            if (inputs[i].shape() != m_graph.m_input_shapes[i]) return false;
+        }
+        return true;
+    }
+
+    TensorStorage CapturedStep::execute(
+            const Op& op,
+            const std::vector<Tensor>& inputs
+    ) {
+        switch (op.kind) {
+            case OpKind::Input: return inputs[op.index].m_node->m_storage;
+            case OpKind::Param: return m_graph.m_params[op.index]->m_storage;
+            case OpKind::Constant: return m_graph.m_constants[op.index];
+            default: break;
+        }
+
+        std::array<const TensorStorage*, 3> args {};
+        for (size_t k = 0; k < op.inputs.size(); ++k) args[k] = &*m_values[op.inputs[k]];
+        return evaluate(op, std::span(args.data(), op.inputs.size()), m_relu_mask);
+    }
+}
@@ -0,0 +1,98 @@
+#ifndef JIT_CAPTURE_H
+#define JIT_CAPTURE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <vector>
+
+#include "trace.h"
+#include "memory_plan.h"
+#include "passes.h"
+#include "../tensors.h"
+
+namespace mt::jit {
+
+    // A training step (forward and backward) captured once as a static graph
+    // and replayed on new input data.
+    //
+    // Capture traces the step and its backward, which runs with create_graph
+    // so that the gradient computation is made of tensor ops as well. The
+    // graph ends with the loss followed by the gradients of the parameters,
+    // and is simplified by the passes of passes.h.
+    //
+    // A replay runs the ops in graph order, straight on the storages: no
+    // grad fn, node or tape is created, and every intermediate is released
+    // after its last use, which is planned at capture. Parameters are read
+    // live, so optimizer updates between steps are seen.
+    //
+    // The first replay is profiled for a memory plan (see memory_plan.h),
+    // later ones take their intermediates from its slab: only the outputs,
+    // which outlive the step, come from the allocator.
+    //
+    // The graph holds for the input shapes it was captured with. A run with
+    // other shapes (e.g. the last partial batch of a DataLoader) falls back
+    // to an eager forward and backward.
+    class CapturedStep {
+    public:
+        // Computes the loss from the inputs of a step.
+        using StepFn = std::function<Tensor(const std::vector<Tensor>&)>;
+
+        // Runs step on example_inputs to capture it, the parameters' grads
+        // are left as they were. Throws if the step runs an op the trace
+        // cannot express (see trace.h) or its loss does not require grad.
+        CapturedStep(
+                StepFn step,
+                const std::vector<Tensor>& example_inputs
+        );
+
+        // Runs the step on inputs: accumulates the gradients of the
+        // parameters into their grad(), as loss.backward() would, and
+        // returns the loss (without graph).
+        Tensor run(
+                const std::vector<Tensor>& inputs
+        );
+
+        const Graph& graph() const;
+
+        // The parameters whose gradients are outputs 1, 2, ... of the graph.
+        const std::vector<Tensor>& grad_params() const;
+
+        // What each optimization pass did to the captured graph.
+        const std::vector<PassStats>& pass_stats() const;
+
+        const MemoryPlan& memory_plan() const;
+
+        size_t replays() const;
+
+        size_t eager_runs() const;
+
+    private:
+        StepFn m_step;
+        Graph m_graph;
+        std::vector<PassStats> m_pass_stats;
+        // parameters whose gradient is output 1 + i of the graph
+        std::vector<Tensor> m_grad_params;
+        // last op reading each value, outputs are read past the end
+        std::vector<size_t> m_last_use;
+        std::vector<bool> m_is_output;
+        MemoryPlan m_memory_plan;
+        // values of a replay, reused across replays
+        std::vector<std::optional<TensorStorage>> m_values;
+        std::vector<uint64_t> m_relu_mask;
+        size_t m_replays;
+        size_t m_eager_runs;
+
+        bool matches(
+                const std::vector<Tensor>& inputs
+        ) const;
+
+        TensorStorage execute(
+                const Op& op,
+                const std::vector<Tensor>& inputs
+        );
+    };
+}
+
+#endif
@@ -0,0 +1,797 @@
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <format>
+#include <limits>
+#include <stdexcept>
+#include <string_view>
+
+#include "codegen.h"
+#include "memory_plan.h"
+#include "../allocator.h"
+#include "../tensor_nodes.h"
+
+namespace mt::jit {
+
+    namespace {
+        enum class Category {
+            Leaf,
+            View,        // strides over another value, no code
+            Elementwise, // one loop, fusable
+            Call         // gemm or a loop nest of its own
+        };
+
+        Category category_of(
+                const Op& op
+        ) {
+            switch (op.kind) {
+                case OpKind::Input:
+                case OpKind::Param:
+                case OpKind::Constant:
+                    return Category::Leaf;
+                case OpKind::Unsqueeze:
+                case OpKind::Squeeze:
+                case OpKind::Repeat:
+                case OpKind::Expand:
+                case OpKind::Transpose:
+                    return Category::View;
+                case OpKind::Sum:
+                case OpKind::Softmax:
+                case OpKind::LogSoftmax:
+                case OpKind::CrossEntropy:
+                case OpKind::OneHot:
+                case OpKind::Matmul:
+                case OpKind::Linear:
+                    return Category::Call;
+                case OpKind::Kernel:
+                    throw std::invalid_argument(
+                        std::format("\nCannot generate code for a kernel called through its pointer.")
+                    );
+                default:
+                    return Category::Elementwise;
+            }
+        }
+
+        size_t numel_of(
+                const mt::DimVector& shape
+        ) {
+            size_t numel { 1 };
+            for (const size_t size : shape) numel *= size;
+            return numel;
+        }
+
+        mt::DimVector dense_strides(
+                const mt::DimVector& shape
+        ) {
+            mt::DimVector strides(shape.size());
+            size_t stride { 1 };
+            for (size_t d = shape.size(); d-- > 0;) {
+                strides[d] = stride;
+                stride *= shape[d];
+            }
+            return strides;
+        }
+
+        std::string float_literal(
+                const float x
+        ) {
+            if (std::isnan(x)) return "std::numeric_limits<float>::quiet_NaN()";
+            if (std::isinf(x)) return x > 0.0f ? "std::numeric_limits<float>::infinity()" : "(-std::numeric_limits<float>::infinity())";
+            std::string literal { std::format("{}", x) };
+            if (literal.find_first_of(".e") == std::string::npos) literal += ".0";
+            literal += 'f';
+            return std::signbit(x) ? "(" + literal + ")" : literal;
+        }
+
+        // Loop variables i0, ..., i<rank - 1>.
+        std::vector<std::string> loop_vars(
+                const size_t rank
+        ) {
+            std::vector<std::string> vars;
+            for (size_t d = 0; d < rank; ++d) vars.push_back(std::format("i{}", d));
+            return vars;
+        }
+
+        // The variables of a loop that index a broadcast operand of the
+        // given rank: the trailing ones.
+        std::vector<std::string> trailing(
+                const std::vector<std::string>& vars,
+                const size_t rank
+        ) {
+            return { vars.end() - static_cast<std::ptrdiff_t>(rank), vars.end() };
+        }
+
+        // Offset of the element at vars (one per dimension) in a value of
+        // the given shape and strides, as a sum of constant-stride terms:
+        // singleton and zero-stride dimensions do not appear.
+        std::string offset(
+                const mt::DimVector& shape,
+                const mt::DimVector& strides,
+                const std::vector<std::string>& vars
+        ) {
+            std::string sum;
+            for (size_t d = 0; d < shape.size(); ++d) {
+                if (shape[d] == 1 || strides[d] == 0) continue;
+                if (!sum.empty()) sum += " + ";
+                sum += strides[d] == 1 ? vars[d] : std::format("{} * {}", vars[d], strides[d]);
+            }
+            return sum.empty() ? "0" : sum;
+        }
+
+        // Indented lines of generated code.
+        class Writer {
+        public:
+            Writer(
+                    std::ostream& os,
+                    const size_t depth
+            ):
+                m_os{ os },
+                m_depth{ depth } {}
+
+            void line(
+                    const std::string_view text
+            ) {
+                if (!text.empty()) m_os << std::string(4 * m_depth, ' ') << text;
+                m_os << '\n';
+            }
+
+            // text followed by an opening brace, or a bare block when empty
+            void open(
+                    const std::string_view text
+            ) {
+                line(text.empty() ? std::string("{") : std::format("{} {{", text));
+                ++m_depth;
+            }
+
+            void close(
+                    const std::string_view suffix = ""
+            ) {
+                --m_depth;
+                line(std::format("}}{}", suffix));
+            }
+
+            void open_loop(
+                    const std::string& var,
+                    const size_t extent
+            ) {
+                open(std::format("for (size_t {} = 0; {} < {}; ++{})", var, var, extent, var));
+            }
+
+            // Loops over every index of shape, with vars as the variables.
+            void open_loops(
+                    const mt::DimVector& shape,
+                    const std::vector<std::string>& vars
+            ) {
+                for (size_t d = 0; d < shape.size(); ++d) open_loop(vars[d], shape[d]);
+            }
+
+            void close_loops(
+                    const size_t count
+            ) {
+                for (size_t d = 0; d < count; ++d) close();
+            }
+
+        private:
+            std::ostream& m_os;
+            size_t m_depth;
+        };
+
+        // Where the elements of a value are read from: a pointer of the
+        // generated code and the strides over it.
+        struct Layout {
+            std::string name {};
+            mt::DimVector strides {};
+        };
+
+        // How a graph maps to generated code, decided once for the header
+        // and the source.
+        class Lowering {
+        public:
+            explicit Lowering(
+                    const Graph& graph
+            );
+
+            size_t workspace_numel() const;
+
+            // The constants read from memory, at namespace scope.
+            void emit_constants(
+                    Writer& out
+            ) const;
+
+            // The body of run.
+            void emit_body(
+                    Writer& out
+            ) const;
+
+        private:
+            const Graph& m_graph;
+            std::vector<Category> m_category;
+            std::vector<size_t> m_uses;
+            // the reader of a value read once
+            std::vector<size_t> m_reader;
+            std::vector<bool> m_is_output;
+            // computed in the loop of its reader
+            std::vector<bool> m_inlined;
+            // a filled constant only read by element-wise ops: its value is
+            // written in their expressions
+            std::vector<bool> m_literal;
+            std::vector<Layout> m_layout;
+            // first output of each value written straight to the caller's
+            // memory, or NO_OUTPUT
+            std::vector<size_t> m_output_slot;
+            // offset in floats into the workspace of the other computed values
+            std::vector<size_t> m_workspace_offset;
+            size_t m_workspace_numel;
+
+            static constexpr size_t NO_OUTPUT { std::numeric_limits<size_t>::max() };
+
+            bool is_computed(
+                    const size_t value
+            ) const;
+
+            // Element of value at the current iteration of a loop with the
+            // given variables, the value broadcast to the loop's shape.
+            std::string element(
+                    const size_t value,
+                    const std::vector<std::string>& vars
+            ) const;
+
+            // The element computed by the element-wise op of value.
+            std::string expression(
+                    const size_t value,
+                    const std::vector<std::string>& vars
+            ) const;
+
+            std::string describe(
+                    const size_t value
+            ) const;
+
+            void emit_op(
+                    Writer& out,
+                    const size_t value
+            ) const;
+        };
+
+        Lowering::Lowering(
+                const Graph& graph
+        ):
+            m_graph{ graph },
+            m_category{},
+            m_uses(graph.m_ops.size(), 0),
+            m_reader(graph.m_ops.size(), 0),
+            m_is_output(graph.m_ops.size(), false),
+            m_inlined(graph.m_ops.size(), false),
+            m_literal(graph.m_ops.size(), false),
+            m_layout(graph.m_ops.size()),
+            m_output_slot(graph.m_ops.size(), NO_OUTPUT),
+            m_workspace_offset(graph.m_ops.size(), 0),
+            m_workspace_numel{ 0 } {
+            const std::vector<Op>& ops = graph.m_ops;
+            const size_t n { ops.size() };
+            for (const Op& op : ops) m_category.push_back(category_of(op));
+
+            std::vector<bool> elementwise_readers(n, true);
+            for (size_t i = 0; i < n; ++i) {
+                for (const size_t input : ops[i].inputs) {
+                    ++m_uses[input];
+                    m_reader[input] = i;
+                    if (m_category[i] != Category::Elementwise) elementwise_readers[input] = false;
+                }
+            }
+            for (size_t k = 0; k < graph.m_outputs.size(); ++k) {
+                const size_t output { graph.m_outputs[k] };
+                ++m_uses[output];
+                m_is_output[output] = true;
+            }
+
+            for (size_t i = 0; i < n; ++i) {
+                const Op& op = ops[i];
+                if (m_category[i] == Category::Elementwise) {
+                    m_inlined[i] = !m_is_output[i]
+                        && m_uses[i] == 1
+                        && m_category[m_reader[i]] == Category::Elementwise
+                        && ops[m_reader[i]].shape == op.shape;
+                }
+                if (op.kind == OpKind::Constant && !m_is_output[i] && elementwise_readers[i]) {
+                    const TensorStorage& constant = graph.m_constants[op.index];
+                    bool filled { true };
+                    for (size_t l = 1; l < constant.m_numel && filled; ++l) {
+                        filled = constant.get_entry_ref(l) == constant.get_entry_ref(0);
+                    }
+                    m_literal[i] = filled;
+                }
+            }
+
+            // a fused value is computed when its reader is, a view is read
+            // where its readers are: buffers live until the last of these
+            std::vector<size_t> computed_at(n);
+            for (size_t i = n; i-- > 0;) computed_at[i] = m_inlined[i] ? computed_at[m_reader[i]] : i;
+            std::vector<size_t> root(n);
+            for (size_t i = 0; i < n; ++i) root[i] = m_category[i] == Category::View ? root[ops[i].inputs[0]] : i;
+            std::vector<size_t> last_use(n);
+            for (size_t i = 0; i < n; ++i) {
+                last_use[i] = i;
+                if (m_category[i] == Category::View) continue;
+                for (const size_t input : ops[i].inputs) {
+                    last_use[root[input]] = std::max(last_use[root[input]], computed_at[i]);
+                }
+            }
+            for (const size_t output : graph.m_outputs) last_use[root[output]] = n;
+
+            for (size_t k = 0; k < graph.m_outputs.size(); ++k) {
+                const size_t output { graph.m_outputs[k] };
+                if (is_computed(output) && m_output_slot[output] == NO_OUTPUT) m_output_slot[output] = k;
+            }
+
+            std::vector<PlannedBuffer> buffers;
+            std::vector<size_t> buffer_values;
+            for (size_t i = 0; i < n; ++i) {
+                if (!is_computed(i) || m_output_slot[i] != NO_OUTPUT) continue;
+                const size_t numel { std::max<size_t>(numel_of(ops[i].shape), 1) };
+                const size_t bytes { (numel * sizeof(float) + BUFFER_ALIGNMENT - 1) / BUFFER_ALIGNMENT * BUFFER_ALIGNMENT };
+                buffers.push_back({ numel, bytes, i, last_use[i] + 1, true, 0 });
+                buffer_values.push_back(i);
+            }
+            m_workspace_numel = plan_offsets(buffers) / sizeof(float);
+            for (size_t b = 0; b < buffers.size(); ++b) m_workspace_offset[buffer_values[b]] = buffers[b].offset / sizeof(float);
+
+            for (size_t i = 0; i < n; ++i) {
+                const Op& op = ops[i];
+                Layout& layout = m_layout[i];
+                switch (op.kind) {
+                    case OpKind::Input: layout = { std::format("in{}", op.index), dense_strides(op.shape) }; continue;
+                    case OpKind::Param: layout = { std::format("p{}", op.index), dense_strides(op.shape) }; continue;
+                    case OpKind::Constant: layout = { std::format("c{}", op.index), dense_strides(op.shape) }; continue;
+                    default: break;
+                }
+                if (m_category[i] != Category::View) {
+                    const bool output { m_output_slot[i] != NO_OUTPUT };
+                    layout = { output ? std::format("out{}", m_output_slot[i]) : std::format("v{}", i), dense_strides(op.shape) };
+                    continue;
+                }
+
+                layout = m_layout[op.inputs[0]];
+                mt::DimVector& strides = layout.strides;
+                switch (op.kind) {
+                    case OpKind::Unsqueeze:
+                        strides.insert(strides.begin() + static_cast<std::ptrdiff_t>(op.dims[0]), 0);
+                        break;
+                    case OpKind::Squeeze:
+                        strides.erase(strides.begin() + static_cast<std::ptrdiff_t>(op.dims[0]));
+                        break;
+                    case OpKind::Transpose:
+                        std::swap(strides[op.dims[0]], strides[op.dims[1]]);
+                        break;
+                    default: // Repeat and Expand, of a singleton dimension
+                        strides[op.dims[0]] = 0;
+                        break;
+                }
+            }
+        }
+
+        size_t Lowering::workspace_numel() const {
+            return m_workspace_numel;
+        }
+
+        bool Lowering::is_computed(
+                const size_t value
+        ) const {
+            const Category category { m_category[value] };
+            return category == Category::Call || (category == Category::Elementwise && !m_inlined[value]);
+        }
+
+        std::string Lowering::element(
+                const size_t value,
+                const std::vector<std::string>& vars
+        ) const {
+            const Op& op = m_graph.m_ops[value];
+            if (m_literal[value]) return float_literal(m_graph.m_constants[op.index].get_entry_ref(0));
+            if (m_inlined[value]) return expression(value, vars);
+            const Layout& layout = m_layout[value];
+            return std::format("{}[{}]", layout.name, offset(op.shape, layout.strides, trailing(vars, op.shape.size())));
+        }
+
+        std::string Lowering::expression(
+                const size_t value,
+                const std::vector<std::string>& vars
+        ) const {
+            const Op& op = m_graph.m_ops[value];
+            const std::string a { element(op.inputs[0], vars) };
+            const std::string b { op.inputs.size() > 1 ? element(op.inputs[1], vars) : float_literal(op.scalar) };
+            switch (op.kind) {
+                case OpKind::Add:
+                case OpKind::AddScalar:
+                    return std::format("({} + {})", a, b);
+                case OpKind::Sub:
+                case OpKind::SubScalar:
+                    return std::format("({} - {})", a, b);
+                case OpKind::RsubScalar:
+                    return std::format("({} - {})", b, a);
+                case OpKind::Mult:
+                case OpKind::MultScalar:
+                    return std::format("({} * {})", a, b);
+                case OpKind::Div:
+                case OpKind::DivScalar:
+                    return std::format("({} / {})", a, b);
+                case OpKind::RdivScalar:
+                    return std::format("({} / {})", b, a);
+                case OpKind::Pow:
+                case OpKind::PowScalar:
+                    return std::format("std::pow({}, {})", a, b);
+                case OpKind::RpowScalar:
+                    return std::format("std::pow({}, {})", b, a);
+                case OpKind::Maximum:
+                case OpKind::MaximumScalar:
+                    return std::format("maximum({}, {})", a, b);
+                case OpKind::Gt:
+                case OpKind::GtScalar:
+                    return std::format("gt({}, {})", a, b);
+                case OpKind::Gte:
+                    return std::format("gte({}, {})", a, b);
+                case OpKind::Lte:
+                    return std::format("lte({}, {})", a, b);
+                case OpKind::Minus:
+                    return std::format("(-{})", a);
+                case OpKind::Log:
+                    return std::format("std::log({})", a);
+                case OpKind::Exp:
+                    return std::format("std::exp({})", a);
+                case OpKind::Relu:
+                    return std::format("maximum({}, 0.0f)", a);
+                case OpKind::Clone:
+                    return a;
+                default:
+                    throw std::invalid_argument(std::format("\nCannot generate code for a {} op.", op_name(op.kind)));
+            }
+        }
+
+        std::string Lowering::describe(
+                const size_t value
+        ) const {
+            const Op& op = m_graph.m_ops[value];
+            std::string text { std::format("%{} = {}(", value, op_name(op.kind)) };
+            for (size_t k = 0; k < op.inputs.size(); ++k) text += std::format("{}%{}", k ? ", " : "", op.inputs[k]);
+            text += std::format(") {}", op.shape);
+
+            // the values fused into this one's loop, innermost last
+            std::vector<size_t> fused;
+            std::vector<size_t> pending { op.inputs };
+            while (!pending.empty()) {
+                const size_t input { pending.back() };
+                pending.pop_back();
+                if (!m_inlined[input]) continue;
+                fused.push_back(input);
+                pending.insert(pending.end(), m_graph.m_ops[input].inputs.begin(), m_graph.m_ops[input].inputs.end());
+            }
+            std::sort(fused.begin(), fused.end());
+            for (size_t k = 0; k < fused.size(); ++k) {
+                text += std::format("{}%{} {}", k ? ", " : ", fused: ", fused[k], op_name(m_graph.m_ops[fused[k]].kind));
+            }
+            return text;
+        }
+
+        void Lowering::emit_constants(
+                Writer& out
+        ) const {
+            const std::vector<Op>& ops = m_graph.m_ops;
+            for (size_t i = 0; i < ops.size(); ++i) {
+                if (ops[i].kind != OpKind::Constant || m_literal[i]) continue;
+                const TensorStorage& constant = m_graph.m_constants[ops[i].index];
+                out.open(std::format("alignas({}) constexpr float c{}[]", BUFFER_ALIGNMENT, ops[i].index));
+                std::string row;
+                for (size_t l = 0; l < constant.m_numel; ++l) {
+                    row += std::format("{}{},", row.empty() ? "" : " ", float_literal(constant.get_entry_ref(l)));
+                    if (l % 8 == 7 || l + 1 == constant.m_numel) {
+                        out.line(row);
+                        row.clear();
+                    }
+                }
+                out.close(";");
+            }
+        }
+
+        void Lowering::emit_body(
+                Writer& out
+        ) const {
+            const std::vector<Op>& ops = m_graph.m_ops;
+            for (size_t i = 0; i < ops.size(); ++i) {
+                const Op& op = ops[i];
+                if (op.kind == OpKind::Input) out.line(std::format("const float* const in{} {{ inputs[{}] }};", op.index, op.index));
+                if (op.kind == OpKind::Param) out.line(std::format("const float* const p{} {{ params[{}] }};", op.index, op.index));
+            }
+            for (size_t k = 0; k < m_graph.m_outputs.size(); ++k) {
+                out.line(std::format("float* const out{} {{ outputs[{}] }};", k, k));
+            }
+
+            for (size_t i = 0; i < ops.size(); ++i) {
+                if (!is_computed(i)) continue;
+                out.line("");
+                out.line(std::format("// {}", describe(i)));
+                if (m_output_slot[i] == NO_OUTPUT) {
+                    out.line(std::format("float* const v{} {{ workspace + {} }};", i, m_workspace_offset[i]));
+                }
+                emit_op(out, i);
+            }
+
+            // outputs that are leaves, views or repeated are copied
+            for (size_t k = 0; k < m_graph.m_outputs.size(); ++k) {
+                const size_t output { m_graph.m_outputs[k] };
+                if (m_output_slot[output] == k) continue;
+                const mt::DimVector& shape = ops[output].shape;
+                const std::vector<std::string> vars { loop_vars(shape.size()) };
+                out.line("");
+                out.line(std::format("// output {} is %{}", k, output));
+                out.open_loops(shape, vars);
+                out.line(std::format("out{}[{}] = {};", k, offset(shape, dense_strides(shape), vars), element(output, vars)));
+                out.close_loops(shape.size());
+            }
+        }
+
+        void Lowering::emit_op(
+                Writer& out,
+                const size_t value
+        ) const {
+            const Op& op = m_graph.m_ops[value];
+            const Layout& y = m_layout[value];
+            const mt::DimVector y_strides { dense_strides(op.shape) };
+
+            if (m_category[value] == Category::Elementwise) {
+                const std::vector<std::string> vars { loop_vars(op.shape.size()) };
+                out.open_loops(op.shape, vars);
+                out.line(std::format("{}[{}] = {};", y.name, offset(op.shape, y_strides, vars), expression(value, vars)));
+                out.close_loops(op.shape.size());
+                return;
+            }
+
+            const Op& x_op = m_graph.m_ops[op.inputs[0]];
+            const Layout& x = m_layout[op.inputs[0]];
+            const mt::DimVector& x_shape = x_op.shape;
+            switch (op.kind) {
+                case OpKind::Matmul:
+                case OpKind::Linear: {
+                    const Layout& w = m_layout[op.inputs[1]];
+                    const size_t m { x_shape[0] };
+                    const size_t k { x_shape[1] };
+                    const size_t n { op.shape[1] };
+                    std::string call { std::format(
+                        "mt::kernels::gemm({}, {}, {}, {{ {}, {}, {} }}, {{ {}, {}, {} }}, {{ {}, {}, 1 }}",
+                        m, n, k,
+                        x.name, x.strides[0], x.strides[1],
+                        w.name, w.strides[0], w.strides[1],
+                        y.name, n
+                    ) };
+                    if (op.kind == OpKind::Linear) {
+                        const bool relu { op.activation == mt::kernels::Activation::ReLU };
+                        const Layout* bias { op.inputs.size() == 3 ? &m_layout[op.inputs[2]] : nullptr };
+                        call += std::format(
+                            ", false, {{ {}, {}, mt::kernels::Activation::{} }}",
+                            bias ? bias->name : "nullptr",
+                            bias ? bias->strides[0] : 0,
+                            relu ? "ReLU" : "None"
+                        );
+                    }
+                    out.line(call + ");");
+                    return;
+                }
+                case OpKind::Sum: {
+                    const std::vector<std::string> vars { loop_vars(x_shape.size()) };
+                    std::vector<std::string> y_vars;
+                    for (size_t d = 0; d < x_shape.size(); ++d) {
+                        const bool reduced { std::find(op.dims.begin(), op.dims.end(), d) != op.dims.end() };
+                        if (!reduced) y_vars.push_back(vars[d]);
+                        else if (op.keepdim) y_vars.push_back("0");
+                    }
+                    out.open_loop("i", numel_of(op.shape));
+                    out.line(std::format("{}[i] = 0.0f;", y.name));
+                    out.close();
+                    out.open_loops(x_shape, vars);
+                    out.line(std::format("{}[{}] += {};", y.name, offset(op.shape, y_strides, y_vars), element(op.inputs[0], vars)));
+                    out.close_loops(x_shape.size());
+                    return;
+                }
+                case OpKind::Softmax:
+                case OpKind::LogSoftmax:
+                case OpKind::CrossEntropy: {
+                    // row by row along dim: max, then the shifted exp-sum
+                    const size_t dim { op.kind == OpKind::CrossEntropy ? x_shape.size() - 1 : op.dims[0] };
+                    const std::vector<std::string> vars { loop_vars(x_shape.size()) };
+                    const std::string& j = vars[dim];
+                    const std::string x_j { element(op.inputs[0], vars) };
+                    const std::string y_j {
+                        op.kind == OpKind::CrossEntropy ? "" : std::format("{}[{}]", y.name, offset(x_shape, y_strides, vars))
+                    };
+                    // the row's scalars are scoped by the outer loops, or a
+                    // block of their own for a single row
+                    if (x_shape.size() == 1) out.open("");
+                    for (size_t d = 0; d < x_shape.size(); ++d) {
+                        if (d != dim) out.open_loop(vars[d], x_shape[d]);
+                    }
+                    out.line("float max { -std::numeric_limits<float>::infinity() };");
+                    out.open_loop(j, x_shape[dim]);
+                    out.line(std::format("max = maximum({}, max);", x_j));
+                    out.close();
+                    out.line("float sum { 0.0f };");
+                    out.open_loop(j, x_shape[dim]);
+                    if (op.kind == OpKind::Softmax) {
+                        out.line(std::format("{} = std::exp({} - max);", y_j, x_j));
+                        out.line(std::format("sum += {};", y_j));
+                    } else {
+                        out.line(std::format("sum += std::exp({} - max);", x_j));
+                    }
+                    out.close();
+
+                    if (op.kind == OpKind::Softmax) {
+                        out.line("const float inv_sum { 1.0f / sum };");
+                        out.open_loop(j, x_shape[dim]);
+                        out.line(std::format("{} *= inv_sum;", y_j));
+                        out.close();
+                    } else if (op.kind == OpKind::LogSoftmax) {
+                        out.line("const float log_sum { std::log(sum) };");
+                        out.open_loop(j, x_shape[dim]);
+                        out.line(std::format("{} = ({} - max) - log_sum;", y_j, x_j));
+                        out.close();
+                    } else {
+                        // class indices are trusted: integral floats in range
+                        const Op& classes = m_graph.m_ops[op.inputs[1]];
+                        const std::vector<std::string> row_vars(vars.begin(), vars.end() - 1);
+                        std::vector<std::string> class_vars { row_vars };
+                        class_vars.push_back("cls");
+                        out.line(std::format(
+                            "const size_t cls {{ static_cast<size_t>({}[{}]) }};",
+                            m_layout[op.inputs[1]].name,
+                            offset(classes.shape, m_layout[op.inputs[1]].strides, row_vars)
+                        ));
+                        out.line(std::format(
+                            "{}[{}] = std::log(sum) - ({}[{}] - max);",
+                            y.name,
+                            offset(op.shape, y_strides, row_vars),
+                            x.name,
+                            offset(x_shape, x.strides, class_vars)
+                        ));
+                    }
+                    out.close_loops(std::max<size_t>(x_shape.size() - 1, 1));
+                    return;
+                }
+                case OpKind::OneHot: {
+                    const std::vector<std::string> vars { loop_vars(x_shape.size()) };
+                    out.open_loop("i", numel_of(op.shape));
+                    out.line(std::format("{}[i] = 0.0f;", y.name));
+                    out.close();
+                    out.open_loops(x_shape, vars);
+                    std::vector<std::string> y_vars { vars };
+                    y_vars.push_back(std::format("static_cast<size_t>({})", element(op.inputs[0], vars)));
+                    out.line(std::format("{}[{}] = 1.0f;", y.name, offset(op.shape, y_strides, y_vars)));
+                    out.close_loops(x_shape.size());
+                    return;
+                }
+                default:
+                    throw std::invalid_argument(std::format("\nCannot generate code for a {} op.", op_name(op.kind)));
+            }
+        }
+
+        std::string numel_list(
+                const std::vector<mt::DimVector>& shapes
+        ) {
+            std::string list;
+            for (size_t k = 0; k < shapes.size(); ++k) list += std::format("{}{}", k ? ", " : "", numel_of(shapes[k]));
+            return list;
+        }
+
+        // The given names as string literals, what<k> for the missing ones.
+        std::string name_list(
+                const char* what,
+                const size_t count,
+                const std::vector<std::string>& names
+        ) {
+            std::string list;
+            for (size_t k = 0; k < count; ++k) {
+                const std::string name { k < names.size() ? names[k] : std::format("{}{}", what, k) };
+                list += std::format("{}\"{}\"", k ? ", " : "", name);
+            }
+            return list;
+        }
+
+        // The names, element counts and (in a comment) the shapes of a list
+        // of operands, e.g. param_names and param_numel.
+        void emit_operands(
+                Writer& out,
+                const char* what,
+                const std::vector<mt::DimVector>& shapes,
+                const std::vector<std::string>& names
+        ) {
+            out.line(std::format("// {}s: {}", what, shapes));
+            out.line(std::format(
+                "constexpr std::array<std::string_view, {}> {}_names {{ {} }};",
+                shapes.size(), what, name_list(what, shapes.size(), names)
+            ));
+            out.line(std::format("constexpr std::array<size_t, {}> {}_numel {{ {} }};", shapes.size(), what, numel_list(shapes)));
+        }
+    }
+
+    void emit_header(
+            const Graph& graph,
+            const CodegenOptions& options,
+            std::ostream& os
+    ) {
+        const Lowering lowering(graph);
+        std::vector<mt::DimVector> param_shapes;
+        for (const std::shared_ptr<TensorNode>& param : graph.m_params) param_shapes.push_back(param->m_storage.m_shape);
+        std::vector<mt::DimVector> output_shapes;
+        for (const size_t output : graph.m_outputs) output_shapes.push_back(graph.m_ops[output].shape);
+
+        std::string guard { options.name };
+        std::transform(guard.begin(), guard.end(), guard.begin(), [](const char c) {
+            return static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+        });
+
+        Writer out(os, 0);
+        out.line("// Generated by mt::jit::emit_header, do not edit.");
+        out.line(std::format("#ifndef {}_H", guard));
+        out.line(std::format("#define {}_H", guard));
+        out.line("");
+        out.line("#include <array>");
+        out.line("#include <cstddef>");
+        out.line("#include <string_view>");
+        out.line("");
+        out.open(std::format("namespace {}", options.name));
+        emit_operands(out, "input", graph.m_input_shapes, options.input_names);
+        out.line("");
+        emit_operands(out, "param", param_shapes, options.param_names);
+        out.line("");
+        emit_operands(out, "output", output_shapes, options.output_names);
+        out.line("");
+        out.line(std::format("constexpr size_t workspace_numel {{ {} }};", lowering.workspace_numel()));
+        out.line("");
+        out.line("// Dense row-major operands, workspace holds workspace_numel floats.");
+        out.line("void run(");
+        out.line("        const float* const* inputs,");
+        out.line("        const float* const* params,");
+        out.line("        float* const* outputs,");
+        out.line("        float* workspace");
+        out.line(");");
+        out.close();
+        out.line("");
+        out.line("#endif");
+    }
+
+    void emit_source(
+            const Graph& graph,
+            const CodegenOptions& options,
+            std::ostream& os
+    ) {
+        const Lowering lowering(graph);
+
+        Writer out(os, 0);
+        out.line("// Generated by mt::jit::emit_source, do not edit. Shapes and strides are");
+        out.line("// constants and are not checked: the operands must have the shapes of the");
+        out.line("// header.");
+        out.line("#include <cmath>");
+        out.line("#include <cstddef>");
+        out.line("#include <limits>");
+        out.line("");
+        out.line(std::format("#include \"{}.h\"", options.name));
+        // the generated files live outside the tree, they are compiled with
+        // its root on the include path
+        out.line("#include \"src/core/kernels/gemm.h\"");
+        out.line("");
+        out.open(std::format("namespace {}", options.name));
+        out.line("");
+        out.open("namespace");
+        out.line("[[maybe_unused]] inline float maximum(const float x, const float y) { return x > y ? x : y; }");
+        out.line("[[maybe_unused]] inline float gt(const float x, const float y) { return x > y ? 1.0f : 0.0f; }");
+        out.line("[[maybe_unused]] inline float gte(const float x, const float y) { return x >= y ? 1.0f : 0.0f; }");
+        out.line("[[maybe_unused]] inline float lte(const float x, const float y) { return x <= y ? 1.0f : 0.0f; }");
+        lowering.emit_constants(out);
+        out.close();
+        out.line("");
+        out.line("void run(");
+        out.line("        [[maybe_unused]] const float* const* inputs,");
+        out.line("        [[maybe_unused]] const float* const* params,");
+        out.line("        [[maybe_unused]] float* const* outputs,");
+        out.line("        [[maybe_unused]] float* workspace");
+        out.open(")");
+        lowering.emit_body(out);
+        out.close();
+        out.close();
+    }
+}
@@ -0,0 +1,51 @@
+#ifndef JIT_CODEGEN_H
+#define JIT_CODEGEN_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "trace.h"
+
+// Ahead-of-time C++ for traced graphs of fixed shapes. The generated
+// translation unit runs the graph with every shape and stride written as a
+// constant: no dispatch, node, grad fn or shape check is left at runtime.
+//
+// Matmuls and linear layers call mt::kernels::gemm (bias and activation in
+// its epilogue), views become the strides their readers index with, and an
+// element-wise op whose only reader is an element-wise op of the same shape
+// is fused into that reader's loop. Intermediates live in one workspace
+// provided by the caller, laid out with plan_offsets (see memory_plan.h).
+namespace mt::jit {
+
+    struct CodegenOptions {
+        // namespace of the generated code and stem of its files, a C++
+        // identifier
+        std::string name;
+        // written in the comments of the header when given
+        std::vector<std::string> input_names {};
+        std::vector<std::string> param_names {};
+        std::vector<std::string> output_names {};
+    };
+
+    // Writes <name>.h: the sizes of the operands and of the workspace, and
+    // the declaration of
+    //     void run(inputs, params, outputs, workspace);
+    // which reads dense row-major inputs and parameters (in the order of
+    // graph.m_params) and writes dense row-major outputs.
+    void emit_header(
+            const Graph& graph,
+            const CodegenOptions& options,
+            std::ostream& os
+    );
+
+    // Writes <name>.cpp, the definition of run. Throws if the graph has an
+    // op with no lowering: a kernel called through its pointer.
+    void emit_source(
+            const Graph& graph,
+            const CodegenOptions& options,
+            std::ostream& os
+    );
+}
+
+#endif
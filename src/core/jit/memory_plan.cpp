@@ -0,0 +1,226 @@
+#include <algorithm>
+#include <format>
+#include <limits>
+#include <utility>
+
+#include "memory_plan.h"
+
+namespace mt::jit {
+
+    namespace {
+        constexpr size_t NO_END { std::numeric_limits<size_t>::max() };
+
+        size_t buffer_bytes(
+                const size_t numel
+        ) {
+            const size_t bytes { std::max<size_t>(numel, 1) * sizeof(float) };
+            return (bytes + BUFFER_ALIGNMENT - 1) / BUFFER_ALIGNMENT * BUFFER_ALIGNMENT;
+        }
+
+        bool overlap(
+                const PlannedBuffer& a,
+                const PlannedBuffer& b
+        ) {
+            return a.start < b.end && b.start < a.end;
+        }
+
+        // Most bytes of the slab's buffers alive at the same time: the
+        // smallest slab any plan could have.
+        size_t live_peak(
+                const std::vector<PlannedBuffer>& buffers
+        ) {
+            std::vector<std::pair<size_t, long>> events;
+            for (const PlannedBuffer& b : buffers) {
+                if (!b.in_slab) continue;
+                events.emplace_back(b.start, static_cast<long>(b.bytes));
+                events.emplace_back(b.end, -static_cast<long>(b.bytes));
+            }
+            // frees first at equal times
+            std::sort(events.begin(), events.end());
+            long live { 0 };
+            long peak { 0 };
+            for (const auto& [time, delta] : events) {
+                live += delta;
+                peak = std::max(peak, live);
+            }
+            return static_cast<size_t>(peak);
+        }
+    }
+
+    // Lifetimes of the buffers of a profiled step. Buffers may outlive the
+    // step and the plan, their deleters hold the profile.
+    struct MemoryPlan::Profile {
+        std::vector<PlannedBuffer> buffers {};
+        size_t clock { 0 };
+        bool open { true };
+    };
+
+    // Records the free of a profiled buffer, then frees it.
+    struct MemoryPlan::ProfileDeleter {
+        std::shared_ptr<float[]> buffer;
+        std::shared_ptr<Profile> profile;
+        size_t index;
+
+        void operator()(float*) {
+            if (profile->open) profile->buffers[index].end = profile->clock++;
+            buffer.reset();
+        }
+    };
+
+    size_t plan_offsets(
+            std::vector<PlannedBuffer>& buffers
+    ) {
+        std::vector<size_t> order;
+        for (size_t i = 0; i < buffers.size(); ++i) {
+            if (buffers[i].in_slab) order.push_back(i);
+        }
+        std::stable_sort(order.begin(), order.end(), [&](const size_t a, const size_t b) {
+            return buffers[a].bytes > buffers[b].bytes;
+        });
+
+        size_t slab { 0 };
+        std::vector<size_t> placed;
+        std::vector<size_t> neighbours;
+        for (const size_t i : order) {
+            PlannedBuffer& buffer = buffers[i];
+            // the placed buffers alive at the same time, by offset: the gaps
+            // between them are free for this one
+            neighbours.clear();
+            for (const size_t p : placed) {
+                if (overlap(buffers[p], buffer)) neighbours.push_back(p);
+            }
+            std::sort(neighbours.begin(), neighbours.end(), [&](const size_t a, const size_t b) {
+                return buffers[a].offset < buffers[b].offset;
+            });
+
+            size_t best { NO_END };
+            size_t best_gap { NO_END };
+            size_t gap_start { 0 };
+            for (const size_t n : neighbours) {
+                const PlannedBuffer& other = buffers[n];
+                if (other.offset > gap_start) {
+                    const size_t gap { other.offset - gap_start };
+                    if (gap >= buffer.bytes && gap < best_gap) {
+                        best = gap_start;
+                        best_gap = gap;
+                    }
+                }
+                gap_start = std::max(gap_start, other.offset + other.bytes);
+            }
+            buffer.offset = best != NO_END ? best : gap_start;
+            slab = std::max(slab, buffer.offset + buffer.bytes);
+            placed.push_back(i);
+        }
+        return slab;
+    }
+
+    std::ostream& operator<<(
+            std::ostream& os,
+            const MemoryPlanStats& stats
+    ) {
+        return os << std::format(
+            "memory plan: {} buffers, {} in the slab, naive peak {:.1f} KiB, live peak {:.1f} KiB, planned peak {:.1f} KiB",
+            stats.buffers,
+            stats.slab_buffers,
+            static_cast<double>(stats.naive_bytes) / 1024.0,
+            static_cast<double>(stats.live_peak_bytes) / 1024.0,
+            static_cast<double>(stats.planned_bytes) / 1024.0
+        );
+    }
+
+    MemoryPlan::MemoryPlan():
+        m_buffers{},
+        m_profile{},
+        m_slab{},
+        m_stats{},
+        m_next{ 0 },
+        m_output{ false },
+        m_ready{ false },
+        m_following{ false } {}
+
+    bool MemoryPlan::ready() const {
+        return m_ready;
+    }
+
+    void MemoryPlan::begin_step() {
+        m_output = false;
+        if (!m_ready) {
+            m_profile = std::make_shared<Profile>();
+            return;
+        }
+        m_next = 0;
+        m_following = true;
+    }
+
+    void MemoryPlan::begin_output(
+            const bool output
+    ) {
+        m_output = output;
+    }
+
+    void MemoryPlan::end_step() {
+        if (m_profile) {
+            Profile& profile = *m_profile;
+            profile.open = false;
+            for (PlannedBuffer& buffer : profile.buffers) {
+                if (buffer.end == NO_END) buffer.end = profile.clock;
+            }
+            m_buffers = std::move(profile.buffers);
+            m_profile = nullptr;
+
+            m_stats = {};
+            m_stats.buffers = m_buffers.size();
+            for (const PlannedBuffer& buffer : m_buffers) {
+                if (!buffer.in_slab) continue;
+                ++m_stats.slab_buffers;
+                m_stats.naive_bytes += buffer.bytes;
+            }
+            m_stats.live_peak_bytes = live_peak(m_buffers);
+            m_stats.planned_bytes = plan_offsets(m_buffers);
+            m_slab = m_stats.planned_bytes ? mt::allocate_buffer(m_stats.planned_bytes / sizeof(float)) : nullptr;
+            m_ready = true;
+            return;
+        }
+        if (!m_following || m_next != m_buffers.size()) {
+            m_slab = nullptr;
+            m_ready = false;
+        }
+        m_following = false;
+    }
+
+    bool MemoryPlan::contains(
+            const TensorStorage& storage
+    ) const {
+        const float* data { storage.m_flat_data.get() };
+        return m_slab
+            && data >= m_slab.get()
+            && data < m_slab.get() + m_stats.planned_bytes / sizeof(float);
+    }
+
+    const MemoryPlanStats& MemoryPlan::stats() const {
+        return m_stats;
+    }
+
+    std::shared_ptr<float[]> MemoryPlan::allocate(
+            const size_t numel
+    ) {
+        if (m_profile) {
+            Profile& profile = *m_profile;
+            std::shared_ptr<float[]> buffer { mt::allocate_buffer(numel) };
+            float* data { buffer.get() };
+            profile.buffers.push_back({ numel, buffer_bytes(numel), profile.clock++, NO_END, !m_output, 0 });
+            return std::shared_ptr<float[]>(data, ProfileDeleter{ std::move(buffer), m_profile, profile.buffers.size() - 1 });
+        }
+
+        if (!m_following) return nullptr;
+        if (m_next == m_buffers.size() || m_buffers[m_next].numel != numel || m_buffers[m_next].in_slab == m_output) {
+            // not the profiled sequence: the allocator serves the rest
+            m_following = false;
+            return nullptr;
+        }
+        const PlannedBuffer& buffer = m_buffers[m_next++];
+        if (!buffer.in_slab) return nullptr;
+        // shares the slab's ownership, no allocation
+        return std::shared_ptr<float[]>(m_slab, m_slab.get() + buffer.offset / sizeof(float));
+    }
+}
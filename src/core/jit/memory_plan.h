@@ -0,0 +1,102 @@
+#ifndef JIT_MEMORY_PLAN_H
+#define JIT_MEMORY_PLAN_H
+
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "../allocator.h"
+#include "../tensor_storages.h"
+
+// Static memory plans of captured graphs. The buffers a replay allocates,
+// kernel temporaries included, are profiled once: their sizes and their
+// lifetimes on a clock that ticks at every allocation and every free. Two
+// buffers whose lifetimes do not overlap can share memory, so each gets an
+// offset in a single slab, assigned greedily by decreasing size into the
+// best-fitting gap. Later replays, which allocate the same sequence, are
+// served from the slab without calling the allocator.
+namespace mt::jit {
+
+    struct PlannedBuffer {
+        size_t numel;
+        size_t bytes;  // numel floats, rounded to BUFFER_ALIGNMENT
+        size_t start;  // clock of its allocation
+        size_t end;    // clock of its free, the end of the step if it outlives it
+        // buffers of the step's outputs outlive it, the allocator serves them
+        bool in_slab;
+        size_t offset; // in bytes from the start of the slab
+    };
+
+    // Assigns the offsets of the buffers in the slab, returns its size.
+    size_t plan_offsets(
+            std::vector<PlannedBuffer>& buffers
+    );
+
+    struct MemoryPlanStats {
+        size_t buffers;         // allocations of a step
+        size_t slab_buffers;    // those served by the slab
+        size_t naive_bytes;     // one buffer per allocation in the slab
+        size_t live_peak_bytes; // most bytes of the slab's buffers alive at once
+        size_t planned_bytes;   // size of the slab
+    };
+
+    std::ostream& operator<<(
+            std::ostream& os,
+            const MemoryPlanStats& stats
+    );
+
+    // Profiles a step, then serves the steps that follow from its slab. A
+    // step that does not allocate the profiled sequence falls back to the
+    // allocator from the first difference on and drops the plan, the next
+    // step is profiled again.
+    class MemoryPlan : public mt::BufferSource {
+    public:
+        MemoryPlan();
+
+        // Whether a plan is ready for the next step.
+        bool ready() const;
+
+        // Starts a step: profiled when no plan is ready, served from the
+        // slab otherwise. The plan must be installed (see BufferSourceGuard)
+        // for the allocations of the step.
+        void begin_step();
+
+        // Allocations that follow are for an output of the step, which are
+        // kept out of the slab.
+        void begin_output(
+                const bool output
+        );
+
+        // Ends a step, plans the slab after a profiled one.
+        void end_step();
+
+        // Whether storage's buffer is in the slab.
+        bool contains(
+                const TensorStorage& storage
+        ) const;
+
+        const MemoryPlanStats& stats() const;
+
+        std::shared_ptr<float[]> allocate(
+                const size_t numel
+        ) override;
+
+    private:
+        struct Profile;
+        struct ProfileDeleter;
+
+        std::vector<PlannedBuffer> m_buffers;
+        std::shared_ptr<Profile> m_profile;
+        std::shared_ptr<float[]> m_slab;
+        MemoryPlanStats m_stats;
+        // allocation of the step served next
+        size_t m_next;
+        bool m_output;
+        bool m_ready;
+        // false once a step diverged from the plan
+        bool m_following;
+    };
+}
+
+#endif
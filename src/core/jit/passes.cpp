@@ -0,0 +1,338 @@
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <format>
+#include <functional>
+#include <limits>
+#include <unordered_map>
+#include <utility>
+
+#include "passes.h"
+
+namespace mt::jit {
+
+    namespace {
+        constexpr size_t NONE { std::numeric_limits<size_t>::max() };
+
+        bool is_leaf(
+                const OpKind kind
+        ) {
+            return kind == OpKind::Input || kind == OpKind::Param || kind == OpKind::Constant;
+        }
+
+        // Identity replacement of every value of the graph.
+        std::vector<size_t> identity(
+                const Graph& graph
+        ) {
+            std::vector<size_t> replace(graph.m_ops.size());
+            for (size_t i = 0; i < replace.size(); ++i) replace[i] = i;
+            return replace;
+        }
+
+        // Points the inputs of op at their replacements, which come before it
+        // and are final already.
+        void replace_inputs(
+                Op& op,
+                const std::vector<size_t>& replace
+        ) {
+            for (size_t& input : op.inputs) input = replace[input];
+        }
+
+        // Keeps the ops the outputs depend on, renumbered in order, and the
+        // constants they read.
+        void prune(
+                Graph& graph
+        ) {
+            std::vector<Op>& ops = graph.m_ops;
+            std::vector<bool> live(ops.size(), false);
+            for (const size_t output : graph.m_outputs) live[output] = true;
+            for (size_t i = ops.size(); i-- > 0;) {
+                if (!live[i]) continue;
+                for (const size_t input : ops[i].inputs) live[input] = true;
+            }
+
+            std::vector<size_t> new_index(ops.size(), NONE);
+            std::vector<size_t> new_constant(graph.m_constants.size(), NONE);
+            std::vector<Op> kept;
+            std::vector<TensorStorage> constants;
+            for (size_t i = 0; i < ops.size(); ++i) {
+                if (!live[i]) continue;
+                Op op = std::move(ops[i]);
+                for (size_t& input : op.inputs) input = new_index[input];
+                if (op.kind == OpKind::Constant) {
+                    if (new_constant[op.index] == NONE) {
+                        new_constant[op.index] = constants.size();
+                        constants.push_back(std::move(graph.m_constants[op.index]));
+                    }
+                    op.index = new_constant[op.index];
+                }
+                new_index[i] = kept.size();
+                kept.push_back(std::move(op));
+            }
+            ops = std::move(kept);
+            graph.m_constants = std::move(constants);
+            for (size_t& output : graph.m_outputs) output = new_index[output];
+        }
+
+        // Reads of each value i become reads of replace[i], which is i or an
+        // earlier value, then the ops nothing reads anymore are dropped.
+        PassStats rewrite(
+                Graph& graph,
+                const char* name,
+                std::vector<size_t>& replace
+        ) {
+            size_t rewrites { 0 };
+            for (size_t i = 0; i < replace.size(); ++i) {
+                if (replace[i] == i) continue;
+                ++rewrites;
+                replace[i] = replace[replace[i]];
+            }
+            for (Op& op : graph.m_ops) replace_inputs(op, replace);
+            for (size_t& output : graph.m_outputs) output = replace[output];
+
+            const size_t ops_before { graph.m_ops.size() };
+            prune(graph);
+            return { name, rewrites, ops_before, graph.m_ops.size() };
+        }
+
+        bool same_contents(
+                const TensorStorage& a,
+                const TensorStorage& b
+        ) {
+            if (a.m_shape != b.m_shape) return false;
+            for (size_t l = 0; l < a.m_numel; ++l) {
+                if (a.get_entry_ref(l) != b.get_entry_ref(l)) return false;
+            }
+            return true;
+        }
+
+        // Whether value is a constant with every entry equal to fill.
+        bool is_filled(
+                const Graph& graph,
+                const size_t value,
+                const float fill
+        ) {
+            const Op& op = graph.m_ops[value];
+            if (op.kind != OpKind::Constant) return false;
+            const TensorStorage& constant = graph.m_constants[op.index];
+            for (size_t l = 0; l < constant.m_numel; ++l) {
+                if (constant.get_entry_ref(l) != fill) return false;
+            }
+            return true;
+        }
+
+        bool same_computation(
+                const Op& a,
+                const Op& b
+        ) {
+            return a.kind == b.kind
+                && a.kernel == b.kernel
+                && std::bit_cast<uint32_t>(a.scalar) == std::bit_cast<uint32_t>(b.scalar)
+                && a.dims == b.dims
+                && a.keepdim == b.keepdim
+                && a.activation == b.activation
+                && a.inputs == b.inputs;
+        }
+
+        size_t hash_computation(
+                const Op& op
+        ) {
+            size_t h { std::hash<size_t>{}(static_cast<size_t>(op.kind)) };
+            const auto combine = [&h](const size_t value) {
+                h ^= std::hash<size_t>{}(value) + 0x9E3779B97F4A7C15ull + (h << 6) + (h >> 2);
+            };
+            for (const size_t input : op.inputs) combine(input);
+            for (const size_t dim : op.dims) combine(dim);
+            combine(std::bit_cast<uint32_t>(op.scalar));
+            return h;
+        }
+    }
+
+    std::ostream& operator<<(
+            std::ostream& os,
+            const PassStats& stats
+    ) {
+        return os << std::format(
+            "{}: {} values rewritten, {} ops removed ({} -> {})",
+            stats.name,
+            stats.rewrites,
+            stats.ops_before - stats.ops_after,
+            stats.ops_before,
+            stats.ops_after
+        );
+    }
+
+    PassStats eliminate_dead_code(
+            Graph& graph
+    ) {
+        std::vector<size_t> replace { identity(graph) };
+        return rewrite(graph, "dead code", replace);
+    }
+
+    PassStats fold_constants(
+            Graph& graph
+    ) {
+        std::vector<Op>& ops = graph.m_ops;
+        std::vector<uint64_t> relu_mask;
+        size_t folded { 0 };
+        for (Op& op : ops) {
+            if (is_leaf(op.kind) || op.inputs.empty()) continue;
+            std::vector<const TensorStorage*> args;
+            for (const size_t input : op.inputs) {
+                if (ops[input].kind != OpKind::Constant) break;
+                args.push_back(&graph.m_constants[ops[input].index]);
+            }
+            if (args.size() != op.inputs.size()) continue;
+
+            graph.m_constants.push_back(evaluate(op, args, relu_mask));
+            op = Op{ .kind = OpKind::Constant, .shape = op.shape, .index = graph.m_constants.size() - 1 };
+            ++folded;
+        }
+
+        // the same constant built in several places (the zeros gradients
+        // start from, the ones backward is seeded with) is kept once
+        std::vector<size_t> replace { identity(graph) };
+        std::vector<size_t> distinct;
+        for (size_t i = 0; i < ops.size(); ++i) {
+            if (ops[i].kind != OpKind::Constant) continue;
+            const TensorStorage& constant = graph.m_constants[ops[i].index];
+            for (const size_t j : distinct) {
+                if (same_contents(graph.m_constants[ops[j].index], constant)) {
+                    replace[i] = j;
+                    break;
+                }
+            }
+            if (replace[i] == i) distinct.push_back(i);
+        }
+
+        PassStats stats { rewrite(graph, "constant folding", replace) };
+        stats.rewrites += folded;
+        return stats;
+    }
+
+    PassStats simplify_algebra(
+            Graph& graph
+    ) {
+        std::vector<Op>& ops = graph.m_ops;
+        std::vector<size_t> replace { identity(graph) };
+        for (size_t i = 0; i < ops.size(); ++i) {
+            Op& op = ops[i];
+            if (is_leaf(op.kind)) continue;
+            replace_inputs(op, replace);
+            // x when it is in the result's shape already (no broadcast)
+            const auto operand = [&](const size_t k) {
+                return ops[op.inputs[k]].shape == op.shape ? op.inputs[k] : NONE;
+            };
+
+            size_t x { NONE };
+            switch (op.kind) {
+                case OpKind::Add:
+                    if (is_filled(graph, op.inputs[1], 0.0f)) x = operand(0);
+                    if (x == NONE && is_filled(graph, op.inputs[0], 0.0f)) x = operand(1);
+                    break;
+                case OpKind::Sub:
+                    if (is_filled(graph, op.inputs[1], 0.0f)) x = operand(0);
+                    break;
+                case OpKind::Mult:
+                    if (is_filled(graph, op.inputs[1], 1.0f)) x = operand(0);
+                    if (x == NONE && is_filled(graph, op.inputs[0], 1.0f)) x = operand(1);
+                    break;
+                case OpKind::Div:
+                    if (is_filled(graph, op.inputs[1], 1.0f)) x = operand(0);
+                    break;
+                case OpKind::AddScalar:
+                case OpKind::SubScalar:
+                    if (op.scalar == 0.0f) x = operand(0);
+                    break;
+                case OpKind::MultScalar:
+                case OpKind::DivScalar:
+                case OpKind::PowScalar:
+                    if (op.scalar == 1.0f) x = operand(0);
+                    break;
+                case OpKind::Sum:
+                    if (op.keepdim) x = operand(0);
+                    break;
+                default:
+                    break;
+            }
+            if (x != NONE) replace[i] = x;
+        }
+        return rewrite(graph, "algebraic simplification", replace);
+    }
+
+    PassStats collapse_views(
+            Graph& graph
+    ) {
+        std::vector<Op>& ops = graph.m_ops;
+        std::vector<size_t> replace { identity(graph) };
+        for (size_t i = 0; i < ops.size(); ++i) {
+            Op& op = ops[i];
+            if (is_leaf(op.kind)) continue;
+            replace_inputs(op, replace);
+            const size_t source { op.inputs[0] };
+
+            switch (op.kind) {
+                case OpKind::Squeeze:
+                case OpKind::Unsqueeze: {
+                    // singleton dimensions only come and go, a value of the
+                    // chain with the same shape holds the same tensor
+                    for (size_t v = source;; v = ops[v].inputs[0]) {
+                        if (ops[v].shape == op.shape) replace[i] = v;
+                        if (ops[v].kind != OpKind::Squeeze && ops[v].kind != OpKind::Unsqueeze) break;
+                    }
+                    break;
+                }
+                case OpKind::Transpose: {
+                    const Op& inner = ops[source];
+                    const bool inverse = inner.kind == OpKind::Transpose
+                        && std::minmax(inner.dims[0], inner.dims[1]) == std::minmax(op.dims[0], op.dims[1]);
+                    if (op.dims[0] == op.dims[1]) replace[i] = source;
+                    else if (inverse) replace[i] = inner.inputs[0];
+                    break;
+                }
+                case OpKind::Expand:
+                case OpKind::Repeat:
+                    if (ops[source].shape == op.shape) replace[i] = source;
+                    break;
+                default:
+                    break;
+            }
+        }
+        return rewrite(graph, "view collapsing", replace);
+    }
+
+    PassStats eliminate_common_subexpressions(
+            Graph& graph
+    ) {
+        std::vector<Op>& ops = graph.m_ops;
+        std::vector<size_t> replace { identity(graph) };
+        std::unordered_map<size_t, std::vector<size_t>> seen;
+        for (size_t i = 0; i < ops.size(); ++i) {
+            Op& op = ops[i];
+            if (is_leaf(op.kind)) continue;
+            replace_inputs(op, replace);
+
+            std::vector<size_t>& bucket = seen[hash_computation(op)];
+            for (const size_t j : bucket) {
+                if (same_computation(ops[j], op)) {
+                    replace[i] = j;
+                    break;
+                }
+            }
+            if (replace[i] == i) bucket.push_back(i);
+        }
+        return rewrite(graph, "common subexpressions", replace);
+    }
+
+    std::vector<PassStats> optimize(
+            Graph& graph
+    ) {
+        std::vector<PassStats> stats;
+        stats.push_back(eliminate_dead_code(graph));
+        stats.push_back(fold_constants(graph));
+        stats.push_back(simplify_algebra(graph));
+        stats.push_back(collapse_views(graph));
+        stats.push_back(eliminate_common_subexpressions(graph));
+        return stats;
+    }
+}
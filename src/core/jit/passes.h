@@ -0,0 +1,66 @@
+#ifndef JIT_PASSES_H
+#define JIT_PASSES_H
+
+#include <cstddef>
+#include <iostream>
+#include <vector>
+
+#include "trace.h"
+
+// Optimization passes over traced graphs. A pass replaces values by
+// equivalent ones computed earlier (or by constants), then drops the ops
+// nothing depends on anymore. Values keep their order, so the graph stays
+// in a valid execution order.
+namespace mt::jit {
+
+    struct PassStats {
+        const char* name;
+        size_t rewrites;   // values replaced by an equivalent one
+        size_t ops_before;
+        size_t ops_after;
+    };
+
+    std::ostream& operator<<(
+            std::ostream& os,
+            const PassStats& stats
+    );
+
+    // Drops the ops the outputs do not depend on (e.g. the gradients of
+    // inputs), and the constants no op reads.
+    PassStats eliminate_dead_code(
+            Graph& graph
+    );
+
+    // Ops whose inputs are all constants are computed once, here, into a
+    // new constant. Constants with the same shape and contents are merged.
+    PassStats fold_constants(
+            Graph& graph
+    );
+
+    // x + 0, x - 0, x * 1, x / 1 (with a filled constant or a scalar) and
+    // x ^ 1 become x, when x already has the result's shape, and so does a
+    // keepdim sum over dimensions of size 1.
+    PassStats simplify_algebra(
+            Graph& graph
+    );
+
+    // View chains that cancel out: squeezes and unsqueezes back to the
+    // shape of the chain's source, a transpose of a transpose of the same
+    // dimensions, and views that leave the shape unchanged.
+    PassStats collapse_views(
+            Graph& graph
+    );
+
+    // Ops computing the same function of the same values are merged.
+    PassStats eliminate_common_subexpressions(
+            Graph& graph
+    );
+
+    // All the passes above, in an order where each one feeds the next:
+    // dead code, constants, algebra, views, common subexpressions.
+    std::vector<PassStats> optimize(
+            Graph& graph
+    );
+}
+
+#endif
@@ -0,0 +1,258 @@
+#include <format>
+#include <stdexcept>
+#include <utility>
+
+#include "trace.h"
+#include "../tensors.h"
+#include "../formatting.h"
+
+namespace mt::jit {
+
+    namespace {
+        thread_local Trace* t_trace { nullptr };
+
+        struct KernelKind {
+            Kernel kernel;
+            OpKind kind;
+        };
+
+        // The kernels that have an OpKind, for passes and code generation to
+        // recognize them.
+        const std::vector<KernelKind>& kernel_kinds() {
+            static const std::vector<KernelKind> kinds {
+                { BinaryKernel{ TensorStorage::s_add }, OpKind::Add },
+                { BinaryKernel{ TensorStorage::s_sub }, OpKind::Sub },
+                { BinaryKernel{ TensorStorage::s_mult }, OpKind::Mult },
+                { BinaryKernel{ TensorStorage::s_div }, OpKind::Div },
+                { BinaryKernel{ TensorStorage::s_pow }, OpKind::Pow },
+                { BinaryKernel{ TensorStorage::s_maximum }, OpKind::Maximum },
+                { BinaryKernel{ TensorStorage::s_gt }, OpKind::Gt },
+                { BinaryKernel{ TensorStorage::s_gte }, OpKind::Gte },
+                { BinaryKernel{ TensorStorage::s_lte }, OpKind::Lte },
+                { BinaryKernel{ TensorStorage::s_matmul }, OpKind::Matmul },
+                { BinaryKernel{ TensorStorage::s_cross_entropy }, OpKind::CrossEntropy },
+                { UnaryKernel{ TensorStorage::s_minus }, OpKind::Minus },
+                { UnaryKernel{ TensorStorage::s_log }, OpKind::Log },
+                { UnaryKernel{ TensorStorage::s_exp }, OpKind::Exp },
+                { ScalarKernel{ TensorStorage::s_add_scalar }, OpKind::AddScalar },
+                { ScalarKernel{ TensorStorage::s_sub_scalar }, OpKind::SubScalar },
+                { ScalarKernel{ TensorStorage::s_rsub_scalar }, OpKind::RsubScalar },
+                { ScalarKernel{ TensorStorage::s_mult_scalar }, OpKind::MultScalar },
+                { ScalarKernel{ TensorStorage::s_div_scalar }, OpKind::DivScalar },
+                { ScalarKernel{ TensorStorage::s_rdiv_scalar }, OpKind::RdivScalar },
+                { ScalarKernel{ TensorStorage::s_pow_scalar }, OpKind::PowScalar },
+                { ScalarKernel{ TensorStorage::s_rpow_scalar }, OpKind::RpowScalar },
+                { ScalarKernel{ TensorStorage::s_maximum_scalar }, OpKind::MaximumScalar },
+                { ScalarKernel{ TensorStorage::s_gt_scalar }, OpKind::GtScalar },
+            };
+            return kinds;
+        }
+
+        OpKind kind_of(
+                const Kernel& kernel
+        ) {
+            for (const KernelKind& entry : kernel_kinds()) {
+                if (entry.kernel == kernel) return entry.kind;
+            }
+            return OpKind::Kernel;
+        }
+    }
+
+    const char* op_name(
+            const OpKind kind
+    ) {
+        switch (kind) {
+            case OpKind::Input: return "Input";
+            case OpKind::Param: return "Param";
+            case OpKind::Constant: return "Constant";
+            case OpKind::Add: return "Add";
+            case OpKind::Sub: return "Sub";
+            case OpKind::Mult: return "Mult";
+            case OpKind::Div: return "Div";
+            case OpKind::Pow: return "Pow";
+            case OpKind::Maximum: return "Maximum";
+            case OpKind::Gt: return "Gt";
+            case OpKind::Gte: return "Gte";
+            case OpKind::Lte: return "Lte";
+            case OpKind::Matmul: return "Matmul";
+            case OpKind::CrossEntropy: return "CrossEntropy";
+            case OpKind::Minus: return "Minus";
+            case OpKind::Log: return "Log";
+            case OpKind::Exp: return "Exp";
+            case OpKind::AddScalar: return "AddScalar";
+            case OpKind::SubScalar: return "SubScalar";
+            case OpKind::RsubScalar: return "RsubScalar";
+            case OpKind::MultScalar: return "MultScalar";
+            case OpKind::DivScalar: return "DivScalar";
+            case OpKind::RdivScalar: return "RdivScalar";
+            case OpKind::PowScalar: return "PowScalar";
+            case OpKind::RpowScalar: return "RpowScalar";
+            case OpKind::MaximumScalar: return "MaximumScalar";
+            case OpKind::GtScalar: return "GtScalar";
+            case OpKind::Kernel: return "Kernel";
+            case OpKind::Relu: return "Relu";
+            case OpKind::Sum: return "Sum";
+            case OpKind::Softmax: return "Softmax";
+            case OpKind::LogSoftmax: return "LogSoftmax";
+            case OpKind::Unsqueeze: return "Unsqueeze";
+            case OpKind::Squeeze: return "Squeeze";
+            case OpKind::Repeat: return "Repeat";
+            case OpKind::Expand: return "Expand";
+            case OpKind::Transpose: return "Transpose";
+            case OpKind::Clone: return "Clone";
+            case OpKind::OneHot: return "OneHot";
+            case OpKind::Linear: return "Linear";
+        }
+        return "?";
+    }
+
+    std::ostream& operator<<(
+            std::ostream& os,
+            const Graph& graph
+    ) {
+        for (size_t i = 0; i < graph.m_ops.size(); ++i) {
+            const Op& op = graph.m_ops[i];
+            os << std::format("%{} = {}(", i, op_name(op.kind));
+            for (size_t k = 0; k < op.inputs.size(); ++k) {
+                os << (k ? ", %" : "%") << op.inputs[k];
+            }
+            if (std::holds_alternative<ScalarKernel>(op.kernel)) os << (op.inputs.empty() ? "" : ", ") << op.scalar;
+            if (!op.dims.empty()) os << std::format(", dims={}", op.dims);
+            os << std::format(") {}\n", op.shape);
+        }
+        os << "return";
+        for (const size_t output : graph.m_outputs) os << " %" << output;
+        return os << '\n';
+    }
+
+    TensorStorage evaluate(
+            const Op& op,
+            std::span<const TensorStorage* const> inputs,
+            std::vector<uint64_t>& relu_mask
+    ) {
+        const TensorStorage& x { *inputs[0] };
+        switch (op.kind) {
+            case OpKind::Relu: return TensorStorage::s_relu(x, relu_mask);
+            case OpKind::Sum: return TensorStorage::s_sum(x, op.dims, op.keepdim);
+            case OpKind::Softmax: return TensorStorage::s_softmax(x, op.dims[0]);
+            case OpKind::LogSoftmax: return TensorStorage::s_log_softmax(x, op.dims[0]);
+            case OpKind::Unsqueeze: return TensorStorage::s_unsqueeze(x, op.dims[0]);
+            case OpKind::Squeeze: return TensorStorage::s_squeeze(x, op.dims[0]);
+            case OpKind::Repeat: return TensorStorage::s_repeat(x, op.dims[0], op.dims[1]);
+            case OpKind::Expand: return TensorStorage::s_expand(x, op.dims[0], op.dims[1]);
+            case OpKind::Transpose: return TensorStorage::s_transpose(x, op.dims[0], op.dims[1]);
+            case OpKind::Clone: return x.clone();
+            case OpKind::OneHot: return TensorStorage::s_one_hot(x, op.dims[0]);
+            case OpKind::Linear:
+                return TensorStorage::s_linear(x, *inputs[1], inputs.size() == 3 ? inputs[2] : nullptr, op.activation);
+            default: break;
+        }
+
+        // a storage kernel
+        if (const UnaryKernel* kernel = std::get_if<UnaryKernel>(&op.kernel)) return (*kernel)(x);
+        if (const BinaryKernel* kernel = std::get_if<BinaryKernel>(&op.kernel)) return (*kernel)(x, *inputs[1]);
+        if (const ScalarKernel* kernel = std::get_if<ScalarKernel>(&op.kernel)) return (*kernel)(x, op.scalar);
+        throw std::invalid_argument(std::format("\nCannot evaluate a {} op.", op_name(op.kind)));
+    }
+
+    Trace::Trace(
+            const std::vector<Tensor>& inputs
+    ):
+        m_graph{},
+        m_values{},
+        m_seen{},
+        m_untraceable{ nullptr },
+        m_recording{ true } {
+        if (t_trace) {
+            throw std::invalid_argument(std::format("\nA trace is already being recorded on this thread."));
+        }
+        for (size_t i = 0; i < inputs.size(); ++i) {
+            m_values.emplace(inputs[i].m_node.get(), m_graph.m_ops.size());
+            m_seen.push_back(inputs[i].m_node);
+            m_graph.m_ops.push_back({ .kind = OpKind::Input, .shape = inputs[i].shape(), .index = i });
+            m_graph.m_input_shapes.push_back(inputs[i].shape());
+        }
+        t_trace = this;
+    }
+
+    Trace::~Trace() {
+        if (m_recording) t_trace = nullptr;
+    }
+
+    size_t Trace::value_of(
+            const Tensor& t
+    ) {
+        const auto it = m_values.find(t.m_node.get());
+        if (it != m_values.end()) return it->second;
+
+        Op leaf { .shape = t.shape() };
+        if (t.m_node->m_requires_grad) {
+            leaf.kind = OpKind::Param;
+            leaf.index = m_graph.m_params.size();
+            m_graph.m_params.push_back(t.m_node);
+        } else {
+            // copied, later in-place updates of the tensor do not leak in
+            leaf.kind = OpKind::Constant;
+            leaf.index = m_graph.m_constants.size();
+            m_graph.m_constants.push_back(t.m_node->m_storage.clone());
+        }
+        m_values.emplace(t.m_node.get(), m_graph.m_ops.size());
+        m_seen.push_back(t.m_node);
+        m_graph.m_ops.push_back(std::move(leaf));
+        return m_graph.m_ops.size() - 1;
+    }
+
+    void Trace::record(
+            Op op,
+            std::initializer_list<const Tensor*> inputs,
+            const Tensor& output
+    ) {
+        for (const Tensor* input : inputs) op.inputs.push_back(value_of(*input));
+        if (!std::holds_alternative<std::monostate>(op.kernel)) op.kind = kind_of(op.kernel);
+        op.shape = output.shape();
+
+        m_values.insert_or_assign(output.m_node.get(), m_graph.m_ops.size());
+        m_seen.push_back(output.m_node);
+        m_graph.m_ops.push_back(std::move(op));
+    }
+
+    void Trace::record_untraceable(
+            const char* what
+    ) {
+        if (!m_untraceable) m_untraceable = what;
+    }
+
+    const Graph& Trace::graph() const {
+        return m_graph;
+    }
+
+    Graph Trace::finish(
+            const std::vector<Tensor>& outputs
+    ) {
+        t_trace = nullptr;
+        m_recording = false;
+        if (m_untraceable) {
+            throw std::invalid_argument(std::format("\nCannot trace {}.", m_untraceable));
+        }
+        for (const Tensor& output : outputs) m_graph.m_outputs.push_back(value_of(output));
+        return std::move(m_graph);
+    }
+
+    bool is_tracing() {
+        return t_trace != nullptr;
+    }
+
+    void record(
+            Op op,
+            std::initializer_list<const Tensor*> inputs,
+            const Tensor& output
+    ) {
+        if (t_trace) t_trace->record(std::move(op), inputs, output);
+    }
+
+    void record_untraceable(
+            const char* what
+    ) {
+        if (t_trace) t_trace->record_untraceable(what);
+    }
+}
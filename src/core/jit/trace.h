@@ -0,0 +1,184 @@
+#ifndef JIT_TRACE_H
+#define JIT_TRACE_H
+
+#include <cstddef>
+#include <initializer_list>
+#include <iostream>
+#include <memory>
+#include <span>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+#include "../tensor_storages.h"
+
+class Tensor;
+class TensorNode;
+
+// Traces of tensor programs. While a trace is recorded on a thread, every
+// tensor op appends itself to it as an Op: a single static assignment of
+// its output from earlier values. Tensors the trace did not produce are
+// leaves: inputs, parameters (leaves that require grad, read live) or
+// constants (copied when first seen).
+namespace mt::jit {
+
+    enum class OpKind {
+        // leaves
+        Input,
+        Param,
+        Constant,
+        // storage kernels applied by Tensor::apply_op_ag and apply_scalar_op_ag
+        Add,
+        Sub,
+        Mult,
+        Div,
+        Pow,
+        Maximum,
+        Gt,
+        Gte,
+        Lte,
+        Matmul,
+        CrossEntropy,
+        Minus,
+        Log,
+        Exp,
+        AddScalar,
+        SubScalar,
+        RsubScalar,
+        MultScalar,
+        DivScalar,
+        RdivScalar,
+        PowScalar,
+        RpowScalar,
+        MaximumScalar,
+        GtScalar,
+        Kernel, // any other kernel, called through its pointer
+        // ops with a Tensor method of their own
+        Relu,
+        Sum,
+        Softmax,
+        LogSoftmax,
+        Unsqueeze,
+        Squeeze,
+        Repeat,
+        Expand,
+        Transpose,
+        Clone,
+        OneHot,
+        Linear
+    };
+
+    const char* op_name(
+            const OpKind kind
+    );
+
+    using UnaryKernel = TensorStorage (*)(const TensorStorage&);
+    using BinaryKernel = TensorStorage (*)(const TensorStorage&, const TensorStorage&);
+    using ScalarKernel = TensorStorage (*)(const TensorStorage&, const float);
+    using Kernel = std::variant<std::monostate, UnaryKernel, BinaryKernel, ScalarKernel>;
+
+    struct Op {
+        OpKind kind { OpKind::Kernel };
+        Kernel kernel {};
+        float scalar { 0.0f };
+        // dimension arguments in the order of the Tensor method: the dims of
+        // Sum, dim (and times) of the views, num_classes of OneHot
+        std::vector<size_t> dims {};
+        bool keepdim { false };
+        mt::kernels::Activation activation { mt::kernels::Activation::None };
+
+        // set by the trace
+        std::vector<size_t> inputs {};
+        mt::DimVector shape {};
+        size_t index { 0 }; // position of a leaf in its list of the graph
+    };
+
+    // A traced program. Values are numbered by the op that computes them,
+    // ops only read lower-numbered values.
+    struct Graph {
+        std::vector<Op> m_ops {};
+        std::vector<mt::DimVector> m_input_shapes {};
+        std::vector<std::shared_ptr<TensorNode>> m_params {};
+        std::vector<TensorStorage> m_constants {};
+        // values the graph is run for
+        std::vector<size_t> m_outputs {};
+    };
+
+    std::ostream& operator<<(
+            std::ostream& os,
+            const Graph& graph
+    );
+
+    // Computes op, which is not a leaf, from the values of its inputs with
+    // the storage functions. relu_mask is scratch for Relu.
+    TensorStorage evaluate(
+            const Op& op,
+            std::span<const TensorStorage* const> inputs,
+            std::vector<uint64_t>& relu_mask
+    );
+
+    // Records the tensor ops run on the calling thread while it is alive,
+    // starting from inputs. Traces do not nest.
+    class Trace {
+    public:
+        explicit Trace(
+                const std::vector<Tensor>& inputs
+        );
+
+        ~Trace();
+
+        Trace(const Trace&) = delete;
+        Trace& operator=(const Trace&) = delete;
+
+        // Value of t, recorded as a leaf when the trace did not produce it.
+        size_t value_of(
+                const Tensor& t
+        );
+
+        void record(
+                Op op,
+                std::initializer_list<const Tensor*> inputs,
+                const Tensor& output
+        );
+
+        void record_untraceable(
+                const char* what
+        );
+
+        // The graph recorded so far.
+        const Graph& graph() const;
+
+        // Stops recording and returns the graph, with outputs as its
+        // outputs. Throws if an untraceable op ran.
+        Graph finish(
+                const std::vector<Tensor>& outputs
+        );
+
+    private:
+        Graph m_graph;
+        std::unordered_map<const TensorNode*, size_t> m_values;
+        // every node seen, kept alive so that its address is not reused
+        std::vector<std::shared_ptr<TensorNode>> m_seen;
+        const char* m_untraceable;
+        bool m_recording;
+    };
+
+    // Whether a trace is being recorded on the calling thread.
+    bool is_tracing();
+
+    // Called by the tensor ops: appends op, computed from inputs, to the
+    // calling thread's trace. op.kind is derived from op.kernel when set.
+    void record(
+            Op op,
+            std::initializer_list<const Tensor*> inputs,
+            const Tensor& output
+    );
+
+    // Ops the trace cannot express (in-place updates, lazy expressions),
+    // the trace fails when one of them runs.
+    void record_untraceable(
+            const char* what
+    );
+}
+
+#endif
@@ -0,0 +1,123 @@
+#include <cstdlib>
+#include <cstring>
+
+#include "elementwise_impl.h"
+
+#if defined(__x86_64__)
+#include <emmintrin.h>
+#endif
+
+namespace mt::kernels {
+
+    namespace {
+        // One lane: the generic loops reduce to plain scalar code, log and pow
+        // go straight to libm.
+        struct Scalar {
+            using V = float;
+            static constexpr size_t W { 1 };
+
+            static V load(const float* p) { return *p; }
+            static void store(float* p, V x) { *p = x; }
+            static V set1(float x) { return x; }
+            static V add(V x, V y) { return x + y; }
+            static V sub(V x, V y) { return x - y; }
+            static V mul(V x, V y) { return x * y; }
+            static V div(V x, V y) { return x / y; }
+            static V max(V x, V y) { return x > y ? x : y; }
+            static V gt01(V x, V y) { return x > y ? 1.0f : 0.0f; }
+            static V ge01(V x, V y) { return x >= y ? 1.0f : 0.0f; }
+            static V le01(V x, V y) { return x <= y ? 1.0f : 0.0f; }
+        };
+
+#if defined(__x86_64__)
+        // SSE2 is part of the x86-64 baseline, so no extra compiler flags.
+        struct Sse2 {
+            using V = __m128;
+            using VI = __m128i;
+            static constexpr size_t W { 4 };
+
+            static V load(const float* p) { return _mm_loadu_ps(p); }
+            static void store(float* p, V x) { _mm_storeu_ps(p, x); }
+            static V set1(float x) { return _mm_set1_ps(x); }
+            static V add(V x, V y) { return _mm_add_ps(x, y); }
+            static V sub(V x, V y) { return _mm_sub_ps(x, y); }
+            static V mul(V x, V y) { return _mm_mul_ps(x, y); }
+            static V div(V x, V y) { return _mm_div_ps(x, y); }
+            // maxps(x, y) is x > y ? x : y, its second operand when either is NaN
+            static V max(V x, V y) { return _mm_max_ps(x, y); }
+            static V gt01(V x, V y) { return _mm_and_ps(_mm_cmpgt_ps(x, y), set1(1.0f)); }
+            static V ge01(V x, V y) { return _mm_and_ps(_mm_cmpge_ps(x, y), set1(1.0f)); }
+            static V le01(V x, V y) { return _mm_and_ps(_mm_cmple_ps(x, y), set1(1.0f)); }
+            static V lt01(V x, V y) { return _mm_and_ps(_mm_cmplt_ps(x, y), set1(1.0f)); }
+
+            static bool all_in_range(V x, float lo, float hi) {
+                const V in { _mm_and_ps(_mm_cmpge_ps(x, set1(lo)), _mm_cmple_ps(x, set1(hi))) };
+                return _mm_movemask_ps(in) == 0xF;
+            }
+            static bool all_eq(V x, V y) { return _mm_movemask_ps(_mm_cmpeq_ps(x, y)) == 0xF; }
+            // bit j set where lane j of x is > y, and lanes of x kept where bit j of bits is set
+            static unsigned gt_bits(V x, V y) { return static_cast<unsigned>(_mm_movemask_ps(_mm_cmpgt_ps(x, y))); }
+            static V select_bits(unsigned bits, V x) {
+                const VI lanes { _mm_setr_epi32(1, 2, 4, 8) };
+                const VI set { _mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(static_cast<int>(bits & 0xFu)), lanes), lanes) };
+                return _mm_and_ps(x, _mm_castsi128_ps(set));
+            }
+            static float hsum(V x) {
+                const V pairs { _mm_add_ps(x, _mm_movehl_ps(x, x)) };
+                return _mm_cvtss_f32(_mm_add_ss(pairs, _mm_shuffle_ps(pairs, pairs, 0x55)));
+            }
+
+            static VI as_int(V x) { return _mm_castps_si128(x); }
+            static V as_float(VI x) { return _mm_castsi128_ps(x); }
+            static V to_float(VI x) { return _mm_cvtepi32_ps(x); }
+            static VI round_to_int(V x) { return _mm_cvtps_epi32(x); }
+            static VI iadd(VI x, VI y) { return _mm_add_epi32(x, y); }
+            static VI isub(VI x, VI y) { return _mm_sub_epi32(x, y); }
+            static VI iand(VI x, VI y) { return _mm_and_si128(x, y); }
+            static VI ior(VI x, VI y) { return _mm_or_si128(x, y); }
+            static VI set1i(int x) { return _mm_set1_epi32(x); }
+            static VI shr23(VI x) { return _mm_srli_epi32(x, 23); }
+            static VI shl23(VI x) { return _mm_slli_epi32(x, 23); }
+        };
+#endif
+
+        int isa_rank(
+                const char* isa
+        ) {
+            if (std::strcmp(isa, "scalar") == 0) return 0;
+            if (std::strcmp(isa, "sse2") == 0) return 1;
+            if (std::strcmp(isa, "avx2") == 0) return 2;
+            return 3;
+        }
+
+        const ElementwiseKernels& select_kernels() {
+            const char* cap { std::getenv("MINITORCH_ISA") };
+            const int max_rank { cap ? isa_rank(cap) : 3 };
+
+#if defined(__x86_64__)
+            __builtin_cpu_init();
+            if (max_rank >= 3 && __builtin_cpu_supports("avx512f")) return avx512_kernels();
+            if (max_rank >= 2 && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return avx2_kernels();
+            if (max_rank >= 1) return sse2_kernels();
+#endif
+            return scalar_kernels();
+        }
+    }
+
+    const ElementwiseKernels& elementwise_kernels() {
+        static const ElementwiseKernels& kernels { select_kernels() };
+        return kernels;
+    }
+
+    const ElementwiseKernels& scalar_kernels() {
+        static const ElementwiseKernels kernels { ElementwiseImpl<Scalar>::table("scalar") };
+        return kernels;
+    }
+
+#if defined(__x86_64__)
+    const ElementwiseKernels& sse2_kernels() {
+        static const ElementwiseKernels kernels { ElementwiseImpl<Sse2>::table("sse2") };
+        return kernels;
+    }
+#endif
+}
@@ -0,0 +1,173 @@
+#ifndef ELEMENTWISE_H
+#define ELEMENTWISE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+
+namespace mt::kernels {
+
+    // out[i] = f(a[i*a_step], b[i*b_step]) for i < n. Steps are 0 (the operand is
+    // a broadcast scalar) or 1 (the operand is dense), out is always dense.
+    using BinaryKernel = void (*)(
+            const float* a,
+            const size_t a_step,
+            const float* b,
+            const size_t b_step,
+            float* out,
+            const size_t n
+    );
+
+    // out[i] = f(a[i]) for i < n, both dense.
+    using UnaryKernel = void (*)(
+            const float* a,
+            float* out,
+            const size_t n
+    );
+
+    // Folds a[0], ..., a[n-1] into one value (their sum, their max), a dense.
+    using ReduceKernel = float (*)(
+            const float* a,
+            const size_t n
+    );
+
+    // out[i] = max(a[i], 0) for i < n, both dense, and bit i of mask set
+    // where a[i] > 0. Bits are packed 64 per word, least significant first,
+    // so mask holds (n + 63) / 64 words.
+    using ReluKernel = void (*)(
+            const float* a,
+            float* out,
+            uint64_t* mask,
+            const size_t n
+    );
+
+    // out[i] = g[i] where bit i of mask is set, 0 elsewhere, both dense.
+    using MaskedKernel = void (*)(
+            const float* g,
+            const uint64_t* mask,
+            float* out,
+            const size_t n
+    );
+
+    // Table of dense element-wise kernels for one instruction set.
+    struct ElementwiseKernels {
+        const char* isa;
+
+        BinaryKernel add;
+        BinaryKernel sub;
+        BinaryKernel mult;
+        BinaryKernel div;
+        BinaryKernel pow;
+        BinaryKernel maximum;
+        BinaryKernel gt;
+        BinaryKernel gte;
+        BinaryKernel lte;
+
+        UnaryKernel minus;
+        UnaryKernel log;
+        UnaryKernel exp;
+
+        ReduceKernel sum;
+        ReduceKernel max;
+
+        ReluKernel relu;
+        MaskedKernel relu_backward;
+    };
+
+    // Kernels for the widest instruction set supported by the running CPU
+    // (AVX-512, AVX2 or SSE2, scalar elsewhere), selected once on first use.
+    // The MINITORCH_ISA environment variable ("avx512", "avx2", "sse2" or
+    // "scalar") caps the selection, which is handy to test every path.
+    const ElementwiseKernels& elementwise_kernels();
+
+    const ElementwiseKernels& scalar_kernels();
+
+    // Per-ISA tables, only defined on x86-64 builds.
+    const ElementwiseKernels& sse2_kernels();
+    const ElementwiseKernels& avx2_kernels();
+    const ElementwiseKernels& avx512_kernels();
+
+    // Element-wise operators usable with TensorStorage::s_apply_op. The call
+    // operator is the scalar definition, vec names the dense kernel that
+    // s_apply_op switches to on unit-stride runs.
+    namespace ops {
+        struct Add {
+            static constexpr BinaryKernel ElementwiseKernels::* vec { &ElementwiseKernels::add };
+            float operator()(float x, float y) const { return x + y; }
+        };
+
+        struct Sub {
+            static constexpr BinaryKernel ElementwiseKernels::* vec { &ElementwiseKernels::sub };
+            float operator()(float x, float y) const { return x - y; }
+        };
+
+        struct Mult {
+            static constexpr BinaryKernel ElementwiseKernels::* vec { &ElementwiseKernels::mult };
+            float operator()(float x, float y) const { return x * y; }
+        };
+
+        struct Div {
+            static constexpr BinaryKernel ElementwiseKernels::* vec { &ElementwiseKernels::div };
+            float operator()(float x, float y) const { return x / y; }
+        };
+
+        struct Pow {
+            static constexpr BinaryKernel ElementwiseKernels::* vec { &ElementwiseKernels::pow };
+            float operator()(float base, float exp) const { return std::pow(base, exp); }
+        };
+
+        struct Maximum {
+            static constexpr BinaryKernel ElementwiseKernels::* vec { &ElementwiseKernels::maximum };
+            float operator()(float x, float y) const { return x > y ? x : y; }
+        };
+
+        struct Gt {
+            static constexpr BinaryKernel ElementwiseKernels::* vec { &ElementwiseKernels::gt };
+            float operator()(float x, float y) const { return x > y ? 1.0f : 0.0f; }
+        };
+
+        struct Gte {
+            static constexpr BinaryKernel ElementwiseKernels::* vec { &ElementwiseKernels::gte };
+            float operator()(float x, float y) const { return x >= y ? 1.0f : 0.0f; }
+        };
+
+        struct Lte {
+            static constexpr BinaryKernel ElementwiseKernels::* vec { &ElementwiseKernels::lte };
+            float operator()(float x, float y) const { return x <= y ? 1.0f : 0.0f; }
+        };
+
+        struct Minus {
+            static constexpr UnaryKernel ElementwiseKernels::* vec { &ElementwiseKernels::minus };
+            float operator()(float x) const { return -x; }
+        };
+
+        struct Log {
+            static constexpr UnaryKernel ElementwiseKernels::* vec { &ElementwiseKernels::log };
+            float operator()(float x) const { return std::log(x); }
+        };
+
+        struct Exp {
+            static constexpr UnaryKernel ElementwiseKernels::* vec { &ElementwiseKernels::exp };
+            float operator()(float x) const { return std::exp(x); }
+        };
+
+        // op(x, value) and op(value, x) for a float operand that is never
+        // materialized: s_apply_op hands &value to Op's kernel as a stride-0
+        // operand.
+        template <typename Op>
+        struct RhsScalar {
+            static constexpr BinaryKernel ElementwiseKernels::* rhs_vec { Op::vec };
+            float value;
+            float operator()(float x) const { return Op{}(x, value); }
+        };
+
+        template <typename Op>
+        struct LhsScalar {
+            static constexpr BinaryKernel ElementwiseKernels::* lhs_vec { Op::vec };
+            float value;
+            float operator()(float x) const { return Op{}(value, x); }
+        };
+    }
+}
+
+#endif
@@ -0,0 +1,71 @@
+// Built with -mavx2 -mfma (see Makefile), only reached through
+// elementwise_kernels() after a runtime CPU check.
+
+#if defined(__x86_64__)
+
+#include <immintrin.h>
+
+#include "elementwise_impl.h"
+
+namespace mt::kernels {
+
+    namespace {
+        struct Avx2 {
+            using V = __m256;
+            using VI = __m256i;
+            static constexpr size_t W { 8 };
+
+            static V load(const float* p) { return _mm256_loadu_ps(p); }
+            static void store(float* p, V x) { _mm256_storeu_ps(p, x); }
+            static V set1(float x) { return _mm256_set1_ps(x); }
+            static V add(V x, V y) { return _mm256_add_ps(x, y); }
+            static V sub(V x, V y) { return _mm256_sub_ps(x, y); }
+            static V mul(V x, V y) { return _mm256_mul_ps(x, y); }
+            static V div(V x, V y) { return _mm256_div_ps(x, y); }
+            // vmaxps(x, y) is x > y ? x : y, its second operand when either is NaN
+            static V max(V x, V y) { return _mm256_max_ps(x, y); }
+            static V gt01(V x, V y) { return _mm256_and_ps(_mm256_cmp_ps(x, y, _CMP_GT_OQ), set1(1.0f)); }
+            static V ge01(V x, V y) { return _mm256_and_ps(_mm256_cmp_ps(x, y, _CMP_GE_OQ), set1(1.0f)); }
+            static V le01(V x, V y) { return _mm256_and_ps(_mm256_cmp_ps(x, y, _CMP_LE_OQ), set1(1.0f)); }
+            static V lt01(V x, V y) { return _mm256_and_ps(_mm256_cmp_ps(x, y, _CMP_LT_OQ), set1(1.0f)); }
+
+            static bool all_in_range(V x, float lo, float hi) {
+                const V in {
+                    _mm256_and_ps(_mm256_cmp_ps(x, set1(lo), _CMP_GE_OQ), _mm256_cmp_ps(x, set1(hi), _CMP_LE_OQ))
+                };
+                return _mm256_movemask_ps(in) == 0xFF;
+            }
+            static bool all_eq(V x, V y) { return _mm256_movemask_ps(_mm256_cmp_ps(x, y, _CMP_EQ_OQ)) == 0xFF; }
+            static unsigned gt_bits(V x, V y) { return static_cast<unsigned>(_mm256_movemask_ps(_mm256_cmp_ps(x, y, _CMP_GT_OQ))); }
+            static V select_bits(unsigned bits, V x) {
+                const VI lanes { _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128) };
+                const VI set { _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(static_cast<int>(bits & 0xFFu)), lanes), lanes) };
+                return _mm256_and_ps(x, _mm256_castsi256_ps(set));
+            }
+            static float hsum(V x) {
+                const __m128 halves { _mm_add_ps(_mm256_castps256_ps128(x), _mm256_extractf128_ps(x, 1)) };
+                const __m128 pairs { _mm_add_ps(halves, _mm_movehl_ps(halves, halves)) };
+                return _mm_cvtss_f32(_mm_add_ss(pairs, _mm_shuffle_ps(pairs, pairs, 0x55)));
+            }
+
+            static VI as_int(V x) { return _mm256_castps_si256(x); }
+            static V as_float(VI x) { return _mm256_castsi256_ps(x); }
+            static V to_float(VI x) { return _mm256_cvtepi32_ps(x); }
+            static VI round_to_int(V x) { return _mm256_cvtps_epi32(x); }
+            static VI iadd(VI x, VI y) { return _mm256_add_epi32(x, y); }
+            static VI isub(VI x, VI y) { return _mm256_sub_epi32(x, y); }
+            static VI iand(VI x, VI y) { return _mm256_and_si256(x, y); }
+            static VI ior(VI x, VI y) { return _mm256_or_si256(x, y); }
+            static VI set1i(int x) { return _mm256_set1_epi32(x); }
+            static VI shr23(VI x) { return _mm256_srli_epi32(x, 23); }
+            static VI shl23(VI x) { return _mm256_slli_epi32(x, 23); }
+        };
+    }
+
+    const ElementwiseKernels& avx2_kernels() {
+        static const ElementwiseKernels kernels { ElementwiseImpl<Avx2>::table("avx2") };
+        return kernels;
+    }
+}
+
+#endif
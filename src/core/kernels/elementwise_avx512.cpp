@@ -0,0 +1,65 @@
+// Built with -mavx512f (see Makefile), only reached through
+// elementwise_kernels() after a runtime CPU check.
+
+#if defined(__x86_64__)
+
+#include <immintrin.h>
+
+#include "elementwise_impl.h"
+
+namespace mt::kernels {
+
+    namespace {
+        struct Avx512 {
+            using V = __m512;
+            using VI = __m512i;
+            static constexpr size_t W { 16 };
+
+            static V load(const float* p) { return _mm512_loadu_ps(p); }
+            static void store(float* p, V x) { _mm512_storeu_ps(p, x); }
+            static V set1(float x) { return _mm512_set1_ps(x); }
+            static V add(V x, V y) { return _mm512_add_ps(x, y); }
+            static V sub(V x, V y) { return _mm512_sub_ps(x, y); }
+            static V mul(V x, V y) { return _mm512_mul_ps(x, y); }
+            static V div(V x, V y) { return _mm512_div_ps(x, y); }
+            // vmaxps(x, y) is x > y ? x : y, its second operand when either is NaN
+            static V max(V x, V y) { return _mm512_max_ps(x, y); }
+            static V gt01(V x, V y) { return _mm512_maskz_mov_ps(_mm512_cmp_ps_mask(x, y, _CMP_GT_OQ), set1(1.0f)); }
+            static V ge01(V x, V y) { return _mm512_maskz_mov_ps(_mm512_cmp_ps_mask(x, y, _CMP_GE_OQ), set1(1.0f)); }
+            static V le01(V x, V y) { return _mm512_maskz_mov_ps(_mm512_cmp_ps_mask(x, y, _CMP_LE_OQ), set1(1.0f)); }
+            static V lt01(V x, V y) { return _mm512_maskz_mov_ps(_mm512_cmp_ps_mask(x, y, _CMP_LT_OQ), set1(1.0f)); }
+
+            static bool all_in_range(V x, float lo, float hi) {
+                const __mmask16 in {
+                    static_cast<__mmask16>(
+                        _mm512_cmp_ps_mask(x, set1(lo), _CMP_GE_OQ) & _mm512_cmp_ps_mask(x, set1(hi), _CMP_LE_OQ)
+                    )
+                };
+                return in == 0xFFFF;
+            }
+            static bool all_eq(V x, V y) { return _mm512_cmp_ps_mask(x, y, _CMP_EQ_OQ) == 0xFFFF; }
+            static unsigned gt_bits(V x, V y) { return _mm512_cmp_ps_mask(x, y, _CMP_GT_OQ); }
+            static V select_bits(unsigned bits, V x) { return _mm512_maskz_mov_ps(static_cast<__mmask16>(bits & 0xFFFFu), x); }
+            static float hsum(V x) { return _mm512_reduce_add_ps(x); }
+
+            static VI as_int(V x) { return _mm512_castps_si512(x); }
+            static V as_float(VI x) { return _mm512_castsi512_ps(x); }
+            static V to_float(VI x) { return _mm512_cvtepi32_ps(x); }
+            static VI round_to_int(V x) { return _mm512_cvtps_epi32(x); }
+            static VI iadd(VI x, VI y) { return _mm512_add_epi32(x, y); }
+            static VI isub(VI x, VI y) { return _mm512_sub_epi32(x, y); }
+            static VI iand(VI x, VI y) { return _mm512_and_si512(x, y); }
+            static VI ior(VI x, VI y) { return _mm512_or_si512(x, y); }
+            static VI set1i(int x) { return _mm512_set1_epi32(x); }
+            static VI shr23(VI x) { return _mm512_srli_epi32(x, 23); }
+            static VI shl23(VI x) { return _mm512_slli_epi32(x, 23); }
+        };
+    }
+
+    const ElementwiseKernels& avx512_kernels() {
+        static const ElementwiseKernels kernels { ElementwiseImpl<Avx512>::table("avx512") };
+        return kernels;
+    }
+}
+
+#endif
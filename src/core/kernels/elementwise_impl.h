@@ -0,0 +1,402 @@
+#ifndef ELEMENTWISE_IMPL_H
+#define ELEMENTWISE_IMPL_H
+
+// Generic bodies of the dense element-wise kernels, written once against a
+// small vector interface (Isa) and instantiated by the translation units
+// compiled for each instruction set. Only intrinsics and compiler builtins may
+// be used here: a standard library inline function would be emitted with the
+// wider instruction set and the linker could pick that copy for the whole
+// program, which then crashes on CPUs without it.
+
+#include <cstddef>
+#include <cstdint>
+
+#include "elementwise.h"
+
+namespace mt::kernels {
+
+    template <typename Isa>
+    struct ElementwiseImpl {
+        using V = typename Isa::V;
+        static constexpr size_t W { Isa::W };
+
+        struct Add {
+            static V vec(V x, V y) { return Isa::add(x, y); }
+            static float scalar(float x, float y) { return x + y; }
+        };
+
+        struct Sub {
+            static V vec(V x, V y) { return Isa::sub(x, y); }
+            static float scalar(float x, float y) { return x - y; }
+        };
+
+        struct Mult {
+            static V vec(V x, V y) { return Isa::mul(x, y); }
+            static float scalar(float x, float y) { return x * y; }
+        };
+
+        struct Div {
+            static V vec(V x, V y) { return Isa::div(x, y); }
+            static float scalar(float x, float y) { return x / y; }
+        };
+
+        struct Maximum {
+            // max(x, y) is x > y ? x : y on every ISA: y when either is NaN
+            static V vec(V x, V y) { return Isa::max(x, y); }
+            static float scalar(float x, float y) { return x > y ? x : y; }
+        };
+
+        struct Gt {
+            static V vec(V x, V y) { return Isa::gt01(x, y); }
+            static float scalar(float x, float y) { return x > y ? 1.0f : 0.0f; }
+        };
+
+        struct Gte {
+            static V vec(V x, V y) { return Isa::ge01(x, y); }
+            static float scalar(float x, float y) { return x >= y ? 1.0f : 0.0f; }
+        };
+
+        struct Lte {
+            static V vec(V x, V y) { return Isa::le01(x, y); }
+            static float scalar(float x, float y) { return x <= y ? 1.0f : 0.0f; }
+        };
+
+        template <typename Op>
+        static void binary(
+                const float* a,
+                const size_t a_step,
+                const float* b,
+                const size_t b_step,
+                float* out,
+                const size_t n
+        ) {
+            size_t i { 0 };
+            if (a_step == 1 && b_step == 1) {
+                for (; i + W <= n; i += W) {
+                    Isa::store(out + i, Op::vec(Isa::load(a + i), Isa::load(b + i)));
+                }
+            } else if (a_step == 0 && b_step == 1) {
+                const V va { Isa::set1(*a) };
+                for (; i + W <= n; i += W) {
+                    Isa::store(out + i, Op::vec(va, Isa::load(b + i)));
+                }
+            } else if (a_step == 1 && b_step == 0) {
+                const V vb { Isa::set1(*b) };
+                for (; i + W <= n; i += W) {
+                    Isa::store(out + i, Op::vec(Isa::load(a + i), vb));
+                }
+            }
+            for (; i < n; ++i) {
+                out[i] = Op::scalar(a[i * a_step], b[i * b_step]);
+            }
+        }
+
+        static void minus(
+                const float* a,
+                float* out,
+                const size_t n
+        ) {
+            const V neg_one { Isa::set1(-1.0f) };
+            size_t i { 0 };
+            for (; i + W <= n; i += W) {
+                Isa::store(out + i, Isa::mul(Isa::load(a + i), neg_one));
+            }
+            for (; i < n; ++i) {
+                out[i] = -a[i];
+            }
+        }
+
+        // Four independent accumulators hide the add latency, lanes are only
+        // folded together at the end.
+        static float sum(
+                const float* a,
+                const size_t n
+        ) {
+            size_t i { 0 };
+            float total { 0.0f };
+            if constexpr (W > 1) {
+                V acc0 { Isa::set1(0.0f) };
+                V acc1 { acc0 };
+                V acc2 { acc0 };
+                V acc3 { acc0 };
+                for (; i + 4 * W <= n; i += 4 * W) {
+                    acc0 = Isa::add(acc0, Isa::load(a + i));
+                    acc1 = Isa::add(acc1, Isa::load(a + i + W));
+                    acc2 = Isa::add(acc2, Isa::load(a + i + 2 * W));
+                    acc3 = Isa::add(acc3, Isa::load(a + i + 3 * W));
+                }
+                for (; i + W <= n; i += W) {
+                    acc0 = Isa::add(acc0, Isa::load(a + i));
+                }
+                total = Isa::hsum(Isa::add(Isa::add(acc0, acc1), Isa::add(acc2, acc3)));
+            }
+            for (; i < n; ++i) {
+                total += a[i];
+            }
+            return total;
+        }
+
+        // Largest of a[0..n-1], -inf for n = 0.
+        static float max(
+                const float* a,
+                const size_t n
+        ) {
+            size_t i { 0 };
+            float best { -__builtin_inff() };
+            if constexpr (W > 1) {
+                if (n >= 2 * W) {
+                    V acc0 { Isa::load(a) };
+                    V acc1 { Isa::load(a + W) };
+                    for (i = 2 * W; i + 2 * W <= n; i += 2 * W) {
+                        acc0 = Isa::max(acc0, Isa::load(a + i));
+                        acc1 = Isa::max(acc1, Isa::load(a + i + W));
+                    }
+                    alignas(64) float lanes[W];
+                    Isa::store(lanes, Isa::max(acc0, acc1));
+                    for (size_t j { 0 }; j < W; ++j) best = lanes[j] > best ? lanes[j] : best;
+                }
+            }
+            for (; i < n; ++i) {
+                best = a[i] > best ? a[i] : best;
+            }
+            return best;
+        }
+
+        // Natural log for finite, normal, positive x (Cephes logf polynomial).
+        static V log_poly(V x) {
+            const auto bits { Isa::as_int(x) };
+            // split x = m * 2^e with m in [0.5, 1)
+            V e { Isa::to_float(Isa::isub(Isa::shr23(bits), Isa::set1i(126))) };
+            const V m { Isa::as_float(Isa::ior(Isa::iand(bits, Isa::set1i(0x007fffff)), Isa::set1i(0x3f000000))) };
+
+            // shift m to [sqrt(0.5), sqrt(2)) so the polynomial stays accurate
+            const V below { Isa::lt01(m, Isa::set1(0.707106781186547524f)) };
+            e = Isa::sub(e, below);
+            x = Isa::add(Isa::sub(m, Isa::set1(1.0f)), Isa::mul(below, m));
+
+            const V z { Isa::mul(x, x) };
+            V y { Isa::set1(7.0376836292e-2f) };
+            y = Isa::add(Isa::mul(y, x), Isa::set1(-1.1514610310e-1f));
+            y = Isa::add(Isa::mul(y, x), Isa::set1(1.1676998740e-1f));
+            y = Isa::add(Isa::mul(y, x), Isa::set1(-1.2420140846e-1f));
+            y = Isa::add(Isa::mul(y, x), Isa::set1(1.4249322787e-1f));
+            y = Isa::add(Isa::mul(y, x), Isa::set1(-1.6668057665e-1f));
+            y = Isa::add(Isa::mul(y, x), Isa::set1(2.0000714765e-1f));
+            y = Isa::add(Isa::mul(y, x), Isa::set1(-2.4999993993e-1f));
+            y = Isa::add(Isa::mul(y, x), Isa::set1(3.3333331174e-1f));
+            y = Isa::mul(Isa::mul(y, x), z);
+
+            y = Isa::add(y, Isa::mul(e, Isa::set1(-2.12194440e-4f)));
+            y = Isa::sub(y, Isa::mul(z, Isa::set1(0.5f)));
+            x = Isa::add(x, y);
+            return Isa::add(x, Isa::mul(e, Isa::set1(0.693359375f)));
+        }
+
+        // e^x for x in [EXP_LO, EXP_HI] (Cephes expf polynomial), the range
+        // keeps 2^n a normal float.
+        static constexpr float EXP_LO { -87.0f };
+        static constexpr float EXP_HI { 88.0f };
+
+        static V exp_poly(V x) {
+            const auto n { Isa::round_to_int(Isa::mul(x, Isa::set1(1.44269504088896341f))) };
+            const V fn { Isa::to_float(n) };
+            x = Isa::sub(x, Isa::mul(fn, Isa::set1(0.693359375f)));
+            x = Isa::sub(x, Isa::mul(fn, Isa::set1(-2.12194440e-4f)));
+
+            const V z { Isa::mul(x, x) };
+            V y { Isa::set1(1.9875691500e-4f) };
+            y = Isa::add(Isa::mul(y, x), Isa::set1(1.3981999507e-3f));
+            y = Isa::add(Isa::mul(y, x), Isa::set1(8.3334519073e-3f));
+            y = Isa::add(Isa::mul(y, x), Isa::set1(4.1665795894e-2f));
+            y = Isa::add(Isa::mul(y, x), Isa::set1(1.6666665459e-1f));
+            y = Isa::add(Isa::mul(y, x), Isa::set1(5.0000001201e-1f));
+            y = Isa::add(Isa::add(Isa::mul(y, z), x), Isa::set1(1.0f));
+
+            const V pow2n { Isa::as_float(Isa::shl23(Isa::iadd(n, Isa::set1i(127)))) };
+            return Isa::mul(y, pow2n);
+        }
+
+        static void log(
+                const float* a,
+                float* out,
+                const size_t n
+        ) {
+            size_t i { 0 };
+            if constexpr (W > 1) {
+                for (; i + W <= n; i += W) {
+                    const V x { Isa::load(a + i) };
+                    if (Isa::all_in_range(x, __FLT_MIN__, __FLT_MAX__)) {
+                        Isa::store(out + i, log_poly(x));
+                    } else {
+                        // zeros, negatives, denormals, inf and NaN keep libm semantics
+                        for (size_t j { i }; j < i + W; ++j) out[j] = __builtin_logf(a[j]);
+                    }
+                }
+            }
+            for (; i < n; ++i) {
+                out[i] = __builtin_logf(a[i]);
+            }
+        }
+
+        // e^x. Lanes below EXP_LO, where e^x is about to go denormal, flush to
+        // 0, which keeps the polynomial path for the very negative arguments
+        // of a shifted softmax. Overflow and NaN keep libm semantics.
+        static void exp(
+                const float* a,
+                float* out,
+                const size_t n
+        ) {
+            size_t i { 0 };
+            if constexpr (W > 1) {
+                const V lo { Isa::set1(EXP_LO) };
+                for (; i + W <= n; i += W) {
+                    const V x { Isa::load(a + i) };
+                    if (Isa::all_in_range(x, -__builtin_inff(), EXP_HI)) {
+                        Isa::store(out + i, Isa::mul(exp_poly(Isa::max(x, lo)), Isa::ge01(x, lo)));
+                    } else {
+                        for (size_t j { i }; j < i + W; ++j) out[j] = __builtin_expf(a[j]);
+                    }
+                }
+            }
+            for (; i < n; ++i) {
+                out[i] = __builtin_expf(a[i]);
+            }
+        }
+
+        // base^k for a small integer k by repeated squaring: exact whenever the
+        // intermediate products are, and valid for negative bases.
+        static V powi(V base, const int k) {
+            unsigned int u { static_cast<unsigned int>(k < 0 ? -k : k) };
+            V result { Isa::set1(1.0f) };
+            while (u) {
+                if (u & 1u) result = Isa::mul(result, base);
+                base = Isa::mul(base, base);
+                u >>= 1u;
+            }
+            return k < 0 ? Isa::div(Isa::set1(1.0f), result) : result;
+        }
+
+        static void pow(
+                const float* a,
+                const size_t a_step,
+                const float* b,
+                const size_t b_step,
+                float* out,
+                const size_t n
+        ) {
+            size_t i { 0 };
+            if constexpr (W > 1) {
+                for (; i + W <= n; i += W) {
+                    const V base { a_step ? Isa::load(a + i) : Isa::set1(*a) };
+                    const V exp { b_step ? Isa::load(b + i) : Isa::set1(*b) };
+
+                    // 1. all lanes share a small integral exponent
+                    const float e0 { b[i * b_step] };
+                    if (e0 >= -64.0f && e0 <= 64.0f) {
+                        const int k { static_cast<int>(e0) };
+                        if (static_cast<float>(k) == e0 && Isa::all_eq(exp, Isa::set1(e0))) {
+                            Isa::store(out + i, powi(base, k));
+                            continue;
+                        }
+                    }
+
+                    // 2. positive bases: exp(exp * log(base))
+                    if (Isa::all_in_range(base, __FLT_MIN__, __FLT_MAX__)) {
+                        const V y { Isa::mul(exp, log_poly(base)) };
+                        if (Isa::all_in_range(y, EXP_LO, EXP_HI)) {
+                            Isa::store(out + i, exp_poly(y));
+                            continue;
+                        }
+                    }
+
+                    // 3. anything else keeps libm semantics
+                    for (size_t j { i }; j < i + W; ++j) {
+                        out[j] = __builtin_powf(a[j * a_step], b[j * b_step]);
+                    }
+                }
+            }
+            for (; i < n; ++i) {
+                out[i] = __builtin_powf(a[i * a_step], b[i * b_step]);
+            }
+        }
+
+        // One mask word covers 64 elements, W divides 64 so vectors never
+        // straddle two words.
+        static constexpr size_t MASK_BITS { 64 };
+
+        static void relu(
+                const float* a,
+                float* out,
+                uint64_t* mask,
+                const size_t n
+        ) {
+            for (size_t i { 0 }; i < n; i += MASK_BITS) {
+                const size_t len { n - i < MASK_BITS ? n - i : MASK_BITS };
+                uint64_t bits { 0 };
+                size_t j { 0 };
+                if constexpr (W > 1) {
+                    const V zero { Isa::set1(0.0f) };
+                    for (; j + W <= len; j += W) {
+                        const V x { Isa::load(a + i + j) };
+                        // max(x, 0) is 0 for NaN lanes, like x > 0 ? x : 0
+                        Isa::store(out + i + j, Isa::max(x, zero));
+                        bits |= static_cast<uint64_t>(Isa::gt_bits(x, zero)) << j;
+                    }
+                }
+                for (; j < len; ++j) {
+                    const float x { a[i + j] };
+                    out[i + j] = x > 0.0f ? x : 0.0f;
+                    bits |= static_cast<uint64_t>(x > 0.0f) << j;
+                }
+                mask[i / MASK_BITS] = bits;
+            }
+        }
+
+        static void relu_backward(
+                const float* g,
+                const uint64_t* mask,
+                float* out,
+                const size_t n
+        ) {
+            for (size_t i { 0 }; i < n; i += MASK_BITS) {
+                const size_t len { n - i < MASK_BITS ? n - i : MASK_BITS };
+                const uint64_t bits { mask[i / MASK_BITS] };
+                size_t j { 0 };
+                if constexpr (W > 1) {
+                    for (; j + W <= len; j += W) {
+                        Isa::store(out + i + j, Isa::select_bits(static_cast<unsigned>(bits >> j), Isa::load(g + i + j)));
+                    }
+                }
+                for (; j < len; ++j) {
+                    out[i + j] = (bits >> j) & 1u ? g[i + j] : 0.0f;
+                }
+            }
+        }
+
+        static ElementwiseKernels table(
+                const char* isa
+        ) {
+            return ElementwiseKernels {
+                isa,
+                &binary<Add>,
+                &binary<Sub>,
+                &binary<Mult>,
+                &binary<Div>,
+                &pow,
+                &binary<Maximum>,
+                &binary<Gt>,
+                &binary<Gte>,
+                &binary<Lte>,
+                &minus,
+                &log,
+                &exp,
+                &sum,
+                &max,
+                &relu,
+                &relu_backward
+            };
+        }
+    };
+}
+
+#endif
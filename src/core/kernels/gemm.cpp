@@ -0,0 +1,235 @@
+#include <algorithm>
+#include <vector>
+
+#include "gemm.h"
+#include "src/core/parallel.h"
+
+namespace mt::kernels {
+
+    namespace {
+        // Register block: an MR x NR tile of C is kept in accumulators for the
+        // whole depth of a packed panel.
+        constexpr size_t MR { 4 };
+        constexpr size_t NR { 16 };
+
+        // Cache blocks: a KC x NR sliver of B stays in L1, an MC x KC block of
+        // A stays in L2, a KC x NC panel of B is reused across all of A.
+        constexpr size_t MC { 128 };
+        constexpr size_t KC { 256 };
+        constexpr size_t NC { 4096 };
+
+        // Multiply-adds per parallel task, below this a C block is computed
+        // on the calling thread.
+        constexpr size_t TILE_GRAIN_FLOPS { 1 << 18 };
+
+        // Packs the mc x kc block of A starting at (ic, pc) into MR-row
+        // micro-panels laid out column after column. Rows past mc are zeroed.
+        void pack_a(
+                const MatrixView a,
+                const size_t ic,
+                const size_t pc,
+                const size_t mc,
+                const size_t kc,
+                float* packed
+        ) {
+            for (size_t ir { 0 }; ir < mc; ir += MR) {
+                const size_t mr { std::min(MR, mc - ir) };
+                for (size_t p { 0 }; p < kc; ++p) {
+                    const float* src { a.data + (ic + ir) * a.row_stride + (pc + p) * a.col_stride };
+                    for (size_t i { 0 }; i < mr; ++i) {
+                        packed[i] = src[i * a.row_stride];
+                    }
+                    for (size_t i { mr }; i < MR; ++i) {
+                        packed[i] = 0.0f;
+                    }
+                    packed += MR;
+                }
+            }
+        }
+
+        // Packs the kc x nc block of B starting at (pc, jc) into NR-column
+        // micro-panels laid out row after row. Columns past nc are zeroed.
+        void pack_b(
+                const MatrixView b,
+                const size_t pc,
+                const size_t jc,
+                const size_t kc,
+                const size_t nc,
+                float* packed
+        ) {
+            for (size_t jr { 0 }; jr < nc; jr += NR) {
+                const size_t nr { std::min(NR, nc - jr) };
+                for (size_t p { 0 }; p < kc; ++p) {
+                    const float* src { b.data + (pc + p) * b.row_stride + (jc + jr) * b.col_stride };
+                    if (b.col_stride == 1) {
+                        std::copy(src, src + nr, packed);
+                    } else {
+                        for (size_t j { 0 }; j < nr; ++j) {
+                            packed[j] = src[j * b.col_stride];
+                        }
+                    }
+                    std::fill(packed + nr, packed + NR, 0.0f);
+                    packed += NR;
+                }
+            }
+        }
+
+        // Multiplies an MR x kc micro-panel of A with a kc x NR micro-panel of B
+        // and stores the valid mr x nr corner of the tile into C. epilogue is
+        // set on the last slice along k only, with bias already offset to the
+        // tile's first column.
+        void micro_kernel(
+                const size_t kc,
+                const float* a_panel,
+                const float* b_panel,
+                const MutMatrixView c,
+                const size_t mr,
+                const size_t nr,
+                const bool accumulate,
+                const Epilogue* epilogue
+        ) {
+            float acc[MR][NR] {};
+
+            for (size_t p { 0 }; p < kc; ++p) {
+                const float* a_col { a_panel + p * MR };
+                const float* b_row { b_panel + p * NR };
+                for (size_t i { 0 }; i < MR; ++i) {
+                    const float a_ip { a_col[i] };
+                    for (size_t j { 0 }; j < NR; ++j) {
+                        acc[i][j] += a_ip * b_row[j];
+                    }
+                }
+            }
+
+            if (epilogue) {
+                const bool relu { epilogue->activation == Activation::ReLU };
+                for (size_t i { 0 }; i < mr; ++i) {
+                    float* c_row { c.data + i * c.row_stride };
+                    for (size_t j { 0 }; j < nr; ++j) {
+                        float v { acc[i][j] };
+                        if (accumulate) v += c_row[j * c.col_stride];
+                        if (epilogue->bias) v += epilogue->bias[j * epilogue->bias_stride];
+                        if (relu) v = v > 0.0f ? v : 0.0f;
+                        c_row[j * c.col_stride] = v;
+                    }
+                }
+                return;
+            }
+
+            for (size_t i { 0 }; i < mr; ++i) {
+                float* c_row { c.data + i * c.row_stride };
+                if (accumulate) {
+                    for (size_t j { 0 }; j < nr; ++j) c_row[j * c.col_stride] += acc[i][j];
+                } else {
+                    for (size_t j { 0 }; j < nr; ++j) c_row[j * c.col_stride] = acc[i][j];
+                }
+            }
+        }
+
+        size_t round_up(
+                const size_t value,
+                const size_t multiple
+        ) {
+            return (value + multiple - 1) / multiple * multiple;
+        }
+    }
+
+    void gemm(
+            const size_t m,
+            const size_t n,
+            const size_t k,
+            const MatrixView a,
+            const MatrixView b,
+            const MutMatrixView c,
+            const bool accumulate,
+            const Epilogue& epilogue
+    ) {
+        const bool has_epilogue { epilogue.bias != nullptr || epilogue.activation != Activation::None };
+
+        // an empty inner dimension has no slice along k to write C: each tile
+        // goes through the micro-kernel with no products, which zeroes it
+        // (or keeps it when accumulating) and applies the epilogue
+        if (k == 0) {
+            for (size_t ir { 0 }; ir < m; ir += MR) {
+                for (size_t jr { 0 }; jr < n; jr += NR) {
+                    const MutMatrixView c_tile { c.data + ir * c.row_stride + jr * c.col_stride, c.row_stride, c.col_stride };
+                    const Epilogue tile_epilogue {
+                        epilogue.bias ? epilogue.bias + jr * epilogue.bias_stride : nullptr,
+                        epilogue.bias_stride,
+                        epilogue.activation
+                    };
+                    micro_kernel(
+                        0,
+                        nullptr,
+                        nullptr,
+                        c_tile,
+                        std::min(MR, m - ir),
+                        std::min(NR, n - jr),
+                        accumulate,
+                        has_epilogue ? &tile_epilogue : nullptr
+                    );
+                }
+            }
+            return;
+        }
+
+        std::vector<float> a_packed(round_up(std::min(m, MC), MR) * std::min(k, KC));
+        std::vector<float> b_packed(round_up(std::min(n, NC), NR) * std::min(k, KC));
+
+        for (size_t jc { 0 }; jc < n; jc += NC) {
+            const size_t nc { std::min(NC, n - jc) };
+            const size_t n_tiles { (nc + NR - 1) / NR };
+
+            for (size_t pc { 0 }; pc < k; pc += KC) {
+                const size_t kc { std::min(KC, k - pc) };
+                // only the first slice along k may overwrite C, only the last
+                // one sees complete sums and runs the epilogue
+                const bool acc_c { accumulate || pc > 0 };
+                const bool finish { has_epilogue && pc + kc == k };
+
+                pack_b(b, pc, jc, kc, nc, b_packed.data());
+
+                // enough MR x NR tiles per task to amortize scheduling
+                const size_t tile_grain { std::max<size_t>(1, TILE_GRAIN_FLOPS / (MR * NR * kc)) };
+
+                for (size_t ic { 0 }; ic < m; ic += MC) {
+                    const size_t mc { std::min(MC, m - ic) };
+                    const size_t m_tiles { (mc + MR - 1) / MR };
+
+                    pack_a(a, ic, pc, mc, kc, a_packed.data());
+
+                    // tiles of C are disjoint: walk them with ir fastest so a
+                    // task keeps reusing the same B sliver from L1
+                    parallel_for(0, m_tiles * n_tiles, tile_grain, [&](const size_t begin, const size_t end) {
+                        for (size_t t { begin }; t < end; ++t) {
+                            const size_t jr { (t / m_tiles) * NR };
+                            const size_t ir { (t % m_tiles) * MR };
+                            const size_t nr { std::min(NR, nc - jr) };
+                            const size_t mr { std::min(MR, mc - ir) };
+                            const MutMatrixView c_tile {
+                                c.data + (ic + ir) * c.row_stride + (jc + jr) * c.col_stride,
+                                c.row_stride,
+                                c.col_stride
+                            };
+                            const Epilogue tile_epilogue {
+                                epilogue.bias ? epilogue.bias + (jc + jr) * epilogue.bias_stride : nullptr,
+                                epilogue.bias_stride,
+                                epilogue.activation
+                            };
+                            micro_kernel(
+                                kc,
+                                a_packed.data() + ir * kc,
+                                b_packed.data() + jr * kc,
+                                c_tile,
+                                mr,
+                                nr,
+                                acc_c,
+                                finish ? &tile_epilogue : nullptr
+                            );
+                        }
+                    });
+                }
+            }
+        }
+    }
+}
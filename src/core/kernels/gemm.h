@@ -0,0 +1,54 @@
+#ifndef GEMM_H
+#define GEMM_H
+
+#include <cstddef>
+
+namespace mt::kernels {
+
+    // Read-only strided matrix operand: element (i, j) lives at
+    // data[i*row_stride + j*col_stride], so transposed and expanded views
+    // are passed without copies.
+    struct MatrixView {
+        const float* data;
+        size_t row_stride;
+        size_t col_stride;
+    };
+
+    // Writable strided matrix operand.
+    struct MutMatrixView {
+        float* data;
+        size_t row_stride;
+        size_t col_stride;
+    };
+
+    enum class Activation {
+        None,
+        ReLU
+    };
+
+    // Element-wise tail of a GEMM: c[i,j] = act(c[i,j] + bias[j*bias_stride]),
+    // applied once the dot product of c[i,j] is complete, to the tile still
+    // held in registers. A null bias is skipped.
+    struct Epilogue {
+        const float* bias { nullptr };
+        size_t bias_stride { 0 };
+        Activation activation { Activation::None };
+    };
+
+    // C[m,n] = A[m,k] * B[k,n], or C += A * B when accumulate is set, then
+    // the epilogue. Blocked for L2/L1 reuse: A and B are packed tile by tile
+    // into contiguous micro-panels, which are then consumed by a
+    // register-blocked micro-kernel.
+    void gemm(
+            const size_t m,
+            const size_t n,
+            const size_t k,
+            const MatrixView a,
+            const MatrixView b,
+            const MutMatrixView c,
+            const bool accumulate = false,
+            const Epilogue& epilogue = {}
+    );
+}
+
+#endif
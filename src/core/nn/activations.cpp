@@ -9,8 +9,7 @@ namespace mt::nn {
     Tensor ReLU::forward(
         const Tensor& input
     ) const {
-        Tensor zeros(input.shape(), 0.0f, false);
-        return Tensor::maximum(input, zeros); // dy/dx = 0 when x = 0
+        return input.relu(); // dy/dx = 0 when x = 0
     }
     
     Softmax::Softmax() {}
@@ -24,16 +23,20 @@ namespace mt::nn {
             return ones;
         }
 
-        const size_t dim = ndim - 1; // softmax over the last dimension
-
-        // compute exponentials using e^x via elementwise pow with base e
-        Tensor e_const(input.shape(), std::exp(1.0f), false);
-        Tensor exps = e_const.pow(input);
-
-        // sum over the target dimension and broadcast for division
-        Tensor sums = exps.sum(dim);
-        Tensor denom = sums.unsqueeze(dim).expand(dim, input.shape()[dim]);
+        return input.softmax(ndim - 1); // softmax over the last dimension
+    }
+    
+    LogSoftmax::LogSoftmax() {}
+    
+    Tensor LogSoftmax::forward(
+        const Tensor& input
+    ) const {
+        const size_t ndim = input.shape().size();
+        if (ndim == 0) {
+            Tensor zeros(input.shape(), 0.0f, false);
+            return zeros;
+        }
 
-        return exps / denom;
+        return input.log_softmax(ndim - 1);
     }
 }
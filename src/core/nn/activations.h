@@ -21,6 +21,15 @@ namespace mt::nn {
             const Tensor& input
         ) const override;
     };
+
+    class LogSoftmax : public Module, public Forward1 {
+    public:
+        LogSoftmax();
+
+        Tensor forward(
+            const Tensor& input
+        ) const override;
+    };
 }
 
 #endif
@@ -1,17 +1,64 @@
 #include "compute.h"
 #include "src/core/reproducibility.h"
 #include "src/core/formatting.h"
+#include "src/core/parallel.h"
 #include <cmath>
 #include <string>
 #include <stdexcept>
+#include <vector>
+#include <algorithm>
 
 namespace mt::nn {
-    
+
+    namespace {
+        // Elements drawn from one generator stream.
+        constexpr size_t RNG_CHUNK { 16384 };
+
+        // Fills x with samples of dist. Tensors of up to one chunk consume rng
+        // directly; larger ones draw one seed per chunk from rng and fill the
+        // chunks in parallel from independent generators, so the values only
+        // depend on the seed and never on the number of threads.
+        template <typename Dist>
+        void fill_random_inplace(
+                Tensor& x,
+                std::mt19937& rng,
+                const Dist& dist
+        ) {
+            TensorStorage& storage { x.m_node->m_storage };
+            const size_t numel { x.numel() };
+
+            if (numel <= RNG_CHUNK) {
+                Dist d { dist };
+                for (size_t i {0}; i < numel; ++i) {
+                    storage.get_entry_ref(i) = d(rng);
+                }
+                return;
+            }
+
+            std::vector<std::mt19937::result_type> seeds((numel + RNG_CHUNK - 1) / RNG_CHUNK);
+            for (auto& s : seeds) s = rng();
+
+            parallel_for(0, seeds.size(), 1, [&](const size_t begin, const size_t end) {
+                for (size_t c { begin }; c < end; ++c) {
+                    std::mt19937 chunk_rng(seeds[c]);
+                    Dist d { dist };
+                    for (size_t i { c * RNG_CHUNK }; i < std::min(numel, (c + 1) * RNG_CHUNK); ++i) {
+                        storage.get_entry_ref(i) = d(chunk_rng);
+                    }
+                }
+            });
+        }
+    }
+
+
     Linear::Linear(
         const size_t in_features,
         const size_t out_features,
-        const bool bias
-    ) {
+        const bool bias,
+        const Activation activation
+    ):
+        m_activation{ activation } {
+
         // Xavier/Glorot uniform initialization to break symmetry between units
         m_weight = Tensor({in_features, out_features}, 0.0f, true);
         m_parameters.emplace("weight", m_weight);
@@ -27,13 +74,8 @@ namespace mt::nn {
     Tensor Linear::forward(
         const Tensor& inputs
     ) const {
-        Tensor mult = Tensor::matmul(inputs, m_weight);
-        if (inputs.shape().size() == 1) {
-            return mult + m_bias;
-        }
-        else {
-            return mult + m_bias.unsqueeze(0).expand(0, inputs.shape()[0]);
-        }
+        // the bias and the activation are applied in the GEMM epilogue
+        return Tensor::linear(inputs, m_weight, m_bias, m_activation);
     }
     
     void xavier_uniform_inplace(
@@ -44,9 +86,7 @@ namespace mt::nn {
         const float limit = std::sqrt(6.0f / static_cast<float>(x.shape()[0] + x.shape()[1]));
         std::uniform_real_distribution<float> dist(-limit, limit);
         
-        for (size_t i {0}; i < x.numel(); ++i) {
-            x.m_node->m_storage.get_entry_ref(i) = dist(rng);
-        }
+        fill_random_inplace(x, rng, dist);
     }
 
     void xavier_normal_inplace(
@@ -57,9 +97,7 @@ namespace mt::nn {
         const float stddev = std::sqrt(2.0f / static_cast<float>(x.shape()[0] + x.shape()[1]));
         std::normal_distribution<float> dist(0.0f, stddev);
 
-        for (size_t i {0}; i < x.numel(); ++i) {
-            x.m_node->m_storage.get_entry_ref(i) = dist(rng);
-        }
+        fill_random_inplace(x, rng, dist);
     }
 
     float calculate_gain(
@@ -93,9 +131,7 @@ namespace mt::nn {
         const float bound = std::sqrt(3.0f) * stddev;
         std::uniform_real_distribution<float> dist(-bound, bound);
 
-        for (size_t i {0}; i < x.numel(); ++i) {
-            x.m_node->m_storage.get_entry_ref(i) = dist(rng);
-        }
+        fill_random_inplace(x, rng, dist);
     }
 
     void kaiming_normal_inplace(
@@ -118,8 +154,6 @@ namespace mt::nn {
         const float stddev = (fan > 0) ? gain / std::sqrt(static_cast<float>(fan)) : 0.0f;
         std::normal_distribution<float> dist(0.0f, stddev);
 
-        for (size_t i {0}; i < x.numel(); ++i) {
-            x.m_node->m_storage.get_entry_ref(i) = dist(rng);
-        }
+        fill_random_inplace(x, rng, dist);
     }
 }
@@ -6,15 +6,20 @@
 #include <string>
 
 namespace mt::nn {
+    using Activation = mt::kernels::Activation;
+
+    // y = activation(x·W + b), computed by a single fused op (Tensor::linear).
     class Linear : public Module, public Forward1 {
     public:
         Tensor m_weight = Tensor(nullptr);
         Tensor m_bias = Tensor(nullptr);
+        Activation m_activation;
 
         Linear(
                 const size_t in_features,
                 const size_t out_features,
-                const bool bias = true
+                const bool bias = true,
+                const Activation activation = Activation::None
         );
 
         Tensor forward(
@@ -1,6 +1,8 @@
 #include "losses.h"
 #include "activations.h"
 #include "src/core/formatting.h"
+#include "src/core/expressions.h"
+#include "src/core/grad_fns.h"
 #include <cmath>
 
 namespace mt::nn {
@@ -19,23 +21,25 @@ namespace mt::nn {
     }
     
     BCELossWithLogits::BCELossWithLogits() {}
+
+    namespace {
+        // BCE with logits stable formulation, fused in a single pass:
+        // loss = max(x, 0) - x * y + log(1 + exp(-abs(x)))
+        TensorStorage bce_with_logits(
+                const TensorStorage& inputs,
+                const TensorStorage& targets
+        ) {
+            const mt::expr::Leaf x { mt::expr::lazy(inputs) };
+            const auto exp_term { mt::expr::exp(-mt::expr::maximum(x, -x)) };
+            return mt::expr::maximum(x, 0.0f) - x * targets + mt::expr::log(exp_term + 1.0f);
+        }
+    }
     
     Tensor BCELossWithLogits::forward(
             const Tensor& inputs,
             const Tensor& targets
     ) const {
-        // BCE with logits stable formulation:
-        // loss = max(x, 0) - x * y + log(1 + exp(-abs(x)))
-        Tensor zeros(inputs.shape(), 0.0f, false);
-        Tensor max_val = Tensor::maximum(inputs, zeros);
-        Tensor abs_inputs = Tensor::maximum(inputs, -inputs);
-    
-        Tensor e_const(inputs.shape(), std::exp(1.0f), false);
-        Tensor exp_term = e_const.pow(-abs_inputs);
-        Tensor ones(inputs.shape(), 1.0f, false);
-        Tensor log_term = (exp_term + ones).log();
-    
-        Tensor loss = max_val - (inputs * targets) + log_term;
+        Tensor loss = Tensor::apply_op_ag<bce_with_logits, BackwardBCEWithLogits>(inputs, targets);
         return loss.mean(0);
     }
     
@@ -46,20 +50,23 @@ namespace mt::nn {
             const Tensor& targets
     ) const {
         const size_t ndim = inputs.shape().size();
+
+        // class indices: a single fused op, the one-hot matrix is never built
+        if (ndim > 0 && targets.shape() == TensorStorage::reduce_shape(inputs.shape(), ndim - 1)) {
+            Tensor losses = Tensor::apply_op_ag<TensorStorage::s_cross_entropy, BackwardCrossEntropy>(inputs, targets);
+            return ndim == 1 ? losses : losses.mean(0);
+        }
+
         if (ndim == 0) {
-            Tensor probs = Softmax().forward(inputs);
-            Tensor logp = probs.log();
+            Tensor logp = LogSoftmax().forward(inputs);
             Tensor loss = -(targets * logp);
             return loss.mean(0);
         }
 
         const size_t dim = ndim - 1; // softmax over last dimension
 
-        // compute probabilities via softmax
-        Tensor probs = Softmax().forward(inputs);
-
-        // log probabilities
-        Tensor log_probs = probs.log();
+        // log probabilities, straight from the logits
+        Tensor log_probs = LogSoftmax().forward(inputs);
 
         // elementwise multiply with targets (expects one-hot targets)
         Tensor mul = targets * log_probs;
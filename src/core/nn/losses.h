@@ -38,6 +38,11 @@ namespace mt::nn {
                 const Tensor& targets
         ) const override;
     };
+
+    // Targets are either class indices, shaped like inputs without the last
+    // (class) dimension, or per-class probabilities such as one-hot rows,
+    // shaped like inputs. Class indices take a fused path with a single
+    // grad fn.
     class CrossEntropyLoss : public Loss {
     public:
         CrossEntropyLoss();
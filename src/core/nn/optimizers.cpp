@@ -1,4 +1,5 @@
 #include "src/core/nn/optimizers.h"
+#include "src/core/expressions.h"
 
 Optimizer::Optimizer(
         std::map<std::string, Tensor>& parameters,
@@ -7,9 +8,13 @@ Optimizer::Optimizer(
     m_parameters{ parameters },
     m_base_lr{ base_lr } {}
 
-void Optimizer::zero_grad() {
+void Optimizer::zero_grad(const bool set_to_none) {
     for (auto& [name, tensor] : m_parameters) {
-        if (tensor.m_node->m_grad) {
+        if (set_to_none) {
+            // The next backward then takes over the buffer of each
+            // parameter's first contribution instead of adding into zeros.
+            tensor.m_node->m_grad = nullptr;
+        } else if (tensor.m_node->m_grad) {
             tensor.reset_grad();
         }
     }
@@ -18,7 +23,8 @@ void Optimizer::zero_grad() {
 void SGD::step() {
     for (auto& [name, tensor] : m_parameters) {
         if (tensor.m_node->m_grad) {
-            tensor -= tensor.grad() * m_base_lr;
+            // p = p - lr * grad in one pass, no scaled gradient in between
+            mt::expr::assign(tensor, mt::expr::lazy(tensor) - mt::expr::lazy(tensor.grad()) * m_base_lr);
         }
     }
 }
@@ -20,7 +20,10 @@ public:
 
     virtual void step() = 0;
 
-    void zero_grad();
+    // Resets the gradients of all parameters to zero. With set_to_none the
+    // gradients are dropped instead: grad() is unset until the next backward
+    // reaches a parameter, and step() skips parameters it did not reach.
+    void zero_grad(const bool set_to_none = false);
 };
 
 class SGD: public Optimizer {
@@ -0,0 +1,256 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "parallel.h"
+
+namespace mt {
+
+    namespace {
+
+        thread_local bool t_in_parallel_region { false };
+
+        // Work-stealing pool. Every thread owns a deque of index ranges: it
+        // splits the range it is working on in halves, pushes the upper half
+        // on the back of its deque and keeps going with the lower half. Idle
+        // threads steal from the front of other deques, which holds the
+        // largest ranges, so load balances itself with few steals.
+        class ThreadPool {
+        public:
+            explicit ThreadPool(
+                    const size_t num_threads
+            ):
+                m_queues{},
+                m_workers{},
+                m_pending{ 0 },
+                m_stop{ false },
+                m_sleep_mutex{},
+                m_sleep_cv{} {
+
+                // queue 0 is shared by the threads that call into the pool
+                for (size_t i { 0 }; i < num_threads; ++i) {
+                    m_queues.push_back(std::make_unique<Queue>());
+                }
+                for (size_t i { 1 }; i < num_threads; ++i) {
+                    m_workers.emplace_back([this, i]() { worker_loop(i); });
+                }
+            }
+
+            ThreadPool(const ThreadPool&) = delete;
+            ThreadPool& operator=(const ThreadPool&) = delete;
+
+            ~ThreadPool() {
+                {
+                    std::lock_guard<std::mutex> lock(m_sleep_mutex);
+                    m_stop = true;
+                }
+                m_sleep_cv.notify_all();
+                for (auto& worker : m_workers) worker.join();
+            }
+
+            size_t size() const {
+                return m_queues.size();
+            }
+
+            void run(
+                    const size_t begin,
+                    const size_t end,
+                    const size_t grain,
+                    const std::function<void(size_t, size_t)>& fn
+            ) {
+                Job job { fn, grain, end - begin };
+                execute(0, Task{ &job, begin, end });
+
+                // help with whatever is queued until the job is complete
+                while (job.remaining.load(std::memory_order_acquire) > 0) {
+                    Task task {};
+                    if (find_task(0, task)) {
+                        execute(0, task);
+                    } else {
+                        std::this_thread::yield();
+                    }
+                }
+
+                if (job.error) std::rethrow_exception(job.error);
+            }
+
+        private:
+            struct Job {
+                const std::function<void(size_t, size_t)>& fn;
+                size_t grain;
+                std::atomic<size_t> remaining;
+                std::exception_ptr error {};
+                std::mutex error_mutex {};
+            };
+
+            struct Task {
+                Job* job;
+                size_t begin;
+                size_t end;
+            };
+
+            struct Queue {
+                std::mutex mutex {};
+                std::deque<Task> tasks {};
+            };
+
+            std::vector<std::unique_ptr<Queue>> m_queues;
+            std::vector<std::thread> m_workers;
+            std::atomic<size_t> m_pending;
+            bool m_stop;
+            std::mutex m_sleep_mutex;
+            std::condition_variable m_sleep_cv;
+
+            void push(
+                    const size_t queue,
+                    const Task task
+            ) {
+                {
+                    std::lock_guard<std::mutex> lock(m_queues[queue]->mutex);
+                    m_queues[queue]->tasks.push_back(task);
+                }
+                m_pending.fetch_add(1, std::memory_order_release);
+                {
+                    // pairs with the predicate check in worker_loop, so a
+                    // worker about to sleep cannot miss this task
+                    std::lock_guard<std::mutex> lock(m_sleep_mutex);
+                }
+                m_sleep_cv.notify_one();
+            }
+
+            // Own queue first (newest, smallest range, still hot in cache),
+            // then steal the oldest range from the others.
+            bool find_task(
+                    const size_t self,
+                    Task& task
+            ) {
+                {
+                    Queue& own { *m_queues[self] };
+                    std::lock_guard<std::mutex> lock(own.mutex);
+                    if (!own.tasks.empty()) {
+                        task = own.tasks.back();
+                        own.tasks.pop_back();
+                        m_pending.fetch_sub(1, std::memory_order_relaxed);
+                        return true;
+                    }
+                }
+                for (size_t k { 1 }; k < m_queues.size(); ++k) {
+                    Queue& victim { *m_queues[(self + k) % m_queues.size()] };
+                    std::lock_guard<std::mutex> lock(victim.mutex);
+                    if (!victim.tasks.empty()) {
+                        task = victim.tasks.front();
+                        victim.tasks.pop_front();
+                        m_pending.fetch_sub(1, std::memory_order_relaxed);
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            void execute(
+                    const size_t self,
+                    Task task
+            ) {
+                Job& job { *task.job };
+
+                // split lazily: only ranges that are still unclaimed get stolen
+                while (task.end - task.begin > job.grain) {
+                    const size_t mid { task.begin + (task.end - task.begin) / 2 };
+                    push(self, Task{ &job, mid, task.end });
+                    task.end = mid;
+                }
+
+                t_in_parallel_region = true;
+                try {
+                    job.fn(task.begin, task.end);
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(job.error_mutex);
+                    if (!job.error) job.error = std::current_exception();
+                }
+                t_in_parallel_region = false;
+
+                job.remaining.fetch_sub(task.end - task.begin, std::memory_order_acq_rel);
+            }
+
+            void worker_loop(
+                    const size_t self
+            ) {
+                while (true) {
+                    Task task {};
+                    if (find_task(self, task)) {
+                        execute(self, task);
+                        continue;
+                    }
+
+                    std::unique_lock<std::mutex> lock(m_sleep_mutex);
+                    m_sleep_cv.wait(lock, [this]() {
+                        return m_stop || m_pending.load(std::memory_order_acquire) > 0;
+                    });
+                    if (m_stop) return;
+                }
+            }
+        };
+
+        size_t default_num_threads() {
+            if (const char* env { std::getenv("MINITORCH_NUM_THREADS") }) {
+                const long requested { std::strtol(env, nullptr, 10) };
+                if (requested > 0) return static_cast<size_t>(requested);
+            }
+            return std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        std::atomic<size_t>& num_threads() {
+            static std::atomic<size_t> value { default_num_threads() };
+            return value;
+        }
+
+        std::mutex s_pool_mutex;
+        std::unique_ptr<ThreadPool> s_pool;
+
+        ThreadPool& pool() {
+            std::lock_guard<std::mutex> lock(s_pool_mutex);
+            const size_t requested { num_threads().load(std::memory_order_relaxed) };
+            if (!s_pool || s_pool->size() != requested) {
+                s_pool.reset();
+                s_pool = std::make_unique<ThreadPool>(requested);
+            }
+            return *s_pool;
+        }
+    }
+
+    void set_num_threads(
+            const size_t num_threads_
+    ) {
+        num_threads().store(std::max<size_t>(1, num_threads_), std::memory_order_relaxed);
+    }
+
+    size_t get_num_threads() {
+        return num_threads().load(std::memory_order_relaxed);
+    }
+
+    bool in_parallel_region() {
+        return t_in_parallel_region;
+    }
+
+    namespace detail {
+        void parallel_for_impl(
+                const size_t begin,
+                const size_t end,
+                const size_t grain,
+                const std::function<void(size_t, size_t)>& fn
+        ) {
+            // a handful of chunks per thread is enough for stealing to balance
+            // uneven chunks, finer splits only add queue traffic
+            const size_t min_chunk { (end - begin + 8 * get_num_threads() - 1) / (8 * get_num_threads()) };
+            pool().run(begin, end, std::max({ grain, min_chunk, size_t{ 1 } }), fn);
+        }
+    }
+}
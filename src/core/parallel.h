@@ -0,0 +1,55 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <cstddef>
+#include <functional>
+
+namespace mt {
+
+    // Minimum number of elements per task for cheap element-wise work. Ranges
+    // at or below the grain run on the calling thread, so small tensors
+    // (batch-1 inference, scalars, biases) never pay for a wake-up.
+    constexpr size_t GRAIN_SIZE { 32768 };
+
+    // Size of the process-wide pool, calling thread included. Defaults to the
+    // MINITORCH_NUM_THREADS environment variable, else to the hardware
+    // concurrency. Must not be changed while a parallel_for is running.
+    void set_num_threads(
+            const size_t num_threads
+    );
+
+    size_t get_num_threads();
+
+    // True on a thread that is currently executing a parallel_for body.
+    bool in_parallel_region();
+
+    namespace detail {
+        void parallel_for_impl(
+                const size_t begin,
+                const size_t end,
+                const size_t grain,
+                const std::function<void(size_t, size_t)>& fn
+        );
+    }
+
+    // Calls fn(chunk_begin, chunk_end) over disjoint chunks covering
+    // [begin, end), each holding at least `grain` indices unless the range is
+    // smaller. Chunks are split lazily and balanced by work stealing. Nested
+    // calls run inline, the first exception thrown by fn is rethrown here.
+    template <typename Func>
+    void parallel_for(
+            const size_t begin,
+            const size_t end,
+            const size_t grain,
+            const Func& fn
+    ) {
+        if (begin >= end) return;
+        if (end - begin <= grain || get_num_threads() == 1 || in_parallel_region()) {
+            fn(begin, end);
+            return;
+        }
+        detail::parallel_for_impl(begin, end, grain, std::function<void(size_t, size_t)>(std::cref(fn)));
+    }
+}
+
+#endif
@@ -0,0 +1,243 @@
+#ifndef SMALL_VECTOR_H
+#define SMALL_VECTOR_H
+
+#include <algorithm>
+#include <cstddef>
+#include <initializer_list>
+#include <iterator>
+#include <type_traits>
+#include <vector>
+
+namespace mt {
+
+    // Vector with room for N elements inline: it only touches the heap once
+    // it grows past N. Meant for tensor metadata, so it is limited to
+    // trivially copyable elements and a subset of the std::vector interface.
+    template <typename T, size_t N>
+    class SmallVector {
+        static_assert(std::is_trivially_copyable_v<T>, "SmallVector holds trivially copyable elements only.");
+
+    public:
+        using value_type = T;
+        using size_type = size_t;
+        using difference_type = std::ptrdiff_t;
+        using reference = T&;
+        using const_reference = const T&;
+        using iterator = T*;
+        using const_iterator = const T*;
+
+        SmallVector():
+            m_inline{},
+            m_data{ m_inline },
+            m_size{ 0 },
+            m_capacity{ N } {}
+
+        explicit SmallVector(
+                const size_t count,
+                const T& value = T{}
+        ):
+            SmallVector() {
+
+            resize(count, value);
+        }
+
+        template <std::input_iterator It>
+        SmallVector(
+                It first,
+                It last
+        ):
+            SmallVector() {
+
+            if constexpr (std::forward_iterator<It>) reserve(static_cast<size_t>(std::distance(first, last)));
+            for (; first != last; ++first) push_back(*first);
+        }
+
+        SmallVector(
+                std::initializer_list<T> init
+        ):
+            SmallVector(init.begin(), init.end()) {}
+
+        SmallVector(
+                const std::vector<T>& other
+        ):
+            SmallVector(other.begin(), other.end()) {}
+
+        SmallVector(
+                const SmallVector& other
+        ):
+            SmallVector(other.begin(), other.end()) {}
+
+        SmallVector(
+                SmallVector&& other
+        ) noexcept:
+            SmallVector() {
+
+            steal(other);
+        }
+
+        SmallVector& operator=(
+                const SmallVector& other
+        ) {
+            if (this != &other) {
+                m_size = 0;
+                reserve(other.m_size);
+                std::copy(other.begin(), other.end(), m_data);
+                m_size = other.m_size;
+            }
+            return *this;
+        }
+
+        SmallVector& operator=(
+                SmallVector&& other
+        ) noexcept {
+            if (this != &other) {
+                release();
+                steal(other);
+            }
+            return *this;
+        }
+
+        ~SmallVector() {
+            release();
+        }
+
+        size_t size() const { return m_size; }
+        size_t capacity() const { return m_capacity; }
+        bool empty() const { return m_size == 0; }
+
+        T* data() { return m_data; }
+        const T* data() const { return m_data; }
+
+        iterator begin() { return m_data; }
+        iterator end() { return m_data + m_size; }
+        const_iterator begin() const { return m_data; }
+        const_iterator end() const { return m_data + m_size; }
+
+        T& operator[](const size_t i) { return m_data[i]; }
+        const T& operator[](const size_t i) const { return m_data[i]; }
+
+        T& front() { return m_data[0]; }
+        const T& front() const { return m_data[0]; }
+        T& back() { return m_data[m_size - 1]; }
+        const T& back() const { return m_data[m_size - 1]; }
+
+        void reserve(
+                const size_t capacity
+        ) {
+            if (capacity <= m_capacity) return;
+            T* grown { new T[capacity] };
+            std::copy(begin(), end(), grown);
+            if (!is_inline()) delete[] m_data;
+            m_data = grown;
+            m_capacity = capacity;
+        }
+
+        void push_back(
+                const T& value
+        ) {
+            // value may alias an element, read it before growing
+            const T copy { value };
+            if (m_size == m_capacity) reserve(2 * m_capacity);
+            m_data[m_size++] = copy;
+        }
+
+        void pop_back() {
+            --m_size;
+        }
+
+        void clear() {
+            m_size = 0;
+        }
+
+        void resize(
+                const size_t count,
+                const T& value = T{}
+        ) {
+            const T copy { value };
+            reserve(count);
+            if (count > m_size) std::fill(m_data + m_size, m_data + count, copy);
+            m_size = count;
+        }
+
+        iterator insert(
+                const_iterator pos,
+                const T& value
+        ) {
+            const size_t index { static_cast<size_t>(pos - m_data) };
+            const T copy { value };
+            if (m_size == m_capacity) reserve(2 * m_capacity);
+            std::copy_backward(m_data + index, m_data + m_size, m_data + m_size + 1);
+            m_data[index] = copy;
+            ++m_size;
+            return m_data + index;
+        }
+
+        iterator erase(
+                const_iterator pos
+        ) {
+            const size_t index { static_cast<size_t>(pos - m_data) };
+            std::copy(m_data + index + 1, m_data + m_size, m_data + index);
+            --m_size;
+            return m_data + index;
+        }
+
+        std::vector<T> to_vector() const {
+            return std::vector<T>(begin(), end());
+        }
+
+        friend bool operator==(
+                const SmallVector& a,
+                const SmallVector& b
+        ) {
+            return std::equal(a.begin(), a.end(), b.begin(), b.end());
+        }
+
+        friend bool operator==(
+                const SmallVector& a,
+                const std::vector<T>& b
+        ) {
+            return std::equal(a.begin(), a.end(), b.begin(), b.end());
+        }
+
+    private:
+        T m_inline[N];
+        T* m_data;
+        size_t m_size;
+        size_t m_capacity;
+
+        bool is_inline() const {
+            return m_data == m_inline;
+        }
+
+        void release() {
+            if (!is_inline()) delete[] m_data;
+            m_data = m_inline;
+            m_size = 0;
+            m_capacity = N;
+        }
+
+        // Takes over other's elements, this must be empty and inline.
+        void steal(
+                SmallVector& other
+        ) {
+            if (other.is_inline()) {
+                std::copy(other.begin(), other.end(), m_inline);
+            } else {
+                m_data = other.m_data;
+                m_capacity = other.m_capacity;
+                other.m_data = other.m_inline;
+                other.m_capacity = N;
+            }
+            m_size = other.m_size;
+            other.m_size = 0;
+        }
+    };
+
+    // Number of dimensions a tensor can have before its shape and strides
+    // spill to the heap.
+    constexpr size_t INLINE_DIMS { 8 };
+
+    using DimVector = SmallVector<size_t, INLINE_DIMS>;
+}
+
+#endif
@@ -0,0 +1,285 @@
+#include <atomic>
+#include <cstdlib>
+#include <string_view>
+#include <vector>
+
+#include "tape.h"
+#include "grad_fns.h"
+#include "tensors.h"
+
+namespace mt::autograd {
+
+    // Arena blocks are never returned while the tape lives, a rewind only
+    // moves the bump pointer back to the first block.
+    constexpr size_t ARENA_BLOCK_SIZE { size_t{ 64 } << 10 };
+    constexpr size_t ARENA_MAX_BLOCKS { 256 };
+
+    class TapeState {
+    public:
+        // One reference for the owning thread, one per live recorded node.
+        // The last one to go deletes the tape, so nodes may outlive the
+        // thread that recorded them.
+        std::atomic<size_t> m_refs { 1 };
+        size_t m_next_slot { 0 };
+        // false once a recorded node has an interior operand off the tape
+        bool m_complete { true };
+        // per-slot holds of the nodes awaiting their turn in a replay
+        std::vector<std::shared_ptr<TensorNode>> m_held {};
+        size_t m_replays { 0 };
+        size_t m_rewinds { 0 };
+
+        // Bumps alignment-padded memory off the current block, nullptr
+        // when all blocks are used.
+        void* allocate(
+                const size_t bytes,
+                const size_t alignment
+        ) {
+            if (bytes > ARENA_BLOCK_SIZE || alignment > alignof(std::max_align_t)) return nullptr;
+            while (true) {
+                if (m_block < m_blocks.size()) {
+                    const size_t offset { (m_offset + alignment - 1) & ~(alignment - 1) };
+                    if (offset + bytes <= ARENA_BLOCK_SIZE) {
+                        m_offset = offset + bytes;
+                        return m_blocks[m_block].get() + offset;
+                    }
+                    ++m_block;
+                    m_offset = 0;
+                    continue;
+                }
+                if (m_blocks.size() == ARENA_MAX_BLOCKS) return nullptr;
+                m_blocks.push_back(std::make_unique_for_overwrite<std::byte[]>(ARENA_BLOCK_SIZE));
+            }
+        }
+
+        bool full() const {
+            return m_block == ARENA_MAX_BLOCKS;
+        }
+
+        size_t arena_bytes() const {
+            return m_blocks.size() * ARENA_BLOCK_SIZE;
+        }
+
+        // Only valid when no recorded node is alive (m_refs == 1).
+        void rewind() {
+            m_block = 0;
+            m_offset = 0;
+            m_next_slot = 0;
+            m_complete = true;
+            ++m_rewinds;
+        }
+
+        void release() {
+            if (m_refs.fetch_sub(1, std::memory_order_acq_rel) == 1) delete this;
+        }
+
+    private:
+        std::vector<std::unique_ptr<std::byte[]>> m_blocks {};
+        size_t m_block { 0 };
+        size_t m_offset { 0 };
+    };
+
+    namespace {
+        Engine default_engine() {
+            const char* env { std::getenv("MINITORCH_AUTOGRAD") };
+            return env && std::string_view(env) == "graph" ? Engine::Graph : Engine::Tape;
+        }
+
+        std::atomic<Engine>& engine() {
+            static std::atomic<Engine> value { default_engine() };
+            return value;
+        }
+
+        // Created on first use, so threads that never record (the pool
+        // workers) have no tape.
+        struct LocalTape {
+            TapeState* m_tape { nullptr };
+
+            LocalTape() = default;
+            LocalTape(const LocalTape&) = delete;
+            LocalTape& operator=(const LocalTape&) = delete;
+
+            ~LocalTape() {
+                if (m_tape) m_tape->release();
+            }
+        };
+
+        thread_local LocalTape t_local_tape {};
+
+        TapeState& local_tape() {
+            if (!t_local_tape.m_tape) t_local_tape.m_tape = new TapeState();
+            return *t_local_tape.m_tape;
+        }
+
+        // Places the control block and the node in the arena, each
+        // allocation holds a reference on the tape.
+        template <typename T>
+        struct ArenaAllocator {
+            using value_type = T;
+
+            TapeState* m_tape;
+
+            explicit ArenaAllocator(
+                    TapeState* tape
+            ):
+                m_tape{ tape } {}
+
+            template <typename U>
+            ArenaAllocator(
+                    const ArenaAllocator<U>& other
+            ):
+                m_tape{ other.m_tape } {}
+
+            T* allocate(
+                    const size_t n
+            ) {
+                void* memory { m_tape->allocate(n * sizeof(T), alignof(T)) };
+                if (!memory) throw std::bad_alloc();
+                m_tape->m_refs.fetch_add(1, std::memory_order_relaxed);
+                return static_cast<T*>(memory);
+            }
+
+            void deallocate(
+                    T*,
+                    const size_t
+            ) noexcept {
+                m_tape->release();
+            }
+
+            template <typename U>
+            bool operator==(
+                    const ArenaAllocator<U>& other
+            ) const {
+                return m_tape == other.m_tape;
+            }
+        };
+    }
+
+    Engine get_engine() {
+        return engine().load(std::memory_order_relaxed);
+    }
+
+    void set_engine(
+            const Engine value
+    ) {
+        engine().store(value, std::memory_order_relaxed);
+    }
+
+    std::shared_ptr<TensorNode> make_node(
+            TensorStorage&& storage,
+            const bool requires_grad
+    ) {
+        if (!requires_grad || get_engine() != Engine::Tape) {
+            return std::make_shared<TensorNode>(std::move(storage), requires_grad);
+        }
+
+        TapeState& tape = local_tape();
+        // nothing recorded is alive anymore, e.g. the previous training step
+        // has been dropped
+        if (tape.m_refs.load(std::memory_order_acquire) == 1 && tape.m_next_slot > 0) tape.rewind();
+
+        if (!tape.full()) {
+            try {
+                std::shared_ptr<TensorNode> node = std::allocate_shared<TensorNode>(
+                    ArenaAllocator<TensorNode>(&tape),
+                    std::move(storage),
+                    requires_grad
+                );
+                node->m_tape = &tape;
+                node->m_tape_slot = tape.m_next_slot++;
+                return node;
+            } catch (const std::bad_alloc&) {
+                // out of blocks before the node was constructed, storage is
+                // still ours
+            }
+        }
+        // an interior node off the tape: graphs through it are not complete
+        tape.m_complete = false;
+        return std::make_shared<TensorNode>(std::move(storage), requires_grad);
+    }
+
+    void* allocate_grad_fn(
+            const TensorNode& out,
+            const size_t bytes,
+            const size_t alignment
+    ) {
+        if (!out.m_tape || out.m_tape != t_local_tape.m_tape) return nullptr;
+        return out.m_tape->allocate(bytes, alignment);
+    }
+
+    void check_operands(
+            const TensorNode& out
+    ) {
+        if (!out.m_tape) return;
+        for (const Tensor& operand : out.m_grad_fn->operands()) {
+            if (operand.m_node->m_grad_fn && operand.m_node->m_tape != out.m_tape) {
+                out.m_tape->m_complete = false;
+            }
+        }
+    }
+
+    bool can_replay(
+            const TensorNode& root
+    ) {
+        return root.m_grad_fn
+            && root.m_tape
+            && root.m_tape == t_local_tape.m_tape
+            && root.m_tape->m_complete;
+    }
+
+    void replay(
+            const std::shared_ptr<TensorNode>& root
+    ) {
+        TapeState& tape = *root->m_tape;
+        // taken out of the tape for the duration of the scan, a backward
+        // started from inside a grad fn gets holds of its own
+        std::vector<std::shared_ptr<TensorNode>> held = std::exchange(tape.m_held, {});
+        held.resize(root->m_tape_slot + 1);
+        held[root->m_tape_slot] = root;
+
+        for (size_t slot { root->m_tape_slot + 1 }; slot-- > 0;) {
+            if (!held[slot]) continue;
+            // the hold is dropped with u, a node nothing else references is
+            // freed as soon as it is done
+            const Tensor u(std::move(held[slot]));
+            TensorNode& node = *u.m_node;
+
+            if (node.m_grad && node.m_grad_fn) {
+                // interior operands are held until their own slot comes up,
+                // the first time one is reached its leftover gradient (from a
+                // retain_grad pass) is dropped before any is sent to it
+                for (const Tensor& operand : node.m_grad_fn->operands()) {
+                    if (!operand.m_node->m_grad_fn) continue;
+                    std::shared_ptr<TensorNode>& hold = held[operand.m_node->m_tape_slot];
+                    if (hold) continue;
+                    operand.m_node->m_grad = nullptr;
+                    hold = operand.m_node;
+                }
+                node.m_grad_fn->compute_operands_grad(u);
+            }
+
+            node.m_grad_fn = nullptr;
+            if (!node.m_retains_grad) {
+                node.m_grad = nullptr;
+            }
+        }
+
+        held.clear();
+        tape.m_held = std::move(held);
+        ++tape.m_replays;
+    }
+
+    void invalidate_tape() {
+        if (t_local_tape.m_tape) t_local_tape.m_tape->m_complete = false;
+    }
+
+    TapeStats tape_stats() {
+        const TapeState& tape = local_tape();
+        return {
+            tape.m_refs.load(std::memory_order_acquire) - 1,
+            tape.m_next_slot,
+            tape.m_replays,
+            tape.m_rewinds,
+            tape.arena_bytes()
+        };
+    }
+}
@@ -0,0 +1,106 @@
+#ifndef TAPE_H
+#define TAPE_H
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+
+#include "tensor_nodes.h"
+
+// Tape engine of autograd. Each thread has a tape: every op output that
+// records a grad fn takes the next slot on it, so the tape lists the forward
+// pass in creation order (a Wengert list). The node, its control block and
+// its grad fn are bump-allocated from the tape's arena.
+//
+// A plain backward from a node of the tape is then a reverse scan of the
+// slots below the root: an operand always has a lower slot than its
+// consumers, no graph walk or sort is needed. Once no recorded node is
+// alive, which in a training loop is the end of each step, the arena and
+// the slots are rewound in O(1) when the next node is recorded.
+//
+// Tensor::backward falls back to the graph engine for retain_graph and
+// create_graph, and for graphs the tape does not hold entirely (interior
+// nodes recorded by another thread, with the graph engine selected or past
+// a full arena).
+namespace mt::autograd {
+
+    enum class Engine {
+        Graph, // heap-allocated nodes, backward orders the graph
+        Tape   // see above
+    };
+
+    // Process-wide. Defaults to MINITORCH_AUTOGRAD ("graph" or "tape"), and
+    // to the tape when it is not set. Changing it does not affect graphs
+    // already recorded.
+    Engine get_engine();
+
+    void set_engine(
+            const Engine engine
+    );
+
+    // Output node of an op. When it requires grad (a grad fn follows) and
+    // the tape engine is on, it is allocated in the arena of the calling
+    // thread's tape and takes the next slot.
+    std::shared_ptr<TensorNode> make_node(
+            TensorStorage&& storage,
+            const bool requires_grad
+    );
+
+    // Arena memory for the grad fn of out, nullptr when out is not on the
+    // calling thread's tape or the arena is full.
+    void* allocate_grad_fn(
+            const TensorNode& out,
+            const size_t bytes,
+            const size_t alignment
+    );
+
+    // The tape can only replay out's graph if the interior operands of its
+    // grad fn are on the same tape.
+    void check_operands(
+            const TensorNode& out
+    );
+
+    // Creates out's grad fn, in the arena when out is on the tape.
+    template <typename GradFn_T, typename... Args>
+    void set_grad_fn(
+            TensorNode& out,
+            Args&&... args
+    ) {
+        if (void* memory = allocate_grad_fn(out, sizeof(GradFn_T), alignof(GradFn_T))) {
+            out.m_grad_fn = GradFnPtr(new (memory) GradFn_T(std::forward<Args>(args)...), GradFnDeleter{ true });
+        } else {
+            out.m_grad_fn = GradFnPtr(new GradFn_T(std::forward<Args>(args)...));
+        }
+        check_operands(out);
+    }
+
+    // Whether backward from root can run as a reverse scan of the calling
+    // thread's tape.
+    bool can_replay(
+            const TensorNode& root
+    );
+
+    // Plain backward (graph freed on the way) from root, whose gradient is
+    // already seeded, by a reverse scan of the tape.
+    void replay(
+            const std::shared_ptr<TensorNode>& root
+    );
+
+    // Interior nodes of the tape may hold gradients of an earlier pass, e.g.
+    // after a retain_graph backward: no replay until the tape is rewound.
+    void invalidate_tape();
+
+    // Counters of the calling thread's tape.
+    struct TapeStats {
+        size_t live_nodes;  // recorded nodes still alive
+        size_t recorded;    // slots taken since the last rewind
+        size_t replays;     // backward passes run as a tape scan
+        size_t rewinds;     // times the arena and the slots were reset
+        size_t arena_bytes; // bytes of arena blocks held by the tape
+    };
+
+    TapeStats tape_stats();
+}
+
+#endif
@@ -0,0 +1,143 @@
+#ifndef TENSOR_ITERATORS_H
+#define TENSOR_ITERATORS_H
+
+#include <array>
+#include <cstddef>
+#include <utility>
+
+#include "small_vector.h"
+
+// Walks N equally-shaped strided operands in lockstep.
+// Singleton dimensions are dropped and adjacent dimensions that are contiguous
+// with respect to every operand are merged, so the kernel is handed the longest
+// possible inner run together with a fixed per-operand pointer increment.
+template <size_t N>
+class StridedLoop {
+public:
+    mt::DimVector m_shape;
+    std::array<mt::DimVector, N> m_strides;
+    std::array<float*, N> m_data;
+
+    StridedLoop(
+            const mt::DimVector& shape,
+            const std::array<float*, N>& data,
+            const std::array<const mt::DimVector*, N>& strides
+    ):
+        m_shape{},
+        m_strides{},
+        m_data{ data } {
+
+        // walk from the innermost dimension outwards, growing the current run
+        // as long as every operand steps through it contiguously
+        for (size_t d { shape.size() }; d-- > 0; ) {
+            if (shape[d] == 1) continue;
+
+            if (!m_shape.empty()) {
+                bool mergeable { true };
+                for (size_t k { 0 }; k < N; ++k) {
+                    if ((*strides[k])[d] != m_strides[k].back() * m_shape.back()) {
+                        mergeable = false;
+                        break;
+                    }
+                }
+                if (mergeable) {
+                    m_shape.back() *= shape[d];
+                    continue;
+                }
+            }
+
+            m_shape.push_back(shape[d]);
+            for (size_t k { 0 }; k < N; ++k) {
+                m_strides[k].push_back((*strides[k])[d]);
+            }
+        }
+
+        // scalars and all-singleton shapes degenerate to a single element
+        if (m_shape.empty()) {
+            m_shape.push_back(1);
+            for (size_t k { 0 }; k < N; ++k) {
+                m_strides[k].push_back(0);
+            }
+        }
+
+        // dimensions were collected innermost first
+        reverse_dims();
+    }
+
+    size_t ndim() const {
+        return m_shape.size();
+    }
+
+    size_t inner_size() const {
+        return m_shape.back();
+    }
+
+    size_t outer_size() const {
+        size_t outer { 1 };
+        for (size_t d { 0 }; d + 1 < m_shape.size(); ++d) outer *= m_shape[d];
+        return outer;
+    }
+
+    std::array<size_t, N> inner_steps() const {
+        std::array<size_t, N> steps;
+        for (size_t k { 0 }; k < N; ++k) steps[k] = m_strides[k].back();
+        return steps;
+    }
+
+    // Calls kernel(ptrs, steps, len) once per inner run, for the outer runs
+    // in [outer_begin, outer_end). Only the starting coordinates are decoded
+    // with div/mod, the remaining ones are reached by pointer increments.
+    template <typename Kernel>
+    void for_each_run(
+            Kernel&& kernel,
+            const size_t outer_begin,
+            const size_t outer_end
+    ) const {
+        if (outer_begin >= outer_end) return;
+
+        const size_t outer_ndim { m_shape.size() - 1 };
+        const size_t len { inner_size() };
+        const std::array<size_t, N> steps { inner_steps() };
+
+        mt::DimVector coords(outer_ndim, 0);
+        std::array<float*, N> ptrs { m_data };
+
+        size_t rest { outer_begin };
+        for (size_t d { outer_ndim }; d-- > 0; ) {
+            coords[d] = rest % m_shape[d];
+            rest /= m_shape[d];
+            for (size_t k { 0 }; k < N; ++k) ptrs[k] += coords[d] * m_strides[k][d];
+        }
+
+        for (size_t run { outer_begin }; run < outer_end; ++run) {
+            kernel(ptrs, steps, len);
+
+            // odometer increment over the outer dimensions
+            for (size_t d { outer_ndim }; d-- > 0; ) {
+                if (++coords[d] < m_shape[d]) {
+                    for (size_t k { 0 }; k < N; ++k) ptrs[k] += m_strides[k][d];
+                    break;
+                }
+                coords[d] = 0;
+                for (size_t k { 0 }; k < N; ++k) ptrs[k] -= (m_shape[d] - 1) * m_strides[k][d];
+            }
+        }
+    }
+
+    template <typename Kernel>
+    void for_each_run(
+            Kernel&& kernel
+    ) const {
+        for_each_run(kernel, 0, outer_size());
+    }
+
+private:
+    void reverse_dims() {
+        for (size_t i { 0 }, j { m_shape.size() - 1 }; i < j; ++i, --j) {
+            std::swap(m_shape[i], m_shape[j]);
+            for (size_t k { 0 }; k < N; ++k) std::swap(m_strides[k][i], m_strides[k][j]);
+        }
+    }
+};
+
+#endif
@@ -1,17 +1,37 @@
+#include <atomic>
+
 #include "tensor_nodes.h"
 #include "grad_fns.h"
 
 #include "tensors.h"
+#include "grad_mode.h"
+
+namespace {
+    std::atomic<uint64_t> s_next_sequence_nr { 0 };
+
+    // Nodes created in inference mode never get a grad fn, so backward never
+    // orders them: they all take 0 rather than a number from the counter
+    // every thread would contend on.
+    uint64_t next_sequence_nr() {
+        if (mt::is_inference_mode()) return 0;
+        return s_next_sequence_nr.fetch_add(1, std::memory_order_relaxed);
+    }
+}
 
 TensorNode::TensorNode(
-        const std::vector<size_t> shape,
+        const mt::DimVector shape,
         const float value,
         const bool requires_grad
 ):
     m_storage{ shape, value },
     m_grad_fn{ nullptr },
     m_grad{ nullptr },
-    m_requires_grad{ requires_grad } {}
+    m_requires_grad{ requires_grad && !mt::is_inference_mode() },
+    m_retains_grad{ false },
+    m_edge_refs{ 0 },
+    m_sequence_nr{ next_sequence_nr() },
+    m_tape{ nullptr },
+    m_tape_slot{ 0 } {}
 
 TensorNode::TensorNode(
         TensorStorage&& storage,
@@ -20,4 +40,19 @@ TensorNode::TensorNode(
     m_storage{ std::move(storage) },
     m_grad_fn{ nullptr },
     m_grad{ nullptr },
-    m_requires_grad{ requires_grad } {}
+    m_requires_grad{ requires_grad && !mt::is_inference_mode() },
+    m_retains_grad{ false },
+    m_edge_refs{ 0 },
+    m_sequence_nr{ next_sequence_nr() },
+    m_tape{ nullptr },
+    m_tape_slot{ 0 } {}
+
+void GradFnDeleter::operator()(
+        GradFn* grad_fn
+) const {
+    if (m_in_arena) {
+        grad_fn->~GradFn();
+    } else {
+        delete grad_fn;
+    }
+}
@@ -1,23 +1,56 @@
 #ifndef TENSOR_NODES_H
 #define TENSOR_NODES_H
 
-#include <map>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
 
 #include "tensor_storages.h"
 
 class Tensor;
 class GradFn;
 
+namespace mt::autograd {
+    class TapeState;
+}
+
+// Deletes a grad fn, or only destroys it when it was placed in a tape arena,
+// whose memory is reclaimed when the tape resets (see tape.h).
+struct GradFnDeleter {
+    bool m_in_arena { false };
+
+    void operator()(
+            GradFn* grad_fn
+    ) const;
+};
+
+using GradFnPtr = std::unique_ptr<GradFn, GradFnDeleter>;
+
 class TensorNode : public std::enable_shared_from_this<TensorNode> {
 public:
     TensorStorage m_storage;
     
-    std::unique_ptr<GradFn> m_grad_fn { nullptr };
+    GradFnPtr m_grad_fn { nullptr };
     std::shared_ptr<Tensor> m_grad { nullptr };
     const bool m_requires_grad {true};
+    // Keep m_grad of a non-leaf node after backward (Tensor::retain_grad).
+    bool m_retains_grad {false};
+    // Grad fns that hold the node only as a graph edge and never read its
+    // storage (BackwardReLU keeps a mask instead). Once they are the only
+    // holders left, the buffer is released (see Tensor::~Tensor).
+    std::atomic<uint32_t> m_edge_refs {0};
+    // Creation order, unique and increasing across threads. An op creates
+    // its output after its operands, so the backward engine processes nodes
+    // by decreasing sequence number. 0 for nodes created in inference mode,
+    // which never have a grad fn.
+    const uint64_t m_sequence_nr;
+    // Tape the node is recorded on and its slot there, nullptr for leaves
+    // and for nodes created off the tape.
+    mt::autograd::TapeState* m_tape;
+    size_t m_tape_slot;
 
     TensorNode(
-            const std::vector<size_t> shape,
+            const mt::DimVector shape,
             const float value = 0.0f,
             const bool requires_grad = true
     );
@@ -4,55 +4,56 @@
 #include <iomanip>
 #include <stdexcept>
 #include <cmath>
+#include <algorithm>
 
 #include "tensor_storages.h"
 #include "formatting.h"
+#include "kernels/gemm.h"
 
 TensorStorage::TensorStorage(
-        const std::vector<size_t>& shape,
+        const mt::DimVector& shape,
         const float value
 ):
-    m_contiguous{ true },
-    m_offset(0) {
-
-    assert_positive_dims(shape);
+    TensorStorage(shape, Uninitialized{}) {
 
-    const size_t numel { compute_numel_from_shape(shape) };
-    
-    m_numel = numel;
-    m_shape = shape;
-    m_strides = TensorStorage::s_init_strides(m_shape);
-    
-    m_flat_data = std::make_shared<std::vector<float>>(
-        m_numel,
-        value
-    );
+    std::fill_n(m_flat_data.get(), m_numel, value);
 }
 
 TensorStorage::TensorStorage(
-        const std::vector<size_t>& shape,
+        const mt::DimVector& shape,
         const float start,
         const float end
 ):
+    TensorStorage(shape, Uninitialized{}) {
+
+    linspace_inplace(start, end);
+}
+
+TensorStorage::TensorStorage(
+        const mt::DimVector& shape,
+        Uninitialized
+):
+    m_shape{ shape },
+    m_strides{ TensorStorage::s_init_strides(shape) },
     m_contiguous{ true },
-    m_offset(0) {
+    m_numel{ 0 },
+    m_offset{ 0 },
+    m_flat_data{} {
 
     assert_positive_dims(shape);
 
-    const size_t numel { compute_numel_from_shape(shape) };
-    
-    m_numel = numel;
-    m_shape = shape;
-    m_strides = TensorStorage::s_init_strides(m_shape);
-    
-    m_flat_data = std::make_shared<std::vector<float>>();
-    m_flat_data->resize(m_numel);
-    linspace_inplace(start, end);
+    m_numel = compute_numel_from_shape(shape);
+    m_flat_data = mt::allocate_buffer(m_numel);
+}
 
+TensorStorage TensorStorage::empty(
+        const mt::DimVector& shape
+) {
+    return TensorStorage(shape, Uninitialized{});
 }
 
 TensorStorage TensorStorage::linspace(
-        const std::vector<size_t>& shape,
+        const mt::DimVector& shape,
         const float start,
         const float end
 ) {
@@ -60,7 +61,7 @@ TensorStorage TensorStorage::linspace(
 }
 
 void TensorStorage::assert_positive_dims(
-        const std::vector<size_t>& shape
+        const mt::DimVector& shape
 ) {
     for (size_t dim : shape) {
         if (dim == 0) {
@@ -70,17 +71,17 @@ void TensorStorage::assert_positive_dims(
 }
 
 size_t TensorStorage::compute_numel_from_shape(
-        const std::vector<size_t>& shape
+        const mt::DimVector& shape
 ) {
     size_t numel { 1 };
     for (size_t dim : shape) numel *= dim;
     return numel;
 }
 
-std::vector<size_t> TensorStorage::s_init_strides(
-        const std::vector<size_t>& shape
+mt::DimVector TensorStorage::s_init_strides(
+        const mt::DimVector& shape
 ) {
-    std::vector<size_t> strides(shape.size(), 0);
+    mt::DimVector strides(shape.size(), 0);
     size_t curr_stride {1};
     // very clunky loop signature to have an unsigned int check for >= 0
     for (size_t i { shape.size() }; i-- > 0; ) {
@@ -91,7 +92,7 @@ std::vector<size_t> TensorStorage::s_init_strides(
 }
 
 size_t TensorStorage::md_to_flat(
-        const std::vector<size_t>& md_index
+        const mt::DimVector& md_index
 ) const {
     if (md_index.size() != m_shape.size()) {
         throw std::invalid_argument(std::format("Index size {} does not match tensor shape size {}.", md_index.size(), m_shape.size()));
@@ -131,7 +132,7 @@ size_t TensorStorage::logical_to_flat(
     
 }
 
-std::vector<size_t> TensorStorage::logical_to_md(
+mt::DimVector TensorStorage::logical_to_md(
         const size_t l_index
 ) const {
     if (l_index >= m_numel) {
@@ -144,7 +145,7 @@ std::vector<size_t> TensorStorage::logical_to_md(
 
     size_t curr_index {l_index};
 
-    std::vector<size_t> md(m_shape.size());
+    mt::DimVector md(m_shape.size());
 
     for (size_t i = m_shape.size(); i-- > 0;) {
         md[i] = curr_index % m_shape[i];
@@ -154,24 +155,28 @@ std::vector<size_t> TensorStorage::logical_to_md(
     return md;
 }
 
+float* TensorStorage::data() const {
+    return m_flat_data.get() + m_offset;
+}
+
 float& TensorStorage::get_entry_ref(
         const size_t l_index
 ) const {
-    return (*m_flat_data)[logical_to_flat(l_index)];
+    return m_flat_data.get()[logical_to_flat(l_index)];
 }
 
 float& TensorStorage::get_entry_ref(
-        const std::vector<size_t>& md_index
+        const mt::DimVector& md_index
 ) const {
     // Scalar case
     if (m_shape.empty()) {
         throw std::invalid_argument(std::format("\nScalar tensor cannot be access by index. Got index {}", md_index));
     }
-    return (*m_flat_data)[md_to_flat(md_index)];
+    return m_flat_data.get()[md_to_flat(md_index)];
 }
 
 bool TensorStorage::is_contiguous() const {
-    const std::vector<size_t> contiguous_strides = TensorStorage::s_init_strides(m_shape);
+    const mt::DimVector contiguous_strides = TensorStorage::s_init_strides(m_shape);
     for (size_t i = 0; i < m_shape.size(); ++i) {
         if (m_shape[i] == 1) continue; // singleton dimensions do not affect contiguity
         if (m_strides[i] != contiguous_strides[i]) return false;
@@ -188,16 +193,17 @@ TensorStorage TensorStorage::fill(
 void TensorStorage::fill_inplace(
         const float value
 ) {
-    for (size_t i = 0; i < m_numel; i++) {
-        get_entry_ref(i) = value;
-    }
+    s_run_op(
+        [value]() { return value; },
+        *this
+    );
 }
 
 TensorStorage TensorStorage::linspace(
         const float start,
         const float end
 ) const {
-    TensorStorage out { m_shape };
+    TensorStorage out { empty(m_shape) };
     out.linspace_inplace(start, end);
     return out;
 }
@@ -216,16 +222,15 @@ float& TensorStorage::item() const {
     if (m_numel != 1) {
         throw std::runtime_error(std::format("Cannot call item() on a non-singleton tensor (shape {}).", m_shape));
     }
-    return (*m_flat_data)[m_offset];
+    return m_flat_data.get()[m_offset];
 }
 
 TensorStorage TensorStorage::clone() const {
-    TensorStorage out(m_shape);
-    out.m_offset = m_offset;
-    out.m_strides = m_strides;
-    *out.m_flat_data = *m_flat_data;
-    out.m_numel = m_numel;
-    return out;
+    // the copy is always contiguous, views are gathered into a fresh buffer
+    return s_apply_op(
+        [](float x) { return x; },
+        *this
+    );
 }
 
 bool TensorStorage::are_shapes_equal(
@@ -240,7 +245,7 @@ TensorStorage TensorStorage::s_mult(
         const TensorStorage& b
 ) {
     return s_apply_op(
-        [](float x, float y) { return x * y; }, 
+        mt::kernels::ops::Mult{}, 
         a, b
     );
 }
@@ -250,7 +255,7 @@ TensorStorage TensorStorage::s_div(
         const TensorStorage& b
 ) {
     return s_apply_op(
-        [](float x, float y) { return x / y; }, 
+        mt::kernels::ops::Div{}, 
         a, b
     );
 }
@@ -260,7 +265,7 @@ TensorStorage TensorStorage::s_add(
         const TensorStorage& b
 ) {
     return s_apply_op(
-        [](float x, float y) { return x + y; }, 
+        mt::kernels::ops::Add{}, 
         a, b
     );
 }
@@ -270,7 +275,7 @@ TensorStorage& TensorStorage::s_add_inplace(
         const TensorStorage& b
 ) {
     return s_apply_op_inplace(
-        [](float x, float y) { return x + y; }, 
+        mt::kernels::ops::Add{}, 
         a, b
     );
 }
@@ -279,7 +284,7 @@ TensorStorage TensorStorage::s_minus(
         const TensorStorage& a
 ) {
     return s_apply_op(
-        [](float x) { return -x; }, 
+        mt::kernels::ops::Minus{}, 
         a
     );
 }
@@ -288,7 +293,10 @@ TensorStorage TensorStorage::s_sub(
         const TensorStorage& a,
         const TensorStorage& b
 ) {
-    return TensorStorage::s_add(a, TensorStorage::s_minus(b));
+    return s_apply_op(
+        mt::kernels::ops::Sub{}, 
+        a, b
+    );
 }
 
 TensorStorage& TensorStorage::s_sub_inplace(
@@ -296,7 +304,7 @@ TensorStorage& TensorStorage::s_sub_inplace(
         const TensorStorage& b
 ) {
     return s_apply_op_inplace(
-        [](float x, float y) { return x - y; }, 
+        mt::kernels::ops::Sub{}, 
         a, b
     );
 }
@@ -306,7 +314,7 @@ TensorStorage TensorStorage::s_pow(
         const TensorStorage& exp
 ) {
     return s_apply_op(
-        [](float base_, float exp_) { return std::pow(base_, exp_); }, 
+        mt::kernels::ops::Pow{}, 
         base, exp
     );
 }
@@ -315,7 +323,16 @@ TensorStorage TensorStorage::s_log(
         const TensorStorage& arg
 ) {
     return s_apply_op(
-        [](float arg_) { return std::log(arg_); }, 
+        mt::kernels::ops::Log{}, 
+        arg
+    );
+}
+
+TensorStorage TensorStorage::s_exp(
+        const TensorStorage& arg
+) {
+    return s_apply_op(
+        mt::kernels::ops::Exp{}, 
         arg
     );
 }
@@ -325,17 +342,70 @@ TensorStorage TensorStorage::s_maximum(
         const TensorStorage& b
 ) {
     return s_apply_op(
-        [](float a, float b) { return a > b ? a : b; }, 
+        mt::kernels::ops::Maximum{}, 
         a, b
     );
 }
 
+namespace {
+    // Elements per mask word of the ReLU kernels.
+    constexpr size_t MASK_BITS { 64 };
+
+    // Runs a dense mask kernel over n elements in parallel, in whole mask
+    // words so that no two tasks write the same word.
+    template <typename Kernel>
+    void for_each_mask_word(
+            const size_t n,
+            const Kernel& kernel
+    ) {
+        const size_t words { (n + MASK_BITS - 1) / MASK_BITS };
+        mt::parallel_for(0, words, std::max<size_t>(1, mt::GRAIN_SIZE / MASK_BITS), [&](const size_t begin, const size_t end) {
+            kernel(begin, begin * MASK_BITS, std::min(end * MASK_BITS, n) - begin * MASK_BITS);
+        });
+    }
+}
+
+TensorStorage TensorStorage::s_relu(
+        const TensorStorage& a,
+        std::vector<uint64_t>& mask
+) {
+    // the kernel reads a dense input, views are gathered first
+    const TensorStorage in { a.is_contiguous() ? a : a.clone() };
+    TensorStorage out{ empty(a.m_shape) };
+    mask.assign((a.m_numel + MASK_BITS - 1) / MASK_BITS, 0);
+
+    const mt::kernels::ElementwiseKernels& kernels { mt::kernels::elementwise_kernels() };
+    for_each_mask_word(a.m_numel, [&](const size_t word, const size_t first, const size_t len) {
+        kernels.relu(in.data() + first, out.data() + first, mask.data() + word, len);
+    });
+    return out;
+}
+
+TensorStorage TensorStorage::s_relu_backward(
+        const TensorStorage& grad,
+        const std::vector<uint64_t>& mask
+) {
+    if (mask.size() != (grad.m_numel + MASK_BITS - 1) / MASK_BITS) {
+        throw std::invalid_argument(
+            std::format("ReLU mask of {} words does not cover a gradient of shape {}.", mask.size(), grad.m_shape)
+        );
+    }
+    const TensorStorage g { grad.is_contiguous() ? grad : grad.clone() };
+    TensorStorage out{ empty(grad.m_shape) };
+
+    const mt::kernels::ElementwiseKernels& kernels { mt::kernels::elementwise_kernels() };
+    for_each_mask_word(grad.m_numel, [&](const size_t word, const size_t first, const size_t len) {
+        kernels.relu_backward(g.data() + first, mask.data() + word, out.data() + first, len);
+    });
+    return out;
+}
+
 TensorStorage TensorStorage::s_gt(
         const TensorStorage& a,
         const TensorStorage& b
 ) {
     return s_apply_op(
-        [](float a, float b) { return a > b ? 1.0f : 0.0f; }, 
+        mt::kernels::ops::Gt{}, 
         a, b
     );
 }
@@ -345,7 +415,7 @@ TensorStorage TensorStorage::s_gte(
         const TensorStorage& b
 ) {
     return s_apply_op(
-        [](float a, float b) { return a >= b ? 1.0f : 0.0f; }, 
+        mt::kernels::ops::Gte{}, 
         a, b
     );
 }
@@ -355,90 +425,614 @@ TensorStorage TensorStorage::s_lte(
         const TensorStorage& b
 ) {
     return s_apply_op(
-        [](float a, float b) { return a <= b ? 1.0f : 0.0f; }, 
+        mt::kernels::ops::Lte{}, 
         a, b
     );
 }
 
- std::vector<size_t> TensorStorage::reduce_shape(
-        const std::vector<size_t>& shape,
+TensorStorage TensorStorage::s_add_scalar(
+        const TensorStorage& a,
+        const float b
+) {
+    return s_apply_op(
+        mt::kernels::ops::RhsScalar<mt::kernels::ops::Add>{ b },
+        a
+    );
+}
+
+TensorStorage TensorStorage::s_sub_scalar(
+        const TensorStorage& a,
+        const float b
+) {
+    return s_apply_op(
+        mt::kernels::ops::RhsScalar<mt::kernels::ops::Sub>{ b },
+        a
+    );
+}
+
+TensorStorage TensorStorage::s_rsub_scalar(
+        const TensorStorage& a,
+        const float b
+) {
+    return s_apply_op(
+        mt::kernels::ops::LhsScalar<mt::kernels::ops::Sub>{ b },
+        a
+    );
+}
+
+TensorStorage TensorStorage::s_mult_scalar(
+        const TensorStorage& a,
+        const float b
+) {
+    return s_apply_op(
+        mt::kernels::ops::RhsScalar<mt::kernels::ops::Mult>{ b },
+        a
+    );
+}
+
+TensorStorage TensorStorage::s_div_scalar(
+        const TensorStorage& a,
+        const float b
+) {
+    return s_apply_op(
+        mt::kernels::ops::RhsScalar<mt::kernels::ops::Div>{ b },
+        a
+    );
+}
+
+TensorStorage TensorStorage::s_rdiv_scalar(
+        const TensorStorage& a,
+        const float b
+) {
+    return s_apply_op(
+        mt::kernels::ops::LhsScalar<mt::kernels::ops::Div>{ b },
+        a
+    );
+}
+
+TensorStorage TensorStorage::s_pow_scalar(
+        const TensorStorage& a,
+        const float b
+) {
+    return s_apply_op(
+        mt::kernels::ops::RhsScalar<mt::kernels::ops::Pow>{ b },
+        a
+    );
+}
+
+TensorStorage TensorStorage::s_rpow_scalar(
+        const TensorStorage& a,
+        const float b
+) {
+    return s_apply_op(
+        mt::kernels::ops::LhsScalar<mt::kernels::ops::Pow>{ b },
+        a
+    );
+}
+
+TensorStorage TensorStorage::s_maximum_scalar(
+        const TensorStorage& a,
+        const float b
+) {
+    return s_apply_op(
+        mt::kernels::ops::RhsScalar<mt::kernels::ops::Maximum>{ b },
+        a
+    );
+}
+
+TensorStorage TensorStorage::s_gt_scalar(
+        const TensorStorage& a,
+        const float b
+) {
+    return s_apply_op(
+        mt::kernels::ops::RhsScalar<mt::kernels::ops::Gt>{ b },
+        a
+    );
+}
+
+mt::DimVector TensorStorage::broadcast_shape(
+        const mt::DimVector& a,
+        const mt::DimVector& b
+) {
+    const mt::DimVector& longer = a.size() >= b.size() ? a : b;
+    const mt::DimVector& shorter = a.size() >= b.size() ? b : a;
+    const size_t lead = longer.size() - shorter.size();
+
+    mt::DimVector out_shape = longer;
+    for (size_t i = 0; i < shorter.size(); ++i) {
+        const size_t x = longer[lead + i];
+        const size_t y = shorter[i];
+        if (x != y && x != 1 && y != 1) {
+            throw std::invalid_argument(
+                std::format("Shapes {} and {} cannot be broadcast together.", a, b)
+            );
+        }
+        out_shape[lead + i] = x == 1 ? y : x;
+    }
+
+    return out_shape;
+}
+
+mt::DimVector TensorStorage::broadcast_strides(
+        const TensorStorage& a,
+        const mt::DimVector& shape
+) {
+    if (a.m_shape == shape) return a.m_strides;
+
+    if (a.m_shape.size() > shape.size()) {
+        throw std::invalid_argument(
+            std::format("Shape {} cannot be broadcast to {}.", a.m_shape, shape)
+        );
+    }
+
+    const size_t lead = shape.size() - a.m_shape.size();
+    mt::DimVector strides(shape.size(), 0);
+    for (size_t i = 0; i < a.m_shape.size(); ++i) {
+        if (a.m_shape[i] == shape[lead + i]) {
+            strides[lead + i] = a.m_strides[i];
+        } else if (a.m_shape[i] != 1) {
+            throw std::invalid_argument(
+                std::format("Shape {} cannot be broadcast to {}.", a.m_shape, shape)
+            );
+        }
+    }
+
+    return strides;
+}
+
+ mt::DimVector TensorStorage::reduce_shape(
+        const mt::DimVector& shape,
         const size_t dim
 ) {
-    std::vector<size_t> out_shape = shape;
+    mt::DimVector out_shape = shape;
     
     out_shape.erase(
         out_shape.begin() +
-        static_cast<std::vector<size_t>::difference_type>(dim)
+        static_cast<mt::DimVector::difference_type>(dim)
     );
 
     return out_shape;
 }
 
-std::vector<size_t> TensorStorage::unsqueeze_shape(
-        const std::vector<size_t>& shape,
+mt::DimVector TensorStorage::unsqueeze_shape(
+        const mt::DimVector& shape,
         const size_t dim
 ) {
-    std::vector<size_t> out_shape = shape;
+    mt::DimVector out_shape = shape;
 
     out_shape.insert(
-        out_shape.begin() + static_cast<std::vector<size_t>::difference_type>(dim),
+        out_shape.begin() + static_cast<mt::DimVector::difference_type>(dim),
          1
     ); // inserts 1 at index 'dim'
 
     return out_shape;
 }
 
-void TensorStorage::populate_in_md_for_accum(
-        std::vector<size_t>& in_md,
-        const std::vector<size_t>& out_md,
-        const size_t dim
+namespace {
+    // Adds one run of the input into the output. A zero output step means the
+    // run lies along reduced dimensions (horizontal sum into one slot), a unit
+    // step on both sides is a row accumulated into a row of partial sums.
+    void accumulate_sum_run(
+            float* out,
+            const size_t out_step,
+            const float* in,
+            const size_t in_step,
+            const size_t len
+    ) {
+        const mt::kernels::ElementwiseKernels& kernels { mt::kernels::elementwise_kernels() };
+        if (out_step == 0) {
+            float acc { 0.0f };
+            if (in_step == 1) {
+                acc = kernels.sum(in, len);
+            } else {
+                for (size_t j = 0; j < len; ++j) acc += in[j * in_step];
+            }
+            *out += acc;
+        } else if (out_step == 1 && in_step == 1) {
+            kernels.add(out, 1, in, 1, out, len);
+        } else {
+            for (size_t j = 0; j < len; ++j) out[j * out_step] += in[j * in_step];
+        }
+    }
+}
+
+std::pair<std::vector<size_t>, std::vector<size_t>> TensorStorage::sum_to_dims(
+        const mt::DimVector& from,
+        const mt::DimVector& to
 ) {
-    // copy output coords into input coords (skip reduced dim)
-    for (size_t i = 0, j = 0; i < in_md.size(); ++i) {
-        if (i == dim) continue;
-        in_md[i] = out_md[j++];
+    if (to.size() > from.size() || broadcast_shape(from, to) != from) {
+        throw std::invalid_argument(
+            std::format("Shape {} cannot be summed to {}.", from, to)
+        );
+    }
+
+    // leading dimensions are dropped, expanded singletons are kept
+    const size_t lead = from.size() - to.size();
+    std::vector<size_t> lead_dims;
+    for (size_t d = 0; d < lead; ++d) lead_dims.push_back(d);
+    std::vector<size_t> singleton_dims;
+    for (size_t d = 0; d < to.size(); ++d) {
+        if (to[d] == 1 && from[lead + d] != 1) singleton_dims.push_back(d);
     }
+    return { std::move(lead_dims), std::move(singleton_dims) };
+}
+
+TensorStorage TensorStorage::s_sum_to(
+        const TensorStorage& a,
+        const mt::DimVector& shape
+) {
+    if (a.m_shape == shape) return a;
+    const auto [lead_dims, singleton_dims] = sum_to_dims(a.m_shape, shape);
+    TensorStorage out = lead_dims.empty() ? a : s_sum(a, lead_dims);
+    if (!singleton_dims.empty()) out = s_sum(out, singleton_dims, true);
+    return out;
 }
 
 TensorStorage TensorStorage::s_sum(
         const TensorStorage& a,
-        const size_t dim
+        const size_t dim,
+        const bool keepdim
 ) {
-    if (dim >= a.m_shape.size()) {
-        throw std::invalid_argument(
-            std::format("Reduction dimension {} out of range for shape {}.",
-            dim, a.m_shape
-            )
-        );
+    return s_sum(a, std::vector<size_t>{ dim }, keepdim);
+}
+
+TensorStorage TensorStorage::s_sum(
+        const TensorStorage& a,
+        const std::vector<size_t>& dims,
+        const bool keepdim
+) {
+    std::vector<bool> reduced(a.m_shape.size(), false);
+    for (const size_t dim : dims) {
+        if (dim >= a.m_shape.size()) {
+            throw std::invalid_argument(
+                std::format("Reduction dimension {} out of range for shape {}.",
+                dim, a.m_shape
+                )
+            );
+        }
+        if (reduced[dim]) {
+            throw std::invalid_argument(
+                std::format("Reduction dimension {} appears more than once in {}.",
+                dim, dims
+                )
+            );
+        }
+        reduced[dim] = true;
     }
 
-    // build output shape
-    const std::vector<size_t> out_shape = reduce_shape(a.m_shape, dim);
-    TensorStorage out{ out_shape };
+    // build output shape, with and without the reduced singletons
+    mt::DimVector kept_shape = a.m_shape;
+    mt::DimVector out_shape;
+    for (size_t d = 0; d < a.m_shape.size(); ++d) {
+        if (reduced[d]) {
+            kept_shape[d] = 1;
+        } else {
+            out_shape.push_back(a.m_shape[d]);
+        }
+    }
+    TensorStorage out{ keepdim ? kept_shape : out_shape, 0.0f };
+    // an empty input sums to zeros, and has no elements to split the work by
+    if (a.m_numel == 0) return out;
+
+    // the output seen with the input's shape: reduced dimensions get stride 0,
+    // so walking both in lockstep drops every input element on its output slot
+    mt::DimVector out_strides = s_init_strides(kept_shape);
+    for (size_t d = 0; d < a.m_shape.size(); ++d) {
+        if (reduced[d]) out_strides[d] = 0;
+    }
+
+    const auto accumulate {
+        [](const std::array<float*, 2>& ptrs, const std::array<size_t, 2>& steps, const size_t len) {
+            accumulate_sum_run(ptrs[0], steps[0], ptrs[1], steps[1], len);
+        }
+    };
+
+    // split along the largest kept dimension: chunks own disjoint outputs
+    size_t split_dim = a.m_shape.size();
+    for (size_t d = 0; d < a.m_shape.size(); ++d) {
+        if (!reduced[d] && a.m_shape[d] > 1 && (split_dim == a.m_shape.size() || a.m_shape[d] > a.m_shape[split_dim])) {
+            split_dim = d;
+        }
+    }
+
+    if (split_dim < a.m_shape.size()) {
+        const size_t per_index { a.m_numel / a.m_shape[split_dim] };
+        const size_t grain { std::max<size_t>(1, mt::GRAIN_SIZE / per_index) };
+        mt::parallel_for(0, a.m_shape[split_dim], grain, [&](const size_t begin, const size_t end) {
+            mt::DimVector chunk_shape = a.m_shape;
+            chunk_shape[split_dim] = end - begin;
+            const StridedLoop<2> loop(
+                chunk_shape,
+                { out.data() + begin * out_strides[split_dim], a.data() + begin * a.m_strides[split_dim] },
+                { &out_strides, &a.m_strides }
+            );
+            loop.for_each_run(accumulate);
+        });
+        return out;
+    }
+
+    // full reduction: partial sums over fixed-size pieces, combined in order,
+    // so the result does not depend on the number of threads
+    const StridedLoop<2> loop(
+        a.m_shape,
+        { out.data(), a.data() },
+        { &out_strides, &a.m_strides }
+    );
+    const size_t inner { loop.inner_size() };
+    const size_t outer { loop.outer_size() };
+    const size_t in_step { loop.inner_steps()[1] };
+
+    // a piece is a block of the single run, or a group of whole runs
+    const size_t piece { outer == 1 ? mt::GRAIN_SIZE : std::max<size_t>(1, mt::GRAIN_SIZE / inner) };
+    const size_t pieces { ((outer == 1 ? inner : outer) + piece - 1) / piece };
+    std::vector<float> partials(pieces, 0.0f);
+
+    mt::parallel_for(0, pieces, 1, [&](const size_t begin, const size_t end) {
+        for (size_t p = begin; p < end; ++p) {
+            if (outer == 1) {
+                const size_t first { p * piece };
+                accumulate_sum_run(&partials[p], 0, loop.m_data[1] + first * in_step, in_step, std::min(piece, inner - first));
+            } else {
+                loop.for_each_run(
+                    [&partials, p](const std::array<float*, 2>& ptrs, const std::array<size_t, 2>& steps, const size_t len) {
+                        accumulate_sum_run(&partials[p], 0, ptrs[1], steps[1], len);
+                    },
+                    p * piece,
+                    std::min((p + 1) * piece, outer)
+                );
+            }
+        }
+    });
 
-    // build input md index with dim inserted
-    std::vector<size_t> in_md(a.m_shape.size());
+    float total = 0.0f;
+    for (const float partial : partials) total += partial;
+    *out.data() = total;
 
-    std::vector<size_t> out_md;
+    return out;
+}
 
-    // iterate over output logical indices
-    for (size_t out_i = 0; out_i < out.m_numel; ++out_i) {
+namespace {
+    // Runs kernel(r, out_row, in_rows, len) on every row along dim of the
+    // inputs, which share a shape (and share it with out, when given). r is
+    // the flat index of the row in that shape with dim removed. Rows are
+    // handed over dense: strided inputs are gathered into a scratch row, and
+    // unless dim is the last one the output row is written to scratch and
+    // scattered afterwards. Without out, out_row is a spare scratch row.
+    template <size_t N, typename Kernel>
+    void for_each_row(
+            TensorStorage* out,
+            const std::array<const TensorStorage*, N>& inputs,
+            const size_t dim,
+            const Kernel& kernel
+    ) {
+        const mt::DimVector& shape { inputs[0]->m_shape };
+        if (dim >= shape.size()) {
+            throw std::invalid_argument(
+                std::format("Row dimension {} out of range for shape {}.", dim, shape)
+            );
+        }
+        for (const TensorStorage* in : inputs) {
+            if (in->m_shape != shape) {
+                throw std::invalid_argument(
+                    std::format("Row-wise operands must share shape {}, got {}.", shape, in->m_shape)
+                );
+            }
+        }
 
-        out_md = out.logical_to_md(out_i);
+        const size_t len { shape[dim] };
+        const size_t rows { inputs[0]->m_numel / len };
+        mt::parallel_for(0, rows, std::max<size_t>(1, mt::GRAIN_SIZE / len), [&](const size_t begin, const size_t end) {
+            std::vector<float> scratch((N + 1) * len);
+            std::array<const float*, N> in_rows {};
+
+            for (size_t r = begin; r < end; ++r) {
+                // row r enumerates the coordinates of every dimension but dim
+                size_t rest { r };
+                size_t out_offset { 0 };
+                std::array<size_t, N> in_offsets {};
+                for (size_t d = shape.size(); d-- > 0;) {
+                    if (d == dim) continue;
+                    const size_t coord { rest % shape[d] };
+                    rest /= shape[d];
+                    if (out) out_offset += coord * out->m_strides[d];
+                    for (size_t k = 0; k < N; ++k) in_offsets[k] += coord * inputs[k]->m_strides[d];
+                }
+
+                for (size_t k = 0; k < N; ++k) {
+                    const float* row { inputs[k]->data() + in_offsets[k] };
+                    const size_t step { inputs[k]->m_strides[dim] };
+                    if (step == 1) {
+                        in_rows[k] = row;
+                    } else {
+                        float* gathered { scratch.data() + (k + 1) * len };
+                        for (size_t j = 0; j < len; ++j) gathered[j] = row[j * step];
+                        in_rows[k] = gathered;
+                    }
+                }
+
+                if (!out) {
+                    kernel(r, scratch.data(), in_rows, len);
+                    continue;
+                }
+                float* out_row { out->data() + out_offset };
+                const size_t out_step { out->m_strides[dim] };
+                kernel(r, out_step == 1 ? out_row : scratch.data(), in_rows, len);
+                if (out_step != 1) {
+                    for (size_t j = 0; j < len; ++j) out_row[j * out_step] = scratch[j];
+                }
+            }
+        });
+    }
 
-        // in_md follows out_md but skips reduced dimension
-        populate_in_md_for_accum(in_md, out_md, dim);
+    // y = softmax(x) over one dense row: max, shifted exp-sum, normalize.
+    void softmax_row(
+            const float* x,
+            float* y,
+            const size_t len
+    ) {
+        const mt::kernels::ElementwiseKernels& kernels { mt::kernels::elementwise_kernels() };
+        const float max { kernels.max(x, len) };
+        kernels.sub(x, 1, &max, 0, y, len);
+        kernels.exp(y, y, len);
+        const float inv_sum { 1.0f / kernels.sum(y, len) };
+        kernels.mult(y, 1, &inv_sum, 0, y, len);
+    }
 
-        // accumulate over reduced dim
-        float acc = 0.0f;
-        for (size_t r = 0; r < a.m_shape[dim]; ++r) {
-            in_md[dim] = r;
-            acc += a.get_entry_ref(in_md);
+    // Target class of row r, an integral float in [0, num_classes).
+    size_t class_index(
+            const TensorStorage& classes,
+            const size_t r,
+            const size_t num_classes
+    ) {
+        const float raw { classes.get_entry_ref(r) };
+        if (!(raw >= 0.0f && raw < static_cast<float>(num_classes)) || raw != std::floor(raw)) {
+            throw std::invalid_argument(
+                std::format("Class index {} out of range [0, {}].", raw, num_classes - 1)
+            );
         }
+        return static_cast<size_t>(raw);
+    }
 
-        out.get_entry_ref(out_i) = acc;
+    // Checks that classes (and grad, when given) have one entry per row of
+    // logits along the last dimension.
+    void check_class_shapes(
+            const TensorStorage& logits,
+            const TensorStorage& classes,
+            const TensorStorage* grad
+    ) {
+        if (logits.m_shape.empty()) {
+            throw std::invalid_argument("Cross-entropy needs logits with a class dimension, got a scalar.");
+        }
+        const mt::DimVector row_shape { TensorStorage::reduce_shape(logits.m_shape, logits.m_shape.size() - 1) };
+        if (classes.m_shape != row_shape || (grad && grad->m_shape != row_shape)) {
+            throw std::invalid_argument(
+                std::format("Class indices of shape {} do not match logits of shape {}.", classes.m_shape, logits.m_shape)
+            );
+        }
     }
+}
+
+TensorStorage TensorStorage::s_softmax(
+        const TensorStorage& a,
+        const size_t dim
+) {
+    TensorStorage out{ empty(a.m_shape) };
+    for_each_row<1>(&out, { &a }, dim, [](const size_t, float* y, const std::array<const float*, 1>& rows, const size_t len) {
+        softmax_row(rows[0], y, len);
+    });
+    return out;
+}
+
+TensorStorage TensorStorage::s_log_softmax(
+        const TensorStorage& a,
+        const size_t dim
+) {
+    TensorStorage out{ empty(a.m_shape) };
+    for_each_row<1>(&out, { &a }, dim, [](const size_t, float* y, const std::array<const float*, 1>& rows, const size_t len) {
+        const mt::kernels::ElementwiseKernels& kernels { mt::kernels::elementwise_kernels() };
+        const float* x { rows[0] };
+        const float max { kernels.max(x, len) };
+        // the exponentials only feed the sum, y is then rewritten as (x - max) - log(sum)
+        kernels.sub(x, 1, &max, 0, y, len);
+        kernels.exp(y, y, len);
+        const float log_sum { std::log(kernels.sum(y, len)) };
+        kernels.sub(x, 1, &max, 0, y, len);
+        kernels.sub(y, 1, &log_sum, 0, y, len);
+    });
+    return out;
+}
+
+TensorStorage TensorStorage::s_softmax_backward(
+        const TensorStorage& y,
+        const TensorStorage& grad,
+        const size_t dim
+) {
+    TensorStorage out{ empty(y.m_shape) };
+    for_each_row<2>(&out, { &y, &grad }, dim, [](const size_t, float* dx, const std::array<const float*, 2>& rows, const size_t len) {
+        const mt::kernels::ElementwiseKernels& kernels { mt::kernels::elementwise_kernels() };
+        kernels.mult(rows[1], 1, rows[0], 1, dx, len);
+        const float dot { kernels.sum(dx, len) };
+        kernels.sub(rows[1], 1, &dot, 0, dx, len);
+        kernels.mult(dx, 1, rows[0], 1, dx, len);
+    });
+    return out;
+}
+
+TensorStorage TensorStorage::s_log_softmax_backward(
+        const TensorStorage& y,
+        const TensorStorage& grad,
+        const size_t dim
+) {
+    TensorStorage out{ empty(y.m_shape) };
+    for_each_row<2>(&out, { &y, &grad }, dim, [](const size_t, float* dx, const std::array<const float*, 2>& rows, const size_t len) {
+        const mt::kernels::ElementwiseKernels& kernels { mt::kernels::elementwise_kernels() };
+        const float grad_sum { kernels.sum(rows[1], len) };
+        kernels.exp(rows[0], dx, len);
+        kernels.mult(dx, 1, &grad_sum, 0, dx, len);
+        kernels.sub(rows[1], 1, dx, 1, dx, len);
+    });
+    return out;
+}
+
+TensorStorage TensorStorage::s_cross_entropy(
+        const TensorStorage& logits,
+        const TensorStorage& classes
+) {
+    check_class_shapes(logits, classes, nullptr);
+    const size_t dim { logits.m_shape.size() - 1 };
+    TensorStorage losses{ empty(classes.m_shape) };
+    float* loss_data { losses.data() };
+
+    for_each_row<1>(nullptr, { &logits }, dim, [&](const size_t r, float* spare, const std::array<const float*, 1>& rows, const size_t len) {
+        const mt::kernels::ElementwiseKernels& kernels { mt::kernels::elementwise_kernels() };
+        const float* x { rows[0] };
+        const size_t cls { class_index(classes, r, len) };
+        const float max { kernels.max(x, len) };
+        kernels.sub(x, 1, &max, 0, spare, len);
+        kernels.exp(spare, spare, len);
+        // -log(softmax(x)[cls]) = log(sum(e^(x - max))) - (x[cls] - max)
+        loss_data[r] = std::log(kernels.sum(spare, len)) - (x[cls] - max);
+    });
+    return losses;
+}
+
+TensorStorage TensorStorage::s_cross_entropy_backward(
+        const TensorStorage& logits,
+        const TensorStorage& classes,
+        const TensorStorage& grad
+) {
+    check_class_shapes(logits, classes, &grad);
+    const size_t dim { logits.m_shape.size() - 1 };
+    TensorStorage out{ empty(logits.m_shape) };
+
+    for_each_row<1>(&out, { &logits }, dim, [&](const size_t r, float* dx, const std::array<const float*, 1>& rows, const size_t len) {
+        const mt::kernels::ElementwiseKernels& kernels { mt::kernels::elementwise_kernels() };
+        const float g { grad.get_entry_ref(r) };
+        softmax_row(rows[0], dx, len);
+        kernels.mult(dx, 1, &g, 0, dx, len);
+        dx[class_index(classes, r, len)] -= g;
+    });
+    return out;
+}
 
+TensorStorage TensorStorage::s_one_hot(
+        const TensorStorage& classes,
+        const size_t num_classes
+) {
+    // classes as the last dimension
+    mt::DimVector out_shape = classes.m_shape;
+    out_shape.push_back(num_classes);
+
+    TensorStorage out(out_shape); // zero-initialized, contiguous
+    float* out_data = out.data();
+    for (size_t i = 0; i < classes.m_numel; ++i) {
+        const float raw = classes.get_entry_ref(i);
+        const long idx_long = static_cast<long>(raw);
+        if (idx_long < 0 || static_cast<size_t>(idx_long) >= num_classes) {
+            throw std::invalid_argument(std::format("one_hot index {} out of range [0, {}]", raw, num_classes-1));
+        }
+        out_data[i * num_classes + static_cast<size_t>(idx_long)] = 1.0f;
+    }
     return out;
 }
 
@@ -455,12 +1049,10 @@ TensorStorage TensorStorage::s_unsqueeze(
     }
 
     // build output shape
-    const std::vector<size_t> out_shape = unsqueeze_shape(a.m_shape, dim);
-    TensorStorage out{ out_shape };
-
-    // make a view: share the underlying flat data and keep the same offset
-    out.m_flat_data = a.m_flat_data;
-    out.m_offset = a.m_offset;
+    const mt::DimVector out_shape = unsqueeze_shape(a.m_shape, dim);
+    // make a view: copying a shares the underlying flat data and the offset
+    TensorStorage out{ a };
+    out.m_shape = out_shape;
 
     // build out strides by inserting a zero stride for the new singleton dim
     out.m_strides.clear();
@@ -511,15 +1103,12 @@ TensorStorage TensorStorage::s_expand(
     }
 
     // build output shape
-    std::vector<size_t> out_shape = a.m_shape;
+    mt::DimVector out_shape = a.m_shape;
     out_shape[dim] = times;
 
-    TensorStorage out{ out_shape };
-
-    // make a view: share the underlying flat data and keep the same offset
-    out.m_flat_data = a.m_flat_data;
-    out.m_offset = a.m_offset;
-    out.m_strides = a.m_strides;
+    // make a view: copying a shares the underlying flat data and the offset
+    TensorStorage out{ a };
+    out.m_shape = out_shape;
     // set expanded dimension stride to zero so every index maps to the same underlying element
     out.m_strides[dim] = 0;
     out.m_contiguous = out.is_contiguous();
@@ -546,13 +1135,11 @@ TensorStorage TensorStorage::s_squeeze(
     }
 
     // build output shape
-    const std::vector<size_t> out_shape = reduce_shape(a.m_shape, dim);
-
-    TensorStorage out{ out_shape };
+    const mt::DimVector out_shape = reduce_shape(a.m_shape, dim);
 
-    // make a view: share the underlying flat data and keep the same offset
-    out.m_flat_data = a.m_flat_data;
-    out.m_offset = a.m_offset;
+    // make a view: copying a shares the underlying flat data and the offset
+    TensorStorage out{ a };
+    out.m_shape = out_shape;
 
     // build out strides by removing the stride corresponding to the squeezed dim
     out.m_strides.clear();
@@ -568,11 +1155,109 @@ TensorStorage TensorStorage::s_squeeze(
     return out;
 }
 
+TensorStorage TensorStorage::s_transpose(
+        const TensorStorage& a,
+        const size_t dim0,
+        const size_t dim1
+) {
+    if (dim0 >= a.m_shape.size() || dim1 >= a.m_shape.size()) {
+        throw std::invalid_argument(
+            std::format("Transposed dimensions ({}, {}) out of range for shape of length {}.",
+            dim0, dim1, a.m_shape.size()
+            )
+        );
+    }
+
+    // build output shape
+    mt::DimVector out_shape = a.m_shape;
+    std::swap(out_shape[dim0], out_shape[dim1]);
+
+    // make a view: copying a shares the underlying flat data, then swap the strides
+    TensorStorage out{ a };
+    out.m_shape = out_shape;
+    std::swap(out.m_strides[dim0], out.m_strides[dim1]);
+    out.m_contiguous = out.is_contiguous();
+
+    return out;
+}
+
+TensorStorage TensorStorage::s_matmul(
+        const TensorStorage& a,
+        const TensorStorage& b
+) {
+    if (a.m_shape.size() != 2 || b.m_shape.size() != 2) {
+        throw std::invalid_argument(
+            std::format("s_matmul requires 2D operands, got shapes {} and {}.",
+            a.m_shape, b.m_shape
+            )
+        );
+    }
+
+    const size_t m = a.m_shape[0];
+    const size_t k = a.m_shape[1];
+    const size_t n = b.m_shape[1];
+
+    if (b.m_shape[0] != k) {
+        throw std::invalid_argument(std::format("matmul inner dimensions must match ({} != {})", k, b.m_shape[0]));
+    }
+
+    TensorStorage out{ empty({m, n}) };
+
+    // strided operands are consumed as they are, packing takes care of the layout
+    mt::kernels::gemm(
+        m, n, k,
+        { a.data(), a.m_strides[0], a.m_strides[1] },
+        { b.data(), b.m_strides[0], b.m_strides[1] },
+        { out.data(), out.m_strides[0], out.m_strides[1] }
+    );
+
+    return out;
+}
+
+TensorStorage TensorStorage::s_linear(
+        const TensorStorage& x,
+        const TensorStorage& w,
+        const TensorStorage* bias,
+        const mt::kernels::Activation activation
+) {
+    if (x.m_shape.size() != 2 || w.m_shape.size() != 2) {
+        throw std::invalid_argument(
+            std::format("s_linear requires 2D input and weight, got shapes {} and {}.",
+            x.m_shape, w.m_shape
+            )
+        );
+    }
+
+    const size_t m = x.m_shape[0];
+    const size_t k = x.m_shape[1];
+    const size_t n = w.m_shape[1];
+
+    if (w.m_shape[0] != k) {
+        throw std::invalid_argument(std::format("linear inner dimensions must match ({} != {})", k, w.m_shape[0]));
+    }
+    if (bias && (bias->m_shape.size() != 1 || bias->m_shape[0] != n)) {
+        throw std::invalid_argument(std::format("Linear bias of shape {} does not match {} output features.", bias->m_shape, n));
+    }
+
+    TensorStorage out{ empty({m, n}) };
+
+    mt::kernels::gemm(
+        m, n, k,
+        { x.data(), x.m_strides[0], x.m_strides[1] },
+        { w.data(), w.m_strides[0], w.m_strides[1] },
+        { out.data(), out.m_strides[0], out.m_strides[1] },
+        false,
+        { bias ? bias->data() : nullptr, bias ? bias->m_strides[0] : 0, activation }
+    );
+
+    return out;
+}
+
 static void s_print_recursive(
         std::ostream& os,
         const TensorStorage& storage,
         const size_t dim_index,
-        std::vector<size_t>& current_indices,
+        mt::DimVector& current_indices,
         const int indent
 ) {
     const size_t dim_size = storage.m_shape[dim_index];
@@ -615,10 +1300,9 @@ static void s_print_recursive(
 std::ostream& operator<<(std::ostream& os, const TensorStorage& storage){
     os << std::format("Tensor(shape={}, dtype=float,\n       data=", storage.m_shape);
     if (storage.m_shape.empty()) {
-        if (!storage.m_flat_data->empty())
-             os << std::fixed << std::setprecision(4) << (*storage.m_flat_data)[0];
+        os << std::fixed << std::setprecision(4) << *storage.data();
     } else {
-        std::vector<size_t> current_indices;
+        mt::DimVector current_indices;
         s_print_recursive(os, storage, 0, current_indices, 12);
     }
     os << ")";
@@ -2,29 +2,50 @@
 #define TENSOR_STORAGES_H
 
 #include <iostream>
+#include <format>
+#include <stdexcept>
 #include <vector>
 #include <mdspan>
 #include <iomanip>
 #include <string>
 #include <memory>
+#include <array>
+#include <utility>
+#include <tuple>
+#include <algorithm>
+#include <cstdint>
+
+#include "small_vector.h"
+#include "tensor_iterators.h"
+#include "parallel.h"
+#include "allocator.h"
+#include "kernels/elementwise.h"
+#include "kernels/gemm.h"
 
 class TensorStorage {
 public:
-    std::vector<size_t> m_shape;
-    std::vector<size_t> m_strides;
+    mt::DimVector m_shape;
+    mt::DimVector m_strides;
     bool m_contiguous;
     size_t m_numel;
     size_t m_offset;
     
-    std::shared_ptr<std::vector<float>> m_flat_data;
+    // pooled buffer (see allocator.h), shared between a tensor and its views
+    std::shared_ptr<float[]> m_flat_data;
 
     TensorStorage(
-            const std::vector<size_t>& shape,
+            const mt::DimVector& shape,
             const float value = 0.0f
     );
 
+    // Contiguous storage with uninitialized contents, for outputs that are
+    // fully written before being read.
+    static TensorStorage empty(
+            const mt::DimVector& shape
+    );
+
     static TensorStorage linspace(
-            const std::vector<size_t>& shape,
+            const mt::DimVector& shape,
             const float start,
             const float end
     );
@@ -33,12 +54,14 @@ public:
     
     bool is_contiguous() const;
 
+    float* data() const;
+
     float& get_entry_ref(
             const size_t l_index
     ) const;
     
     float& get_entry_ref(
-            const std::vector<size_t>& md_index
+            const mt::DimVector& md_index
     ) const;
     
     TensorStorage fill(
@@ -111,10 +134,27 @@ public:
             const TensorStorage& arg
     );
     
+    static TensorStorage s_exp(
+            const TensorStorage& arg
+    );
+    
     static TensorStorage s_maximum(
             const TensorStorage& a,
             const TensorStorage& b
     );
+
+    // max(a, 0), also setting bit i of mask where element i of a (in
+    // row-major order) is > 0: the backward pass needs 1 bit per element.
+    static TensorStorage s_relu(
+            const TensorStorage& a,
+            std::vector<uint64_t>& mask
+    );
+
+    // grad where the mask bit of s_relu is set, 0 elsewhere, in one pass.
+    static TensorStorage s_relu_backward(
+            const TensorStorage& grad,
+            const std::vector<uint64_t>& mask
+    );
     
     static TensorStorage s_gt(
             const TensorStorage& a,
@@ -131,26 +171,161 @@ public:
             const TensorStorage& b
     );
 
-    static std::vector<size_t> reduce_shape(
-            const std::vector<size_t>& shape,
+    // Ops with a float operand b, which is passed to the kernels as a
+    // stride-0 operand instead of a filled tensor. The r-prefixed ones put
+    // the float on the left: s_rsub_scalar(a, b) = b - a.
+    static TensorStorage s_add_scalar(
+            const TensorStorage& a,
+            const float b
+    );
+    
+    static TensorStorage s_sub_scalar(
+            const TensorStorage& a,
+            const float b
+    );
+    
+    static TensorStorage s_rsub_scalar(
+            const TensorStorage& a,
+            const float b
+    );
+    
+    static TensorStorage s_mult_scalar(
+            const TensorStorage& a,
+            const float b
+    );
+    
+    static TensorStorage s_div_scalar(
+            const TensorStorage& a,
+            const float b
+    );
+    
+    static TensorStorage s_rdiv_scalar(
+            const TensorStorage& a,
+            const float b
+    );
+    
+    static TensorStorage s_pow_scalar(
+            const TensorStorage& a,
+            const float b
+    );
+    
+    static TensorStorage s_rpow_scalar(
+            const TensorStorage& a,
+            const float b
+    );
+    
+    static TensorStorage s_maximum_scalar(
+            const TensorStorage& a,
+            const float b
+    );
+    
+    static TensorStorage s_gt_scalar(
+            const TensorStorage& a,
+            const float b
+    );
+
+    // NumPy-style broadcast of two shapes: aligned on the trailing
+    // dimension, sizes must match or one of them must be 1.
+    static mt::DimVector broadcast_shape(
+            const mt::DimVector& a,
+            const mt::DimVector& b
+    );
+
+    // Strides that read a as if it had the given shape, which a must
+    // broadcast to: added leading and expanded singleton dimensions get 0.
+    static mt::DimVector broadcast_strides(
+            const TensorStorage& a,
+            const mt::DimVector& shape
+    );
+
+    static mt::DimVector reduce_shape(
+            const mt::DimVector& shape,
             const size_t dim
     );
     
-    static std::vector<size_t> unsqueeze_shape(
-            const std::vector<size_t>& shape,
+    static mt::DimVector unsqueeze_shape(
+            const mt::DimVector& shape,
             const size_t dim
     );
 
-    static void populate_in_md_for_accum(
-            std::vector<size_t>& in_md,
-            const std::vector<size_t>& out_md,
-            const size_t dim
+    // Dimensions of from to reduce for summing it back to to, which must
+    // broadcast to from: the leading dimensions (dropped) and the expanded
+    // singletons of to (kept), both in from's indexing.
+    static std::pair<std::vector<size_t>, std::vector<size_t>> sum_to_dims(
+            const mt::DimVector& from,
+            const mt::DimVector& to
+    );
+
+    static TensorStorage s_sum(
+            const TensorStorage& a,
+            const size_t dim,
+            const bool keepdim = false
+    );
+
+    // Sums a broadcast storage back to shape, see sum_to_dims. Returns a
+    // (sharing) copy of a when the shapes already match.
+    static TensorStorage s_sum_to(
+            const TensorStorage& a,
+            const mt::DimVector& shape
     );
 
+    // Sums over every dimension in dims (any order, no repeats). Reduced
+    // dimensions are dropped, or kept as singletons when keepdim is set.
     static TensorStorage s_sum(
+            const TensorStorage& a,
+            const std::vector<size_t>& dims,
+            const bool keepdim = false
+    );
+    
+    // Softmax and log-softmax along dim, row by row: each row is shifted by
+    // its max before exp, so large logits cannot overflow.
+    static TensorStorage s_softmax(
             const TensorStorage& a,
             const size_t dim
     );
+
+    static TensorStorage s_log_softmax(
+            const TensorStorage& a,
+            const size_t dim
+    );
+
+    // Gradients w.r.t. the input, from the saved output y and its gradient:
+    // softmax: (grad - sum(grad * y)) * y, log-softmax: grad - e^y * sum(grad).
+    static TensorStorage s_softmax_backward(
+            const TensorStorage& y,
+            const TensorStorage& grad,
+            const size_t dim
+    );
+
+    static TensorStorage s_log_softmax_backward(
+            const TensorStorage& y,
+            const TensorStorage& grad,
+            const size_t dim
+    );
+
+    // Cross-entropy of logits against class indices, along the last
+    // dimension: one loss per row, log(sum(e^x)) - x[class], computed in a
+    // single pass over the row. classes has the shape of logits without the
+    // last dimension and holds integral floats in [0, num_classes).
+    static TensorStorage s_cross_entropy(
+            const TensorStorage& logits,
+            const TensorStorage& classes
+    );
+
+    // Its gradient w.r.t. the logits, (softmax(x) - onehot(class)) times the
+    // row's upstream gradient, written without a one-hot matrix.
+    static TensorStorage s_cross_entropy_backward(
+            const TensorStorage& logits,
+            const TensorStorage& classes,
+            const TensorStorage& grad
+    );
+    
+    // One-hot rows for integral class indices in [0, num_classes), with
+    // the classes as a new last dimension.
+    static TensorStorage s_one_hot(
+            const TensorStorage& classes,
+            const size_t num_classes
+    );
     
     static TensorStorage s_unsqueeze(
             const TensorStorage& a,
@@ -174,34 +349,97 @@ public:
             const size_t times
     );
     
+    static TensorStorage s_transpose(
+            const TensorStorage& a,
+            const size_t dim0,
+            const size_t dim1
+    );
+
+    static TensorStorage s_matmul(
+            const TensorStorage& a,
+            const TensorStorage& b
+    );
+
+    // activation(x·w + bias) for x [m, k], w [k, n] and bias [n] (or null),
+    // in one GEMM whose epilogue adds the bias and applies the activation
+    // before each output tile is stored.
+    static TensorStorage s_linear(
+            const TensorStorage& x,
+            const TensorStorage& w,
+            const TensorStorage* bias,
+            const mt::kernels::Activation activation
+    );
+
+    // Evaluates a fused expression (see expressions.h) in one s_apply_op
+    // pass over its leaf operands, given as a tuple of pointers.
+    template <typename Fused, typename Leaves>
+    static TensorStorage s_eval(
+            const Fused& fused,
+            const Leaves& leaves
+    ) {
+        return std::apply(
+            [&fused](const auto*... operands) { return s_apply_op(fused, *operands...); },
+            leaves
+        );
+    }
+
+    // Same, writing into out, whose shape the leaves must broadcast to.
+    template <typename Fused, typename Leaves>
+    static void s_eval_inplace(
+            TensorStorage& out,
+            const Fused& fused,
+            const Leaves& leaves
+    ) {
+        std::apply(
+            [&out, &fused](const auto*... operands) {
+                mt::DimVector out_shape { out.m_shape };
+                ((out_shape = broadcast_shape(out_shape, operands->m_shape)), ...);
+                if (out_shape != out.m_shape) {
+                    throw std::invalid_argument(
+                        std::format("In-place operation cannot broadcast shape {} to {}.", out.m_shape, out_shape)
+                    );
+                }
+                s_run_op(fused, out, *operands...);
+            },
+            leaves
+        );
+    }
+    
 private:
+    struct Uninitialized {};
+
     TensorStorage(
-            const std::vector<size_t>& shape,
+            const mt::DimVector& shape,
             const float start,
             const float end
     );
 
+    TensorStorage(
+            const mt::DimVector& shape,
+            Uninitialized
+    );
+
     static void assert_positive_dims(
-            const std::vector<size_t>& shape
+            const mt::DimVector& shape
     );
     
     static size_t compute_numel_from_shape(
-            const std::vector<size_t>& shape
+            const mt::DimVector& shape
     );
 
-    static std::vector<size_t> s_init_strides(
-            const std::vector<size_t>& shape
+    static mt::DimVector s_init_strides(
+            const mt::DimVector& shape
     );
 
     size_t md_to_flat(
-            const std::vector<size_t>& md_index
+            const mt::DimVector& md_index
     ) const;
 
     size_t logical_to_flat(
             const size_t logical_index
     ) const;
 
-    std::vector<size_t> logical_to_md(
+    mt::DimVector logical_to_md(
             const size_t l_index
     ) const;
 
@@ -210,21 +448,13 @@ private:
             const Func op,
             const Tensors&... operands
     ) {
-        // 2. Get metadata from the first tensor (using a trick to access the first element of a pack)
-        const auto& first = [] (auto& head, [[maybe_unused]] auto&... tail) -> auto& { return head; }(operands...);
-        const size_t numel = first.m_numel;
-        TensorStorage out(first.m_shape);
+        // 2. Output shape: the operands broadcast against each other
+        mt::DimVector out_shape {};
+        ((out_shape = broadcast_shape(out_shape, operands.m_shape)), ...);
+        TensorStorage out { empty(out_shape) };
 
-        // 3. Optional: Shape safety check using Fold Expressions
-        if (!((operands.m_shape == first.m_shape) && ...)) {
-            throw std::invalid_argument("Shapes must match for element-wise operation");
-        }
-
-        // 4. Computation loop
-                for (size_t i = 0; i < numel; i++) {
-                        // The magic: "Unpack" the i-th element of every tensor into the lambda
-                        out.get_entry_ref(i) = op((operands.get_entry_ref(i))...);
-                }
+        // 3. Computation loop
+        s_run_op(op, out, operands...);
 
         return out;
     }
@@ -236,26 +466,126 @@ private:
     ) {
         // 2. Get metadata from the first tensor (using a trick to access the first element of a pack)
         auto& first = [] (auto& head, [[maybe_unused]] auto&... tail) -> auto& { return head; }(operands...);
-        const size_t numel = first.m_numel;
         TensorStorage& out = first;
 
         // if (out.m_requires_grad) {
         //     throw std::logic_error(std::format("Cannot compute gradients on inplace operators. Set requires_grad = false."));
         // }
 
-        // 3. Optional: Shape safety check using Fold Expressions
-        if (!((operands.m_shape == first.m_shape) && ...)) {
-            throw std::invalid_argument("Shapes must match for element-wise operation");
+        // 3. The other operands may broadcast, but cannot grow the output
+        mt::DimVector out_shape {};
+        ((out_shape = broadcast_shape(out_shape, operands.m_shape)), ...);
+        if (out_shape != out.m_shape) {
+            throw std::invalid_argument(
+                std::format("In-place operation cannot broadcast shape {} to {}.", out.m_shape, out_shape)
+            );
         }
 
         // 4. Computation loop
-                for (size_t i = 0; i < numel; i++) {
-                        // The magic: "Unpack" the i-th element of every tensor into the lambda
-                        out.get_entry_ref(i) = op((operands.get_entry_ref(i))...);
-                }
+        s_run_op(op, out, operands...);
         
         return out;
     }
+
+    // Evaluates op element-wise over the operands and writes into out, whose
+    // shape the operands must broadcast to. Broadcast operands are read with
+    // stride 0, index arithmetic is left to StridedLoop, so the per-element
+    // cost is a pointer increment per operand.
+    template <typename Func, typename... Tensors>
+    static void s_run_op(
+            const Func op,
+            TensorStorage& out,
+            const Tensors&... operands
+    ) {
+        constexpr size_t N { sizeof...(Tensors) + 1 };
+        const std::array<mt::DimVector, N - 1> strides { broadcast_strides(operands, out.m_shape)... };
+        std::array<const mt::DimVector*, N> stride_ptrs { &out.m_strides };
+        for (size_t k = 1; k < N; k++) stride_ptrs[k] = &strides[k - 1];
+
+        const StridedLoop<N> loop(
+            out.m_shape,
+            { out.data(), operands.data()... },
+            stride_ptrs
+        );
+        const auto run {
+            [&op](const std::array<float*, N>& ptrs, const std::array<size_t, N>& steps, const size_t len) {
+                if constexpr (requires { op.run(ptrs, steps, len); }) {
+                    // fused expressions walk their own tree block by block
+                    op.run(ptrs, steps, len);
+                } else {
+                    s_run_inner(op, ptrs, steps, len, std::make_index_sequence<N - 1>{});
+                }
+            }
+        };
+
+        const size_t inner { loop.inner_size() };
+        const size_t outer { loop.outer_size() };
+        if (outer == 1) {
+            // a single run (e.g. fully contiguous operands) is split along its
+            // length, in whole blocks so that SIMD kernels see the same vector
+            // and tail split for any number of threads
+            constexpr size_t BLOCK { 64 };
+            const std::array<size_t, N> steps { loop.inner_steps() };
+            const size_t blocks { (inner + BLOCK - 1) / BLOCK };
+            mt::parallel_for(0, blocks, mt::GRAIN_SIZE / BLOCK, [&](const size_t begin, const size_t end) {
+                const size_t first { begin * BLOCK };
+                std::array<float*, N> ptrs { loop.m_data };
+                for (size_t k = 0; k < N; k++) ptrs[k] += first * steps[k];
+                run(ptrs, steps, std::min(end * BLOCK, inner) - first);
+            });
+        } else {
+            const size_t grain { std::max<size_t>(1, mt::GRAIN_SIZE / inner) };
+            mt::parallel_for(0, outer, grain, [&](const size_t begin, const size_t end) {
+                loop.for_each_run(run, begin, end);
+            });
+        }
+    }
+
+    template <typename Func, size_t N, size_t... Is>
+    static void s_run_inner(
+            const Func& op,
+            const std::array<float*, N>& ptrs,
+            const std::array<size_t, N>& steps,
+            const size_t len,
+            std::index_sequence<Is...>
+    ) {
+        float* out = ptrs[0];
+        if constexpr (requires { Func::vec; }) {
+            // operators with a SIMD kernel take dense or scalar-broadcast runs
+            const auto kernel { mt::kernels::elementwise_kernels().*Func::vec };
+            if constexpr (N == 3) {
+                if (steps[0] == 1 && steps[1] <= 1 && steps[2] <= 1) {
+                    kernel(ptrs[1], steps[1], ptrs[2], steps[2], out, len);
+                    return;
+                }
+            } else if constexpr (N == 2) {
+                if (steps[0] == 1 && steps[1] == 1) {
+                    kernel(ptrs[1], out, len);
+                    return;
+                }
+            }
+        } else if constexpr (requires { Func::rhs_vec; }) {
+            if (steps[0] == 1 && steps[1] <= 1) {
+                (mt::kernels::elementwise_kernels().*Func::rhs_vec)(ptrs[1], steps[1], &op.value, 0, out, len);
+                return;
+            }
+        } else if constexpr (requires { Func::lhs_vec; }) {
+            if (steps[0] == 1 && steps[1] <= 1) {
+                (mt::kernels::elementwise_kernels().*Func::lhs_vec)(&op.value, 0, ptrs[1], steps[1], out, len);
+                return;
+            }
+        }
+        if (steps[0] == 1 && ((steps[Is + 1] == 1) && ...)) {
+            // dense run: plain indexing lets the compiler vectorize
+            for (size_t j = 0; j < len; j++) {
+                out[j] = op(ptrs[Is + 1][j]...);
+            }
+        } else {
+            for (size_t j = 0; j < len; j++) {
+                out[j * steps[0]] = op(ptrs[Is + 1][j * steps[Is + 1]]...);
+            }
+        }
+    }
 };
 
 #endif
@@ -1,15 +1,18 @@
-#include <queue>
-#include <map>
-#include <set>
 #include <algorithm>
+#include <optional>
+#include <utility>
 
 #include "tensors.h"
 #include "tensor_nodes.h"
 #include "grad_fns.h"
 #include "tensor_storages.h"
+#include "parallel.h"
+#include "expressions.h"
+#include "tape.h"
+#include "jit/trace.h"
 
 Tensor::Tensor(
-        const std::vector<size_t> shape,
+        const mt::DimVector shape,
         const float value,
         const bool requires_grad
 ) {
@@ -24,6 +27,49 @@ Tensor::Tensor(
         const std::shared_ptr<TensorNode> node
 ): m_node{node} {}
 
+namespace {
+    // Called before a handle of node is dropped. When the holders left are
+    // only graph edges that never read the values (TensorNode::m_edge_refs),
+    // and the node's own grad fn does not either, the buffer is released.
+    // The shape stays for the gradients still accumulated into the node.
+    void release_if_edges_only(
+            const std::shared_ptr<TensorNode>& node
+    ) {
+        if (!node) return;
+        const uint32_t edges { node->m_edge_refs.load(std::memory_order_relaxed) };
+        if (edges == 0 || node.use_count() != static_cast<long>(edges) + 1) return;
+        if (node->m_grad_fn && node->m_grad_fn->reads_output()) return;
+        node->m_storage.m_flat_data = nullptr;
+    }
+
+    // Where the gradient of node is summed during the plain backward pass
+    // running on the calling thread, nullptr outside of one and for nodes it
+    // does not process (leaves). Defined with the pass's scratch below.
+    std::optional<TensorStorage>* pending_grad(
+            const TensorNode* node
+    );
+}
+
+Tensor& Tensor::operator=(
+        const Tensor& other
+) {
+    const std::shared_ptr<TensorNode> previous { std::exchange(m_node, other.m_node) };
+    release_if_edges_only(previous);
+    return *this;
+}
+
+Tensor& Tensor::operator=(
+        Tensor&& other
+) noexcept {
+    const std::shared_ptr<TensorNode> previous { std::exchange(m_node, std::move(other.m_node)) };
+    release_if_edges_only(previous);
+    return *this;
+}
+
+Tensor::~Tensor() {
+    release_if_edges_only(m_node);
+}
+
 std::ostream& operator<<(
         std::ostream& os,
         const Tensor& tensor
@@ -35,7 +81,14 @@ std::ostream& operator<<(
     return os;
 }
 float& Tensor::operator[](
-        const std::vector<size_t>& md_index
+        const mt::DimVector& md_index
+) {
+    mt::jit::record_untraceable("a write through operator[]");
+    return std::as_const(*this)[md_index];
+}
+
+float& Tensor::operator[](
+        const mt::DimVector& md_index
 ) const {
     if (m_node->m_storage.m_shape.empty()) { // Scalar case
         throw std::invalid_argument(std::format("\nScalar tensor cannot be access by index. Got index {}", md_index));
@@ -50,6 +103,7 @@ float& Tensor::item() const {
 void Tensor::fill_inplace(
         const float value
 ) {
+    mt::jit::record_untraceable("fill_inplace");
     m_node->m_storage.fill_inplace(value);
 }
 
@@ -82,7 +136,7 @@ Tensor Tensor::linspace(
 }
 
 Tensor Tensor::linspace(
-        const std::vector<size_t>& shape,
+        const mt::DimVector& shape,
         const float start,
         const float end,
         const bool requires_grad
@@ -102,8 +156,7 @@ bool Tensor::is_contiguous() const {
 void Tensor::reset_grad() {
     // Replaces the gradient with a new zeroed tensor.
     // This ensures that any existing references to the old gradient (e.g. for higher order derivatives) are preserved intact.
-    m_node->m_grad = std::make_shared<Tensor>(m_node->m_storage.m_shape);
-    m_node->m_grad->fill_inplace(0.0f);
+    m_node->m_grad = std::make_shared<Tensor>(m_node->m_storage.m_shape, 0.0f, false);
 }
 
 void Tensor::zero_grad() {
@@ -119,9 +172,14 @@ void Tensor::detach_inplace() {
     m_node->m_grad_fn = nullptr;
 }
 
+void Tensor::retain_grad() {
+    m_node->m_retains_grad = true;
+}
+
 bool Tensor::compute_requires_grad_from_operands(
         const std::vector<Tensor>& operands
 ) {
+    if (!mt::is_grad_enabled()) return false;
     const bool requires_grad_or = std::any_of(
         operands.begin(),
         operands.end(),
@@ -130,21 +188,109 @@ bool Tensor::compute_requires_grad_from_operands(
     return requires_grad_or;
 }
 
+void Tensor::record_kernel(
+        TensorStorage (*kernel)(const TensorStorage&),
+        const Tensor& operand,
+        const Tensor& result
+) {
+    mt::jit::record({ .kernel = kernel }, { &operand }, result);
+}
+
+void Tensor::record_kernel(
+        TensorStorage (*kernel)(const TensorStorage&, const TensorStorage&),
+        const Tensor& a,
+        const Tensor& b,
+        const Tensor& result
+) {
+    mt::jit::record({ .kernel = kernel }, { &a, &b }, result);
+}
+
+void Tensor::record_kernel(
+        TensorStorage (*kernel)(const TensorStorage&, const float),
+        const Tensor& operand,
+        const float scalar,
+        const Tensor& result
+) {
+    mt::jit::record({ .kernel = kernel, .scalar = scalar }, { &operand }, result);
+}
+
 void Tensor::accumulate_grad(
         const Tensor& gradient
 ) {
-    if (m_node->m_requires_grad) {
+    if (!m_node->m_requires_grad) {
+        return;
+    }
+    const mt::DimVector& shape = m_node->m_storage.m_shape;
+
+    if (mt::is_grad_enabled()) {
+        // create_graph: the accumulation is recorded too, so the gradient can
+        // be differentiated again
         if (!m_node->m_grad) {
-            // Initialize with zeros
-            m_node->m_grad = std::make_shared<Tensor>(m_node->m_storage.m_shape);
-            m_node->m_grad->fill_inplace(0.0f);
+            m_node->m_grad = std::make_shared<Tensor>(shape, 0.0f, false);
         }
-    
         const Tensor current_grad(*m_node->m_grad);
-        Tensor new_grad = current_grad + gradient;
-    
-        m_node->m_grad->m_node = new_grad.m_node;    
+        // gradients of broadcast operands come in the broadcast shape
+        Tensor new_grad = current_grad + gradient.sum_to(shape);
+
+        m_node->m_grad->m_node = new_grad.m_node;
+        return;
     }
+
+    // gradient is the caller's, its storage is shared and never taken over
+    accumulate_grad(TensorStorage(gradient.m_node->m_storage));
+}
+
+void Tensor::accumulate_grad(
+        TensorStorage&& gradient
+) {
+    if (!m_node->m_requires_grad) {
+        return;
+    }
+    if (mt::is_grad_enabled()) {
+        accumulate_grad(Tensor(std::make_shared<TensorNode>(std::move(gradient), false)));
+        return;
+    }
+
+    // Plain backward, straight on the storages, no graph. Gradients of
+    // broadcast operands come in the broadcast shape.
+    const mt::DimVector& shape = m_node->m_storage.m_shape;
+    if (gradient.m_shape != shape) gradient = TensorStorage::s_sum_to(gradient, shape);
+
+    // an interior node of the running pass collects its gradient in the
+    // pass's scratch, it becomes a Tensor once, when the node's turn comes
+    if (std::optional<TensorStorage>* pending = pending_grad(m_node.get())) {
+        if (!*pending) {
+            *pending = std::move(gradient);
+        } else if ((*pending)->m_flat_data.use_count() == 1 && (*pending)->is_contiguous()) {
+            TensorStorage::s_add_inplace(**pending, gradient);
+        } else {
+            // a buffer shared with another gradient, or a view of one
+            *pending = TensorStorage::s_add(**pending, gradient);
+        }
+        return;
+    }
+
+    if (!m_node->m_grad) {
+        // First contribution: the incoming buffer is taken over when nothing
+        // else references it, otherwise it is copied into a buffer of our own.
+        const bool owned = gradient.m_flat_data.use_count() == 1 && gradient.is_contiguous();
+        TensorStorage first = owned ? std::move(gradient) : gradient.clone();
+        m_node->m_grad = std::make_shared<Tensor>(std::make_shared<TensorNode>(std::move(first), false));
+        return;
+    }
+
+    Tensor& current_grad = *m_node->m_grad;
+    if (current_grad.m_node->m_requires_grad) {
+        // created by an earlier create_graph backward, other gradients may
+        // depend on it, so it is replaced rather than written to
+        current_grad.m_node = std::make_shared<TensorNode>(
+            TensorStorage::s_add(current_grad.m_node->m_storage, gradient),
+            false
+        );
+        return;
+    }
+    // Later contributions are added in place with the vectorized add kernel
+    mt::expr::assign(current_grad, mt::expr::lazy(current_grad) + gradient);
 }
 
 Tensor Tensor::operator+(
@@ -168,6 +314,7 @@ Tensor Tensor::operator/(
 void Tensor::operator+=(
         const Tensor& other
 ) {
+    mt::jit::record_untraceable("an in-place addition");
     TensorStorage::s_add_inplace(
         m_node->m_storage,
         other.m_node->m_storage
@@ -190,6 +337,7 @@ Tensor Tensor::operator-(
 void Tensor::operator-=(
         const Tensor& other
 ) {
+    mt::jit::record_untraceable("an in-place subtraction");
     TensorStorage::s_sub_inplace(
         m_node->m_storage,
         other.m_node->m_storage
@@ -206,10 +354,111 @@ Tensor Tensor::operator*(
 }
 
 Tensor Tensor::operator*(
-        float scalar
+        const float scalar
+) const {
+    return apply_scalar_op_ag<TensorStorage::s_mult_scalar, BackwardMultScalar>(
+        *this,
+        scalar
+    );
+}
+
+Tensor Tensor::operator+(
+        const float scalar
+) const {
+    return apply_scalar_op_ag<TensorStorage::s_add_scalar, BackwardAddScalar>(
+        *this,
+        scalar
+    );
+}
+
+Tensor Tensor::operator-(
+        const float scalar
+) const {
+    return apply_scalar_op_ag<TensorStorage::s_sub_scalar, BackwardAddScalar>(
+        *this,
+        scalar
+    );
+}
+
+Tensor Tensor::operator/(
+        const float scalar
 ) const {
-    Tensor other(this->shape(), scalar);
-    return *this * other;
+    return apply_scalar_op_ag<TensorStorage::s_div_scalar, BackwardDivScalar>(
+        *this,
+        scalar
+    );
+}
+
+Tensor Tensor::pow(
+        const float exponent
+) const {
+    return apply_scalar_op_ag<TensorStorage::s_pow_scalar, BackwardPowScalar>(
+        *this,
+        exponent
+    );
+}
+
+Tensor Tensor::pow(
+        const float base,
+        const Tensor& exponent
+) {
+    return apply_scalar_op_ag<TensorStorage::s_rpow_scalar, BackwardRpowScalar>(
+        exponent,
+        base
+    );
+}
+
+Tensor Tensor::maximum(
+        const Tensor& a,
+        const float b
+) {
+    return apply_scalar_op_ag<TensorStorage::s_maximum_scalar, BackwardMaximumScalar>(
+        a,
+        b
+    );
+}
+
+Tensor Tensor::operator>(
+        const float scalar
+) const {
+    return apply_scalar_op_ag<TensorStorage::s_gt_scalar, void>(
+        *this,
+        scalar
+    );
+}
+
+Tensor operator+(
+        const float scalar,
+        const Tensor& tensor
+) {
+    return tensor + scalar;
+}
+
+Tensor operator-(
+        const float scalar,
+        const Tensor& tensor
+) {
+    return Tensor::apply_scalar_op_ag<TensorStorage::s_rsub_scalar, BackwardRsubScalar>(
+        tensor,
+        scalar
+    );
+}
+
+Tensor operator*(
+        const float scalar,
+        const Tensor& tensor
+) {
+    return tensor * scalar;
+}
+
+Tensor operator/(
+        const float scalar,
+        const Tensor& tensor
+) {
+    return Tensor::apply_scalar_op_ag<TensorStorage::s_rdiv_scalar, BackwardRdivScalar>(
+        tensor,
+        scalar
+    );
 }
 
 Tensor Tensor::pow(
@@ -225,6 +474,10 @@ Tensor Tensor::log() const {
     return apply_op_ag<TensorStorage::s_log, BackwardLog>(*this);
 }
 
+Tensor Tensor::exp() const {
+    return apply_op_ag<TensorStorage::s_exp, BackwardExp>(*this);
+}
+
 Tensor Tensor::maximum(
         const Tensor& a,
         const Tensor& b
@@ -235,6 +488,31 @@ Tensor Tensor::maximum(
     );
 }
 
+Tensor Tensor::relu() const {
+    // the mask is only built for a grad fn to keep, maximum(x, 0) is the
+    // same x > 0 ? x : 0 without it
+    const bool requires_grad { any_requires_grad(*this) };
+    std::vector<uint64_t> mask;
+    TensorStorage out_storage = requires_grad
+        ? TensorStorage::s_relu(m_node->m_storage, mask)
+        : TensorStorage::s_maximum_scalar(m_node->m_storage, 0.0f);
+    std::shared_ptr<TensorNode> out = mt::autograd::make_node(
+        std::move(out_storage),
+        requires_grad
+    );
+    if (out->m_requires_grad) {
+        mt::autograd::set_grad_fn<BackwardReLU>(
+            *out,
+            *this,
+            std::move(mask)
+        );
+    }
+
+    const Tensor result(out);
+    if (mt::jit::is_tracing()) mt::jit::record({ .kind = mt::jit::OpKind::Relu }, { this }, result);
+    return result;
+}
+
 Tensor Tensor::operator>(
         const Tensor& other
 ) const {
@@ -263,42 +541,131 @@ Tensor Tensor::operator<=(
 }
 
 Tensor Tensor::sum(
-        const size_t dim
+        const size_t dim,
+        const bool keepdim
+) const {
+    return sum(std::vector<size_t>{ dim }, keepdim);
+}
+
+Tensor Tensor::sum(
+        const std::vector<size_t>& dims,
+        const bool keepdim
 ) const {
     TensorStorage out_storage = TensorStorage::s_sum(
         m_node->m_storage, 
-        dim
-    );
-    std::shared_ptr<TensorNode> out = std::make_shared<TensorNode>(
-        std::move(out_storage)
+        dims,
+        keepdim
     );
-    out->m_grad_fn = std::make_unique<BackwardSum>(
-        *this,
-        dim,
-        this->m_node->m_storage.m_shape[dim]
+    std::shared_ptr<TensorNode> out = mt::autograd::make_node(
+        std::move(out_storage),
+        any_requires_grad(*this)
     );
+    if (out->m_requires_grad) {
+        mt::autograd::set_grad_fn<BackwardSum>(
+            *out,
+            *this,
+            dims,
+            keepdim
+        );
+    }
 
-    return Tensor(out);
+    const Tensor result(out);
+    if (mt::jit::is_tracing()) mt::jit::record({ .kind = mt::jit::OpKind::Sum, .dims = dims, .keepdim = keepdim }, { this }, result);
+    return result;
+}
+
+Tensor Tensor::sum() const {
+    std::vector<size_t> dims(shape().size());
+    for (size_t d = 0; d < dims.size(); ++d) dims[d] = d;
+    return sum(dims);
+}
+
+Tensor Tensor::sum_to(
+        const mt::DimVector& shape
+) const {
+    if (this->shape() == shape) {
+        return *this;
+    }
+    const auto [lead_dims, singleton_dims] = TensorStorage::sum_to_dims(this->shape(), shape);
+
+    Tensor out = *this;
+    if (!lead_dims.empty()) out = out.sum(lead_dims);
+    if (!singleton_dims.empty()) out = out.sum(singleton_dims, true);
+    return out;
 }
 
 Tensor Tensor::mean(
-        const size_t dim
+        const size_t dim,
+        const bool keepdim
+) const {
+    return mean(std::vector<size_t>{ dim }, keepdim);
+}
+
+Tensor Tensor::mean(
+        const std::vector<size_t>& dims,
+        const bool keepdim
 ) const {
-    // Compute mean by reusing sum followed by elementwise scaling by 1/N.
+    // Compute mean by reusing sum followed by a scalar scaling by 1/N.
     // This avoids introducing a dedicated BackwardMean or a s_mean storage op.
-    Tensor s = this->sum(dim);
-    const float denom = static_cast<float>(this->m_node->m_storage.m_shape[dim]);
+    Tensor s = this->sum(dims, keepdim);
+    size_t count = 1;
+    for (const size_t dim : dims) count *= this->m_node->m_storage.m_shape[dim];
+
+    return s * (1.0f / static_cast<float>(count));
+}
 
-    // Create a tensor of the same shape as `s` filled with 1/denom and mark
-    // it non-differentiable so gradients only flow back through `s`.
-    TensorStorage scale_storage = s.m_node->m_storage.fill(1.0f / denom);
-    std::shared_ptr<TensorNode> scale_node = std::make_shared<TensorNode>(
-        std::move(scale_storage),
-        false
+Tensor Tensor::mean() const {
+    std::vector<size_t> dims(shape().size());
+    for (size_t d = 0; d < dims.size(); ++d) dims[d] = d;
+    return mean(dims);
+}
+
+Tensor Tensor::softmax(
+        const size_t dim
+) const {
+    TensorStorage out_storage = TensorStorage::s_softmax(
+        m_node->m_storage,
+        dim
+    );
+    std::shared_ptr<TensorNode> out = mt::autograd::make_node(
+        std::move(out_storage),
+        any_requires_grad(*this)
+    );
+    if (out->m_requires_grad) {
+        mt::autograd::set_grad_fn<BackwardSoftmax>(
+            *out,
+            *this,
+            dim
+        );
+    }
+
+    const Tensor result(out);
+    if (mt::jit::is_tracing()) mt::jit::record({ .kind = mt::jit::OpKind::Softmax, .dims = { dim } }, { this }, result);
+    return result;
+}
+
+Tensor Tensor::log_softmax(
+        const size_t dim
+) const {
+    TensorStorage out_storage = TensorStorage::s_log_softmax(
+        m_node->m_storage,
+        dim
     );
-    Tensor scale(scale_node);
+    std::shared_ptr<TensorNode> out = mt::autograd::make_node(
+        std::move(out_storage),
+        any_requires_grad(*this)
+    );
+    if (out->m_requires_grad) {
+        mt::autograd::set_grad_fn<BackwardLogSoftmax>(
+            *out,
+            *this,
+            dim
+        );
+    }
 
-    return s * scale;
+    const Tensor result(out);
+    if (mt::jit::is_tracing()) mt::jit::record({ .kind = mt::jit::OpKind::LogSoftmax, .dims = { dim } }, { this }, result);
+    return result;
 }
 
 Tensor Tensor::unsqueeze(
@@ -308,16 +675,22 @@ Tensor Tensor::unsqueeze(
         m_node->m_storage, 
         dim
     );
-    std::shared_ptr<TensorNode> out = std::make_shared<TensorNode>(
-        std::move(out_storage)
+    std::shared_ptr<TensorNode> out = mt::autograd::make_node(
+        std::move(out_storage),
+        any_requires_grad(*this)
     );
 
-    out->m_grad_fn = std::make_unique<BackwardUnsqueeze>(
-        *this,
-        dim
-    );
+    if (out->m_requires_grad) {
+        mt::autograd::set_grad_fn<BackwardUnsqueeze>(
+            *out,
+            *this,
+            dim
+        );
+    }
 
-    return Tensor(out);
+    const Tensor result(out);
+    if (mt::jit::is_tracing()) mt::jit::record({ .kind = mt::jit::OpKind::Unsqueeze, .dims = { dim } }, { this }, result);
+    return result;
 }
 
 Tensor Tensor::squeeze(
@@ -327,16 +700,22 @@ Tensor Tensor::squeeze(
         m_node->m_storage, 
         dim
     );
-    std::shared_ptr<TensorNode> out = std::make_shared<TensorNode>(
-        std::move(out_storage)
+    std::shared_ptr<TensorNode> out = mt::autograd::make_node(
+        std::move(out_storage),
+        any_requires_grad(*this)
     );
 
-    out->m_grad_fn = std::make_unique<BackwardSqueeze>(
-        *this,
-        dim
-    );
+    if (out->m_requires_grad) {
+        mt::autograd::set_grad_fn<BackwardSqueeze>(
+            *out,
+            *this,
+            dim
+        );
+    }
 
-    return Tensor(out);
+    const Tensor result(out);
+    if (mt::jit::is_tracing()) mt::jit::record({ .kind = mt::jit::OpKind::Squeeze, .dims = { dim } }, { this }, result);
+    return result;
 }
 
 Tensor Tensor::repeat(
@@ -348,16 +727,22 @@ Tensor Tensor::repeat(
         dim,
         times
     );
-    std::shared_ptr<TensorNode> out = std::make_shared<TensorNode>(
-        std::move(out_storage)
+    std::shared_ptr<TensorNode> out = mt::autograd::make_node(
+        std::move(out_storage),
+        any_requires_grad(*this)
     );
 
-    out->m_grad_fn = std::make_unique<BackwardRepeat>(
-        *this,
-        dim
-    );
+    if (out->m_requires_grad) {
+        mt::autograd::set_grad_fn<BackwardRepeat>(
+            *out,
+            *this,
+            dim
+        );
+    }
 
-    return Tensor(out);
+    const Tensor result(out);
+    if (mt::jit::is_tracing()) mt::jit::record({ .kind = mt::jit::OpKind::Repeat, .dims = { dim, times } }, { this }, result);
+    return result;
 }
 
 Tensor Tensor::expand(
@@ -369,84 +754,87 @@ Tensor Tensor::expand(
         dim,
         times
     );
-    std::shared_ptr<TensorNode> out = std::make_shared<TensorNode>(
-        std::move(out_storage)
+    std::shared_ptr<TensorNode> out = mt::autograd::make_node(
+        std::move(out_storage),
+        any_requires_grad(*this)
     );
 
-    out->m_grad_fn = std::make_unique<BackwardRepeat>(
-        *this,
-        dim
-    );
+    if (out->m_requires_grad) {
+        mt::autograd::set_grad_fn<BackwardRepeat>(
+            *out,
+            *this,
+            dim
+        );
+    }
 
-    return Tensor(out);
+    const Tensor result(out);
+    if (mt::jit::is_tracing()) mt::jit::record({ .kind = mt::jit::OpKind::Expand, .dims = { dim, times } }, { this }, result);
+    return result;
 }
 
-Tensor Tensor::one_hot(
-        size_t num_classes
+Tensor Tensor::transpose(
+        const size_t dim0,
+        const size_t dim1
 ) const {
-    const std::vector<size_t>& in_shape = m_node->m_storage.m_shape;
-    const size_t in_numel = m_node->m_storage.m_numel;
-
-    // Build output shape by appending classes as the last dimension
-    std::vector<size_t> out_shape = in_shape;
-    out_shape.push_back(num_classes);
-
-    TensorStorage out_storage(out_shape); // zero-initialized
-
-    // Helper: convert logical index -> multi-dim coordinates for input
-    for (size_t i = 0; i < in_numel; ++i) {
-        const float raw = m_node->m_storage.get_entry_ref(i);
-        const long idx_long = static_cast<long>(raw);
-        if (idx_long < 0 || static_cast<size_t>(idx_long) >= num_classes) {
-            throw std::invalid_argument(std::format("one_hot index {} out of range [0, {}]", raw, num_classes-1));
-        }
-        const size_t cls = static_cast<size_t>(idx_long);
-
-        if (in_shape.empty()) {
-            // Scalar input -> output is 1D of length num_classes
-            std::vector<size_t> out_md{cls};
-            out_storage.get_entry_ref(out_md) = 1.0f;
-            continue;
-        }
-
-        // compute multi-dim coords for the input logical index
-        std::vector<size_t> in_md(in_shape.size());
-        size_t curr = i;
-        for (size_t d = in_shape.size(); d-- > 0; ) {
-            in_md[d] = curr % in_shape[d];
-            curr /= in_shape[d];
-        }
+    TensorStorage out_storage = TensorStorage::s_transpose(
+        m_node->m_storage, 
+        dim0,
+        dim1
+    );
+    std::shared_ptr<TensorNode> out = mt::autograd::make_node(
+        std::move(out_storage),
+        any_requires_grad(*this)
+    );
 
-        // append class dim
-        in_md.push_back(cls);
-        out_storage.get_entry_ref(in_md) = 1.0f;
+    if (out->m_requires_grad) {
+        mt::autograd::set_grad_fn<BackwardTranspose>(
+            *out,
+            *this,
+            dim0,
+            dim1
+        );
     }
 
+    const Tensor result(out);
+    if (mt::jit::is_tracing()) mt::jit::record({ .kind = mt::jit::OpKind::Transpose, .dims = { dim0, dim1 } }, { this }, result);
+    return result;
+}
+
+Tensor Tensor::one_hot(
+        size_t num_classes
+) const {
     std::shared_ptr<TensorNode> out_node = std::make_shared<TensorNode>(
-        std::move(out_storage),
+        TensorStorage::s_one_hot(m_node->m_storage, num_classes),
         false // non-differentiable
     );
 
-    return Tensor(out_node);
+    const Tensor result(out_node);
+    if (mt::jit::is_tracing()) mt::jit::record({ .kind = mt::jit::OpKind::OneHot, .dims = { num_classes } }, { this }, result);
+    return result;
 }
 
 Tensor Tensor::clone() const {
     TensorStorage out_storage = m_node->m_storage.clone();
-    std::shared_ptr<TensorNode> out = std::make_shared<TensorNode>(
-        std::move(out_storage)
+    std::shared_ptr<TensorNode> out = mt::autograd::make_node(
+        std::move(out_storage),
+        any_requires_grad(*this)
     );
 
-    out->m_grad_fn = std::make_unique<BackwardClone>(*this);
+    if (out->m_requires_grad) {
+        mt::autograd::set_grad_fn<BackwardClone>(*out, *this);
+    }
 
-    return Tensor(out);
+    const Tensor result(out);
+    if (mt::jit::is_tracing()) mt::jit::record({ .kind = mt::jit::OpKind::Clone }, { this }, result);
+    return result;
 }
 
 Tensor Tensor::matmul(
         const Tensor& a,
         const Tensor& b
 ) {
-    const std::vector<size_t>& a_shape = a.m_node->m_storage.m_shape;
-    const std::vector<size_t>& b_shape = b.m_node->m_storage.m_shape;
+    const mt::DimVector& a_shape = a.m_node->m_storage.m_shape;
+    const mt::DimVector& b_shape = b.m_node->m_storage.m_shape;
 
     const size_t a_ndim = a_shape.size();
     const size_t b_ndim = b_shape.size();
@@ -462,24 +850,8 @@ Tensor Tensor::matmul(
     const Tensor a2 = a_was_1d ? a.unsqueeze(0) : a; // [1,K] or [M,K]
     const Tensor b2 = b_was_1d ? b.unsqueeze(1) : b; // [K,1] or [K,N]
 
-    const std::vector<size_t>& a2_shape = a2.m_node->m_storage.m_shape;
-    const std::vector<size_t>& b2_shape = b2.m_node->m_storage.m_shape;
-
-    const size_t m = a2_shape[0];
-    const size_t k = a2_shape[1];
-    const size_t kb = b2_shape[0];
-    const size_t n = b2_shape[1];
-
-    if (k != kb) {
-        throw std::invalid_argument(std::format("matmul inner dimensions must match ({} != {})", k, kb));
-    }
-
-    // Use unsqueeze->expand->mult->sum pipeline on 2D views
-    const Tensor a_expanded = a2.unsqueeze(2).expand(2, n); // [m,k,1] -> [m,k,n]
-    const Tensor b_expanded = b2.unsqueeze(0).expand(0, m); // [1,k,n] -> [m,k,n]
-
-    const Tensor prod = a_expanded * b_expanded; // elementwise [m,k,n]
-    Tensor out = prod.sum(1); // sum over k -> [m,n]
+    // Blocked GEMM on the (possibly strided) 2D views, no [m,k,n] intermediate
+    Tensor out = apply_op_ag<TensorStorage::s_matmul, BackwardMatmul>(a2, b2);
 
     // Squeeze result back to original dimensionality
     if (a_was_1d && b_was_1d) {
@@ -493,11 +865,54 @@ Tensor Tensor::matmul(
     return out;
 }
 
+Tensor Tensor::linear(
+        const Tensor& x,
+        const Tensor& w,
+        const Tensor& bias,
+        const mt::kernels::Activation activation
+) {
+    const bool x_was_1d = (x.shape().size() == 1);
+    const Tensor x2 = x_was_1d ? x.unsqueeze(0) : x; // [1,K] or [M,K]
+    const bool has_bias = (bias.m_node != nullptr);
+
+    TensorStorage out_storage = TensorStorage::s_linear(
+        x2.m_node->m_storage,
+        w.m_node->m_storage,
+        has_bias ? &bias.m_node->m_storage : nullptr,
+        activation
+    );
+    std::shared_ptr<TensorNode> out = mt::autograd::make_node(
+        std::move(out_storage),
+        has_bias ? any_requires_grad(x2, w, bias) : any_requires_grad(x2, w)
+    );
+    if (out->m_requires_grad) {
+        if (has_bias) {
+            mt::autograd::set_grad_fn<BackwardLinear>(*out, x2, w, bias, activation);
+        } else {
+            mt::autograd::set_grad_fn<BackwardLinearNoBias>(*out, x2, w, activation);
+        }
+    }
+
+    const Tensor result(out);
+    if (mt::jit::is_tracing()) {
+        const mt::jit::Op op { .kind = mt::jit::OpKind::Linear, .activation = activation };
+        if (has_bias) {
+            mt::jit::record(op, { &x2, &w, &bias }, result);
+        } else {
+            mt::jit::record(op, { &x2, &w }, result);
+        }
+    }
+    return x_was_1d ? result.squeeze(0) : result;
+}
+
 Tensor Tensor::grad() const {
+    if (!m_node->m_grad) {
+        throw std::invalid_argument(std::format("\nTensor has no gradient: backward did not reach it, or it is a non-leaf tensor without retain_grad()."));
+    }
     return *m_node->m_grad;
 }
 
-const std::vector<size_t>& Tensor::shape() const {
+const mt::DimVector& Tensor::shape() const {
     return m_node->m_storage.m_shape;
 }
 
@@ -505,83 +920,206 @@ size_t Tensor::numel() const {
     return m_node->m_storage.m_numel;
 }
 
-std::map<TensorNode*, int> Tensor::compute_in_degree() const {
-    std::map<TensorNode*, int> in_degree;
-    std::queue<TensorNode*> bfs_queue;
-    std::set<TensorNode*> visited;
-
-    TensorNode* start = m_node.get();
-    bfs_queue.push(start);
-    visited.insert(start);
-    in_degree[start] = 0; 
-    
-    // 1. Calculate in-degrees via BFS
-    while(!bfs_queue.empty()) {
-        TensorNode* u = bfs_queue.front();
-        bfs_queue.pop();
-        
-        if (u->m_grad_fn) {
-            const std::vector<Tensor> operands = u->m_grad_fn->get_operands();
-            for(auto& op : operands) {
-                TensorNode* v = op.m_node.get();
-                in_degree[v]++;
-                if(visited.find(v) == visited.end()) {
-                    visited.insert(v);
-                    bfs_queue.push(v);
-                }
-            }
+namespace {
+    // Scratch of the backward pass, reused across calls so that ordering the
+    // graph allocates nothing once its buffers have grown to the graph size.
+    struct BackwardScratch {
+        // open-addressing set of the visited nodes, nullptr marks free slots
+        std::vector<TensorNode*> visited {};
+        size_t visited_count { 0 };
+        std::vector<TensorNode*> stack {};
+        // interior nodes (those with a grad fn), each held until processed
+        std::vector<std::shared_ptr<TensorNode>> order {};
+        // gradient of each interior node at its slot of visited, summed on
+        // storages until the node is processed
+        std::vector<std::optional<TensorStorage>> grads {};
+    };
+
+    thread_local BackwardScratch t_backward_scratch {};
+    // scratch of the plain (no create_graph) pass running on this thread
+    thread_local BackwardScratch* t_pass_scratch { nullptr };
+
+    // Fibonacci hashing of the sequence number, table sizes are powers of two.
+    size_t visited_slot(
+            const TensorNode* node,
+            const size_t mask
+    ) {
+        return static_cast<size_t>((node->m_sequence_nr * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+    }
+
+    // Slot of node in the visited set, the table's size when it is absent.
+    size_t find_visited(
+            const BackwardScratch& scratch,
+            const TensorNode* node
+    ) {
+        const std::vector<TensorNode*>& table = scratch.visited;
+        if (table.empty()) return 0;
+        size_t slot = visited_slot(node, table.size() - 1);
+        while (table[slot]) {
+            if (table[slot] == node) return slot;
+            slot = (slot + 1) & (table.size() - 1);
         }
+        return table.size();
     }
 
-    return in_degree;
-}
+    // Makes scratch the calling thread's pass scratch for its scope, the one
+    // of an outer pass (backward run from a grad fn) is restored on exit.
+    class PassScratchGuard {
+    public:
+        explicit PassScratchGuard(
+                BackwardScratch* scratch
+        ):
+            m_outer{ std::exchange(t_pass_scratch, scratch) } {}
+
+        ~PassScratchGuard() {
+            t_pass_scratch = m_outer;
+        }
 
-void Tensor::topological_backprop(
-        std::map<TensorNode*, int>& in_degree,
-        const bool retain_graph
-) const {
-    // Process in topological order
-    // Use Tensor objects in the queue (they hold shared_ptr to the node)
-    std::queue<Tensor> process_queue;
-    process_queue.push(*this);
-
-    while(!process_queue.empty()) {
-        Tensor u_tensor = process_queue.front();
-        process_queue.pop();
-        TensorNode* u = u_tensor.m_node.get();
-
-        if (u->m_grad_fn) {
-            // Push accumulated gradient to children
-            u->m_grad_fn->compute_operands_grad(
-                u_tensor
-            );
-
-            std::vector<Tensor> operands = u->m_grad_fn->get_operands();
-            for (auto& op : operands) {
-                TensorNode* v = op.m_node.get();
-                in_degree[v]--;
-                if(in_degree[v] == 0) {
-                    process_queue.push(op);
-                }
+        PassScratchGuard(const PassScratchGuard&) = delete;
+        PassScratchGuard& operator=(const PassScratchGuard&) = delete;
+
+    private:
+        BackwardScratch* const m_outer;
+    };
+
+    std::optional<TensorStorage>* pending_grad(
+            const TensorNode* node
+    ) {
+        if (!t_pass_scratch) return nullptr;
+        const size_t slot { find_visited(*t_pass_scratch, node) };
+        return slot < t_pass_scratch->grads.size() ? &t_pass_scratch->grads[slot] : nullptr;
+    }
+
+    // Adds node to the visited set, false when it was already there. The
+    // table is kept at most half full.
+    bool insert_visited(
+            BackwardScratch& scratch,
+            TensorNode* node
+    ) {
+        std::vector<TensorNode*>& table = scratch.visited;
+        if (2 * (scratch.visited_count + 1) > table.size()) {
+            std::vector<TensorNode*> old(std::max<size_t>(64, 2 * table.size()), nullptr);
+            old.swap(table);
+            for (TensorNode* n : old) {
+                if (!n) continue;
+                size_t slot = visited_slot(n, table.size() - 1);
+                while (table[slot]) slot = (slot + 1) & (table.size() - 1);
+                table[slot] = n;
             }
-            if (!retain_graph) {
-                u->m_grad_fn = nullptr;
+        }
+
+        size_t slot = visited_slot(node, table.size() - 1);
+        while (table[slot]) {
+            if (table[slot] == node) return false;
+            slot = (slot + 1) & (table.size() - 1);
+        }
+        table[slot] = node;
+        ++scratch.visited_count;
+        return true;
+    }
+
+    // Collects the interior nodes reachable from root into scratch.order, in
+    // reverse creation order. A node is created after its operands, so every
+    // consumer of a node comes before it: a topological order for backward.
+    void order_interior_nodes(
+            const std::shared_ptr<TensorNode>& root,
+            BackwardScratch& scratch
+    ) {
+        std::fill(scratch.visited.begin(), scratch.visited.end(), nullptr);
+        scratch.visited_count = 0;
+        scratch.stack.clear();
+        scratch.order.clear();
+        if (!root->m_grad_fn) return;
+
+        insert_visited(scratch, root.get());
+        scratch.order.push_back(root);
+        scratch.stack.push_back(root.get());
+        while (!scratch.stack.empty()) {
+            TensorNode* u = scratch.stack.back();
+            scratch.stack.pop_back();
+            for (const Tensor& op : u->m_grad_fn->operands()) {
+                TensorNode* v = op.m_node.get();
+                if (!v->m_grad_fn || !insert_visited(scratch, v)) continue;
+                scratch.order.push_back(op.m_node);
+                scratch.stack.push_back(v);
             }
         }
+
+        std::sort(scratch.order.begin(), scratch.order.end(), [](const auto& a, const auto& b) {
+            return a->m_sequence_nr > b->m_sequence_nr;
+        });
     }
 }
 
 void Tensor::backward(
-        const bool retain_graph
+        const bool retain_graph,
+        const bool create_graph
 ) {
     if (m_node->m_requires_grad) {
-        m_node->m_grad = std::make_shared<Tensor>(m_node->m_storage.m_shape);
-        m_node->m_grad->fill_inplace(1.0f);
-        
-        // map to store in-degrees (number of parents in the computation graph that use this node)
-        std::map<TensorNode*, int> in_degree { compute_in_degree() };
-        // topological sort to ensure correctness for DAGs (shared nodes)
-        topological_backprop(in_degree, retain_graph);
+        // grad fns use tracked ops only when create_graph asks for a graph of
+        // the backward pass itself, otherwise nothing is recorded
+        mt::GradModeGuard grad_mode(create_graph);
+        // the forward graph is part of a created one, so it is kept
+        const bool keep_graph = retain_graph || create_graph;
+
+        // a plain pass over a graph recorded on this thread's tape is a
+        // reverse scan of it (see tape.h)
+        if (!keep_graph && mt::autograd::can_replay(*m_node)) {
+            m_node->m_grad = std::make_shared<Tensor>(m_node->m_storage.m_shape, 1.0f, false);
+            // a pass of an enclosing backward does not own the tape's slots
+            const PassScratchGuard no_pass_scratch(nullptr);
+            mt::autograd::replay(m_node);
+            return;
+        }
+        // gradients left on the tape's interior nodes would be added to by a
+        // later replay
+        if (keep_graph) mt::autograd::invalidate_tape();
+
+        // taken out of the thread's slot for the duration of the pass, so a
+        // backward started from inside a grad fn gets a scratch of its own
+        BackwardScratch scratch = std::exchange(t_backward_scratch, {});
+        order_interior_nodes(m_node, scratch);
+
+        // gradients of interior nodes are per-pass buffers: one left over from
+        // an earlier (retained or created) backward must not be added to
+        for (const std::shared_ptr<TensorNode>& node : scratch.order) node->m_grad = nullptr;
+        m_node->m_grad = std::make_shared<Tensor>(m_node->m_storage.m_shape, 1.0f, false);
+
+        // a plain pass sums the interior gradients in the scratch (see
+        // accumulate_grad), a created graph needs them as tracked tensors
+        scratch.grads.assign(create_graph ? 0 : scratch.visited.size(), std::nullopt);
+        const PassScratchGuard pass_scratch(create_graph ? nullptr : &scratch);
+
+        for (std::shared_ptr<TensorNode>& node : scratch.order) {
+            // our reference is dropped with u, a node nothing else holds is
+            // freed as soon as it is done
+            const Tensor u(std::move(node));
+            const size_t slot { find_visited(scratch, u.m_node.get()) };
+            if (slot < scratch.grads.size() && scratch.grads[slot]) {
+                // every consumer has sent its part: wrapped once, contiguous
+                // for the grad fn's kernels
+                TensorStorage& grad = *scratch.grads[slot];
+                u.m_node->m_grad = std::make_shared<Tensor>(std::make_shared<TensorNode>(
+                    grad.is_contiguous() ? std::move(grad) : grad.clone(),
+                    false
+                ));
+                scratch.grads[slot].reset();
+            }
+            // no consumer sent a gradient (e.g. class indices of a loss)
+            if (u.m_node->m_grad) u.m_node->m_grad_fn->compute_operands_grad(u);
+
+            // the saved operands and the gradient of an interior node are
+            // only needed by its own grad fn, release them right away
+            if (!keep_graph) {
+                u.m_node->m_grad_fn = nullptr;
+            }
+            if (!u.m_node->m_retains_grad) {
+                u.m_node->m_grad = nullptr;
+            }
+        }
+
+        scratch.order.clear();
+        t_backward_scratch = std::move(scratch);
     }
     else {
         throw std::invalid_argument(std::format("\nCannot call backward on tensor with requires_grad=False. Likely, the graph has no leaf nodes requiring gradients."));
@@ -595,9 +1133,10 @@ namespace mt {
         if (tensors.empty()) {
             throw std::invalid_argument(std::format("stack requires at least one tensor"));
         }
+        mt::jit::record_untraceable("mt::stack");
 
         const TensorStorage& first_storage = tensors[0].m_node->m_storage;
-        const std::vector<size_t>& first_shape = first_storage.m_shape;
+        const mt::DimVector& first_shape = first_storage.m_shape;
         const size_t slice_numel = first_storage.m_numel;
 
         // Ensure all tensors have the same shape
@@ -608,20 +1147,27 @@ namespace mt {
         }
 
         // New shape: prepend the number of tensors as the first dimension
-        std::vector<size_t> out_shape;
-        out_shape.reserve(first_shape.size() + 1);
-        out_shape.push_back(tensors.size());
-        out_shape.insert(out_shape.end(), first_shape.begin(), first_shape.end());
-
-        TensorStorage out_storage(out_shape);
-
-        // Copy data for each tensor into the corresponding slice
-        auto& dst_vec = *out_storage.m_flat_data;
-        for (size_t i = 0; i < tensors.size(); ++i) {
-            const auto& src_vec = *tensors[i].m_node->m_storage.m_flat_data;
-            auto offset = static_cast<std::vector<float>::difference_type>(i * slice_numel);
-            std::copy(src_vec.begin(), src_vec.end(), dst_vec.begin() + offset);
-        }
+        mt::DimVector out_shape { tensors.size() };
+        for (const size_t dim : first_shape) out_shape.push_back(dim);
+
+        TensorStorage out_storage { TensorStorage::empty(out_shape) };
+
+        // Copy data for each tensor into the corresponding slice, slices are
+        // disjoint so whole tensors are spread across the pool
+        float* dst = out_storage.data();
+        const size_t grain = std::max<size_t>(1, GRAIN_SIZE / slice_numel);
+        parallel_for(0, tensors.size(), grain, [&](const size_t begin, const size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                const TensorStorage& src = tensors[i].m_node->m_storage;
+                if (src.is_contiguous()) {
+                    std::copy(src.data(), src.data() + slice_numel, dst + i * slice_numel);
+                } else {
+                    for (size_t j = 0; j < slice_numel; ++j) {
+                        dst[i * slice_numel + j] = src.get_entry_ref(j);
+                    }
+                }
+            }
+        });
 
         std::shared_ptr<TensorNode> out_node = std::make_shared<TensorNode>(std::move(out_storage));
         return Tensor(out_node);
@@ -6,6 +6,18 @@
 #include <iostream>
 
 #include "tensor_nodes.h"
+#include "grad_mode.h"
+#include "tape.h"
+
+// The tensor ops append themselves to the calling thread's trace while one
+// is recorded (see jit/trace.h).
+namespace mt::jit {
+    bool is_tracing();
+
+    void record_untraceable(
+            const char* what
+    );
+}
 
 class Tensor {
 public:
@@ -14,7 +26,7 @@ public:
     friend class TensorNode;
 
     Tensor(
-            const std::vector<size_t> shape,
+            const mt::DimVector shape,
             const float value = 0.0f,
             const bool requires_grad = true
     );
@@ -23,10 +35,26 @@ public:
             const std::shared_ptr<TensorNode> node
     );
 
+    Tensor(const Tensor& other) = default;
+    Tensor(Tensor&& other) noexcept = default;
+    Tensor& operator=(const Tensor& other);
+    Tensor& operator=(Tensor&& other) noexcept;
+
+    // Dropping the last handle that may read a node's values releases its
+    // buffer when only graph edges that do not read it are left, e.g. the
+    // input of a ReLU (see TensorNode::m_edge_refs).
+    ~Tensor();
+
     friend std::ostream& operator<<(std::ostream& os, const Tensor& tensor);
     
+    // The non-const overload hands out a writable entry, a trace cannot
+    // follow writes through it and fails.
     float& operator[](
-            const std::vector<size_t>& md_index
+            const mt::DimVector& md_index
+    );
+
+    float& operator[](
+            const mt::DimVector& md_index
     ) const;
 
     float& item() const;
@@ -35,25 +63,37 @@ public:
 
     Tensor grad() const;
 
-    const std::vector<size_t>& shape() const;
+    const mt::DimVector& shape() const;
     
     size_t numel() const;
 
+    // Backpropagates from this tensor, seeded with ones. The graph is freed
+    // on the way unless retain_graph is set. With create_graph the gradients
+    // are computed with tracked ops, so they can be differentiated again
+    // (implies retain_graph), otherwise they are plain storages and the
+    // backward pass records nothing.
     void backward(
-            const bool retain_graph = false
+            const bool retain_graph = false,
+            const bool create_graph = false
     );
 
+    // Adds gradient, summed back to this tensor's shape, to grad(). Under
+    // create_graph (grad mode on) the addition is tracked. Otherwise later
+    // contributions are added into grad() in place, and gradient itself is
+    // never modified: a first contribution is copied.
     void accumulate_grad(
             const Tensor& gradient
     );
 
-    std::map<TensorNode*, int> compute_in_degree() const;
+    // The same for a gradient computed on storages, as the grad fns do
+    // outside create_graph. A first contribution's buffer is taken over when
+    // gradient is its only owner. During a plain backward an interior node's
+    // gradients are summed in the pass's scratch and wrapped in a Tensor
+    // once, when the node's grad fn runs.
+    void accumulate_grad(
+            TensorStorage&& gradient
+    );
 
-    void topological_backprop(
-            std::map<TensorNode*, int>& in_degree,
-            const bool retain_graph
-    ) const;
-    
     void fill_inplace(
             const float value
     );
@@ -73,7 +113,7 @@ public:
     ) const;
 
     static Tensor linspace(
-            const std::vector<size_t>& shape,
+            const mt::DimVector& shape,
             const float start,
             const float end,
             const bool requires_grad = true
@@ -85,30 +125,94 @@ public:
 
     void detach_inplace();
 
+    // Keeps grad() of this non-leaf tensor after backward, which otherwise
+    // frees it once its grad fn has run. Leaves always keep theirs.
+    void retain_grad();
+
     static bool compute_requires_grad_from_operands(
         const std::vector<Tensor>& others
     );
 
+    // Whether an op on these operands records a grad fn: grad mode is on
+    // and at least one of them requires grad.
+    template <typename... Tensors>
+    static bool any_requires_grad(
+            const Tensors&... operands
+    ) {
+        return mt::is_grad_enabled() && (operands.m_node->m_requires_grad || ...);
+    }
+
+    // Appends result, computed by a storage kernel from the operands, to the
+    // calling thread's trace. Only called while one is recorded.
+    static void record_kernel(
+            TensorStorage (*kernel)(const TensorStorage&),
+            const Tensor& operand,
+            const Tensor& result
+    );
+
+    static void record_kernel(
+            TensorStorage (*kernel)(const TensorStorage&, const TensorStorage&),
+            const Tensor& a,
+            const Tensor& b,
+            const Tensor& result
+    );
+
+    static void record_kernel(
+            TensorStorage (*kernel)(const TensorStorage&, const float),
+            const Tensor& operand,
+            const float scalar,
+            const Tensor& result
+    );
+
     template <auto Op, typename GradFn_T, typename... Tensors>
     static Tensor apply_op_ag(
             const Tensors&... operands
     ) {
         TensorStorage out_storage = Op(operands.m_node->m_storage...);
-        std::shared_ptr<TensorNode> out = std::make_shared<TensorNode>(
-            std::move(out_storage),
-            compute_requires_grad_from_operands({operands...})
-        );
+        // outputs without a grad fn (comparisons) are constants: they do not
+        // require grad and are not put on the tape
+        std::shared_ptr<TensorNode> out = std::is_same_v<GradFn_T, void>
+            ? std::make_shared<TensorNode>(std::move(out_storage), false)
+            : mt::autograd::make_node(std::move(out_storage), any_requires_grad(operands...));
+        if constexpr (!std::is_same_v<GradFn_T, void>) {
+            if (out->m_requires_grad) {
+                mt::autograd::set_grad_fn<GradFn_T>(*out, operands...);
+            }
+        }
+        const Tensor result(out);
+        if (mt::jit::is_tracing()) record_kernel(Op, operands..., result);
+        return result;
+    }
+
+    // Like apply_op_ag for ops with a float operand. The scalar is not
+    // materialized in forward nor in backward, where GradFn_T receives it
+    // as a plain float.
+    template <auto Op, typename GradFn_T>
+    static Tensor apply_scalar_op_ag(
+            const Tensor& operand,
+            const float scalar
+    ) {
+        TensorStorage out_storage = Op(operand.m_node->m_storage, scalar);
+        std::shared_ptr<TensorNode> out = std::is_same_v<GradFn_T, void>
+            ? std::make_shared<TensorNode>(std::move(out_storage), false)
+            : mt::autograd::make_node(std::move(out_storage), any_requires_grad(operand));
         if constexpr (!std::is_same_v<GradFn_T, void>) {
             if (out->m_requires_grad) {
-                out->m_grad_fn = std::make_unique<GradFn_T>(operands...);
+                mt::autograd::set_grad_fn<GradFn_T>(*out, operand, scalar);
             }
         }
-        return Tensor(out);
+        const Tensor result(out);
+        if (mt::jit::is_tracing()) record_kernel(Op, operand, scalar, result);
+        return result;
     }
 
     Tensor operator+(
             const Tensor& other
     ) const;
+
+    Tensor operator+(
+            const float scalar
+    ) const;
     
     void operator+=(
             const Tensor& other
@@ -123,33 +227,66 @@ public:
     Tensor operator-(
             const Tensor& other
     ) const;
+
+    Tensor operator-(
+            const float scalar
+    ) const;
     
     Tensor operator*(
             const Tensor& other
     ) const;
     
     Tensor operator*(
-            float scalar
+            const float scalar
     ) const;
     
     Tensor operator/(
             const Tensor& other
     ) const;
+
+    Tensor operator/(
+            const float scalar
+    ) const;
     
     Tensor pow(
             const Tensor& other
     ) const;
+
+    Tensor pow(
+            const float exponent
+    ) const;
+
+    // base^exponent for a float base, e.g. pow(e, x).
+    static Tensor pow(
+            const float base,
+            const Tensor& exponent
+    );
     
     Tensor log() const;
 
+    Tensor exp() const;
+
     static Tensor maximum(
             const Tensor& a,
             const Tensor& b
     );
 
+    static Tensor maximum(
+            const Tensor& a,
+            const float b
+    );
+
+    // max(x, 0). The grad fn keeps a 1-bit-per-element mask of x > 0
+    // instead of a float tensor.
+    Tensor relu() const;
+
     Tensor operator>(
             const Tensor& other
     ) const;
+
+    Tensor operator>(
+            const float scalar
+    ) const;
     
     Tensor operator>=(
             const Tensor& other
@@ -160,10 +297,46 @@ public:
     ) const;
     
     Tensor sum(
-            const size_t dim
+            const size_t dim,
+            const bool keepdim = false
+    ) const;
+
+    Tensor sum(
+            const std::vector<size_t>& dims,
+            const bool keepdim = false
+    ) const;
+
+    // Sum of all elements, as a scalar.
+    Tensor sum() const;
+    
+    // Sums a broadcast tensor back to shape, which must broadcast to this
+    // tensor's shape (the reduction of a broadcast gradient).
+    Tensor sum_to(
+            const mt::DimVector& shape
     ) const;
     
     Tensor mean(
+            const size_t dim,
+            const bool keepdim = false
+    ) const;
+
+    Tensor mean(
+            const std::vector<size_t>& dims,
+            const bool keepdim = false
+    ) const;
+
+    Tensor mean() const;
+
+    // Normalized exponentials along dim, computed in one fused kernel per row
+    // (max-shifted, so large inputs are safe). The backward pass only needs
+    // the output.
+    Tensor softmax(
+            const size_t dim
+    ) const;
+
+    // log(softmax(x)) along dim, without going through the probabilities:
+    // entries far below the row max do not underflow to log(0).
+    Tensor log_softmax(
             const size_t dim
     ) const;
     
@@ -184,6 +357,11 @@ public:
             const size_t dim,
             const size_t times
     ) const;
+    
+    Tensor transpose(
+            const size_t dim0,
+            const size_t dim1
+    ) const;
 
     Tensor one_hot(
         size_t num_classes
@@ -195,9 +373,40 @@ public:
             const Tensor& a,
             const Tensor& b
     );
+
+    // activation(x·w + bias) as a single op: one GEMM whose epilogue adds
+    // the bias and applies the activation, and one grad fn for dx, dw and
+    // dbias. x is [m, k] or [k], w is [k, n], bias is [n] or a null tensor.
+    static Tensor linear(
+            const Tensor& x,
+            const Tensor& w,
+            const Tensor& bias,
+            const mt::kernels::Activation activation = mt::kernels::Activation::None
+    );
 private:
 };
 
+// Float on the left-hand side.
+Tensor operator+(
+        const float scalar,
+        const Tensor& tensor
+);
+
+Tensor operator-(
+        const float scalar,
+        const Tensor& tensor
+);
+
+Tensor operator*(
+        const float scalar,
+        const Tensor& tensor
+);
+
+Tensor operator/(
+        const float scalar,
+        const Tensor& tensor
+);
+
 namespace mt {
     Tensor stack(
         const std::vector<Tensor>& tensors
@@ -7,14 +7,14 @@
 #include "core/tensors.h"
 #include "core/tensor_nodes.h"
 #include "core/tensor_storages.h"
-#include "src/core/nn/modules.h"
-#include "src/core/nn/compute.h"
 #include "src/core/nn/activations.h"
 #include "src/core/nn/losses.h"
 #include "src/core/nn/optimizers.h"
+#include "src/core/jit/capture.h"
 #include "src/data/datasets.h"
 #include "src/data/dataloaders.h"
 #include "src/io/csv.h"
+#include "src/models/covertype.h"
 
 namespace nn = mt::nn;
 
@@ -62,66 +62,32 @@ void try_covertype() {
         io::CSVReader m_csv_reader;
     };
 
-    class CovertypeClassifier: public nn::Module, nn::Forward1 {
-    public:
-        nn::Linear lin1;
-        nn::ReLU relu;
-        nn::Linear lin2;
-        nn::Linear lin3;
-
-        CovertypeClassifier():
-            lin1(54, 100),
-            relu{},
-            lin2(100, 100),
-            lin3(100, 7) {
-                register_module("lin1", lin1);
-                register_module("lin2", lin2);
-                register_module("lin3", lin3);
-                reset_parameters();
-            }
+    using mt::models::CovertypeClassifier;
 
-        Tensor forward(
-                const Tensor& inputs
-        ) const {
-            Tensor y1 = lin1.forward(inputs);
-            Tensor y2 = relu.forward(y1);
-            Tensor y3 = lin2.forward(y2);
-            Tensor y4 = relu.forward(y3);
-            Tensor prs = lin3.forward(y4);
-            return prs;
-        }
-
-        void reset_parameters() {
-            nn::kaiming_uniform_inplace(lin1.m_weight, get_rng());
-            lin1.m_bias.fill_inplace(0.0f);
-            nn::kaiming_uniform_inplace(lin2.m_weight, get_rng());
-            lin2.m_bias.fill_inplace(0.0f);
-            nn::kaiming_uniform_inplace(lin3.m_weight, get_rng());
-            lin3.m_bias.fill_inplace(0.0f);
-        }
-
-        Tensor evaluate(
+    const auto evaluate = [](
+            const CovertypeClassifier& model,
             mt::data::DataLoader<Tensor, Tensor>& dl,
             nn::Loss& criterion
-        ) {
-            float curr_loss = 0;
-            float curr_sample_count = 0;
+    ) {
+        // forward math only, no graph is built for validation batches
+        mt::InferenceModeGuard inference_mode;
 
-            for (size_t step { 0 }; step < dl.size(); ++step) {
-                auto [inputs, gts] = dl.get_batch(step);
-                
-                Tensor prs_oh = forward(inputs);
+        float curr_loss = 0;
+        float curr_sample_count = 0;
 
-                Tensor gts_oh = gts.one_hot(prs_oh.shape()[1]);
+        for (size_t step { 0 }; step < dl.size(); ++step) {
+            auto [inputs, gts] = dl.get_batch(step);
             
-                Tensor loss = criterion.forward(prs_oh, gts_oh);
+            Tensor prs_oh = model.forward(inputs);
 
-                curr_loss += loss.item()*(static_cast<float>(inputs.shape()[0]));
-                curr_sample_count += static_cast<float>(inputs.shape()[0]);
-            }
-            float total_loss = curr_loss / curr_sample_count;
-            return Tensor({}, total_loss);
+            // class indices go straight to the fused cross-entropy
+            Tensor loss = criterion.forward(prs_oh, gts);
+
+            curr_loss += loss.item()*(static_cast<float>(inputs.shape()[0]));
+            curr_sample_count += static_cast<float>(inputs.shape()[0]);
         }
+        float total_loss = curr_loss / curr_sample_count;
+        return Tensor({}, total_loss);
     };
 
     auto START = std::chrono::high_resolution_clock::now();
@@ -146,7 +112,7 @@ void try_covertype() {
 
     START = std::chrono::high_resolution_clock::now();
 
-    CovertypeClassifier model{};
+    CovertypeClassifier model(get_rng());
 
     std::cout << std::format("Model set up (took {} s)",
         static_cast<double>((std::chrono::high_resolution_clock::now() - START).count())/1e9
@@ -164,13 +130,25 @@ void try_covertype() {
 
     START = std::chrono::high_resolution_clock::now();
 
-    auto init_val_loss = model.evaluate(val_dl, criterion);
+    auto init_val_loss = evaluate(model, val_dl, criterion);
 
     std::cout << std::format("Initial loss: {} (took {} s)",
         init_val_loss.item(),
         static_cast<double>((std::chrono::high_resolution_clock::now() - START).count())/1e9
     ) << '\n';
 
+    // The training step is captured once on the first batch and replayed on
+    // the others, the last partial batch runs eagerly.
+    const mt::jit::CapturedStep::StepFn train_step_fn = [&](const std::vector<Tensor>& batch) {
+        Tensor prs_oh = model.forward(batch[0]);
+        return criterion.forward(prs_oh, batch[1]);
+    };
+    auto [first_inputs, first_gts] = train_dl.get_batch(0);
+    mt::jit::CapturedStep train_step(train_step_fn, { first_inputs, first_gts });
+    for (const mt::jit::PassStats& stats : train_step.pass_stats()) {
+        std::cout << stats << '\n';
+    }
+
     const size_t num_epochs = 2;
 
     for (size_t epoch { 0 }; epoch < num_epochs; ++epoch) {
@@ -179,20 +157,15 @@ void try_covertype() {
 
         for (size_t step { 0 }; step < train_dl.size(); ++step) {
             auto [inputs, gts] = train_dl.get_batch(step);
-            
-            Tensor prs_oh = model.forward(inputs);
 
-            Tensor gts_oh = gts.one_hot(prs_oh.shape()[1]);
-
-            Tensor loss = criterion.forward(prs_oh, gts_oh);
-            loss.backward();
+            Tensor loss = train_step.run({ inputs, gts });
 
             // if (step % 10 == 0) {
             //     std::cout << loss << '\n';
             // }
             
             optimizer.step();
-            optimizer.zero_grad();
+            optimizer.zero_grad(true);
         }
 
         std::cout << std::format("[Epoch {}/{}] Training done: (took {} s)",
@@ -200,10 +173,13 @@ void try_covertype() {
             num_epochs,
             static_cast<double>((std::chrono::high_resolution_clock::now() - START).count())/1e9
         ) << '\n';
+        if (epoch == 0) {
+            std::cout << train_step.memory_plan().stats() << '\n';
+        }
 
         START = std::chrono::high_resolution_clock::now();
         
-        auto epoch_val_loss = model.evaluate(val_dl, criterion);
+        auto epoch_val_loss = evaluate(model, val_dl, criterion);
         
         std::cout << std::format("[Epoch {}/{}] val. loss: {} (took {} s)",
             epoch+1,
@@ -217,7 +193,7 @@ void try_covertype() {
 
     START = std::chrono::high_resolution_clock::now();
 
-    auto final_train_loss = model.evaluate(train_dl, criterion);
+    auto final_train_loss = evaluate(model, train_dl, criterion);
 
     std::cout << std::format("Final training loss: {} (took {} s)",
         final_train_loss.item(),
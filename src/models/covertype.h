@@ -0,0 +1,60 @@
+#ifndef COVERTYPE_H
+#define COVERTYPE_H
+
+#include <random>
+#include <utility>
+
+#include "src/core/tensors.h"
+#include "src/core/nn/modules.h"
+#include "src/core/nn/compute.h"
+
+namespace mt::models {
+    // The covertype classifier: 54 features, two hidden layers of 100 with
+    // ReLU fused in, 7 classes. Shared by src/main.cpp and the AOT tools, so
+    // that the generated code is checked against the model that is trained.
+    class CovertypeClassifier: public mt::nn::Module, public mt::nn::Forward1 {
+    public:
+        static constexpr size_t NUM_FEATURES { 54 };
+        static constexpr size_t NUM_CLASSES { 7 };
+
+        mt::nn::Linear lin1;
+        mt::nn::Linear lin2;
+        mt::nn::Linear lin3;
+
+        explicit CovertypeClassifier(
+                std::mt19937&& rng
+        ):
+            lin1(NUM_FEATURES, 100, true, mt::nn::Activation::ReLU),
+            lin2(100, 100, true, mt::nn::Activation::ReLU),
+            lin3(100, NUM_CLASSES) {
+            register_module("lin1", lin1);
+            register_module("lin2", lin2);
+            register_module("lin3", lin3);
+            reset_parameters(std::move(rng));
+        }
+
+        Tensor forward(
+                const Tensor& inputs
+        ) const override {
+            // ReLU is fused into the first two layers
+            Tensor y1 = lin1.forward(inputs);
+            Tensor y2 = lin2.forward(y1);
+            return lin3.forward(y2);
+        }
+
+        // Kaiming-uniform weights, each layer from its own seed drawn from
+        // rng, and zero biases.
+        void reset_parameters(
+                std::mt19937&& rng
+        ) {
+            mt::nn::kaiming_uniform_inplace(lin1.m_weight, std::mt19937(rng()));
+            lin1.m_bias.fill_inplace(0.0f);
+            mt::nn::kaiming_uniform_inplace(lin2.m_weight, std::mt19937(rng()));
+            lin2.m_bias.fill_inplace(0.0f);
+            mt::nn::kaiming_uniform_inplace(lin3.m_weight, std::mt19937(rng()));
+            lin3.m_bias.fill_inplace(0.0f);
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,140 @@
+#ifndef TEST_CREATE_GRAPH_H
+#define TEST_CREATE_GRAPH_H
+
+#include <cmath>
+#include <functional>
+
+#include "src/core/tensors.h"
+#include "src/core/expressions.h"
+#include "src/core/nn/losses.h"
+#include "tests/test_utils.h"
+
+// A fresh leaf holding x0 + eps * v.
+Tensor shifted_leaf(
+        const Tensor& x0,
+        const Tensor& v,
+        const float eps
+) {
+    Tensor leaf(x0.shape());
+    mt::expr::assign(leaf, mt::expr::lazy(x0) + mt::expr::lazy(v) * eps);
+    return leaf;
+}
+
+// Hessian-vector product of loss at x0 along v, once by double backward and
+// once by central differences of plain gradients. Returns the largest
+// difference relative to the largest entry.
+float hvp_error(
+        const std::function<Tensor(const Tensor&)>& loss,
+        const Tensor& x0,
+        const Tensor& v
+) {
+    Tensor x = shifted_leaf(x0, v, 0.0f);
+    loss(x).backward(false, true);
+    Tensor g = x.grad();
+    x.zero_grad();
+    (g * v).sum().backward();
+    Tensor hv = x.grad();
+
+    const float eps { 1e-2f };
+    Tensor xp = shifted_leaf(x0, v, eps);
+    Tensor xm = shifted_leaf(x0, v, -eps);
+    loss(xp).backward();
+    loss(xm).backward();
+
+    float max_diff { 0.0f };
+    float max_ref { 1e-3f };
+    for (size_t i = 0; i < x0.numel(); ++i) {
+        const float fd = (xp.grad().m_node->m_storage.get_entry_ref(i) - xm.grad().m_node->m_storage.get_entry_ref(i)) / (2.0f * eps);
+        max_diff = std::max(max_diff, std::abs(hv.m_node->m_storage.get_entry_ref(i) - fd));
+        max_ref = std::max(max_ref, std::abs(fd));
+    }
+    return max_diff / max_ref;
+}
+
+void test_create_graph() {
+
+    std::cout << "\n===[ test_create_graph.h ]===\n";
+
+    // 1. Plain backward records nothing and frees the graph
+    {
+        Tensor a = Tensor::linspace({2, 3}, -1.0f, 1.0f);
+        Tensor b = Tensor::linspace({3}, 0.5f, 2.0f);
+        Tensor y = ((a * b).exp() + b).sum();
+        y.backward();
+        ASSERT_TRUE(a.grad().m_node->m_grad_fn == nullptr && !a.grad().m_node->m_requires_grad, "gradients are plain tensors");
+        ASSERT_TRUE(y.m_node->m_grad_fn == nullptr, "graph freed");
+        ASSERT_EQ_APPROX(b.grad()[{0}], 2.0f + std::exp(-0.5f) * -1.0f + std::exp(0.2f * 0.5f) * 0.2f, 1e-5, "broadcast operand gradient summed back");
+
+        Tensor c = Tensor::linspace({4}, 1.0f, 4.0f);
+        Tensor d = Tensor::linspace({4}, 1.0f, 4.0f);
+        (c + d).sum().backward();
+        ASSERT_TRUE(c.grad().m_node->m_storage.data() != d.grad().m_node->m_storage.data(), "pass-through gradients do not alias");
+    }
+
+    // 2. create_graph: the gradient is differentiable again
+    {
+        Tensor x = Tensor::linspace({3}, -1.0f, 2.0f);
+        (x * x * x).sum().backward(false, true);
+        Tensor g = x.grad();
+        ASSERT_TRUE(g.m_node->m_grad_fn != nullptr, "gradient keeps a grad fn");
+        ASSERT_EQ_APPROX(g[{2}], 12.0f, 1e-5, "d(x^3) = 3x^2");
+        x.zero_grad();
+        g.sum().backward();
+        ASSERT_EQ_APPROX(x.grad()[{0}], -6.0f, 1e-5, "d2(x^3) = 6x");
+        ASSERT_EQ_APPROX(x.grad()[{2}], 12.0f, 1e-5, "d2(x^3) = 6x");
+        ASSERT_TRUE(mt::is_grad_enabled(), "grad mode restored after backward");
+    }
+
+    // 3. Second derivatives through the fused grad fns
+    {
+        const Tensor x0 = Tensor::linspace({2, 4}, -1.5f, 1.2f, false);
+        const Tensor v = Tensor::linspace({2, 4}, 0.7f, -0.4f, false);
+        const Tensor w = Tensor::linspace({2, 4}, -1.0f, 2.0f, false);
+        const Tensor e = Tensor::linspace({2, 4}, 0.5f, 2.5f, false);
+
+        ASSERT_TRUE(hvp_error([&](const Tensor& x) { return (x.softmax(1) * w).sum(); }, x0, v) < 2e-2f, "softmax");
+        ASSERT_TRUE(hvp_error([&](const Tensor& x) { return (x.log_softmax(0) * w).sum(); }, x0, v) < 2e-2f, "log_softmax");
+        ASSERT_TRUE(hvp_error([&](const Tensor& x) {
+            return ((x * x + 1.0f).pow(e) / (x.exp() + 2.0f) + Tensor::pow(2.0f, x) + 1.0f / (x * x + 1.0f) + (x * x + 1.0f).pow(1.5f)).sum();
+        }, x0, v) < 2e-2f, "pow, exp, div and scalar ops");
+
+        const Tensor y = Tensor::linspace({2, 4}, 0.0f, 1.0f, false);
+        ASSERT_TRUE(hvp_error([&](const Tensor& x) { return mt::nn::BCELossWithLogits().forward(x, y).sum(); }, x0, v) < 2e-2f, "BCE with logits");
+
+        Tensor classes({2}, 0.0f, false);
+        classes[{0}] = 1.0f; classes[{1}] = 3.0f;
+        ASSERT_TRUE(hvp_error([&](const Tensor& x) { return mt::nn::CrossEntropyLoss().forward(x, classes); }, x0, v) < 2e-2f, "cross-entropy on class indices");
+
+        const Tensor lw = Tensor::linspace({4, 3}, -0.5f, 0.5f, false);
+        const Tensor lb = Tensor::linspace({3}, 0.1f, 0.3f, false);
+        ASSERT_TRUE(hvp_error([&](const Tensor& x) { return Tensor::linear(x, lw, lb).pow(2.0f).sum(); }, x0, v) < 2e-2f, "fused linear");
+    }
+
+    // 4. A plain pass sums an interior node's gradients on storages, its
+    // consumers being an add (which passes its gradient on), a product and a
+    // view, and hands the node one untracked, contiguous gradient
+    {
+        Tensor x = Tensor::linspace({3, 4}, -1.0f, 1.0f);
+        Tensor h = x * 2.0f;
+        h.retain_grad();
+        Tensor y = h * h + h.transpose(0, 1).transpose(0, 1) + h;
+        y.retain_grad();
+        y.sum().backward();
+
+        bool hg = true;
+        bool xg = true;
+        for (size_t i = 0; i < 3; ++i) {
+            for (size_t j = 0; j < 4; ++j) {
+                hg = hg && std::abs(h.grad()[{i, j}] - (2.0f * h[{i, j}] + 2.0f)) < 1e-5f;
+                xg = xg && std::abs(x.grad()[{i, j}] - 2.0f * (2.0f * h[{i, j}] + 2.0f)) < 1e-5f;
+            }
+        }
+        ASSERT_TRUE(hg, "dy/dh = 2h + 2 from three consumers");
+        ASSERT_TRUE(xg, "dy/dx = 2 * dy/dh");
+        ASSERT_TRUE(!h.grad().m_node->m_requires_grad && !h.grad().m_node->m_grad_fn, "the summed gradient is untracked");
+        ASSERT_TRUE(h.grad().m_node->m_storage.is_contiguous(), "the summed gradient is contiguous");
+        ASSERT_EQ(y.grad()[{2, 3}], 1.0f, "the retained gradient passed on by add is not written to");
+    }
+}
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef TEST_ENGINE_H
+#define TEST_ENGINE_H
+
+#include "src/core/tensors.h"
+#include "src/core/grad_fns.h"
+#include "src/core/nn/losses.h"
+#include "tests/test_utils.h"
+
+void test_backward_engine() {
+
+    std::cout << "\n===[ test_engine.h ]===\n";
+
+    // 1. Outputs are numbered after their operands, operands are visited in place
+    {
+        Tensor x = Tensor::linspace({3}, 1.0f, 3.0f);
+        Tensor y = x * 2.0f;
+        Tensor z = x + y;
+        ASSERT_TRUE(z.m_node->m_sequence_nr > y.m_node->m_sequence_nr && y.m_node->m_sequence_nr > x.m_node->m_sequence_nr, "sequence numbers follow creation");
+        const auto ops = z.m_node->m_grad_fn->operands();
+        ASSERT_TRUE(ops.size() == 2 && ops[1].m_node == y.m_node, "operands span views the saved tensors");
+    }
+
+    // 2. Shared interior nodes get every contribution before their grad fn runs
+    {
+        Tensor x = Tensor::linspace({2}, 1.0f, 2.0f);
+        Tensor a = x * 2.0f;
+        Tensor d = (a + a * 3.0f) * a; // 16 x^2
+        d.sum().backward();
+        ASSERT_EQ(x.grad()[{1}], 64.0f, "d(16 x^2) = 32 x");
+    }
+
+    // 3. Long chains, twice, with the scratch reused
+    {
+        for (size_t pass = 0; pass < 2; ++pass) {
+            Tensor x = Tensor::linspace({4}, 0.0f, 3.0f);
+            Tensor h = x;
+            for (size_t i = 0; i < 3000; ++i) h = h + 1.0f;
+            h.sum().backward();
+            ASSERT_EQ(x.grad()[{3}], 1.0f, "gradient through 3000 ops");
+        }
+    }
+
+    // 4. Interior nodes that no grad fn sends a gradient to are skipped
+    {
+        Tensor logits = Tensor::linspace({2, 3}, -1.0f, 1.0f);
+        Tensor raw = Tensor::linspace({2}, 0.0f, 2.0f);
+        Tensor classes = raw * 1.0f;
+        mt::nn::CrossEntropyLoss().forward(logits, classes).backward();
+        ASSERT_TRUE(raw.m_node->m_grad == nullptr, "no gradient for class indices");
+        ASSERT_TRUE(logits.m_node->m_grad != nullptr, "logits still reached");
+    }
+}
+
+#endif
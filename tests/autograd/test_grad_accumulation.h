@@ -0,0 +1,93 @@
+#ifndef TEST_GRAD_ACCUMULATION_H
+#define TEST_GRAD_ACCUMULATION_H
+
+#include <map>
+#include <string>
+
+#include "src/core/tensors.h"
+#include "src/core/nn/optimizers.h"
+#include "tests/test_utils.h"
+
+void test_grad_accumulation() {
+
+    std::cout << "\n===[ test_grad_accumulation.h ]===\n";
+
+    // 1. A first contribution handed over as a storage is taken over when
+    // unshared, later ones are added in place (grad mode off, as in a plain
+    // backward)
+    {
+        mt::NoGradGuard no_grad;
+        Tensor x({4});
+        TensorStorage g1 = TensorStorage::linspace({4}, 1.0f, 4.0f);
+        const float* g1_data { g1.data() };
+        x.accumulate_grad(std::move(g1));
+        ASSERT_TRUE(x.grad().m_node->m_storage.data() == g1_data, "unshared buffer taken over");
+
+        Tensor g2 = Tensor::linspace({4}, 1.0f, 1.0f, false);
+        Tensor g2_ref = g2;
+        x.accumulate_grad(g2);
+        ASSERT_TRUE(x.grad().m_node->m_storage.data() == g1_data, "second contribution added in place");
+        ASSERT_EQ(x.grad()[{3}], 5.0f, "4 + 1");
+        ASSERT_EQ(g2_ref[{3}], 1.0f, "shared contribution left untouched");
+
+        Tensor y({4});
+        y.accumulate_grad(g2);
+        ASSERT_TRUE(y.grad().m_node->m_storage.data() != g2.m_node->m_storage.data(), "shared buffer copied");
+
+        // a Tensor passed by reference is the caller's, even when it is the
+        // only handle of its buffer
+        Tensor z({4});
+        Tensor g3 = Tensor::linspace({4}, 1.0f, 4.0f, false);
+        const float* g3_data { g3.m_node->m_storage.data() };
+        z.accumulate_grad(g3);
+        ASSERT_TRUE(g3.m_node->m_storage.data() == g3_data && g3[{3}] == 4.0f, "the argument keeps its buffer");
+        ASSERT_TRUE(z.grad().m_node->m_storage.data() != g3_data, "its first contribution is copied");
+    }
+
+    // 2. Broadcast contributions and expanded views
+    {
+        Tensor b({3});
+        {
+            mt::NoGradGuard no_grad;
+            b.accumulate_grad(Tensor({2, 3}, 1.0f, false));
+            b.accumulate_grad(Tensor({4, 3}, 0.5f, false));
+        }
+        ASSERT_EQ(b.grad()[{1}], 4.0f, "broadcast contributions summed back, then added");
+
+        Tensor x = Tensor::linspace({2, 3}, -1.0f, 1.0f);
+        (x.sum() + x.sum(0).sum() + (x * 2.0f).sum()).backward();
+        ASSERT_EQ(x.grad()[{1, 2}], 4.0f, "expanded sum gradients accumulated");
+        ASSERT_TRUE(x.grad().is_contiguous(), "gradient is a dense buffer");
+    }
+
+    // 3. Optimizer::zero_grad zeroes gradients, or drops them with set_to_none
+    {
+        std::map<std::string, Tensor> params { { "w", Tensor::linspace({3}, 1.0f, 3.0f) } };
+        SGD sgd(params, 0.1f);
+        (params.at("w") * 2.0f).sum().backward();
+        sgd.zero_grad();
+        ASSERT_EQ(params.at("w").grad()[{1}], 0.0f, "gradient zeroed");
+        (params.at("w") * 3.0f).sum().backward();
+        ASSERT_EQ(params.at("w").grad()[{2}], 3.0f, "accumulates into zeros");
+
+        sgd.zero_grad(true);
+        ASSERT_TRUE(params.at("w").m_node->m_grad == nullptr, "gradient dropped");
+        ASSERT_THROWS(params.at("w").grad(), std::invalid_argument);
+        sgd.step();
+        ASSERT_EQ(params.at("w")[{0}], 1.0f, "step skips parameters without gradient");
+        (params.at("w") * 3.0f).sum().backward();
+        ASSERT_EQ(params.at("w").grad()[{2}], 3.0f, "no stale gradient");
+    }
+
+    // 4. A gradient from a create_graph backward is replaced, not written to
+    {
+        Tensor x = Tensor::linspace({2}, 1.0f, 2.0f);
+        (x * x).sum().backward(false, true);
+        Tensor g = x.grad();
+        (x * 5.0f).sum().backward();
+        ASSERT_EQ(g[{1}], 4.0f, "tracked gradient untouched");
+        ASSERT_EQ(x.grad()[{1}], 9.0f, "4 + 5");
+    }
+}
+
+#endif
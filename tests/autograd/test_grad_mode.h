@@ -0,0 +1,74 @@
+#ifndef TEST_GRAD_MODE_H
+#define TEST_GRAD_MODE_H
+
+#include <thread>
+
+#include "src/core/tensors.h"
+#include "src/core/grad_mode.h"
+#include "src/core/nn/compute.h"
+#include "tests/test_utils.h"
+
+void test_grad_mode() {
+
+    std::cout << "\n===[ test_grad_mode.h ]===\n";
+
+    // 1. Views, sums and clones of constants record nothing
+    {
+        Tensor c({2, 3}, 1.0f, false);
+        Tensor v = c.unsqueeze(0).expand(0, 2).transpose(1, 2).unsqueeze(2).repeat(2, 2).unsqueeze(0).squeeze(0).clone().sum();
+        ASSERT_TRUE(!v.m_node->m_requires_grad, "chain of constants does not require grad");
+        ASSERT_TRUE(v.m_node->m_grad_fn == nullptr, "no grad fn on constants");
+        ASSERT_THROWS(v.backward(), std::invalid_argument);
+    }
+
+    // 2. NoGradGuard: same values, no graph, leaves unaffected, nested scopes restore
+    {
+        Tensor x = Tensor::linspace({2, 3}, -1.0f, 1.0f);
+        Tensor tracked = (x * x + 1.0f).sum(1);
+        {
+            mt::NoGradGuard no_grad;
+            ASSERT_TRUE(!mt::is_grad_enabled(), "grad disabled in scope");
+            Tensor y = (x * x + 1.0f).sum(1);
+            ASSERT_TRUE(y.m_node->m_grad_fn == nullptr && !y.m_node->m_requires_grad, "no graph under no_grad");
+            ASSERT_EQ(y[{1}], tracked[{1}], "same forward values");
+            ASSERT_TRUE(Tensor({2}).m_node->m_requires_grad, "leaves still require grad");
+            {
+                mt::NoGradGuard nested;
+            }
+            ASSERT_TRUE(!mt::is_grad_enabled(), "nested guard restores disabled");
+        }
+        ASSERT_TRUE(mt::is_grad_enabled(), "grad enabled after scope");
+        ASSERT_TRUE((x * 2.0f).m_node->m_grad_fn != nullptr, "graph recorded again");
+    }
+
+    // 3. InferenceModeGuard: no grad bookkeeping even for leaves
+    {
+        mt::nn::Linear lin(3, 2);
+        Tensor x = Tensor::linspace({4, 3}, -1.0f, 1.0f);
+        Tensor tracked = lin.forward(x);
+        {
+            mt::InferenceModeGuard inference_mode;
+            ASSERT_TRUE(mt::is_inference_mode(), "inference mode in scope");
+            Tensor leaf({3});
+            ASSERT_TRUE(!leaf.m_node->m_requires_grad, "leaves do not require grad");
+            Tensor y = lin.forward(x);
+            ASSERT_TRUE(y.m_node->m_grad_fn == nullptr, "no grad fn in inference mode");
+            ASSERT_EQ(y[{3, 1}], tracked[{3, 1}], "same forward values");
+            ASSERT_THROWS(y.sum().backward(), std::invalid_argument);
+            ASSERT_TRUE(leaf.m_node->m_sequence_nr == 0 && y.m_node->m_sequence_nr == 0, "no sequence number is taken");
+        }
+        ASSERT_TRUE(!mt::is_inference_mode() && mt::is_grad_enabled(), "modes restored after scope");
+        ASSERT_TRUE((x * 2.0f).m_node->m_sequence_nr > tracked.m_node->m_sequence_nr, "numbering resumes after scope");
+    }
+
+    // 4. The mode is per thread
+    {
+        mt::NoGradGuard no_grad;
+        bool other_enabled { false };
+        std::thread t([&]() { other_enabled = mt::is_grad_enabled(); });
+        t.join();
+        ASSERT_TRUE(other_enabled, "other threads keep recording");
+    }
+}
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef TEST_RETAIN_GRAD_H
+#define TEST_RETAIN_GRAD_H
+
+#include <cmath>
+#include <memory>
+
+#include "src/core/tensors.h"
+#include "tests/test_utils.h"
+
+void test_retain_grad() {
+
+    std::cout << "\n===[ test_retain_grad.h ]===\n";
+
+    // 1. Interior gradients are freed once used, unless retained
+    {
+        Tensor x = Tensor::linspace({3}, 1.0f, 3.0f);
+        Tensor h = x * 2.0f;
+        Tensor k = x * 3.0f;
+        k.retain_grad();
+        (h * k).sum().backward();
+        ASSERT_TRUE(h.m_node->m_grad == nullptr, "interior gradient freed");
+        ASSERT_THROWS(h.grad(), std::invalid_argument);
+        ASSERT_EQ(k.grad()[{2}], 6.0f, "retained gradient d(h * k)/dk = h");
+        ASSERT_EQ(x.grad()[{2}], 36.0f, "leaf gradient kept, 2 * 9 + 3 * 6");
+    }
+
+    // 2. Saved operands are released as soon as their consumer's grad fn has run
+    {
+        Tensor x = Tensor::linspace({3}, 1.0f, 3.0f);
+        std::weak_ptr<TensorNode> hidden;
+        Tensor y { nullptr };
+        {
+            Tensor h = (x * 2.0f).exp();
+            hidden = h.m_node;
+            y = (h * h).sum();
+        }
+        ASSERT_TRUE(!hidden.expired(), "activation kept alive by the graph");
+        y.backward(true);
+        ASSERT_TRUE(!hidden.expired(), "retain_graph keeps saved operands");
+        y.backward();
+        ASSERT_TRUE(hidden.expired(), "released by the last backward");
+        ASSERT_EQ_APPROX(x.grad()[{0}], 2.0f * 4.0f * std::exp(4.0f), 1e-2, "two passes accumulated on the leaf");
+    }
+}
+
+#endif
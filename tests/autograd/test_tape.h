@@ -0,0 +1,134 @@
+#ifndef TEST_TAPE_H
+#define TEST_TAPE_H
+
+#include <cmath>
+#include <thread>
+#include <vector>
+
+#include "src/core/tensors.h"
+#include "src/core/tape.h"
+#include "src/core/grad_mode.h"
+#include "tests/test_utils.h"
+
+// Gradients of x, w and b for a small network with shared subexpressions,
+// broadcasting, a fused linear and a view chain.
+std::vector<Tensor> tape_test_grads() {
+    Tensor x = Tensor::linspace({4, 3}, -1.0f, 1.0f);
+    Tensor w = Tensor::linspace({3, 5}, 0.5f, -0.5f);
+    Tensor b = Tensor::linspace({5}, -0.2f, 0.2f);
+
+    Tensor h = Tensor::linear(x, w, b, mt::kernels::Activation::ReLU);
+    Tensor sq = h * h;
+    Tensor y = (sq + h.exp() * b).transpose(0, 1).unsqueeze(0).squeeze(0).log_softmax(0);
+    (y * sq.transpose(0, 1)).sum().backward();
+    return { x.grad(), w.grad(), b.grad() };
+}
+
+void test_tape() {
+
+    std::cout << "\n===[ test_tape.h ]===\n";
+
+    using mt::autograd::Engine;
+    const Engine prev_engine = mt::autograd::get_engine();
+    mt::autograd::set_engine(Engine::Tape);
+
+    // 1. Op outputs that record a grad fn take a slot, leaves and untracked
+    //    results do not
+    {
+        const mt::autograd::TapeStats before = mt::autograd::tape_stats();
+        Tensor a = Tensor::linspace({3}, 1.0f, 3.0f);
+        Tensor c = Tensor::linspace({3}, 1.0f, 3.0f, false);
+        Tensor y = a * c + 1.0f;
+        Tensor mask = a > c;
+        {
+            mt::NoGradGuard no_grad;
+            Tensor z = a * c;
+        }
+        const mt::autograd::TapeStats after = mt::autograd::tape_stats();
+        ASSERT_EQ(after.live_nodes - before.live_nodes, 2ul, "a * c and + 1 are recorded");
+        ASSERT_TRUE(y.m_node->m_tape != nullptr, "the output lives on the tape");
+        ASSERT_TRUE(a.m_node->m_tape == nullptr, "leaves are not recorded");
+        ASSERT_TRUE(mask.m_node->m_tape == nullptr, "comparisons are not recorded");
+    }
+
+    // 2. A plain backward is a tape scan, with the graph engine's gradients
+    {
+        mt::autograd::set_engine(Engine::Graph);
+        const std::vector<Tensor> expected = tape_test_grads();
+        mt::autograd::set_engine(Engine::Tape);
+
+        const size_t replays = mt::autograd::tape_stats().replays;
+        const std::vector<Tensor> grads = tape_test_grads();
+        ASSERT_EQ(mt::autograd::tape_stats().replays, replays + 1, "backward replayed the tape");
+
+        bool same = true;
+        for (size_t i = 0; i < grads.size(); ++i) {
+            for (size_t j = 0; j < grads[i].numel(); ++j) {
+                const float a = grads[i].m_node->m_storage.get_entry_ref(j);
+                const float b = expected[i].m_node->m_storage.get_entry_ref(j);
+                same = same && std::abs(a - b) <= 1e-6f * std::max(1.0f, std::abs(b));
+            }
+        }
+        ASSERT_TRUE(same, "tape and graph engines agree on x, w and b");
+    }
+
+    // 3. The arena is rewound once a step's tensors are gone, and reused
+    {
+        Tensor w = Tensor::linspace({8, 8}, -1.0f, 1.0f);
+        Tensor x = Tensor::linspace({4, 8}, 0.0f, 1.0f, false);
+        ASSERT_EQ(mt::autograd::tape_stats().live_nodes, 0ul, "nothing recorded is alive");
+
+        const size_t rewinds = mt::autograd::tape_stats().rewinds;
+        size_t arena_bytes = 0;
+        for (size_t step = 0; step < 4; ++step) {
+            Tensor loss = Tensor::matmul(x, w).relu().mean();
+            ASSERT_EQ(mt::autograd::tape_stats().recorded, 4ul, "the tape holds this step only");
+            loss.backward();
+            if (step == 1) arena_bytes = mt::autograd::tape_stats().arena_bytes;
+        }
+        ASSERT_EQ(mt::autograd::tape_stats().rewinds, rewinds + 4, "one rewind per step");
+        ASSERT_EQ(mt::autograd::tape_stats().arena_bytes, arena_bytes, "steps reuse the same blocks");
+    }
+
+    // 4. retain_graph runs on the graph engine, and the tape is not replayed
+    //    again until it is rewound
+    {
+        Tensor x = Tensor::linspace({3}, 1.0f, 3.0f);
+        Tensor y = (x * x).sum();
+        const size_t replays = mt::autograd::tape_stats().replays;
+        y.backward(true);
+        y.backward();
+        ASSERT_EQ(mt::autograd::tape_stats().replays, replays, "no replay after retain_graph");
+        ASSERT_EQ(x.grad()[{2}], 12.0f, "two passes of 2x");
+    }
+
+    // 5. Interior nodes recorded on another thread: the graph engine takes
+    //    over, and nodes may outlive the thread that recorded them
+    {
+        Tensor x = Tensor::linspace({3}, 1.0f, 3.0f);
+        Tensor h { nullptr };
+        std::thread worker([&]() { h = x * 2.0f; });
+        worker.join();
+
+        ASSERT_TRUE(h.m_node->m_tape != nullptr, "h is on the worker's tape");
+        Tensor y = (h * x).sum();
+        const size_t replays = mt::autograd::tape_stats().replays;
+        y.backward();
+        ASSERT_EQ(mt::autograd::tape_stats().replays, replays, "not replayed");
+        ASSERT_EQ(x.grad()[{1}], 8.0f, "d(2x * x)/dx = 4x");
+    }
+
+    // 6. With the graph engine selected nodes are heap-allocated
+    {
+        mt::autograd::set_engine(Engine::Graph);
+        Tensor x = Tensor::linspace({3}, 1.0f, 3.0f);
+        Tensor y = (x * x).sum();
+        ASSERT_TRUE(y.m_node->m_tape == nullptr, "not recorded");
+        y.backward();
+        ASSERT_EQ(x.grad()[{0}], 2.0f, "graph engine gradient");
+    }
+
+    mt::autograd::set_engine(prev_engine);
+}
+
+#endif
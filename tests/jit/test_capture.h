@@ -0,0 +1,174 @@
+#ifndef TEST_CAPTURE_H
+#define TEST_CAPTURE_H
+
+#include <cmath>
+#include <functional>
+#include <vector>
+
+#include "src/core/tensors.h"
+#include "src/core/expressions.h"
+#include "src/core/jit/capture.h"
+#include "src/core/nn/losses.h"
+#include "tests/test_utils.h"
+
+// Largest difference between the entries of a and b, relative to b.
+float capture_max_error(
+        const Tensor& a,
+        const Tensor& b
+) {
+    float error = 0.0f;
+    for (size_t i = 0; i < b.numel(); ++i) {
+        const float expected = b.m_node->m_storage.get_entry_ref(i);
+        const float diff = std::abs(a.m_node->m_storage.get_entry_ref(i) - expected);
+        error = std::max(error, diff / std::max(1.0f, std::abs(expected)));
+    }
+    return error;
+}
+
+// Class indices 0, 1, 2, 0, ... for a batch of n.
+Tensor capture_classes(
+        const size_t n
+) {
+    Tensor classes({n}, 0.0f, false);
+    for (size_t i = 0; i < n; ++i) classes[{i}] = static_cast<float>(i % 3);
+    return classes;
+}
+
+void test_capture() {
+
+    std::cout << "\n===[ test_capture.h ]===\n";
+
+    Tensor w1 = Tensor::linspace({4, 6}, -0.5f, 0.5f);
+    Tensor b1 = Tensor::linspace({6}, -0.1f, 0.1f);
+    Tensor w2 = Tensor::linspace({6, 3}, 0.4f, -0.3f);
+    const std::vector<Tensor> params { w1, b1, w2 };
+    const mt::nn::CrossEntropyLoss criterion {};
+
+    const mt::jit::CapturedStep::StepFn step = [&](const std::vector<Tensor>& inputs) {
+        Tensor h = Tensor::linear(inputs[0], w1, b1, mt::kernels::Activation::ReLU);
+        Tensor logits = Tensor::matmul(h, w2).log_softmax(1).exp() * 2.0f;
+        return criterion.forward(logits, inputs[1]);
+    };
+    // Loss and gradients of an eager step, the gradients are reset after.
+    const auto eager = [&](const std::vector<Tensor>& inputs) {
+        Tensor loss = step(inputs);
+        loss.backward();
+        std::vector<Tensor> out { loss };
+        for (Tensor p : params) {
+            out.push_back(p.grad());
+            p.m_node->m_grad = nullptr;
+        }
+        return out;
+    };
+    const auto matches_eager = [&](const Tensor& loss, const std::vector<Tensor>& expected) {
+        float error = capture_max_error(loss, expected[0]);
+        for (size_t i = 0; i < params.size(); ++i) {
+            error = std::max(error, capture_max_error(params[i].grad(), expected[1 + i]));
+        }
+        return error <= 1e-5f;
+    };
+
+    const std::vector<Tensor> batch { Tensor::linspace({5, 4}, -1.0f, 1.0f, false), capture_classes(5) };
+    const std::vector<Tensor> expected = eager(batch);
+
+    // 1. Capturing leaves the gradients alone, a replay has eager's loss and
+    //    gradients
+    {
+        mt::jit::CapturedStep captured(step, batch);
+        ASSERT_TRUE(!w1.m_node->m_grad && !b1.m_node->m_grad, "capture computed no gradient");
+        ASSERT_EQ(captured.graph().m_outputs.size(), 4ul, "loss and three gradients");
+        ASSERT_EQ(captured.graph().m_input_shapes.size(), 2ul, "two inputs");
+
+        const Tensor loss = captured.run(batch);
+        ASSERT_EQ(captured.replays(), 1ul, "replayed");
+        ASSERT_TRUE(matches_eager(loss, expected), "replay matches eager");
+        ASSERT_TRUE(loss.m_node->m_grad_fn == nullptr, "the loss carries no graph");
+
+        // gradients accumulate like backward's
+        captured.run(batch);
+        ASSERT_EQ_APPROX(w2.grad().m_node->m_storage.get_entry_ref(0), 2.0f * expected[3].m_node->m_storage.get_entry_ref(0), 1e-5, "second replay accumulates");
+        for (Tensor p : params) p.m_node->m_grad = nullptr;
+    }
+
+    // 2. Parameters and inputs are read at replay time: new data after an
+    //    update of the weights
+    {
+        mt::jit::CapturedStep captured(step, batch);
+        w2.fill_inplace(0.25f);
+        const std::vector<Tensor> next { Tensor::linspace({5, 4}, 2.0f, -1.0f, false), capture_classes(5) };
+        const std::vector<Tensor> next_expected = eager(next);
+        const Tensor loss = captured.run(next);
+        ASSERT_TRUE(matches_eager(loss, next_expected), "replay sees the updated weights and the new batch");
+        for (Tensor p : params) p.m_node->m_grad = nullptr;
+    }
+
+    // 3. Other input shapes (a last partial batch) run eagerly
+    {
+        mt::jit::CapturedStep captured(step, batch);
+        const std::vector<Tensor> partial { Tensor::linspace({2, 4}, -1.0f, 1.0f, false), capture_classes(2) };
+        const std::vector<Tensor> partial_expected = eager(partial);
+        const Tensor loss = captured.run(partial);
+        ASSERT_EQ(captured.eager_runs(), 1ul, "fell back to eager");
+        ASSERT_EQ(captured.replays(), 0ul, "not replayed");
+        ASSERT_TRUE(matches_eager(loss, partial_expected), "eager fallback gradients");
+        for (Tensor p : params) p.m_node->m_grad = nullptr;
+    }
+
+    // 4. Ops the graph cannot express fail the capture
+    {
+        const mt::jit::CapturedStep::StepFn inplace = [&](const std::vector<Tensor>& inputs) {
+            Tensor h = Tensor::matmul(inputs[0], w1);
+            h += h;
+            return h.sum();
+        };
+        ASSERT_THROWS(mt::jit::CapturedStep(inplace, batch), std::invalid_argument);
+        ASSERT_TRUE(!mt::jit::is_tracing(), "the trace is gone");
+        ASSERT_THROWS(mt::jit::CapturedStep([](const std::vector<Tensor>& inputs) { return inputs[0].sum(); }, batch), std::invalid_argument);
+
+        // writes that bypass the ops: fill_inplace, operator[] and assign
+        const auto fails_capture = [&](const std::function<void(Tensor&)>& write) {
+            const mt::jit::CapturedStep::StepFn fn = [&](const std::vector<Tensor>& inputs) {
+                Tensor h = Tensor::matmul(inputs[0], w1);
+                write(h);
+                return h.sum();
+            };
+            bool threw = false;
+            try {
+                mt::jit::CapturedStep captured(fn, batch);
+            } catch (const std::invalid_argument&) {
+                threw = true;
+            }
+            return threw && !mt::jit::is_tracing();
+        };
+        ASSERT_TRUE(fails_capture([](Tensor& h) { h.fill_inplace(1.0f); }), "fill_inplace");
+        ASSERT_TRUE(fails_capture([](Tensor& h) { h[{0, 0}] = 1.0f; }), "operator[] write");
+        ASSERT_TRUE(fails_capture([](Tensor& h) { mt::expr::assign(h, mt::expr::lazy(h) * 2.0f); }), "mt::expr::assign");
+    }
+
+    // 5. ReLU's backward factor follows the replayed batch, not the mask of
+    //    the captured one
+    {
+        Tensor v1 = Tensor::linspace({4, 6}, -0.5f, 0.5f);
+        Tensor c1 = Tensor::linspace({6}, -0.1f, 0.1f);
+        Tensor v2 = Tensor::linspace({6, 3}, 0.4f, -0.3f);
+        const mt::jit::CapturedStep::StepFn relu_step = [&](const std::vector<Tensor>& inputs) {
+            Tensor h = (Tensor::matmul(inputs[0], v1) + c1).relu();
+            return criterion.forward(Tensor::matmul(h, v2), inputs[1]);
+        };
+        mt::jit::CapturedStep captured(relu_step, batch);
+
+        // the units active on this batch are mostly inactive on the captured one
+        const std::vector<Tensor> next { Tensor::linspace({5, 4}, 2.0f, -1.0f, false), capture_classes(5) };
+        relu_step(next).backward();
+        const Tensor expected_v1 = v1.grad();
+        const Tensor expected_c1 = c1.grad();
+        for (Tensor p : { v1, c1, v2 }) p.m_node->m_grad = nullptr;
+
+        captured.run(next);
+        ASSERT_EQ(captured.replays(), 1ul, "replayed");
+        ASSERT_TRUE(capture_max_error(v1.grad(), expected_v1) <= 1e-5f, "relu replay on another batch: weight gradient");
+        ASSERT_TRUE(capture_max_error(c1.grad(), expected_c1) <= 1e-5f, "relu replay on another batch: bias gradient");
+    }
+}
+
+#endif
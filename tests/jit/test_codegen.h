@@ -0,0 +1,51 @@
+#ifndef TEST_CODEGEN_H
+#define TEST_CODEGEN_H
+
+#include <sstream>
+#include <string>
+
+#include "src/core/tensors.h"
+#include "src/core/jit/codegen.h"
+#include "tests/test_utils.h"
+
+void test_codegen() {
+
+    std::cout << "\n===[ test_codegen.h ]===\n";
+
+    const Tensor x = Tensor::linspace({4, 8}, -1.0f, 1.0f, false);
+    const Tensor w = Tensor::linspace({8, 3}, -0.5f, 0.5f);
+    const Tensor b = Tensor::linspace({3}, -0.1f, 0.1f);
+    const mt::jit::CodegenOptions options { .name = "small" };
+
+    // 1. A linear layer is a gemm call, the chain after it one loop
+    {
+        mt::jit::Trace trace({x});
+        const Tensor y = (Tensor::linear(x, w, b, mt::kernels::Activation::ReLU).exp() * 2.0f + 1.0f).transpose(0, 1);
+        const mt::jit::Graph graph = trace.finish({y});
+
+        std::ostringstream header;
+        std::ostringstream source;
+        mt::jit::emit_header(graph, options, header);
+        mt::jit::emit_source(graph, options, source);
+        std::cout << source.str();
+        ASSERT_TRUE(header.str().find("namespace small") != std::string::npos, "the header is in the namespace");
+        ASSERT_TRUE(header.str().find("workspace_numel") != std::string::npos, "the header sizes the workspace");
+        ASSERT_TRUE(header.str().find("input_numel { 32 }") != std::string::npos, "the input has 4 * 8 entries");
+        ASSERT_TRUE(source.str().find("mt::kernels::gemm(") != std::string::npos, "the linear layer calls gemm");
+        ASSERT_TRUE(source.str().find("fused: ") != std::string::npos, "exp and * 2 are fused into + 1");
+        ASSERT_TRUE(source.str().find("std::exp(") != std::string::npos, "exp is inlined");
+    }
+
+    // 2. An op called through a kernel pointer has no lowering
+    {
+        mt::jit::Trace trace({x});
+        const Tensor y = x * 2.0f;
+        mt::jit::Graph graph = trace.finish({y});
+        graph.m_ops[1].kind = mt::jit::OpKind::Kernel;
+
+        std::ostringstream source;
+        ASSERT_THROWS(mt::jit::emit_source(graph, options, source), std::invalid_argument);
+    }
+}
+
+#endif
@@ -0,0 +1,101 @@
+#ifndef TEST_MEMORY_PLAN_H
+#define TEST_MEMORY_PLAN_H
+
+#include <vector>
+
+#include "src/core/tensors.h"
+#include "src/core/allocator.h"
+#include "src/core/jit/capture.h"
+#include "src/core/jit/memory_plan.h"
+#include "src/core/nn/losses.h"
+#include "tests/test_utils.h"
+
+// Whether no two buffers alive at the same time share bytes of the slab.
+bool plan_is_disjoint(
+        const std::vector<mt::jit::PlannedBuffer>& buffers
+) {
+    for (size_t i = 0; i < buffers.size(); ++i) {
+        for (size_t j = i + 1; j < buffers.size(); ++j) {
+            const mt::jit::PlannedBuffer& a = buffers[i];
+            const mt::jit::PlannedBuffer& b = buffers[j];
+            if (!a.in_slab || !b.in_slab) continue;
+            const bool live_together = a.start < b.end && b.start < a.end;
+            const bool share_bytes = a.offset < b.offset + b.bytes && b.offset < a.offset + a.bytes;
+            if (live_together && share_bytes) return false;
+        }
+    }
+    return true;
+}
+
+void test_memory_plan() {
+
+    std::cout << "\n===[ test_memory_plan.h ]===\n";
+
+    // 1. Offsets: buffers that are never alive together share memory, the
+    //    smaller ones go to the tightest gap
+    {
+        std::vector<mt::jit::PlannedBuffer> buffers {
+            { 128, 512, 0, 2, true, 0 },  // a
+            { 64, 256, 1, 10, true, 0 },  // b, alive with all the others
+            { 32, 128, 3, 6, true, 0 },   // c, in a's place
+            { 16, 64, 4, 6, true, 0 },    // d, after c
+            { 512, 2048, 0, 10, false, 0 } // an output, outside the slab
+        };
+        const size_t slab = mt::jit::plan_offsets(buffers);
+        ASSERT_EQ(slab, 768ul, "a and b side by side");
+        ASSERT_EQ(buffers[1].offset, 512ul, "b after a");
+        ASSERT_EQ(buffers[2].offset, 0ul, "c reuses a's memory");
+        ASSERT_EQ(buffers[3].offset, 128ul, "d in the gap left by c");
+        ASSERT_TRUE(plan_is_disjoint(buffers), "no overlap between live buffers");
+    }
+
+    // 2. A captured step is profiled by its first replay and served from the
+    //    slab afterwards, with the same results
+    {
+        Tensor w1 = Tensor::linspace({8, 16}, -0.5f, 0.5f);
+        Tensor b1 = Tensor::linspace({16}, -0.1f, 0.1f);
+        Tensor w2 = Tensor::linspace({16, 4}, 0.3f, -0.3f);
+        const mt::nn::CrossEntropyLoss criterion {};
+        const mt::jit::CapturedStep::StepFn step = [&](const std::vector<Tensor>& inputs) {
+            Tensor h = Tensor::linear(inputs[0], w1, b1, mt::kernels::Activation::ReLU);
+            Tensor logits = Tensor::matmul(h, w2).softmax(1).log() + h.sum(1, true) * 0.01f;
+            return criterion.forward(logits, inputs[1]);
+        };
+
+        Tensor classes({6}, 0.0f, false);
+        for (size_t i = 0; i < 6; ++i) classes[{i}] = static_cast<float>(i % 4);
+        const std::vector<Tensor> batch { Tensor::linspace({6, 8}, -1.0f, 1.0f, false), classes };
+
+        mt::jit::CapturedStep captured(step, batch);
+        ASSERT_TRUE(!captured.memory_plan().ready(), "no plan before a replay");
+        const float profiled_loss = captured.run(batch).item();
+        const Tensor profiled_grad = w1.grad().clone();
+        w1.m_node->m_grad = nullptr;
+        b1.m_node->m_grad = nullptr;
+        w2.m_node->m_grad = nullptr;
+
+        const mt::jit::MemoryPlan& plan = captured.memory_plan();
+        const mt::jit::MemoryPlanStats& stats = plan.stats();
+        std::cout << stats << '\n';
+        ASSERT_TRUE(plan.ready(), "planned after the first replay");
+        ASSERT_TRUE(stats.slab_buffers > 0 && stats.slab_buffers < stats.buffers, "intermediates in the slab, outputs not");
+        ASSERT_TRUE(stats.planned_bytes < stats.naive_bytes, "buffers share memory");
+        ASSERT_TRUE(stats.planned_bytes >= stats.live_peak_bytes, "no plan below the live peak");
+
+        const mt::AllocatorStats before = mt::allocator_stats();
+        const float loss = captured.run(batch).item();
+        const mt::AllocatorStats after = mt::allocator_stats();
+        ASSERT_EQ(after.allocations - before.allocations, stats.buffers - stats.slab_buffers, "only the outputs are allocated");
+        ASSERT_EQ(loss, profiled_loss, "same loss from the slab");
+
+        bool same = true;
+        for (size_t i = 0; i < profiled_grad.numel(); ++i) {
+            same = same && w1.grad().m_node->m_storage.get_entry_ref(i) == profiled_grad.m_node->m_storage.get_entry_ref(i);
+        }
+        ASSERT_TRUE(same, "same gradients from the slab");
+        ASSERT_TRUE(!plan.contains(w1.grad().m_node->m_storage), "gradients are not in the slab");
+        ASSERT_TRUE(plan.ready(), "the plan holds");
+    }
+}
+
+#endif
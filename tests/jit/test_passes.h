@@ -0,0 +1,125 @@
+#ifndef TEST_PASSES_H
+#define TEST_PASSES_H
+
+#include <cmath>
+#include <vector>
+
+#include "src/core/tensors.h"
+#include "src/core/jit/capture.h"
+#include "src/core/jit/passes.h"
+#include "src/core/nn/losses.h"
+#include "tests/test_utils.h"
+
+// Kinds of the ops of graph, in order.
+std::vector<mt::jit::OpKind> pass_kinds(
+        const mt::jit::Graph& graph
+) {
+    std::vector<mt::jit::OpKind> kinds;
+    for (const mt::jit::Op& op : graph.m_ops) kinds.push_back(op.kind);
+    return kinds;
+}
+
+void test_passes() {
+
+    std::cout << "\n===[ test_passes.h ]===\n";
+
+    using mt::jit::OpKind;
+    const Tensor x = Tensor::linspace({2, 3}, -1.0f, 1.0f, false);
+    const Tensor z = Tensor::linspace({2, 3}, 1.0f, -1.0f, false);
+
+    // 1. Dead code: ops the outputs do not read are dropped
+    {
+        mt::jit::Trace trace({x});
+        const Tensor unused = x.exp();
+        const Tensor y = x * 2.0f;
+        mt::jit::Graph graph = trace.finish({y});
+        const mt::jit::PassStats stats = mt::jit::eliminate_dead_code(graph);
+        std::cout << stats << '\n';
+        ASSERT_EQ(stats.ops_before - stats.ops_after, 1ul, "the unused exp is dropped");
+        ASSERT_TRUE(pass_kinds(graph) == std::vector<OpKind>{ OpKind::Input, OpKind::MultScalar }, "x * 2 is left");
+        ASSERT_EQ(graph.m_outputs[0], 1ul, "the output is renumbered");
+    }
+
+    // 2. Views: squeezes back to the source's shape and a transpose of a
+    //    transpose are the source itself
+    {
+        mt::jit::Trace trace({x});
+        const Tensor y = x.unsqueeze(0).unsqueeze(2).squeeze(2).squeeze(0).transpose(0, 1).transpose(1, 0) * 2.0f;
+        mt::jit::Graph graph = trace.finish({y});
+        const mt::jit::PassStats stats = mt::jit::collapse_views(graph);
+        std::cout << stats << '\n';
+        ASSERT_TRUE(pass_kinds(graph) == std::vector<OpKind>{ OpKind::Input, OpKind::MultScalar }, "the views are gone");
+        ASSERT_EQ(graph.m_ops[1].inputs[0], 0ul, "x * 2 reads x");
+    }
+
+    // 3. Common subexpressions: the same comparison is computed once
+    {
+        mt::jit::Trace trace({x, z});
+        const Tensor gt = (x > z) * (x > z);
+        const Tensor y = gt + (x <= z);
+        mt::jit::Graph graph = trace.finish({y});
+        const mt::jit::PassStats stats = mt::jit::eliminate_common_subexpressions(graph);
+        std::cout << stats << '\n';
+        ASSERT_EQ(stats.rewrites, 1ul, "one duplicate, x <= z is another op");
+        ASSERT_TRUE(pass_kinds(graph) == std::vector<OpKind>{ OpKind::Input, OpKind::Input, OpKind::Gt, OpKind::Mult, OpKind::Lte, OpKind::Add }, "one Gt left");
+        ASSERT_TRUE(graph.m_ops[3].inputs == std::vector<size_t>{ 2, 2 }, "the product reads it twice");
+    }
+
+    // 4. Constants: ops on constants only are computed at capture, equal
+    //    constants are merged, after which the products are duplicates
+    {
+        const Tensor c1({2, 3}, 2.0f, false);
+        const Tensor c2({2, 3}, 2.0f, false);
+        mt::jit::Trace trace({x});
+        const Tensor y = x * (c1 * 0.5f).exp() + x * (c2 * 0.5f).exp();
+        mt::jit::Graph graph = trace.finish({y});
+        const std::vector<mt::jit::PassStats> stats = mt::jit::optimize(graph);
+        for (const mt::jit::PassStats& s : stats) std::cout << s << '\n';
+        ASSERT_TRUE(pass_kinds(graph) == std::vector<OpKind>{ OpKind::Input, OpKind::Constant, OpKind::Mult, OpKind::Add }, "folded, merged, then shared");
+        ASSERT_EQ(graph.m_constants.size(), 1ul, "one constant kept");
+        ASSERT_EQ_APPROX(graph.m_constants[0].get_entry_ref(0), std::exp(1.0f), 1e-6, "the constant is exp(1)");
+    }
+
+    // 5. Algebra: x * 1 + 0 is x
+    {
+        const Tensor ones({2, 3}, 1.0f, false);
+        mt::jit::Trace trace({x});
+        const Tensor y = ((x * 1.0f + 0.0f) * ones).exp();
+        mt::jit::Graph graph = trace.finish({y});
+        const mt::jit::PassStats stats = mt::jit::simplify_algebra(graph);
+        std::cout << stats << '\n';
+        ASSERT_EQ(stats.rewrites, 3ul, "three identities");
+        ASSERT_TRUE(pass_kinds(graph) == std::vector<OpKind>{ OpKind::Input, OpKind::Exp }, "exp(x) is left");
+    }
+
+    // 6. A captured step is optimized, its replay still matches eager
+    {
+        Tensor w1 = Tensor::linspace({8, 16}, -0.5f, 0.5f);
+        Tensor b1 = Tensor::linspace({16}, -0.1f, 0.1f);
+        Tensor w2 = Tensor::linspace({16, 4}, 0.3f, -0.3f);
+        const mt::nn::CrossEntropyLoss criterion {};
+        const mt::jit::CapturedStep::StepFn step = [&](const std::vector<Tensor>& inputs) {
+            Tensor h = Tensor::linear(inputs[0], w1, b1, mt::kernels::Activation::ReLU);
+            Tensor logits = Tensor::matmul(h, w2).softmax(1).log() + h.sum(1, true) * 0.01f;
+            return criterion.forward(logits, inputs[1]);
+        };
+
+        Tensor classes({6}, 0.0f, false);
+        for (size_t i = 0; i < 6; ++i) classes[{i}] = static_cast<float>(i % 4);
+        const std::vector<Tensor> batch { Tensor::linspace({6, 8}, -1.0f, 1.0f, false), classes };
+
+        const float eager_loss = step(batch).item();
+        mt::jit::CapturedStep captured(step, batch);
+        size_t removed = 0;
+        for (const mt::jit::PassStats& stats : captured.pass_stats()) {
+            std::cout << stats << '\n';
+            removed += stats.ops_before - stats.ops_after;
+        }
+        ASSERT_EQ(captured.pass_stats().size(), 5ul, "every pass reports");
+        ASSERT_TRUE(removed > 0, "the passes remove ops from a training step");
+        ASSERT_EQ_APPROX(captured.run(batch).item(), eager_loss, 1e-6, "same loss after the passes");
+        ASSERT_EQ_APPROX(captured.run(batch).item(), eager_loss, 1e-6, "same loss from the memory plan");
+    }
+}
+
+#endif
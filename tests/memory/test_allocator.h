@@ -0,0 +1,80 @@
+#ifndef TEST_ALLOCATOR_H
+#define TEST_ALLOCATOR_H
+
+#include <cstdint>
+#include <vector>
+
+#include "src/core/allocator.h"
+#include "src/core/tensors.h"
+#include "tests/test_utils.h"
+
+void test_allocator() {
+
+    std::cout << "\n===[ test_allocator.h ]===\n";
+
+    // 1. Buffers are aligned for every size
+    {
+        bool aligned { true };
+        for (size_t n : {1ul, 3ul, 17ul, 1000ul, 700000ul}) {
+            TensorStorage s { TensorStorage::empty({n}) };
+            aligned = aligned && reinterpret_cast<std::uintptr_t>(s.data()) % mt::BUFFER_ALIGNMENT == 0;
+        }
+        ASSERT_TRUE(aligned, "buffers are 64-byte aligned");
+    }
+
+    // 2. A freed buffer is reused by the next request of the same size class
+    {
+        float* first { nullptr };
+        {
+            TensorStorage s { TensorStorage::empty({40, 25}) };
+            first = s.data();
+        }
+        const mt::AllocatorStats before { mt::allocator_stats() };
+        TensorStorage again { TensorStorage::empty({999}) };
+        const mt::AllocatorStats after { mt::allocator_stats() };
+        ASSERT_TRUE(again.data() == first, "same size class reuses the cached block");
+        ASSERT_EQ(after.cache_hits - before.cache_hits, 1ul, "reuse is counted as a cache hit");
+    }
+
+    // 3. empty() only skips initialization, the metadata is as usual
+    {
+        TensorStorage s { TensorStorage::empty({2, 3}) };
+        ASSERT_TRUE(s.m_shape == std::vector<size_t>{2, 3}, "empty shape");
+        ASSERT_TRUE(s.m_strides == std::vector<size_t>{3, 1}, "empty strides");
+        ASSERT_EQ(s.m_numel, 6ul, "empty numel");
+        ASSERT_THROWS(TensorStorage::empty({2, 0}), std::invalid_argument);
+
+        TensorStorage z({2, 3});
+        ASSERT_EQ(z.get_entry_ref(5), 0.0f, "the default constructor still zero-fills");
+    }
+
+    // 4. Views share the buffer and do not allocate
+    {
+        Tensor t = Tensor::linspace({4, 1}, 1.0f, 4.0f);
+        const size_t before { mt::allocator_stats().allocations };
+        Tensor v = t.transpose(0, 1).unsqueeze(0).squeeze(0).transpose(0, 1).expand(1, 5);
+        ASSERT_EQ(mt::allocator_stats().allocations - before, 0ul, "view chain allocates nothing");
+        ASSERT_EQ(v[{3, 4}], 4.0f, "view chain reads the base buffer");
+    }
+
+    // 5. A repeated step is served entirely from the cache once warm
+    {
+        Tensor a = Tensor::linspace({64, 32}, -1.0f, 1.0f);
+        Tensor b = Tensor::linspace({32, 16}, 1.0f, 2.0f);
+        const auto step { [&]() { return (Tensor::matmul(a, b) * 2.0f + 1.0f).sum(0); } };
+        step();
+        const mt::AllocatorStats before { mt::allocator_stats() };
+        for (int i = 0; i < 10; i++) step();
+        const mt::AllocatorStats after { mt::allocator_stats() };
+        ASSERT_TRUE(after.allocations > before.allocations, "steps allocate outputs");
+        ASSERT_EQ(after.cache_hits - before.cache_hits, after.allocations - before.allocations, "every output comes from the cache");
+    }
+
+    // 6. empty_cache hands everything back
+    {
+        mt::empty_cache();
+        ASSERT_EQ(mt::allocator_stats().cached_bytes, 0ul, "nothing cached after empty_cache");
+    }
+}
+
+#endif
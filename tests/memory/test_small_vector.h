@@ -0,0 +1,69 @@
+#ifndef TEST_SMALL_VECTOR_H
+#define TEST_SMALL_VECTOR_H
+
+#include <utility>
+#include <vector>
+
+#include "src/core/small_vector.h"
+#include "src/core/tensors.h"
+#include "tests/test_utils.h"
+
+void test_small_vector() {
+
+    std::cout << "\n===[ test_small_vector.h ]===\n";
+
+    using Small = mt::SmallVector<size_t, 4>;
+
+    // 1. Inline up to N, heap past it, contents preserved across the switch
+    {
+        Small v { 1, 2, 3 };
+        const size_t* inline_data { v.data() };
+        v.push_back(4);
+        ASSERT_TRUE(v.data() == inline_data, "fourth element still inline");
+        v.push_back(5);
+        ASSERT_TRUE(v.data() != inline_data, "fifth element spills to the heap");
+        ASSERT_TRUE(v == std::vector<size_t>{1, 2, 3, 4, 5}, "contents survive the spill");
+    }
+
+    // 2. Copies are deep, moves steal heap storage
+    {
+        Small big { 1, 2, 3, 4, 5, 6 };
+        Small copy { big };
+        copy[0] = 9;
+        ASSERT_EQ(big[0], 1ul, "copy does not alias");
+
+        const size_t* heap_data { big.data() };
+        Small moved { std::move(big) };
+        ASSERT_TRUE(moved.data() == heap_data, "move takes over the heap buffer");
+
+        Small small { 7, 8 };
+        moved = small;
+        ASSERT_TRUE(moved == Small{7, 8}, "copy assignment into a spilled vector");
+        moved = Small{ 1, 2, 3, 4, 5 };
+        ASSERT_EQ(moved.size(), 5ul, "move assignment of a spilled vector");
+    }
+
+    // 3. Insert and erase, the shape edits of unsqueeze and squeeze
+    {
+        Small v { 2, 3 };
+        v.insert(v.begin() + 1, 1);
+        ASSERT_TRUE(v == Small{2, 1, 3}, "insert in the middle");
+        v.insert(v.end(), 1);
+        v.insert(v.begin(), 1);
+        ASSERT_TRUE(v == Small{1, 2, 1, 3, 1}, "insert past the inline capacity");
+        v.erase(v.begin() + 2);
+        ASSERT_TRUE(v == Small{1, 2, 3, 1}, "erase");
+    }
+
+    // 4. Tensors with more dimensions than fit inline
+    {
+        Tensor t({1, 2, 1, 2, 1, 2, 1, 2, 1, 3}, 1.0f);
+        Tensor u = t.unsqueeze(0).transpose(0, 10).squeeze(10);
+        ASSERT_EQ(u.shape().size(), 10ul, "rank after spilled view chain");
+        ASSERT_EQ(u.shape()[0], 3ul, "transposed spilled dimension");
+        Tensor s = (u + u).sum();
+        ASSERT_EQ(s.item(), 96.0f, "element-wise op and sum over 10 dimensions");
+    }
+}
+
+#endif
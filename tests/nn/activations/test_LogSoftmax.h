@@ -0,0 +1,94 @@
+#ifndef TEST_LOGSOFTMAX_H
+#define TEST_LOGSOFTMAX_H
+
+#include <cmath>
+#include <vector>
+
+#include "src/core/tensors.h"
+#include "src/core/nn/activations.h"
+#include "tests/test_utils.h"
+
+void test_log_softmax_forward_backward() {
+    std::cout << "\n===[ test_LogSoftmax.h ]===\n";
+
+    // 1. Large logits: the max shift keeps exp finite and log away from 0
+    {
+        Tensor t({2, 3});
+        t[{0, 0}] = 1000.0f; t[{0, 1}] = 1001.0f; t[{0, 2}] = 1002.0f;
+        t[{1, 0}] = -500.0f; t[{1, 1}] = 0.0f;    t[{1, 2}] = 500.0f;
+
+        Tensor p = mt::nn::Softmax().forward(t);
+        Tensor logp = mt::nn::LogSoftmax().forward(t);
+
+        const float e = std::exp(1.0f);
+        const float denom = 1.0f + e + e * e;
+        ASSERT_EQ_APPROX(p[{0, 2}], e * e / denom, 1e-6, "softmax of shifted large logits");
+        ASSERT_EQ_APPROX(logp[{0, 0}], -std::log(denom), 1e-5, "log_softmax of shifted large logits");
+        ASSERT_EQ_APPROX(p[{1, 0}], 0.0f, 1e-6, "softmax underflows to 0");
+        ASSERT_EQ_APPROX(logp[{1, 0}], -1000.0f, 1e-3, "log_softmax stays finite where softmax underflows");
+    }
+
+    // 2. Any dimension, on a transposed input
+    {
+        Tensor t = Tensor::linspace({4, 3}, -2.0f, 3.0f).transpose(0, 1); // {3, 4}
+        Tensor p = t.softmax(0);
+        Tensor logp = t.log_softmax(0);
+        for (size_t j = 0; j < 4; ++j) {
+            float denom = 0.0f;
+            for (size_t i = 0; i < 3; ++i) denom += std::exp(t[{i, j}]);
+            float col_sum = 0.0f;
+            for (size_t i = 0; i < 3; ++i) {
+                col_sum += p[{i, j}];
+                ASSERT_EQ_APPROX(logp[{i, j}], t[{i, j}] - std::log(denom), 1e-5, "log_softmax along dim 0");
+            }
+            ASSERT_EQ_APPROX(col_sum, 1.0f, 1e-6, "softmax columns sum to 1");
+        }
+        ASSERT_THROWS(t.softmax(2), std::invalid_argument);
+    }
+
+    // 3. Gradients through the saved output, against the analytic formulas
+    {
+        Tensor x = Tensor::linspace({2, 5}, -1.0f, 2.0f);
+        Tensor w = Tensor::linspace({2, 5}, 0.5f, -0.5f, false);
+
+        Tensor p = x.softmax(1);
+        ASSERT_TRUE(p.m_node->m_grad_fn != nullptr, "a single grad fn on the softmax output");
+        (p * w).sum().backward();
+        std::vector<float> softmax_grad(10);
+        for (size_t i = 0; i < 2; ++i) {
+            float dot = 0.0f;
+            for (size_t j = 0; j < 5; ++j) dot += w[{i, j}] * p[{i, j}];
+            for (size_t j = 0; j < 5; ++j) softmax_grad[i * 5 + j] = (w[{i, j}] - dot) * p[{i, j}];
+        }
+        bool softmax_ok = true;
+        for (size_t i = 0; i < 10; ++i) {
+            softmax_ok = softmax_ok && std::abs(x.grad().m_node->m_storage.get_entry_ref(i) - softmax_grad[i]) < 1e-6f;
+        }
+        ASSERT_TRUE(softmax_ok, "softmax gradient is (g - sum(g * y)) * y");
+
+        Tensor z = Tensor::linspace({2, 5}, -1.0f, 2.0f);
+        Tensor logp = z.log_softmax(1);
+        (logp * w).sum().backward();
+        bool log_softmax_ok = true;
+        for (size_t i = 0; i < 2; ++i) {
+            float grad_sum = 0.0f;
+            for (size_t j = 0; j < 5; ++j) grad_sum += w[{i, j}];
+            for (size_t j = 0; j < 5; ++j) {
+                const float expected = w[{i, j}] - std::exp(logp[{i, j}]) * grad_sum;
+                log_softmax_ok = log_softmax_ok && std::abs(z.grad()[{i, j}] - expected) < 1e-6f;
+            }
+        }
+        ASSERT_TRUE(log_softmax_ok, "log_softmax gradient is g - softmax * sum(g)");
+    }
+
+    // 4. exp as a tensor op
+    {
+        Tensor x = Tensor::linspace({3}, -1.0f, 1.0f);
+        Tensor y = x.exp();
+        ASSERT_EQ_APPROX(y[{2}], std::exp(1.0f), 1e-6, "exp forward");
+        y.sum().backward();
+        ASSERT_EQ_APPROX(x.grad()[{0}], std::exp(-1.0f), 1e-6, "exp backward");
+    }
+}
+
+#endif
@@ -1,7 +1,11 @@
 #ifndef TEST_ACTIVATIONS_H
 #define TEST_ACTIVATIONS_H
 
+#include <memory>
+
 #include "src/core/tensors.h"
+#include "src/core/grad_fns.h"
+#include "src/core/grad_mode.h"
 #include "src/core/nn/activations.h"
 #include "tests/test_utils.h"
 
@@ -40,6 +44,102 @@ void test_relu_forward_backward() {
         ASSERT_EQ(g[{1}], 0.0f, "ReLU backward zero -> grad 0 (implementation choice)");
         ASSERT_EQ(g[{2}], 1.0f, "ReLU backward positive -> grad 1");
     }
+
+    // Dedicated op: several mask words, a strided input, a single grad fn with a packed mask
+    {
+        Tensor t = Tensor::linspace({7, 100}, -3.0f, 4.0f).transpose(0, 1); // {100, 7}
+        t.retain_grad(); // a transposed view, not a leaf
+        Tensor out = t.relu();
+        Tensor ref = Tensor::maximum(t, 0.0f);
+        bool same = true;
+        for (size_t i = 0; i < out.numel(); ++i) {
+            same = same && out.m_node->m_storage.get_entry_ref(i) == ref.m_node->m_storage.get_entry_ref(i);
+        }
+        ASSERT_TRUE(same, "relu matches maximum(x, 0) on a transposed input");
+
+        const BackwardReLU* grad_fn = dynamic_cast<const BackwardReLU*>(out.m_node->m_grad_fn.get());
+        ASSERT_TRUE(grad_fn != nullptr, "relu records BackwardReLU");
+        ASSERT_EQ(grad_fn->m_mask.size(), 11ul, "one 64-bit word per 64 elements");
+
+        // upstream gradient i + 1 at element i, routed only where t > 0
+        Tensor upstream = Tensor::linspace({100, 7}, 1.0f, 700.0f, false);
+        (out * upstream).sum().backward();
+        bool routed = true;
+        for (size_t i = 0; i < 100; ++i) {
+            for (size_t j = 0; j < 7; ++j) {
+                const float expected = t[{i, j}] > 0.0f ? upstream[{i, j}] : 0.0f;
+                routed = routed && t.grad()[{i, j}] == expected;
+            }
+        }
+        ASSERT_TRUE(routed, "relu backward routes the gradient through the mask");
+    }
+
+    // The grad fn holds its input as a graph edge only: the input's buffer
+    // goes with its last handle, unless another grad fn reads it
+    {
+        Tensor w = Tensor::linspace({4, 16}, -1.0f, 1.0f);
+        Tensor h = w * 2.0f;
+        const std::weak_ptr<float[]> buffer { h.m_node->m_storage.m_flat_data };
+        Tensor out = h.relu();
+        ASSERT_TRUE(!buffer.expired(), "the input is kept while it has a handle");
+        h = out;
+        ASSERT_TRUE(buffer.expired(), "the input's buffer is freed with its last handle");
+
+        out.sum().backward();
+        bool routed = true;
+        for (size_t i = 0; i < 4; ++i) {
+            for (size_t j = 0; j < 16; ++j) routed = routed && w.grad()[{i, j}] == (w[{i, j}] > 0.0f ? 2.0f : 0.0f);
+        }
+        ASSERT_TRUE(routed, "the gradient still reaches the input's operands");
+
+        Tensor read = w * 2.0f;
+        const std::weak_ptr<float[]> read_buffer { read.m_node->m_storage.m_flat_data };
+        const Tensor both = read.relu() + read * read;
+        read = both;
+        ASSERT_TRUE(!read_buffer.expired(), "an input another grad fn reads is kept");
+
+        Tensor soft = w.softmax(1);
+        const std::weak_ptr<float[]> soft_buffer { soft.m_node->m_storage.m_flat_data };
+        const Tensor soft_out = soft.relu();
+        soft = soft_out;
+        ASSERT_TRUE(!soft_buffer.expired(), "an output its own grad fn reads is kept");
+
+        // exp's grad fn reads its output, which only the ReLU edge holds
+        Tensor e = Tensor::linspace({3, 70}, -2.0f, 2.0f);
+        e.exp().relu().sum().backward();
+        bool exp_grads = true;
+        for (size_t j = 0; j < 70; ++j) exp_grads = exp_grads && std::abs(e.grad()[{2, j}] - std::exp(e[{2, j}])) < 1e-4f;
+        ASSERT_TRUE(exp_grads, "d(sum relu(exp(x)))/dx = exp(x), the output of exp is kept");
+    }
+
+    // create_graph through a released input: the 0/1 factor comes from the mask
+    {
+        Tensor w = Tensor::linspace({2, 5}, -1.0f, 1.0f);
+        Tensor out = (w * 2.0f).relu();
+        (out * out).sum().backward(false, true);
+        bool grads = true;
+        for (size_t j = 0; j < 5; ++j) grads = grads && w.grad()[{1, j}] == (w[{1, j}] > 0.0f ? 8.0f * w[{1, j}] : 0.0f);
+        ASSERT_TRUE(grads, "d(sum relu(2w)^2)/dw = 8w where w > 0");
+        ASSERT_TRUE(w.grad().m_node->m_requires_grad, "the gradient can be differentiated again");
+        w.zero_grad();
+    }
+
+    // Without a grad fn no mask is built, the values are the same
+    {
+        const Tensor t = Tensor::linspace({3, 50}, -2.0f, 2.0f);
+        Tensor out = t.relu();
+        {
+            const mt::NoGradGuard no_grad;
+            out = t.relu();
+        }
+        ASSERT_TRUE(out.m_node->m_grad_fn == nullptr, "no grad fn under no_grad");
+        bool same = true;
+        for (size_t i = 0; i < out.numel(); ++i) {
+            const float x = t.m_node->m_storage.get_entry_ref(i);
+            same = same && out.m_node->m_storage.get_entry_ref(i) == (x > 0.0f ? x : 0.0f);
+        }
+        ASSERT_TRUE(same, "relu without a mask matches x > 0 ? x : 0");
+    }
 }
 
 #endif
@@ -58,6 +58,33 @@ void test_crossentropy_loss_forward_backward() {
             ASSERT_EQ_APPROX(g[{i,j}], expected_grad, 1e-6, "grad matches softmax-crossentropy derivative");
         }
     }
+
+    // Class indices: same loss and gradient as the one-hot targets above, from a single grad fn
+    Tensor logits({2,3});
+    logits[{0,0}] = 1.0f; logits[{0,1}] = 2.0f; logits[{0,2}] = 3.0f;
+    logits[{1,0}] = 0.5f; logits[{1,1}] = -1.0f; logits[{1,2}] = 0.0f;
+    Tensor classes({2}, 0.0f, false);
+    classes[{0}] = 2.0f;
+    classes[{1}] = 0.0f;
+
+    Tensor loss_idx = loss.forward(logits, classes);
+    ASSERT_EQ_APPROX(loss_idx.item(), expected_mean.item(), 1e-6, "crossentropy with class indices forward mean");
+    loss_idx.backward();
+    for (size_t i = 0; i < 2; ++i) {
+        for (size_t j = 0; j < 3; ++j) {
+            ASSERT_EQ_APPROX(logits.grad()[{i,j}], g[{i,j}], 1e-6, "class-index grad matches one-hot grad");
+        }
+    }
+
+    // Large logits stay finite, bad indices are rejected
+    Tensor big({1,2}, 0.0f);
+    big[{0,0}] = 1000.0f;
+    Tensor cls1({1}, 1.0f, false);
+    ASSERT_EQ_APPROX(loss.forward(big, cls1).item(), 1000.0f, 1e-3, "crossentropy of large logits");
+    Tensor out_of_range({1}, 2.0f, false);
+    ASSERT_THROWS(loss.forward(big, out_of_range), std::invalid_argument);
+    Tensor fractional({1}, 0.5f, false);
+    ASSERT_THROWS(loss.forward(big, fractional), std::invalid_argument);
 }
 
 #endif
@@ -1,6 +1,9 @@
 #ifndef TEST_NN_H
 #define TEST_NN_H
 
+#include <array>
+#include <cmath>
+
 #include "src/core/tensors.h"
 #include "src/core/nn/compute.h"
 #include "src/core/nn/activations.h"
@@ -88,4 +91,70 @@ void test_two_layer_linear_relu_linear_backward() {
     ASSERT_EQ_APPROX(gx[{1}], 0.02f, 1e-6, "Input grad[1] after two-layer backward");
 }
 
+// largest absolute difference between two tensors of the same shape
+float max_abs_diff(const Tensor& a, const Tensor& b) {
+    float diff = 0.0f;
+    for (size_t i = 0; i < a.numel(); ++i) {
+        diff = std::max(diff, std::abs(a.m_node->m_storage.get_entry_ref(i) - b.m_node->m_storage.get_entry_ref(i)));
+    }
+    return diff;
+}
+
+void test_fused_linear_forward_backward() {
+    std::cout << "\n===[ test_nn: fused Linear epilogue ]===\n";
+
+    using mt::nn::Activation;
+
+    // k = 300 spans two GEMM depth slices, the epilogue must only run on the last
+    const auto make_inputs = []() {
+        return std::array<Tensor, 3>{
+            Tensor::linspace({300, 37}, -1.0f, 1.0f).transpose(0, 1), // strided [37, 300]
+            Tensor::linspace({300, 21}, 0.05f, -0.04f),
+            Tensor::linspace({21}, -0.5f, 0.5f)
+        };
+    };
+    Tensor upstream = Tensor::linspace({37, 21}, 1.0f, 2.0f, false);
+
+    for (const Activation activation : {Activation::None, Activation::ReLU}) {
+        auto [x, w, b] = make_inputs();
+        auto [rx, rw, rb] = make_inputs();
+        x.retain_grad(); // transposed views
+        rx.retain_grad();
+
+        Tensor y = Tensor::linear(x, w, b, activation);
+        Tensor ref = Tensor::matmul(rx, rw) + rb;
+        if (activation == Activation::ReLU) ref = Tensor::maximum(ref, 0.0f);
+
+        ASSERT_TRUE(max_abs_diff(y, ref) < 1e-5f, "fused linear forward matches matmul + bias (+ maximum)");
+        ASSERT_TRUE(y.m_node->m_grad_fn->get_operands().size() == 3, "one grad fn holds x, w and bias");
+
+        (y * upstream).sum().backward();
+        (ref * upstream).sum().backward();
+        ASSERT_TRUE(max_abs_diff(x.grad(), rx.grad()) < 1e-5f, "fused linear dx");
+        ASSERT_TRUE(max_abs_diff(w.grad(), rw.grad()) < 1e-4f, "fused linear dw");
+        ASSERT_TRUE(max_abs_diff(b.grad(), rb.grad()) < 1e-4f, "fused linear dbias");
+    }
+
+    // Without bias, on a vector input, through the module
+    {
+        mt::nn::Linear lin(3, 2, false, Activation::ReLU);
+        lin.m_weight[{0, 0}] = 1.0f;  lin.m_weight[{0, 1}] = -1.0f;
+        lin.m_weight[{1, 0}] = 2.0f;  lin.m_weight[{1, 1}] = -2.0f;
+        lin.m_weight[{2, 0}] = 3.0f;  lin.m_weight[{2, 1}] = -3.0f;
+        Tensor x = Tensor::linspace({3}, 1.0f, 3.0f);
+
+        Tensor y = lin.forward(x);
+        ASSERT_EQ(y.shape().size(), 1ul, "vector input gives a vector output");
+        ASSERT_EQ_APPROX(y[{0}], 14.0f, 1e-6, "x·w, positive unit");
+        ASSERT_EQ_APPROX(y[{1}], 0.0f, 1e-6, "x·w, unit clamped by ReLU");
+
+        y.sum().backward();
+        ASSERT_EQ_APPROX(lin.m_weight.grad()[{2, 0}], 3.0f, 1e-6, "dw of the active unit");
+        ASSERT_EQ_APPROX(lin.m_weight.grad()[{2, 1}], 0.0f, 1e-6, "no dw through the clamped unit");
+        ASSERT_EQ_APPROX(x.grad()[{1}], 2.0f, 1e-6, "dx only through the active unit");
+
+        ASSERT_THROWS(Tensor::linear(Tensor({2, 4}), lin.m_weight, Tensor(nullptr)), std::invalid_argument);
+    }
+}
+
 #endif
@@ -0,0 +1,98 @@
+#ifndef TEST_BROADCAST_H
+#define TEST_BROADCAST_H
+
+#include <vector>
+
+#include "src/core/tensors.h"
+#include "tests/test_utils.h"
+
+void test_broadcast() {
+
+    std::cout << "\n===[ test_broadcast.h ]===\n";
+
+    // 1. Row vector, column vector and scalar operands
+    {
+        Tensor a = Tensor::linspace({3, 4}, 1.0f, 12.0f); // a[i,j] = 4i + j + 1
+        Tensor row = Tensor::linspace({4}, 10.0f, 40.0f);
+        Tensor col = Tensor::linspace({3, 1}, 100.0f, 300.0f);
+        Tensor scalar(std::vector<size_t>{}, 0.5f);
+
+        Tensor r = a + row;
+        ASSERT_TRUE(r.shape() == std::vector<size_t>{3, 4}, "row broadcast shape");
+        ASSERT_EQ(r[{2, 3}], 52.0f, "12 + 40 at (2,3)");
+
+        Tensor c = col - a;
+        ASSERT_TRUE(c.shape() == std::vector<size_t>{3, 4}, "column broadcast shape");
+        ASSERT_EQ(c[{1, 0}], 195.0f, "200 - 5 at (1,0)");
+
+        Tensor s = a * scalar;
+        ASSERT_EQ(s[{2, 1}], 5.0f, "10 * 0.5 at (2,1)");
+    }
+
+    // 2. Both operands broadcast, and a leading dimension is added
+    {
+        Tensor col = Tensor::linspace({3, 1}, 1.0f, 3.0f);
+        Tensor row = Tensor::linspace({1, 4}, 10.0f, 40.0f);
+        Tensor outer = col * row;
+        ASSERT_TRUE(outer.shape() == std::vector<size_t>{3, 4}, "outer product shape");
+        ASSERT_EQ(outer[{2, 1}], 60.0f, "3 * 20 at (2,1)");
+
+        Tensor batch({2, 3, 4}, 1.0f);
+        Tensor sum = batch + outer;
+        ASSERT_TRUE(sum.shape() == std::vector<size_t>{2, 3, 4}, "leading dimension broadcast shape");
+        ASSERT_EQ(sum[{1, 2, 1}], 61.0f, "1 + 60 at (1,2,1)");
+    }
+
+    // 3. Incompatible shapes and in-place growth are rejected
+    {
+        Tensor a({3, 4});
+        Tensor b({3});
+        ASSERT_THROWS(a + b, std::invalid_argument);
+
+        Tensor small({4}, 1.0f);
+        ASSERT_THROWS(small += a, std::invalid_argument);
+
+        a.fill_inplace(1.0f);
+        a += small;
+        ASSERT_EQ(a[{2, 3}], 2.0f, "in-place add of a broadcast row");
+    }
+
+    // 4. Strided operand broadcast against a contiguous one
+    {
+        Tensor a = Tensor::linspace({4, 3}, 1.0f, 12.0f).transpose(0, 1); // {3, 4}
+        Tensor col = Tensor::linspace({3, 1}, 1.0f, 3.0f);
+        Tensor d = a / col;
+        ASSERT_EQ(d[{2, 3}], 4.0f, "12 / 3 at (2,3)");
+    }
+
+    // 5. Gradients of broadcast operands are summed back to their shape
+    {
+        Tensor x = Tensor::linspace({2, 3}, 1.0f, 6.0f);
+        Tensor bias = Tensor::linspace({3}, 1.0f, 3.0f);
+        Tensor col = Tensor::linspace({2, 1}, 2.0f, 4.0f);
+        Tensor y = (x + bias) * col;
+        y.backward();
+
+        Tensor g_bias = bias.grad();
+        ASSERT_TRUE(g_bias.shape() == std::vector<size_t>{3}, "bias grad keeps the bias shape");
+        ASSERT_EQ(g_bias[{1}], 6.0f, "bias grad sums the column factors 2 + 4");
+
+        Tensor g_col = col.grad();
+        ASSERT_TRUE(g_col.shape() == std::vector<size_t>{2, 1}, "column grad keeps the singleton");
+        ASSERT_EQ(g_col[{1, 0}], 21.0f, "column grad sums row 1 of x + bias: 5 + 7 + 9");
+
+        Tensor g_x = x.grad();
+        ASSERT_EQ(g_x[{1, 2}], 4.0f, "x grad is the broadcast column");
+    }
+
+    // 6. sum_to reduces leading and singleton dimensions
+    {
+        Tensor g({2, 3, 4}, 1.0f);
+        Tensor r = g.sum_to({3, 1});
+        ASSERT_TRUE(r.shape() == std::vector<size_t>{3, 1}, "sum_to shape");
+        ASSERT_EQ(r[{0, 0}], 8.0f, "sum_to adds 2 * 4 entries");
+        ASSERT_THROWS(g.sum_to({2, 4}), std::invalid_argument);
+    }
+}
+
+#endif
@@ -0,0 +1,146 @@
+#ifndef TEST_ELEMENTWISE_KERNELS_H
+#define TEST_ELEMENTWISE_KERNELS_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "src/core/kernels/elementwise.h"
+#include "tests/test_utils.h"
+
+// true when a matches b up to a relative tolerance, NaN matching NaN and
+// infinities matching exactly
+bool kernel_value_matches(float a, float b, float rel_tol) {
+    if (std::isnan(a) || std::isnan(b)) return std::isnan(a) && std::isnan(b);
+    if (std::isinf(a) || std::isinf(b)) return a == b;
+    return std::abs(a - b) <= rel_tol * std::max(1.0f, std::abs(b));
+}
+
+template <typename Op>
+bool binary_kernel_matches(
+        const mt::kernels::ElementwiseKernels& kernels,
+        const std::vector<float>& a,
+        const std::vector<float>& b,
+        size_t a_step,
+        size_t b_step,
+        float rel_tol
+) {
+    const size_t n { a_step ? a.size() : b.size() };
+    std::vector<float> out(n);
+    (kernels.*Op::vec)(a.data(), a_step, b.data(), b_step, out.data(), n);
+    for (size_t i = 0; i < n; i++) {
+        if (!kernel_value_matches(out[i], Op{}(a[i * a_step], b[i * b_step]), rel_tol)) return false;
+    }
+    return true;
+}
+
+template <typename Op>
+bool unary_kernel_matches(
+        const mt::kernels::ElementwiseKernels& kernels,
+        const std::vector<float>& a,
+        float rel_tol
+) {
+    std::vector<float> out(a.size());
+    (kernels.*Op::vec)(a.data(), out.data(), a.size());
+    for (size_t i = 0; i < a.size(); i++) {
+        if (!kernel_value_matches(out[i], Op{}(a[i]), rel_tol)) return false;
+    }
+    return true;
+}
+
+void test_elementwise_kernels() {
+
+    std::cout << "\n===[ test_elementwise_kernels.h ]===\n";
+
+    using namespace mt::kernels;
+
+    std::vector<const ElementwiseKernels*> tables { &scalar_kernels() };
+#if defined(__x86_64__)
+    tables.push_back(&sse2_kernels());
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) tables.push_back(&avx2_kernels());
+    if (__builtin_cpu_supports("avx512f")) tables.push_back(&avx512_kernels());
+#endif
+
+    // sizes below, at and past every vector width, so the tails are covered
+    for (size_t n : {1ul, 7ul, 16ul, 37ul}) {
+        std::vector<float> x(n), y(n), pos(n), special(n), int_exp(n, 3.0f), any_exp(n), wide(n);
+        const float specials[] { 0.0f, -0.0f, -2.0f, INFINITY, NAN, 1e-40f, 1.0f, 3.5f };
+        for (size_t i = 0; i < n; i++) {
+            const float t { static_cast<float>(i) };
+            x[i] = std::sin(t) * 4.0f;
+            y[i] = std::cos(t * 0.7f) * 3.0f;
+            pos[i] = 0.05f + t * 0.37f;
+            special[i] = specials[i % 8];
+            any_exp[i] = std::sin(t) * 2.5f;
+            wide[i] = std::sin(t * 1.3f) * 120.0f;
+        }
+        // equal halves so the comparisons see ties
+        for (size_t i = 0; i < n; i += 2) y[i] = x[i];
+
+        for (const ElementwiseKernels* k : tables) {
+            const std::string tag { std::string(k->isa) + " n=" + std::to_string(n) };
+
+            // 1. exact ops, dense and with either operand broadcast
+            for (auto [a_step, b_step] : {std::pair{1ul, 1ul}, {0ul, 1ul}, {1ul, 0ul}}) {
+                const std::string steps { " steps=" + std::to_string(a_step) + std::to_string(b_step) };
+                bool ok { true };
+                ok = ok && binary_kernel_matches<ops::Add>(*k, x, y, a_step, b_step, 0.0f);
+                ok = ok && binary_kernel_matches<ops::Sub>(*k, x, y, a_step, b_step, 0.0f);
+                ok = ok && binary_kernel_matches<ops::Mult>(*k, x, y, a_step, b_step, 0.0f);
+                ok = ok && binary_kernel_matches<ops::Div>(*k, x, y, a_step, b_step, 0.0f);
+                ok = ok && binary_kernel_matches<ops::Maximum>(*k, x, y, a_step, b_step, 0.0f);
+                ok = ok && binary_kernel_matches<ops::Gt>(*k, x, y, a_step, b_step, 0.0f);
+                ok = ok && binary_kernel_matches<ops::Gte>(*k, x, y, a_step, b_step, 0.0f);
+                ok = ok && binary_kernel_matches<ops::Lte>(*k, x, y, a_step, b_step, 0.0f);
+                ASSERT_TRUE(ok, tag + steps + " arithmetic and comparisons match scalar");
+            }
+            // maximum is x > y ? x : y in the vector body and the tail alike,
+            // so a NaN in either operand gives the second operand
+            ASSERT_TRUE(binary_kernel_matches<ops::Maximum>(*k, special, x, 1, 1, 0.0f), tag + " maximum with NaN first");
+            ASSERT_TRUE(binary_kernel_matches<ops::Maximum>(*k, x, special, 1, 1, 0.0f), tag + " maximum with NaN second");
+            ASSERT_TRUE(unary_kernel_matches<ops::Minus>(*k, x, 0.0f), tag + " minus matches scalar");
+
+            float ref_sum = 0.0f;
+            for (float v : x) ref_sum += v;
+            ASSERT_TRUE(kernel_value_matches(k->sum(x.data(), n), ref_sum, 1e-5f), tag + " sum matches sequential sum");
+            ASSERT_EQ(k->max(x.data(), n), *std::max_element(x.begin(), x.end()), tag + " max matches std::max_element");
+
+            // 2. log: polynomial on normal positives, libm semantics elsewhere
+            ASSERT_TRUE(unary_kernel_matches<ops::Log>(*k, pos, 1e-6f), tag + " log matches std::log");
+            ASSERT_TRUE(unary_kernel_matches<ops::Log>(*k, special, 1e-6f), tag + " log of special values");
+
+            // 3. pow: shared integral exponent, positive bases, general case
+            ASSERT_TRUE(binary_kernel_matches<ops::Pow>(*k, x, int_exp, 1, 1, 1e-6f), tag + " pow with integral exponent");
+            ASSERT_TRUE(binary_kernel_matches<ops::Pow>(*k, pos, any_exp, 1, 1, 1e-5f), tag + " pow of positive bases");
+            ASSERT_TRUE(binary_kernel_matches<ops::Pow>(*k, x, any_exp, 1, 1, 1e-5f), tag + " pow of mixed-sign bases");
+            ASSERT_TRUE(binary_kernel_matches<ops::Pow>(*k, special, any_exp, 1, 1, 1e-5f), tag + " pow of special values");
+            ASSERT_TRUE(binary_kernel_matches<ops::Pow>(*k, pos, int_exp, 1, 0, 1e-6f), tag + " pow with broadcast exponent");
+
+            // 4. exp: polynomial up to overflow, underflow flushed to 0
+            ASSERT_TRUE(unary_kernel_matches<ops::Exp>(*k, x, 1e-6f), tag + " exp matches std::exp");
+            ASSERT_TRUE(unary_kernel_matches<ops::Exp>(*k, wide, 1e-6f), tag + " exp underflow and overflow");
+            ASSERT_TRUE(unary_kernel_matches<ops::Exp>(*k, special, 1e-6f), tag + " exp of special values");
+
+            // 5. relu with its bit mask, and the masked backward
+            for (const std::vector<float>* in : {&x, &special}) {
+                std::vector<float> out(n), back(n);
+                std::vector<uint64_t> mask((n + 63) / 64);
+                k->relu(in->data(), out.data(), mask.data(), n);
+                k->relu_backward(y.data(), mask.data(), back.data(), n);
+                bool ok { true };
+                for (size_t i = 0; i < n; i++) {
+                    const bool pos { (*in)[i] > 0.0f };
+                    ok = ok && kernel_value_matches(out[i], pos ? (*in)[i] : 0.0f, 0.0f);
+                    ok = ok && ((mask[i / 64] >> (i % 64)) & 1u) == pos;
+                    ok = ok && back[i] == (pos ? y[i] : 0.0f);
+                }
+                ASSERT_TRUE(ok, tag + " relu value, mask bits and masked gradient");
+            }
+        }
+    }
+}
+
+#endif
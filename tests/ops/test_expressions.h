@@ -0,0 +1,118 @@
+#ifndef TEST_EXPRESSIONS_H
+#define TEST_EXPRESSIONS_H
+
+#include <cmath>
+#include <vector>
+
+#include "src/core/expressions.h"
+#include "src/core/grad_fns.h"
+#include "src/core/nn/losses.h"
+#include "tests/test_utils.h"
+
+// true when a and b have the same shape and values up to tol
+bool tensors_match(const Tensor& a, const Tensor& b, float tol) {
+    if (!(a.shape() == b.shape())) return false;
+    for (size_t i = 0; i < a.numel(); i++) {
+        const float x = a.m_node->m_storage.get_entry_ref(i);
+        const float y = b.m_node->m_storage.get_entry_ref(i);
+        if (std::abs(x - y) > tol * std::max(1.0f, std::abs(y))) return false;
+    }
+    return true;
+}
+
+void test_expressions() {
+
+    std::cout << "\n===[ test_expressions.h ]===\n";
+
+    using mt::expr::lazy;
+
+    // 1. Fused trees match the eager operators, across several blocks
+    {
+        Tensor a = Tensor::linspace({7, 300}, -2.0f, 3.0f);
+        Tensor b = Tensor::linspace({7, 300}, 0.5f, 4.0f);
+        Tensor g = Tensor::linspace({7, 300}, 1.0f, -1.0f);
+
+        Tensor fused = -lazy(a) / (lazy(b) * b) * g;
+        ASSERT_TRUE(tensors_match(fused, -a / (b * b) * g, 1e-6f), "-a / (b * b) * g");
+
+        Tensor fused_log = mt::expr::log(lazy(b) + 1.0f) * 2.0f - mt::expr::maximum(lazy(a), 0.0f);
+        ASSERT_TRUE(tensors_match(fused_log, (b + 1.0f).log() * 2.0f - Tensor::maximum(a, 0.0f), 1e-6f), "unary and scalar nodes");
+
+        Tensor mask = mt::expr::gt(lazy(a), b) + mt::expr::lte(lazy(a), b);
+        ASSERT_TRUE(tensors_match(mask, Tensor({7, 300}, 1.0f), 0.0f), "comparison masks partition the elements");
+    }
+
+    // 2. Strided and broadcast leaves, and a scalar-only subtree
+    {
+        Tensor a = Tensor::linspace({5, 3}, 1.0f, 15.0f).transpose(0, 1); // {3, 5}
+        Tensor row = Tensor::linspace({5}, 1.0f, 5.0f);
+        Tensor col = Tensor::linspace({3, 1}, 10.0f, 30.0f);
+
+        Tensor fused = (lazy(a) + row) * col - mt::expr::Scalar(2.0f) * 3.0f;
+        ASSERT_TRUE(tensors_match(fused, (a + row) * col - 6.0f, 1e-6f), "transposed, row and column leaves");
+    }
+
+    // 3. Results are plain tensors, the graph is not extended
+    {
+        Tensor a = Tensor::linspace({4}, 1.0f, 4.0f);
+        Tensor fused = lazy(a) * 2.0f;
+        ASSERT_TRUE(fused.m_node->m_grad_fn == nullptr, "no grad_fn on fused results");
+        ASSERT_TRUE(!fused.m_node->m_requires_grad, "fused results do not require grad");
+    }
+
+    // 4. In-place assignment reading its own target
+    {
+        Tensor p = Tensor::linspace({1000}, 0.0f, 999.0f);
+        Tensor g({1000}, 2.0f);
+        mt::expr::assign(p, lazy(p) - lazy(g) * 0.5f);
+        ASSERT_EQ(p[{999}], 998.0f, "p - 0.5 * g in place");
+
+        Tensor small({3}, 1.0f);
+        ASSERT_THROWS(mt::expr::assign(small, lazy(small) + p), std::invalid_argument);
+    }
+
+    // 5. Fused BCE with logits agrees with the unfused formula and its gradient
+    {
+        Tensor x = Tensor::linspace({4, 3}, -6.0f, 5.0f);
+        Tensor y = Tensor::linspace({4, 3}, 0.0f, 1.0f);
+        Tensor loss = mt::nn::BCELossWithLogits().forward(x, y);
+
+        float expected_loss = 0.0f;
+        std::vector<float> expected_grad(12);
+        for (size_t i = 0; i < 12; i++) {
+            const float xi = x.m_node->m_storage.get_entry_ref(i);
+            const float yi = y.m_node->m_storage.get_entry_ref(i);
+            expected_loss += std::max(xi, 0.0f) - xi * yi + std::log1p(std::exp(-std::abs(xi)));
+            expected_grad[i] = (1.0f / (1.0f + std::exp(-xi)) - yi) / 4.0f;
+        }
+        ASSERT_EQ_APPROX(loss.sum().item(), expected_loss / 4.0f, 1e-4, "BCE value");
+
+        loss.sum().backward();
+        bool grad_ok = true;
+        for (size_t i = 0; i < 12; i++) {
+            grad_ok = grad_ok && std::abs(x.grad().m_node->m_storage.get_entry_ref(i) - expected_grad[i]) < 1e-5f;
+        }
+        ASSERT_TRUE(grad_ok, "BCE gradient is (sigmoid(x) - y) / N");
+    }
+
+    // 6. create_graph keeps the tracked formulas, so the gradient can be
+    // differentiated again
+    {
+        Tensor x = Tensor::linspace({3}, 1.0f, 3.0f);
+        (2.0f / x).sum().backward(false, true);
+        Tensor g = x.grad(); // -2 / x^2
+        ASSERT_TRUE(g.m_node->m_grad_fn != nullptr, "the gradient of rdiv is tracked");
+        x.zero_grad();
+        g.sum().backward();
+        ASSERT_EQ_APPROX(x.grad()[{1}], 0.5f, 1e-5, "d2(2/x)/dx2 = 4/x^3");
+
+        Tensor z = Tensor::linspace({3}, 1.0f, 3.0f);
+        z.pow(3.0f).sum().backward(false, true);
+        Tensor h = z.grad(); // 3 z^2
+        z.zero_grad();
+        h.sum().backward();
+        ASSERT_EQ_APPROX(z.grad()[{2}], 18.0f, 1e-4, "d2(z^3)/dz2 = 6z");
+    }
+}
+
+#endif
@@ -158,6 +158,59 @@ void test_tensor_matmul() {
         ASSERT_EQ(q.grad()[{1}], 2.0f, "q.grad dot 1");
         ASSERT_EQ(q.grad()[{2}], 3.0f, "q.grad dot 2");
     }
+
+    // 8. Sizes spanning several register and cache blocks, strided (transposed) lhs
+    {
+        const size_t m = 37, k = 300, n = 21;
+        Tensor At = Tensor::linspace({k, m}, -1.0f, 1.0f); // A is the transpose of At
+        Tensor B = Tensor::linspace({k, n}, 2.0f, -2.0f);
+
+        Tensor C = Tensor::matmul(At.transpose(0, 1), B);
+        ASSERT_EQ(C.shape()[0], m, "blocked matmul rows");
+        ASSERT_EQ(C.shape()[1], n, "blocked matmul cols");
+
+        float max_err = 0.0f;
+        for (size_t i = 0; i < m; ++i) {
+            for (size_t j = 0; j < n; ++j) {
+                double ref = 0.0;
+                for (size_t p = 0; p < k; ++p) {
+                    ref += static_cast<double>(At[{p, i}]) * static_cast<double>(B[{p, j}]);
+                }
+                max_err = std::max(max_err, std::abs(C[{i, j}] - static_cast<float>(ref)));
+            }
+        }
+        ASSERT_EQ_APPROX(max_err, 0.0f, 1e-3, "blocked matmul matches naive reference");
+
+        C.backward();
+
+        // dAt[p,i] = sum_j B[p,j], dB[p,j] = sum_i At[p,i]
+        float b_row0 = 0.0f, at_row0 = 0.0f;
+        for (size_t j = 0; j < n; ++j) b_row0 += B[{0, j}];
+        for (size_t i = 0; i < m; ++i) at_row0 += At[{0, i}];
+        ASSERT_EQ_APPROX(At.grad()[{0, 5}], b_row0, 1e-3, "blocked matmul grad through transposed lhs");
+        ASSERT_EQ_APPROX(B.grad()[{0, 7}], at_row0, 1e-3, "blocked matmul grad of rhs");
+    }
+
+    // 9. An empty inner dimension (singletons expanded 0 times): the output
+    // is zeros, and the fused linear still adds the bias and applies ReLU
+    {
+        Tensor A = Tensor({5, 1}, 1.0f).expand(1, 0); // {5, 0}
+        Tensor B = Tensor({1, 20}, 1.0f).expand(0, 0); // {0, 20}
+        Tensor C = Tensor::matmul(A, B);
+        bool zeros = true;
+        for (size_t i = 0; i < 5; ++i) {
+            for (size_t j = 0; j < 20; ++j) zeros = zeros && C[{i, j}] == 0.0f;
+        }
+        ASSERT_TRUE(zeros, "matmul with k == 0 is zeros");
+
+        Tensor bias = Tensor::linspace({20}, -1.0f, 1.0f);
+        Tensor L = Tensor::linear(A, B, bias, mt::kernels::Activation::ReLU);
+        bool epilogue = true;
+        for (size_t i = 0; i < 5; ++i) {
+            for (size_t j = 0; j < 20; ++j) epilogue = epilogue && L[{i, j}] == std::max(bias[{j}], 0.0f);
+        }
+        ASSERT_TRUE(epilogue, "linear with k == 0 is relu(bias)");
+    }
 }
 
 #endif
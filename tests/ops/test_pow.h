@@ -4,6 +4,7 @@
 #include <cmath>
 
 #include "src/core/tensors.h"
+#include "src/core/grad_fns.h"
 #include "tests/test_utils.h"
 
 void test_tensor_pow() {
@@ -73,6 +74,22 @@ void test_tensor_pow() {
         float expected_dy = 4.0f * std::log(2.0f);
         ASSERT_EQ_APPROX(y.grad().item(), expected_dy, 1e-4, "grad exp (2^2)");
     }
+
+    // 5. Constant exponent: only the base needs grad, the ln(base) term is
+    // skipped, so negative bases are fine
+    {
+        Tensor x({2}); x.fill_inplace(-3.0f);
+        Tensor y({2}, 2.0f, false);
+
+        Tensor z = x.pow(y);
+        const auto* grad_fn = dynamic_cast<const BackwardPow*>(z.m_node->m_grad_fn.get());
+        ASSERT_TRUE(grad_fn != nullptr, "pow records BackwardPow");
+        ASSERT_TRUE(grad_fn->m_needs_grad[0] && !grad_fn->m_needs_grad[1], "needs grad recorded per operand");
+
+        z.sum().backward();
+        ASSERT_EQ(x.grad()[{1}], -6.0f, "grad base ((-3)^2)");
+        ASSERT_TRUE(y.m_node->m_grad == nullptr, "no grad buffer for the constant exponent");
+    }
 }
 
 #endif
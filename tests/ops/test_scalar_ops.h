@@ -0,0 +1,79 @@
+#ifndef TEST_SCALAR_OPS_H
+#define TEST_SCALAR_OPS_H
+
+#include <cmath>
+#include <vector>
+
+#include "src/core/tensors.h"
+#include "tests/test_utils.h"
+
+void test_scalar_ops() {
+
+    std::cout << "\n===[ test_scalar_ops.h ]===\n";
+
+    // 1. Forward: float on either side
+    {
+        Tensor x = Tensor::linspace({5}, 1.0f, 5.0f); // [1,2,3,4,5]
+
+        ASSERT_EQ((x + 2.0f)[{4}], 7.0f, "x + 2 at index 4");
+        ASSERT_EQ((x - 2.0f)[{0}], -1.0f, "x - 2 at index 0");
+        ASSERT_EQ((x * 3.0f)[{1}], 6.0f, "x * 3 at index 1");
+        ASSERT_EQ((x / 2.0f)[{2}], 1.5f, "x / 2 at index 2");
+        ASSERT_EQ(x.pow(2.0f)[{3}], 16.0f, "x ^ 2 at index 3");
+        ASSERT_EQ(Tensor::maximum(x, 2.5f)[{0}], 2.5f, "max(x, 2.5) at index 0");
+        ASSERT_EQ((x > 2.0f)[{2}], 1.0f, "x > 2 at index 2");
+
+        ASSERT_EQ((10.0f + x)[{0}], 11.0f, "10 + x at index 0");
+        ASSERT_EQ((10.0f - x)[{0}], 9.0f, "10 - x at index 0");
+        ASSERT_EQ((2.0f * x)[{4}], 10.0f, "2 * x at index 4");
+        ASSERT_EQ((12.0f / x)[{3}], 3.0f, "12 / x at index 3");
+        ASSERT_EQ_APPROX(Tensor::pow(2.0f, x)[{4}], 32.0f, 1e-4, "2 ^ x at index 4");
+    }
+
+    // 2. Strided and broadcast inputs
+    {
+        Tensor t = Tensor::linspace({3, 2}, 1.0f, 6.0f).transpose(0, 1); // {2, 3}
+        Tensor y = t * 2.0f;
+        ASSERT_EQ(y[{1, 2}], 12.0f, "scalar op on a transposed view");
+
+        Tensor e = Tensor::linspace({1, 3}, 1.0f, 3.0f).expand(0, 4);
+        Tensor z = 1.0f - e;
+        ASSERT_EQ(z[{3, 2}], -2.0f, "scalar op on an expanded view");
+    }
+
+    // 3. Gradients
+    {
+        Tensor x = Tensor::linspace({3}, 1.0f, 3.0f);
+        Tensor y = (x * 3.0f + 1.0f) / 2.0f - 4.0f;
+        y.backward();
+        ASSERT_EQ(x.grad()[{1}], 1.5f, "d((3x + 1) / 2 - 4)/dx == 1.5");
+    }
+    {
+        Tensor x = Tensor::linspace({3}, 1.0f, 3.0f);
+        Tensor y = 6.0f / x + (5.0f - x);
+        y.backward();
+        ASSERT_EQ(x.grad()[{1}], -2.5f, "d(6/x + 5 - x)/dx at 2 == -6/4 - 1");
+    }
+    {
+        Tensor x = Tensor::linspace({3}, 1.0f, 3.0f);
+        Tensor y = x.pow(3.0f);
+        y.backward();
+        ASSERT_EQ_APPROX(x.grad()[{2}], 27.0f, 1e-4, "d(x^3)/dx at 3 == 27");
+    }
+    {
+        Tensor x = Tensor::linspace({3}, 1.0f, 3.0f);
+        Tensor y = Tensor::pow(2.0f, x);
+        y.backward();
+        ASSERT_EQ_APPROX(x.grad()[{2}], 8.0f * std::log(2.0f), 1e-4, "d(2^x)/dx at 3 == 8 ln 2");
+    }
+    {
+        Tensor x = Tensor::linspace({3}, -1.0f, 1.0f); // [-1, 0, 1]
+        Tensor y = Tensor::maximum(x, 0.0f);
+        y.backward();
+        ASSERT_EQ(x.grad()[{0}], 0.0f, "max(x, 0) grad below the threshold");
+        ASSERT_EQ(x.grad()[{1}], 0.0f, "max(x, 0) grad at the threshold");
+        ASSERT_EQ(x.grad()[{2}], 1.0f, "max(x, 0) grad above the threshold");
+    }
+}
+
+#endif
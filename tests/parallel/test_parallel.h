@@ -0,0 +1,104 @@
+#ifndef TEST_PARALLEL_H
+#define TEST_PARALLEL_H
+
+#include <atomic>
+#include <cmath>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "src/core/parallel.h"
+#include "src/core/tensors.h"
+#include "tests/test_utils.h"
+
+// Runs a few large ops, the results must not depend on the pool size.
+std::vector<Tensor> run_parallel_workload() {
+    Tensor a = Tensor::linspace({300, 257}, -1.0f, 1.0f);
+    Tensor b = Tensor::linspace({257, 190}, 2.0f, -2.0f);
+    Tensor c = Tensor::linspace({300, 257}, 0.5f, 3.0f);
+
+    Tensor rows = a.unsqueeze(0).expand(0, 4);
+    return {
+        a + c,
+        (a * c).log(),
+        a.transpose(0, 1) + c.transpose(0, 1),
+        a.sum(0),
+        a.sum(1),
+        Tensor::matmul(a, b),
+        mt::stack({a, c, a.transpose(0, 1).transpose(0, 1)}),
+        rows.sum(0)
+    };
+}
+
+bool same_values(const Tensor& x, const Tensor& y) {
+    if (x.shape() != y.shape()) return false;
+    for (size_t i = 0; i < x.numel(); i++) {
+        const float u = x.m_node->m_storage.get_entry_ref(i);
+        const float v = y.m_node->m_storage.get_entry_ref(i);
+        if (u != v && !(std::isnan(u) && std::isnan(v))) return false;
+    }
+    return true;
+}
+
+void test_parallel() {
+
+    std::cout << "\n===[ test_parallel.h ]===\n";
+
+    const size_t default_threads = mt::get_num_threads();
+
+    // 1. every index is visited exactly once, in chunks of at least grain
+    {
+        mt::set_num_threads(4);
+        const size_t n = 100003;
+        std::vector<std::atomic<int>> hits(n);
+        std::atomic<bool> small_chunk { false };
+        mt::parallel_for(0, n, 1000, [&](size_t begin, size_t end) {
+            if (end - begin < 1000 && end != n) small_chunk = true;
+            for (size_t i = begin; i < end; i++) hits[i]++;
+        });
+        bool once = true;
+        for (size_t i = 0; i < n; i++) once = once && hits[i] == 1;
+        ASSERT_TRUE(once, "parallel_for covers the range exactly once");
+        ASSERT_TRUE(!small_chunk, "parallel_for chunks respect the grain");
+    }
+
+    // 2. ranges within the grain stay on the calling thread
+    {
+        mt::set_num_threads(4);
+        const std::thread::id caller = std::this_thread::get_id();
+        bool same_thread = true;
+        mt::parallel_for(0, 100, 1000, [&](size_t, size_t) {
+            same_thread = same_thread && std::this_thread::get_id() == caller;
+        });
+        ASSERT_TRUE(same_thread, "small range runs on the calling thread");
+    }
+
+    // 3. exceptions thrown by a chunk reach the caller
+    {
+        mt::set_num_threads(4);
+        ASSERT_THROWS(
+            mt::parallel_for(0, 10000, 10, [](size_t begin, size_t end) {
+                if (begin <= 5000 && 5000 < end) throw std::runtime_error("chunk failed");
+            }),
+            std::runtime_error
+        );
+    }
+
+    // 4. tensor ops give identical results with one and several threads
+    {
+        mt::set_num_threads(1);
+        const std::vector<Tensor> serial = run_parallel_workload();
+        mt::set_num_threads(4);
+        const std::vector<Tensor> parallel = run_parallel_workload();
+
+        bool same = serial.size() == parallel.size();
+        for (size_t i = 0; same && i < serial.size(); i++) {
+            same = same_values(serial[i], parallel[i]);
+        }
+        ASSERT_TRUE(same, "ops match between 1 and 4 threads");
+    }
+
+    mt::set_num_threads(default_threads);
+}
+
+#endif
@@ -75,6 +75,18 @@ void test_storage_mean() {
             }
         }
     }
+    // 7. Multi-axis and full means
+    {
+        Tensor a = Tensor::linspace({2, 3, 4}, 1.0f, 24.0f);
+        Tensor m = a.mean(std::vector<size_t>{0, 2}, true);
+        ASSERT_TRUE(m.shape() == std::vector<size_t>{1, 3, 1}, "multi-axis mean keepdim shape");
+        ASSERT_EQ_APPROX(m[std::vector<size_t>{0, 1, 0}], 12.5f, 1e-5, "mean over i,k at j=1");
+
+        Tensor all = a.mean();
+        ASSERT_EQ_APPROX(all.item(), 12.5f, 1e-5, "mean of 1..24");
+        all.backward();
+        ASSERT_EQ_APPROX(a.grad()[std::vector<size_t>{1, 2, 3}], 1.0f / 24.0f, 1e-7, "full mean grad == 1/24");
+    }
 }
 
 #endif
@@ -90,6 +90,83 @@ void test_storage_sum() {
             }
         }
     }
+
+    // 8. keepdim, multi-axis and full reductions on a 3D tensor
+    {
+        Tensor a = Tensor::linspace({2, 3, 4}, 1.0f, 24.0f); // a[i,j,k] = 12i + 4j + k + 1
+
+        Tensor k1 = a.sum(1, true);
+        ASSERT_TRUE(k1.shape() == std::vector<size_t>{2, 1, 4}, "keepdim keeps a singleton");
+        ASSERT_EQ(k1[std::vector<size_t>{1, 0, 2}], 57.0f, "sum over j of 15+4j");
+
+        Tensor s02 = a.sum(std::vector<size_t>{2, 0});
+        ASSERT_TRUE(s02.shape() == std::vector<size_t>{3}, "multi-axis sum drops both dims");
+        ASSERT_EQ(s02[std::vector<size_t>{1}], 100.0f, "sum over i,k at j=1");
+
+        Tensor s02k = a.sum(std::vector<size_t>{0, 2}, true);
+        ASSERT_TRUE(s02k.shape() == std::vector<size_t>{1, 3, 1}, "multi-axis keepdim shape");
+
+        Tensor all = a.sum();
+        ASSERT_EQ(all.shape().size(), (size_t)0, "full sum is a scalar");
+        ASSERT_EQ(all.item(), 300.0f, "sum of 1..24 == 300");
+
+        ASSERT_THROWS(a.sum(std::vector<size_t>{1, 1}), std::invalid_argument);
+        ASSERT_THROWS(a.sum(std::vector<size_t>{0, 3}), std::invalid_argument);
+    }
+
+    // 9. Inner and outer reductions of strided views match a naive sum
+    {
+        Tensor a = Tensor::linspace({37, 70}, -3.0f, 5.0f);
+        Tensor t = a.transpose(0, 1); // {70, 37}, non-contiguous
+        for (size_t dim = 0; dim < 2; dim++) {
+            Tensor s = t.sum(dim);
+            bool ok = true;
+            for (size_t o = 0; o < s.numel(); o++) {
+                float ref = 0.0f;
+                for (size_t r = 0; r < t.shape()[dim]; r++) {
+                    ref += dim == 0 ? t[std::vector<size_t>{r, o}] : t[std::vector<size_t>{o, r}];
+                }
+                ok = ok && std::abs(s[std::vector<size_t>{o}] - ref) <= 1e-3f;
+            }
+            ASSERT_TRUE(ok, "strided sum matches naive sum along dim " + std::to_string(dim));
+        }
+
+        Tensor expanded = Tensor::linspace({5}, 1.0f, 5.0f).unsqueeze(0).expand(0, 40);
+        ASSERT_EQ(expanded.sum(0)[std::vector<size_t>{4}], 200.0f, "sum over an expanded dim");
+        ASSERT_EQ(expanded.sum().item(), 600.0f, "full sum of an expanded view");
+    }
+
+    // 10. Large full reduction (split in partial sums) stays accurate
+    {
+        Tensor a({300, 500}, 0.5f);
+        ASSERT_EQ(a.sum().item(), 75000.0f, "full sum of 150000 halves");
+        ASSERT_EQ(a.transpose(0, 1).sum().item(), 75000.0f, "full sum of a transposed view");
+    }
+
+    // 11. Backward of a multi-axis reduction, with and without keepdim
+    {
+        Tensor a = Tensor::linspace({2, 3, 4}, 1.0f, 24.0f);
+        Tensor s = a.sum(std::vector<size_t>{0, 2});
+        Tensor w = Tensor::linspace({3}, 1.0f, 3.0f);
+        (s * w).backward();
+        Tensor g = a.grad();
+        ASSERT_EQ(g[std::vector<size_t>{1, 2, 3}], 3.0f, "grad broadcast along both reduced dims");
+        ASSERT_EQ(g[std::vector<size_t>{0, 0, 1}], 1.0f, "grad picks the weight of its row");
+
+        Tensor b = Tensor::linspace({2, 3}, 1.0f, 6.0f);
+        b.sum(1, true).backward();
+        ASSERT_EQ(b.grad()[std::vector<size_t>{1, 2}], 1.0f, "keepdim grad broadcasts back");
+    }
+
+    // 12. An empty dimension (a singleton expanded 0 times) next to a kept
+    // one sums to zeros
+    {
+        Tensor a = Tensor({4, 1, 3}, 1.0f).expand(1, 0);
+        Tensor s = a.sum(1);
+        ASSERT_TRUE(s.shape() == std::vector<size_t>{4, 3}, "sum over the empty dim keeps the others");
+        ASSERT_EQ(s[std::vector<size_t>{3, 2}], 0.0f, "sum over no elements is 0");
+        ASSERT_EQ(a.sum().item(), 0.0f, "full sum of an empty tensor is 0");
+    }
 }
 
 #endif
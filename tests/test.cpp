@@ -13,16 +13,36 @@
 #include "ops/test_pow.h"
 #include "ops/test_log.h"
 #include "ops/test_ops.h"
+#include "ops/test_elementwise_kernels.h"
+#include "ops/test_broadcast.h"
+#include "ops/test_scalar_ops.h"
+#include "ops/test_expressions.h"
 #include "views/test_unsqueeze.h"
 #include "views/test_squeeze.h"
 #include "views/test_repeat.h"
 #include "views/test_expand.h"
+#include "views/test_transpose.h"
 #include "reduces/test_sum.h"
 #include "reduces/test_mean.h"
 #include "nn/activations/test_ReLU.h"
+#include "nn/activations/test_Softmax.h"
+#include "nn/activations/test_LogSoftmax.h"
 #include "nn/losses/test_MSELoss.h"
 #include "nn/losses/test_CrossEntropyLoss.h"
 #include "nn/test_nn.h"
+#include "parallel/test_parallel.h"
+#include "memory/test_allocator.h"
+#include "memory/test_small_vector.h"
+#include "autograd/test_grad_mode.h"
+#include "autograd/test_create_graph.h"
+#include "autograd/test_grad_accumulation.h"
+#include "autograd/test_retain_grad.h"
+#include "autograd/test_engine.h"
+#include "autograd/test_tape.h"
+#include "jit/test_capture.h"
+#include "jit/test_codegen.h"
+#include "jit/test_memory_plan.h"
+#include "jit/test_passes.h"
 
 void test_tensors_with_dims0() {
     // no tensor with 0 dims
@@ -78,18 +98,39 @@ int main() {
     test_chained_ops();
     test_chained_ops_more();
     test_tensor_log();
+    test_elementwise_kernels();
+    test_broadcast();
+    test_scalar_ops();
+    test_expressions();
     test_unsqueeze();
     test_squeeze();
     test_repeat();
     test_expand();
+    test_transpose();
     test_relu_forward_backward();
+    test_softmax_forward_backward();
+    test_log_softmax_forward_backward();
     test_storage_sum();
     test_storage_mean();
     test_tensor_matmul();
     test_linear_relu_forward_backward();
     test_two_layer_linear_relu_linear_backward();
+    test_fused_linear_forward_backward();
     test_mse_loss_forward_backward();
     test_crossentropy_loss_forward_backward();
+    test_parallel();
+    test_allocator();
+    test_small_vector();
+    test_grad_mode();
+    test_create_graph();
+    test_grad_accumulation();
+    test_retain_grad();
+    test_backward_engine();
+    test_tape();
+    test_capture();
+    test_codegen();
+    test_memory_plan();
+    test_passes();
     
     if (failed_tests == 0) {
         std::cout << "\nAll tests passed!\n";
@@ -23,6 +23,20 @@ void test_expand() {
         r[{3,1,2}] = 123.0f;
         ASSERT_EQ(t[{0,1,2}], 123.0f, "mutation through expanded view updates original");
     }
+
+    // 2. Element-wise ops on expanded (stride-0) views read every broadcast position
+    {
+        Tensor col = Tensor::linspace({2, 1}, 1.0f, 2.0f);  // [[1],[2]]
+        Tensor row = Tensor::linspace({1, 3}, 10.0f, 30.0f); // [[10,20,30]]
+
+        Tensor out = col.expand(1, 3) + row.expand(0, 2);  // shape {2,3}
+
+        ASSERT_EQ(out[{0,0}], 11.0f, "expanded add at 0,0");
+        ASSERT_EQ(out[{0,2}], 31.0f, "expanded add at 0,2");
+        ASSERT_EQ(out[{1,1}], 22.0f, "expanded add at 1,1");
+        ASSERT_EQ(out[{1,2}], 32.0f, "expanded add at 1,2");
+        ASSERT_TRUE(out.is_contiguous(), "element-wise result on views is contiguous");
+    }
 }
 
 #endif
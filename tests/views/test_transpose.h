@@ -0,0 +1,46 @@
+#ifndef TEST_TRANSPOSE_H
+#define TEST_TRANSPOSE_H
+
+#include "src/core/tensors.h"
+#include "tests/test_utils.h"
+
+void test_transpose() {
+    std::cout << "\n===[ test_transpose.h ]===\n";
+
+    // 1. Transpose swaps shape and strides without copying
+    {
+        Tensor t = Tensor::linspace({2, 3}, 0.0f, 5.0f);
+        Tensor tt = t.transpose(0, 1); // shape -> {3,2}
+
+        ASSERT_EQ(tt.shape()[0], static_cast<size_t>(3), "transposed dim 0 == 3");
+        ASSERT_EQ(tt.shape()[1], static_cast<size_t>(2), "transposed dim 1 == 2");
+        ASSERT_TRUE(tt.m_node->m_storage.m_flat_data == t.m_node->m_storage.m_flat_data, "transpose shares underlying storage");
+        ASSERT_TRUE(!tt.is_contiguous(), "transposed view is not contiguous");
+
+        ASSERT_EQ(tt[{2, 1}], t[{1, 2}], "value preserved after transpose at 2,1");
+        ASSERT_EQ(tt[{1, 0}], t[{0, 1}], "value preserved after transpose at 1,0");
+    }
+
+    // 2. Out-of-range transpose should throw
+    {
+        Tensor t({2, 3});
+        ASSERT_THROWS(t.transpose(0, 2), std::invalid_argument);
+    }
+
+    // 3. Backward: gradient is transposed back to the original layout
+    {
+        Tensor t = Tensor::linspace({2, 3}, 0.0f, 5.0f);
+        Tensor w = Tensor::linspace({3, 2}, 1.0f, 6.0f);
+
+        Tensor y = t.transpose(0, 1) * w; // shape {3,2}
+        y.backward();
+
+        Tensor g = t.grad();
+        ASSERT_EQ(g.shape()[0], static_cast<size_t>(2), "grad dim0 == 2");
+        ASSERT_EQ(g.shape()[1], static_cast<size_t>(3), "grad dim1 == 3");
+        ASSERT_EQ(g[{0, 2}], w[{2, 0}], "grad at 0,2 == w at 2,0");
+        ASSERT_EQ(g[{1, 0}], w[{0, 1}], "grad at 1,0 == w at 0,1");
+    }
+}
+
+#endif
@@ -0,0 +1,152 @@
+// Checks the code generated by codegen.out against the library on a random
+// batch, and times both. Built by `make aot`.
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "covertype_forward.h"
+#include "covertype_step.h"
+#include "src/core/grad_mode.h"
+#include "src/core/nn/losses.h"
+#include "src/models/covertype.h"
+
+using mt::models::CovertypeClassifier;
+
+namespace {
+    constexpr float TOLERANCE { 1e-4f };
+
+    // Largest difference between the entries of expected and actual,
+    // relative to expected.
+    float max_error(
+            const Tensor& expected,
+            const std::vector<float>& actual
+    ) {
+        float error { 0.0f };
+        for (size_t i = 0; i < actual.size(); ++i) {
+            const float e { expected.m_node->m_storage.get_entry_ref(i) };
+            error = std::max(error, std::abs(actual[i] - e) / std::max(1.0f, std::abs(e)));
+        }
+        return error;
+    }
+
+    // Microseconds per call of f.
+    double time_us(
+            const std::function<void()>& f
+    ) {
+        constexpr size_t RUNS { 2000 };
+        f();
+        const auto start = std::chrono::high_resolution_clock::now();
+        for (size_t i = 0; i < RUNS; ++i) f();
+        const std::chrono::duration<double, std::micro> elapsed { std::chrono::high_resolution_clock::now() - start };
+        return elapsed.count() / static_cast<double>(RUNS);
+    }
+
+    // The model's parameters in the order of the generated code.
+    template <size_t N>
+    std::vector<Tensor> params_of(
+            const CovertypeClassifier& model,
+            const std::array<std::string_view, N>& names
+    ) {
+        const std::map<std::string, Tensor> params { model.parameters() };
+        std::vector<Tensor> out;
+        for (const std::string_view name : names) out.push_back(params.at(std::string(name)));
+        return out;
+    }
+
+    std::vector<const float*> data_of(
+            const std::vector<Tensor>& tensors
+    ) {
+        std::vector<const float*> data;
+        for (const Tensor& t : tensors) data.push_back(t.m_node->m_storage.data());
+        return data;
+    }
+}
+
+int main() {
+    const CovertypeClassifier model(std::mt19937(1));
+    const mt::nn::CrossEntropyLoss criterion {};
+    const size_t batch_size { covertype_forward::input_numel[0] / CovertypeClassifier::NUM_FEATURES };
+
+    std::mt19937 rng(2);
+    std::uniform_real_distribution<float> feature(-1.0f, 1.0f);
+    Tensor inputs({batch_size, CovertypeClassifier::NUM_FEATURES}, 0.0f, false);
+    Tensor classes({batch_size}, 0.0f, false);
+    for (size_t i = 0; i < batch_size; ++i) {
+        for (size_t j = 0; j < CovertypeClassifier::NUM_FEATURES; ++j) inputs[{i, j}] = feature(rng);
+        classes[{i}] = static_cast<float>(rng() % CovertypeClassifier::NUM_CLASSES);
+    }
+    bool ok { true };
+
+    // forward
+    {
+        const std::vector<Tensor> params { params_of(model, covertype_forward::param_names) };
+        const std::vector<const float*> param_data { data_of(params) };
+        const float* const input_data[] { inputs.m_node->m_storage.data() };
+        std::vector<float> logits(covertype_forward::output_numel[0]);
+        float* const output_data[] { logits.data() };
+        std::vector<float> workspace(covertype_forward::workspace_numel);
+        const auto generated = [&]() {
+            covertype_forward::run(input_data, param_data.data(), output_data, workspace.data());
+        };
+        const auto eager = [&]() {
+            const mt::InferenceModeGuard inference_mode;
+            return model.forward(inputs);
+        };
+
+        generated();
+        const float error { max_error(eager(), logits) };
+        ok = ok && error < TOLERANCE;
+        std::cout << "forward: max error " << error
+            << ", eager " << time_us([&]() { eager(); }) << " us"
+            << ", generated " << time_us(generated) << " us\n";
+    }
+
+    // training step: loss and gradients
+    {
+        const std::vector<Tensor> params { params_of(model, covertype_step::param_names) };
+        const std::vector<const float*> param_data { data_of(params) };
+        const float* const input_data[] { inputs.m_node->m_storage.data(), classes.m_node->m_storage.data() };
+        std::vector<std::vector<float>> outputs;
+        std::vector<float*> output_data;
+        for (const size_t numel : covertype_step::output_numel) outputs.emplace_back(numel);
+        for (std::vector<float>& output : outputs) output_data.push_back(output.data());
+        std::vector<float> workspace(covertype_step::workspace_numel);
+        const auto generated = [&]() {
+            covertype_step::run(input_data, param_data.data(), output_data.data(), workspace.data());
+        };
+        const auto eager = [&]() {
+            Tensor loss = criterion.forward(model.forward(inputs), classes);
+            loss.backward();
+            return loss;
+        };
+
+        generated();
+        float error { max_error(eager(), outputs[0]) };
+        // the gradients' order is the order of the step's outputs
+        for (size_t k = 1; k < outputs.size(); ++k) {
+            const std::string_view name { covertype_step::output_names[k] };
+            const Tensor param = model.parameters().at(std::string(name.substr(name.find_last_of(' ') + 1)));
+            error = std::max(error, max_error(param.grad(), outputs[k]));
+        }
+        ok = ok && error < TOLERANCE;
+        const auto eager_step = [&]() {
+            eager();
+            for (const Tensor& p : params) p.m_node->m_grad = nullptr;
+        };
+        eager_step();
+        std::cout << "step: max error " << error
+            << ", eager " << time_us(eager_step) << " us"
+            << ", generated " << time_us(generated) << " us\n";
+    }
+
+    std::cout << (ok ? "generated code matches the library\n" : "generated code does not match the library\n");
+    return ok ? 0 : 1;
+}